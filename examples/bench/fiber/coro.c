@@ -0,0 +1,54 @@
+#include "fiber.h"
+
+#include <myth/myth.h>
+
+/* fibers on MassiveThreads coroutines, resumed in turn by
+   fiber_wait like those of ctx.c, without the scheduler */
+
+static myth_coro_t g_fibers[MAX_FIBERS];
+static int g_num_fibers = 0;
+
+void fiber_init(void)
+{
+	myth_init();
+}
+
+void fiber_yield(void)
+{
+	myth_coro_yield(0, 0);
+}
+
+static void * _start(void * func)
+{
+	((void (*)(void))func)();
+	return 0;
+}
+
+int fiber_spawn(void (*func)(void))
+{
+	if (g_num_fibers == MAX_FIBERS) return -1;
+	if (myth_coro_create(&g_fibers[g_num_fibers], _start, 0)) {
+		printf("Create fiber failed.\n");
+		return -1;
+	}
+	/* start it with its function */
+	myth_coro_resume(g_fibers[g_num_fibers], (void *)func, 0);
+	++ g_num_fibers;
+	return 0;
+}
+
+int fiber_wait(void)
+{
+	int i = 0;
+	while (g_num_fibers > 0) {
+		myth_coro_resume(g_fibers[i], 0, 0);
+		if (myth_coro_done(g_fibers[i])) {
+			myth_coro_destroy(g_fibers[i]);
+			g_fibers[i] = g_fibers[-- g_num_fibers];
+		} else {
+			i++;
+		}
+		if (i >= g_num_fibers) i = 0;
+	}
+	return 0;
+}
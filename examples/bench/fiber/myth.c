@@ -0,0 +1,55 @@
+#include "fiber.h"
+
+#include <myth/myth.h>
+
+/* fibers on MassiveThreads threads. run with MYTH_NUM_WORKERS=1
+   to compare the switch with ctx.c and jmp.c. built with
+   -DFIBER_FPCSR=MYTH_FPCSR_SAVE (myth_fpcsr), every fiber saves
+   its FP control registers when it switches */
+
+#ifndef FIBER_FPCSR
+#define FIBER_FPCSR MYTH_FPCSR_SHARED
+#endif
+
+static myth_thread_t g_fibers[MAX_FIBERS];
+static int g_num_fibers = 0;
+
+void fiber_init(void)
+{
+	myth_init();
+}
+
+void fiber_yield(void)
+{
+	myth_yield();
+}
+
+static void * _start(void * func)
+{
+	((void (*)(void))func)();
+	return 0;
+}
+
+int fiber_spawn(void (*func)(void))
+{
+	myth_thread_attr_t attr;
+	if (g_num_fibers == MAX_FIBERS) return -1;
+	myth_thread_attr_init(&attr);
+	attr.child_first = 0;
+	myth_thread_attr_setfpcsr(&attr, FIBER_FPCSR);
+	if (myth_create_ex(&g_fibers[g_num_fibers], &attr, _start, (void *)func)) {
+		printf("Create fiber failed.\n");
+		return -1;
+	}
+	++ g_num_fibers;
+	return 0;
+}
+
+int fiber_wait(void)
+{
+	int i;
+	for (i = 0; i < g_num_fibers; i++)
+		myth_join(g_fibers[i], 0);
+	g_num_fibers = 0;
+	return 0;
+}
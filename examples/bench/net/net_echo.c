@@ -0,0 +1,344 @@
+/*
+ * net_echo.c : loopback echo benchmark of the socket I/O layer
+ *
+ * a thread-per-connection echo server and a load generator in one
+ * process. it uses pthreads and blocking sockets only, so the same
+ * executable runs on plain pthreads (MYTH_WRAP_PTHREAD=0) or on
+ * MassiveThreads with socket calls multiplexed (MYTH_WRAP_SOCKIO=1,
+ * with MYTH_IO_URING=0 for epoll); see run.
+ *
+ * each of the client threads keeps one request in flight on each of
+ * its connections, waiting for the responses with epoll, and reports
+ * the throughput and latency percentiles over the measured period.
+ */
+#include <assert.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+/* log-linear histogram of latencies in ns: 2^SUB_BITS buckets
+   for each power of two, so a bucket is within 3% of its values */
+#define SUB_BITS 5
+#define N_BUCKETS (64 << SUB_BITS)
+
+typedef struct {
+  long count[N_BUCKETS];
+} hist_t;
+
+static int bucket_of(unsigned long v) {
+  int e;
+  if (v < (1UL << SUB_BITS)) return (int)v;
+  e = 63 - __builtin_clzl(v);
+  return ((e - SUB_BITS + 1) << SUB_BITS)
+    + (int)((v >> (e - SUB_BITS)) & ((1 << SUB_BITS) - 1));
+}
+
+static unsigned long value_of(int b) {
+  int e;
+  if (b < (1 << SUB_BITS)) return b;
+  e = (b >> SUB_BITS) + SUB_BITS - 1;
+  return (1UL << e) | ((unsigned long)(b & ((1 << SUB_BITS) - 1)) << (e - SUB_BITS));
+}
+
+/* the latency in us below which a fraction Q of the samples are */
+static double percentile(hist_t * h, long n, double q) {
+  long k = 0, want = (long)(q * n);
+  int b;
+  for (b = 0; b < N_BUCKETS; b++) {
+    k += h->count[b];
+    if (k > want) return value_of(b) * 1.0e-3;
+  }
+  return 0.0;
+}
+
+static double cur_time(void) {
+  struct timeval tv[1];
+  gettimeofday(tv, 0);
+  return tv->tv_sec + tv->tv_usec * 1.0e-6;
+}
+
+static int n_conns = 1000;
+static int n_clients = 4;
+static int msg_size = 64;
+static double warmup = 1.0;
+static double duration = 3.0;
+static const char * label = "";
+static struct sockaddr_in server_addr;
+
+static int read_all(int s, char * buf, int n) {
+  int got = 0;
+  while (got < n) {
+    ssize_t r = read(s, buf + got, n - got);
+    if (r <= 0) return -1;
+    got += r;
+  }
+  return 0;
+}
+
+static int write_all(int s, const char * buf, int n) {
+  int put = 0;
+  while (put < n) {
+    ssize_t r = write(s, buf + put, n - put);
+    if (r <= 0) return -1;
+    put += r;
+  }
+  return 0;
+}
+
+/* ---- server ---- */
+
+void * handler(void * arg) {
+  int s = (int)(long)arg;
+  char * buf = malloc(msg_size);
+  while (read_all(s, buf, msg_size) == 0) {
+    if (write_all(s, buf, msg_size) != 0) break;
+  }
+  close(s);
+  free(buf);
+  return 0;
+}
+
+typedef struct {
+  int ls;
+  pthread_t * th;
+  volatile int n;
+} acceptor_arg_t;
+
+/* accept all connections, with a thread for each */
+void * acceptor(void * arg_) {
+  acceptor_arg_t * arg = arg_;
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  pthread_attr_setstacksize(&attr, 64 * 1024);
+  for (arg->n = 0; arg->n < n_conns; arg->n++) {
+    int one = 1;
+    int s = accept(arg->ls, 0, 0);
+    if (s == -1) {
+      perror("accept");
+      break;
+    }
+    setsockopt(s, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    if (pthread_create(&arg->th[arg->n], &attr, handler, (void *)(long)s) != 0) {
+      fprintf(stderr, "pthread_create failed at %d connections\n", arg->n);
+      close(s);
+      break;
+    }
+  }
+  pthread_attr_destroy(&attr);
+  return 0;
+}
+
+/* ---- load generator ---- */
+
+typedef struct {
+  int s;
+  double sent;
+} conn_t;
+
+typedef struct {
+  int first, n;			/* connections [first, first + n) */
+  conn_t * conns;
+  double t_begin, t_end;	/* measured period */
+  long done;
+  hist_t hist;
+} client_arg_t;
+
+/* a connection from 127.0.0.X, so that there are enough ports */
+static int connect_one(int i) {
+  struct sockaddr_in a;
+  int one = 1;
+  int s = socket(AF_INET, SOCK_STREAM, 0);
+  if (s == -1) return -1;
+  memset(&a, 0, sizeof(a));
+  a.sin_family = AF_INET;
+  a.sin_addr.s_addr = htonl(INADDR_LOOPBACK + 1 + i / 20000);
+  if (bind(s, (struct sockaddr *)&a, sizeof(a)) != 0
+      || connect(s, (struct sockaddr *)&server_addr, sizeof(server_addr)) != 0) {
+    close(s);
+    return -1;
+  }
+  setsockopt(s, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  return s;
+}
+
+void * client(void * arg_) {
+  client_arg_t * arg = arg_;
+  struct epoll_event * evs = malloc(sizeof(struct epoll_event) * 256);
+  char * buf = calloc(1, msg_size);
+  int ep = epoll_create1(0);
+  int i;
+  assert(ep >= 0);
+  for (i = 0; i < arg->n; i++) {
+    conn_t * c = &arg->conns[arg->first + i];
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.ptr = c;
+    assert(epoll_ctl(ep, EPOLL_CTL_ADD, c->s, &ev) == 0);
+    c->sent = cur_time();
+    if (write_all(c->s, buf, msg_size) != 0) {
+      perror("write");
+      exit(1);
+    }
+  }
+  while (1) {
+    double t = cur_time();
+    int r, k;
+    if (t >= arg->t_end) break;
+    r = epoll_wait(ep, evs, 256, 100);
+    if (r == -1 && errno == EINTR) continue;
+    if (r == -1) {
+      perror("epoll_wait");
+      exit(1);
+    }
+    for (k = 0; k < r; k++) {
+      conn_t * c = evs[k].data.ptr;
+      if (read_all(c->s, buf, msg_size) != 0) {
+	fprintf(stderr, "connection closed by the server\n");
+	exit(1);
+      }
+      t = cur_time();
+      if (t >= arg->t_begin && t < arg->t_end) {
+	arg->hist.count[bucket_of((unsigned long)((t - c->sent) * 1.0e9))]++;
+	arg->done++;
+      }
+      c->sent = t;
+      if (write_all(c->s, buf, msg_size) != 0) {
+	perror("write");
+	exit(1);
+      }
+    }
+  }
+  /* the last responses are still coming */
+  for (i = 0; i < arg->n; i++) {
+    conn_t * c = &arg->conns[arg->first + i];
+    read_all(c->s, buf, msg_size);
+  }
+  close(ep);
+  free(buf);
+  free(evs);
+  return 0;
+}
+
+static void usage(const char * prog) {
+  fprintf(stderr,
+	  "usage: %s [-c connections] [-t client_threads] [-s msg_size]\n"
+	  "          [-w warmup_sec] [-d duration_sec] [-l label]\n", prog);
+  exit(1);
+}
+
+int main(int argc, char ** argv) {
+  acceptor_arg_t acc;
+  pthread_t acc_th, * cl_th;
+  client_arg_t * cl;
+  conn_t * conns;
+  struct rlimit rl;
+  socklen_t len = sizeof(server_addr);
+  hist_t * total;
+  long done = 0;
+  double t0;
+  int opt, i, b;
+  while ((opt = getopt(argc, argv, "c:t:s:w:d:l:")) != -1) {
+    switch (opt) {
+    case 'c': n_conns = atoi(optarg); break;
+    case 't': n_clients = atoi(optarg); break;
+    case 's': msg_size = atoi(optarg); break;
+    case 'w': warmup = atof(optarg); break;
+    case 'd': duration = atof(optarg); break;
+    case 'l': label = optarg; break;
+    default: usage(argv[0]);
+    }
+  }
+  if (n_conns < 1 || n_clients < 1 || msg_size < 1) usage(argv[0]);
+  if (n_clients > n_conns) n_clients = n_conns;
+  /* MassiveThreads starts at its first call, and sockets created
+     before that are not multiplexed; the listening socket would then
+     block a worker in accept */
+  sched_yield();
+  /* both ends of each connection are in this process */
+  if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+    rl.rlim_cur = rl.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &rl);
+  }
+  if (getrlimit(RLIMIT_NOFILE, &rl) == 0
+      && rl.rlim_cur != RLIM_INFINITY && rl.rlim_cur < 2 * (rlim_t)n_conns + 64) {
+    fprintf(stderr, "RLIMIT_NOFILE (%ld) is too low for %d connections\n",
+	    (long)rl.rlim_cur, n_conns);
+    return 1;
+  }
+  memset(&server_addr, 0, sizeof(server_addr));
+  server_addr.sin_family = AF_INET;
+  server_addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  acc.ls = socket(AF_INET, SOCK_STREAM, 0);
+  assert(acc.ls >= 0);
+  assert(bind(acc.ls, (struct sockaddr *)&server_addr, len) == 0);
+  assert(getsockname(acc.ls, (struct sockaddr *)&server_addr, &len) == 0);
+  assert(listen(acc.ls, SOMAXCONN) == 0);
+  acc.th = malloc(sizeof(pthread_t) * n_conns);
+  assert(pthread_create(&acc_th, 0, acceptor, &acc) == 0);
+  /* connect */
+  t0 = cur_time();
+  conns = malloc(sizeof(conn_t) * n_conns);
+  for (i = 0; i < n_conns; i++) {
+    conns[i].s = connect_one(i);
+    if (conns[i].s == -1) {
+      perror("connect");
+      return 1;
+    }
+    /* connecting does not block, so let the acceptor catch up
+       before the backlog overflows and SYNs are retransmitted */
+    while (i - acc.n > 1024) usleep(100);
+  }
+  pthread_join(acc_th, 0);
+  if (acc.n < n_conns) return 1;
+  fprintf(stderr, "%d connections in %.2f s\n", n_conns, cur_time() - t0);
+  /* run */
+  cl = calloc(n_clients, sizeof(client_arg_t));
+  cl_th = malloc(sizeof(pthread_t) * n_clients);
+  t0 = cur_time();
+  for (i = 0; i < n_clients; i++) {
+    cl[i].first = (long)n_conns * i / n_clients;
+    cl[i].n = (long)n_conns * (i + 1) / n_clients - cl[i].first;
+    cl[i].conns = conns;
+    cl[i].t_begin = t0 + warmup;
+    cl[i].t_end = t0 + warmup + duration;
+    assert(pthread_create(&cl_th[i], 0, client, &cl[i]) == 0);
+  }
+  total = calloc(1, sizeof(hist_t));
+  for (i = 0; i < n_clients; i++) {
+    pthread_join(cl_th[i], 0);
+    done += cl[i].done;
+    for (b = 0; b < N_BUCKETS; b++) total->count[b] += cl[i].hist.count[b];
+  }
+  /* let the handlers finish. connections are reset, or the ports
+     would be in TIME_WAIT for the next run */
+  for (i = 0; i < n_conns; i++) {
+    struct linger lg = { 1, 0 };
+    setsockopt(conns[i].s, SOL_SOCKET, SO_LINGER, &lg, sizeof(lg));
+    close(conns[i].s);
+  }
+  for (i = 0; i < n_conns; i++) pthread_join(acc.th[i], 0);
+  close(acc.ls);
+  printf("%s conns=%d clients=%d size=%d requests=%ld"
+	 " throughput=%.0f req/s p50=%.1f p99=%.1f p999=%.1f us\n",
+	 label, n_conns, n_clients, msg_size, done, done / duration,
+	 percentile(total, done, 0.5), percentile(total, done, 0.99),
+	 percentile(total, done, 0.999));
+  free(total);
+  free(cl);
+  free(cl_th);
+  free(conns);
+  free(acc.th);
+  return 0;
+}
@@ -0,0 +1,94 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <sys/time.h>
+#include <myth/myth.h>
+
+/* Fibonacci spawning children with myth_create and with
+   myth_task_spawn, which gives them a thread only when stolen */
+
+static inline double curr_time(void)
+{
+  struct timeval tv;
+  gettimeofday(&tv,NULL);
+  return tv.tv_sec + (double) tv.tv_usec * 1e-6;
+}
+
+static inline uint64_t curr_clock(void)
+{
+#if defined __i386__ || defined __x86_64__
+  uint32_t hi, lo;
+  asm volatile("lfence\nrdtsc\n" : "=a"(lo),"=d"(hi));
+  return ((uint64_t)hi)<<32 | lo;
+#elif __sparc__
+  uint64_t tick;
+  asm volatile("rd %%tick, %0" : "=r" (tick));
+  return tick;
+#else
+#error "curr_clock() not implemented"
+  return 0;
+#endif
+}
+
+void *fib_thread(void *args)
+{
+  myth_thread_t th;
+  intptr_t n = (intptr_t) args;
+  intptr_t ret1, ret2;
+
+  if (n == 0 || n == 1) return (void *) n;
+
+  th = myth_create(fib_thread, (void *) (n - 1));
+  ret2 = (intptr_t) fib_thread((void *) (n - 2));
+  myth_join(th, (void **) &ret1);
+  return (void *) (ret1 + ret2);
+}
+
+void *fib_task(void *args)
+{
+  myth_task_t t;
+  intptr_t n = (intptr_t) args;
+  intptr_t ret1, ret2;
+
+  if (n == 0 || n == 1) return (void *) n;
+
+  myth_task_spawn(&t, fib_task, (void *) (n - 1));
+  ret2 = (intptr_t) fib_task((void *) (n - 2));
+  myth_task_join(&t, (void **) &ret1);
+  return (void *) (ret1 + ret2);
+}
+
+/* number of spawns in fib(n) */
+static intptr_t n_spawns(intptr_t n)
+{
+  return (n < 2 ? 0 : 1 + n_spawns(n - 1) + n_spawns(n - 2));
+}
+
+static void run(const char *what, myth_func_t f, intptr_t n)
+{
+  double t0, t1;
+  uint64_t c0, c1;
+  intptr_t ret;
+  myth_thread_t th;
+
+  t0 = curr_time();
+  c0 = curr_clock();
+  th = myth_create(f, (void *) n);
+  myth_join(th, (void **) &ret);
+  c1 = curr_clock();
+  t1 = curr_time();
+  printf("%s: fib(%d)=%d, took %lf sec, %.1f cycles per spawn\n",
+	 what, (int)n, (int)ret, t1 - t0,
+	 (double)(c1 - c0) / n_spawns(n));
+}
+
+int main(int argc,char **argv)
+{
+  intptr_t n = (argc > 1 ? atoi(argv[1]) : 30);
+
+  myth_init();
+  run("myth_create", fib_thread, n);
+  run("myth_task_spawn", fib_task, n);
+  myth_fini();
+  return 0;
+}
@@ -363,6 +363,8 @@ extern "C" {
     size_t guardsize;
     int detachstate;
     int child_first;
+    int fpcsr;
+    struct myth_cancel_group * cancel_group;
     /* TODO: get rid of them */
     size_t custom_data_size;
     void *custom_data;
@@ -431,6 +433,49 @@ extern "C" {
   myth_thread_t myth_create_nosched(myth_func_t func, void * arg,
 				    myth_thread_attr_t * attr);
 
+  /*
+    Function: myth_create_many
+
+    Create nthreads user-level threads executing
+    func(args + i * arg_stride) (i = 0, ..., nthreads - 1)
+    at once. The caller keeps running; the threads are
+    put in runqueues in chunks, which go directly to
+    idle workers when there are some. Should the
+    caller's runqueue fill up, it lets the threads
+    there run before creating more.
+
+    Parameters:
+
+    ids - an array of nthreads elements receiving the
+    identifiers of the threads, or NULL to create them
+    detached.
+    attr - a pointer to a data structure of type
+    <myth_thread_attr_t> applied to all threads, or
+    NULL to mean the default. child_first is ignored.
+    func - a pointer to a function.
+    args - the argument given to the first thread.
+    arg_stride - the distance in bytes between the
+    arguments of consecutive threads (0 gives all of
+    them the same argument).
+    nthreads - the number of threads to create.
+
+    Returns:
+
+    0 if succeed.
+
+    Bug:
+
+    Should any error occur, it terminates the
+    program rather than returning an error
+    code.
+
+    See Also:
+    <myth_create_ex>, <myth_join>, <myth_create_join_many_ex>
+  */
+  int myth_create_many(myth_thread_t * ids, myth_thread_attr_t * attr,
+		       myth_func_t func, void * args, size_t arg_stride,
+		       long nthreads);
+
   /*
     Function: myth_exit
 
@@ -551,6 +596,62 @@ extern "C" {
 			       size_t arg_stride,
 			       size_t result_stride,
 			       long nthreads);
+
+  /*
+    Constant: MYTH_GRAINSIZE_AUTO
+
+    A grainsize to <myth_create_join_many_grain_ex> that
+    lets it choose how many elements each thread runs.
+  */
+#define MYTH_GRAINSIZE_AUTO 0
+
+  /*
+    Function: myth_create_join_many_grain_ex
+
+    The same as <myth_create_join_many_ex>, except that
+    a thread is not necessarily created for each element.
+
+    Parameters:
+
+    ids, attrs, func, args, results,
+    id_stride, attr_stride, arg_stride,
+    result_stride, nthreads - the same as <myth_create_join_many_ex>
+    grainsize -     the range of elements is split into threads
+                    until it has no more than grainsize elements,
+                    which are then executed one after another by
+                    the thread.  if it is MYTH_GRAINSIZE_AUTO,
+                    each thread runs elements until it finds a
+                    worker idle, and only then splits the rest.
+
+    with grainsize = 1, this is <myth_create_join_many_ex>.
+    with a larger grainsize, or MYTH_GRAINSIZE_AUTO, the cost
+    of creating a thread is paid once for many elements,
+    which matters when each of them does little work.
+
+    note that elements run by the same thread run sequentially,
+    so func must not block waiting for another element (e.g.,
+    by a mutex, condition variable or barrier shared among
+    elements); it may deadlock.  use grainsize = 1 for that.
+    ids receives the id of the thread that ran each element.
+
+    Returns:
+
+    0 if succeed. EINVAL if grainsize is negative.
+
+    See Also:
+    <myth_create_join_many_ex>
+  */
+  int myth_create_join_many_grain_ex(myth_thread_t * ids,
+				     myth_thread_attr_t * attrs,
+				     myth_func_t func,
+				     void * args,
+				     void * results,
+				     size_t id_stride,
+				     size_t attr_stride,
+				     size_t arg_stride,
+				     size_t result_stride,
+				     long nthreads,
+				     long grainsize);
   
   /*
     Function: myth_create_join_various_ex
@@ -640,6 +741,76 @@ extern "C" {
 				  size_t result_stride,
 				  long nthreads);
 
+  /*
+    Type: myth_task_t
+
+    A child spawned by <myth_task_spawn>. It is
+    provided by the caller, typically on its stack,
+    and must remain valid until it is joined by
+    <myth_task_join>. Its fields are private.
+  */
+  typedef struct myth_task {
+    myth_func_t func;
+    void * arg;
+    myth_thread_t thread;
+    myth_thread_t spawner;
+    volatile int state;
+  } myth_task_t;
+
+  /*
+    Function: myth_task_spawn
+
+    Spawn a child executing func(arg) that gets a
+    thread of its own only if another worker takes it
+    before the caller joins it. Otherwise <myth_task_join>
+    simply calls func(arg), so spawning costs a few stores
+    rather than allocating a thread descriptor and a stack.
+
+    Parameters:
+
+    t - a pointer to a <myth_task_t> describing the child.
+    func - a pointer to a function.
+    arg - a pointer given to func.
+
+    Returns:
+
+    0 if succeed.
+
+    Bug:
+
+    Every task must be joined exactly once by the thread
+    that spawned it. Joining tasks in the reverse order
+    they were spawned, as in fork-join programs, is the
+    fastest; other orders give threads to the tasks
+    spawned after the one joined.
+
+    See Also:
+    <myth_task_join>, <myth_create>
+  */
+  int myth_task_spawn(myth_task_t * t, myth_func_t func, void * arg);
+
+  /*
+    Function: myth_task_join
+
+    Wait for the child spawned by <myth_task_spawn> to
+    finish, calling it on the caller's stack if no other
+    worker has taken it.
+
+    Parameters:
+
+    t - the <myth_task_t> given to <myth_task_spawn>.
+    result - a pointer to a data structure receiving
+    the return value of the child, or NULL.
+
+    Returns:
+
+    0 if succeed.
+
+    See Also:
+    <myth_task_spawn>, <myth_join>
+  */
+  int myth_task_join(myth_task_t * t, void ** result);
+
   /*
     Function: myth_detach
   */
@@ -723,6 +894,59 @@ extern "C" {
   int myth_thread_attr_setstack(myth_thread_attr_t *attr,
 				void *stackaddr, size_t stacksize);
 
+  /* 
+     Constants: FP control attribute of a thread
+
+     MYTH_FPCSR_SHARED - (default) the thread leaves the floating point
+     control registers (rounding mode and exception masks; MXCSR and the
+     x87 control word on x86-64, FPCR on AArch64) as they were when
+     MassiveThreads was initialized, so they need not be saved when it
+     switches
+     MYTH_FPCSR_SAVE - the thread may change them; they are saved when it
+     switches out and restored when it resumes, possibly on another worker
+  */
+#define MYTH_FPCSR_SHARED 0
+#define MYTH_FPCSR_SAVE   1
+
+  /* 
+     Function: myth_thread_attr_getfpcsr
+
+     get the FP control attribute of attr
+     (MYTH_FPCSR_SHARED or MYTH_FPCSR_SAVE)
+   */
+  int myth_thread_attr_getfpcsr(const myth_thread_attr_t *attr, int *fpcsr);
+
+  /* 
+     Function: myth_thread_attr_setfpcsr
+
+     set the FP control attribute of attr. it returns EINVAL
+     unless fpcsr is MYTH_FPCSR_SHARED or MYTH_FPCSR_SAVE.
+     a thread made with MYTH_FPCSR_SHARED that changes the FP
+     control registers anyway changes them for the threads that
+     run after it on the same worker
+   */
+  int myth_thread_attr_setfpcsr(myth_thread_attr_t *attr, int fpcsr);
+
+  /* 
+     Function: myth_thread_attr_getcancelgroup
+
+     get the cancel group attribute of attr (see
+     <myth_thread_attr_setcancelgroup>)
+   */
+  int myth_thread_attr_getcancelgroup(const myth_thread_attr_t *attr,
+				      struct myth_cancel_group ** g);
+
+  /* 
+     Function: myth_thread_attr_setcancelgroup
+
+     set the cancel group attribute of attr. a thread created
+     with it joins cancel group g (see <myth_cancel_group>).
+     if g is null (the default), it joins that of the thread
+     creating it, if any
+   */
+  int myth_thread_attr_setcancelgroup(myth_thread_attr_t *attr,
+				      struct myth_cancel_group * g);
+
   /* 
      Function: myth_getattr_default_np
    */
@@ -818,6 +1042,34 @@ extern "C" {
 
   /* 
      Function: myth_cancel
+
+     Request cancellation of th.
+
+     Returns:
+
+     Zero.
+
+     Note:
+
+     Only deferred cancellation is supported. th acts on the
+     request when it calls <myth_testcancel>, which terminates
+     it. if th is waiting in <myth_cond_wait>, in <myth_sleep>,
+     <myth_usleep> or <myth_nanosleep>, or for a socket in a
+     call multiplexed by the I/O layer (recv, send, accept,
+     connect, poll, select, epoll_wait, and so on), it is woken
+     up, and the call fails with ECANCELED (<myth_cond_wait>
+     does so after relocking the mutex; <myth_sleep> returns the
+     seconds left instead; socket calls, and usleep and nanosleep
+     wrapped by libmyth-ld/-dl, return -1 and set errno); so do
+     those calls made after the request.
+     calls whose operation is in an io_uring or with a file I/O
+     helper are not interrupted but finish as usual.
+     nothing happens while cancellation is disabled by
+     <myth_setcancelstate>.
+
+     See Also:
+
+     <myth_cancel_group>
    */
   int myth_cancel(myth_thread_t th);
 
@@ -826,6 +1078,165 @@ extern "C" {
    */
   void myth_testcancel(void);
 
+  /*
+    Type: myth_cancel_group_t
+
+    A set of threads cancelled all at once by <myth_cancel_group>.
+    a thread joins one when it is created (see
+    <myth_thread_attr_setcancelgroup>) and leaves it when it
+    finishes, so threads created by its members join it too.
+  */
+  typedef struct myth_cancel_group * myth_cancel_group_t;
+
+  /*
+    Function: myth_cancel_group_create
+
+    Create an empty cancel group and store it to g.
+
+    Returns:
+
+    Zero if succeed, or ENOMEM.
+  */
+  int myth_cancel_group_create(myth_cancel_group_t * g);
+
+  /*
+    Function: myth_cancel_group_destroy
+
+    Destroy cancel group g.
+
+    Returns:
+
+    Zero if succeed, or EBUSY if some of its members have
+    not finished.
+  */
+  int myth_cancel_group_destroy(myth_cancel_group_t g);
+
+  /*
+    Function: myth_cancel_group
+
+    Request cancellation of all the threads of g, as
+    <myth_cancel> does for each, and of those that join it
+    later. members waiting in the calls listed in <myth_cancel>
+    are woken up; others act on it at their next
+    <myth_testcancel> or such call.
+
+    Returns:
+
+    Zero.
+
+    Note:
+
+    It visits each member once. members enter and leave one
+    list per worker, so creating and finishing members on
+    many workers does not contend on the group.
+  */
+  int myth_cancel_group(myth_cancel_group_t g);
+
+  /*
+    Type: myth_coro_t
+
+    An asymmetric coroutine. it runs on its own stack but within
+    the thread that resumes it, never enters the run queues and
+    cannot be stolen. see <myth_coro_create>.
+  */
+  typedef struct myth_coro * myth_coro_t;
+
+  /*
+    Function: myth_coro_create
+
+    Create a coroutine that executes func when it is first
+    resumed, with the value given to that <myth_coro_resume>
+    as its argument.
+
+    Parameters:
+
+    co - a pointer to which the coroutine is stored
+    func - a function to execute
+    stacksize - the size of its stack, or 0 for the default
+    stack size of threads
+
+    Returns:
+
+    Zero if succeed.
+
+    See Also:
+
+    <myth_coro_resume>, <myth_coro_yield>, <myth_coro_destroy>
+  */
+  int myth_coro_create(myth_coro_t * co, myth_func_t func, size_t stacksize);
+
+  /*
+    Function: myth_coro_resume
+
+    Run co until it calls <myth_coro_yield> or its function
+    returns.
+
+    Parameters:
+
+    co - a coroutine neither running nor finished
+    x - the value <myth_coro_yield> stores in co (or the
+    argument of its function when it is first resumed)
+    y - if not null, the value given to <myth_coro_yield>
+    (or returned by its function) is stored to it
+
+    Returns:
+
+    Zero if succeed, or EINVAL if co is running (i.e., it or
+    a coroutine it resumed called this) or has finished.
+
+    See Also:
+
+    <myth_coro_done>
+  */
+  int myth_coro_resume(myth_coro_t co, void * x, void ** y);
+
+  /*
+    Function: myth_coro_yield
+
+    Suspend the calling coroutine and go back to where it was
+    resumed with <myth_coro_resume>.
+
+    Parameters:
+
+    y - the value to give to the caller of <myth_coro_resume>
+    x - if not null, the value given to the next
+    <myth_coro_resume> of it is stored to it
+
+    Returns:
+
+    Zero if succeed, or EPERM if the caller is not in a
+    coroutine (nothing is done then).
+
+    Note:
+
+    A coroutine may call other functions of MassiveThreads and
+    block or yield the thread; the thread then migrates with it,
+    so the coroutine may later resume on another worker.
+  */
+  int myth_coro_yield(void * y, void ** x);
+
+  /*
+    Function: myth_coro_done
+
+    Returns:
+
+    1 if the function of co has returned, 0 otherwise.
+  */
+  int myth_coro_done(myth_coro_t co);
+
+  /*
+    Function: myth_coro_destroy
+
+    Release co and its stack. A coroutine suspended in
+    <myth_coro_yield> is discarded without running further
+    (nothing on its stack is cleaned up).
+
+    Returns:
+
+    Zero if succeed, or EBUSY if co is running.
+  */
+  int myth_coro_destroy(myth_coro_t co);
+
 
   enum {
     myth_once_state_init = 0,
@@ -1149,7 +1560,9 @@ extern "C" {
 
     Returns:
 
-    Zero if succeed, or an errno when an error occurred.
+    Zero if succeed, or an errno when an error occurred
+    (ECANCELED if the calling thread has been cancelled;
+    see <myth_cancel>).
 
     See Also:
 
@@ -1531,6 +1944,277 @@ extern "C" {
   */
   int myth_get_num_workers(void);
 
+  /*
+    Type: myth_alloc_stats_t
+
+    Counters of the allocator MassiveThreads uses internally
+    for thread stacks and other runtime data, and of the reuse
+    of thread descriptors and stacks.
+    See <myth_get_alloc_stats>.
+  */
+  typedef struct myth_alloc_stats {
+    unsigned long long n_allocs;  /* blocks allocated */
+    unsigned long long n_frees;   /* blocks freed */
+    unsigned long long n_remote_frees; /* of which returned to another worker */
+    unsigned long long n_spills;  /* blocks moved from a full cache to the global pool */
+    unsigned long long n_refills; /* blocks taken from the global pool */
+    unsigned long long n_maps;    /* mmap calls for slabs and large blocks */
+    unsigned long long mapped_bytes; /* total bytes mapped by them */
+    unsigned long long n_desc_hot_hits;  /* descriptors reused right after being freed */
+    unsigned long long n_desc_hot_misses; /* descriptors taken from elsewhere */
+    unsigned long long n_stack_hot_hits; /* default-sized stacks reused right after being freed */
+    unsigned long long n_stack_hot_misses; /* default-sized stacks taken from elsewhere */
+  } myth_alloc_stats_t;
+
+  /*
+    Function: myth_get_alloc_stats
+
+    Obtain allocation counters of a worker.
+
+    Parameters:
+
+    rank - the index of a worker, or -1 to sum over all workers
+    stats - a pointer to which the counters will be stored
+
+    Returns:
+
+    Zero if succeed, or EINVAL if rank is out of range or
+    MassiveThreads is not initialized.
+
+    Counters of other workers are read without synchronization,
+    so they may be slightly stale.
+
+    See Also:
+
+    <myth_get_num_workers>
+  */
+  int myth_get_alloc_stats(int rank, myth_alloc_stats_t * stats);
+
+  /*
+    Type: myth_stats_t
+
+    Counters of the scheduler, kept by each worker at all times.
+    See <myth_get_stats>.
+  */
+  typedef struct myth_stats {
+    unsigned long long n_creates;     /* threads created (including for tasks) */
+    unsigned long long n_task_spawns; /* tasks spawned by myth_task_spawn */
+    unsigned long long n_local_pops;  /* threads taken from its own runqueue */
+    unsigned long long n_steal_attempts; /* tries to steal a thread from another worker */
+    unsigned long long n_steals;      /* of which succeeded */
+    unsigned long long n_task_steals; /* tasks taken from another worker */
+    unsigned long long n_join_blocks; /* joins that had to wait for the thread */
+    unsigned long long n_switches;    /* context switches */
+  } myth_stats_t;
+
+  /*
+    Function: myth_get_stats
+
+    Obtain scheduling counters of a worker.
+
+    Parameters:
+
+    rank - the index of a worker, or -1 to sum over all workers
+    stats - a pointer to which the counters will be stored
+
+    Returns:
+
+    Zero if succeed, or EINVAL if rank is out of range or
+    MassiveThreads is not initialized.
+
+    Counters of other workers are read without synchronization,
+    so they may be slightly stale. Steals are counted by the
+    default steal function only (see <myth_wsapi_set_stealfunc>).
+    MYTH_STATS_INTERVAL=n makes them written to the standard
+    error every n milliseconds, as by <myth_dump_stats>.
+
+    See Also:
+
+    <myth_get_steal_stats>, <myth_dump_stats>
+  */
+  int myth_get_stats(int rank, myth_stats_t * stats);
+
+  /*
+    Function: myth_get_steal_stats
+
+    Obtain how often a worker tried to steal from each of
+    the others and how often it succeeded.
+
+    Parameters:
+
+    rank - the index of the thief, or -1 to sum over all workers
+    attempts - an array of myth_get_num_workers() elements, the
+    i-th of which will be the attempts on worker i
+    steals - the same for the attempts that succeeded (may be NULL)
+
+    Returns:
+
+    Zero if succeed, or EINVAL if rank is out of range or
+    MassiveThreads is not initialized.
+
+    See Also:
+
+    <myth_get_stats>
+  */
+  int myth_get_steal_stats(int rank, unsigned long long * attempts,
+			   unsigned long long * steals);
+
+  /*
+    Function: myth_dump_stats
+
+    Write the scheduling counters of each worker and their sum,
+    as text.
+
+    Parameters:
+
+    fd - a file descriptor to which they will be written
+
+    Returns:
+
+    Zero if succeed, EINVAL if MassiveThreads is not initialized,
+    or an errno when an error occurred.
+
+    See Also:
+
+    <myth_get_stats>
+  */
+  int myth_dump_stats(int fd);
+
+  /*
+    Type: myth_io_fd_stats_t
+
+    Counters of the calls user threads made on a socket, kept
+    when MassiveThreads multiplexes socket calls
+    (MYTH_WRAP_SOCKIO=1) and MYTH_IO_STATS=1.
+    See <myth_io_get_fd_stats>.
+  */
+  typedef struct myth_io_fd_stats {
+    unsigned long long n_reads;   /* receives (and accepts) completed */
+    unsigned long long n_writes;  /* sends completed */
+    unsigned long long read_bytes;    /* bytes received */
+    unsigned long long written_bytes; /* bytes sent */
+    unsigned long long n_eagain;  /* calls that found the socket not ready */
+    unsigned long long park_usec; /* total time threads waited for it */
+  } myth_io_fd_stats_t;
+
+  /*
+    Function: myth_io_get_fd_stats
+
+    Obtain the counters of a socket.
+
+    Parameters:
+
+    fd - a socket of the I/O layer, which counts from the
+    time it was created or accepted
+    stats - a pointer to which the counters will be stored
+
+    Returns:
+
+    Zero if succeed, or EINVAL if the counters are not kept
+    (MYTH_IO_STATS is not set) or fd is not such a socket.
+
+    See Also:
+
+    <myth_io_get_slow_ops>, <myth_io_dump_stats>
+  */
+  int myth_io_get_fd_stats(int fd, myth_io_fd_stats_t * stats);
+
+  /*
+    Type: myth_io_slow_op_t
+
+    A socket call for which a user thread waited longer than
+    MYTH_IO_SLOW_USEC microseconds.
+    See <myth_io_get_slow_ops>.
+  */
+  typedef struct myth_io_slow_op {
+    unsigned long long seq;  /* 0 for the first slow call */
+    unsigned long long usec; /* how long the thread waited */
+    struct timespec end;     /* when it completed (CLOCK_REALTIME) */
+    const char * op;         /* "recv", "send", "accept", ... */
+    myth_thread_t thread;    /* the thread that made it */
+    int worker;              /* the worker it was made on */
+    int fd;
+    long ret;                /* what the call returned */
+    int err;                 /* and errno, if it returned -1 */
+  } myth_io_slow_op_t;
+
+  /*
+    Function: myth_io_get_slow_ops
+
+    Obtain the most recent slow socket calls. The last
+    MYTH_IO_SLOW_OPS of them are kept.
+
+    Parameters:
+
+    ops - an array to which they will be stored, oldest first
+    n - the size of ops
+
+    Returns:
+
+    The number of calls stored, 0 if none is kept
+    (MYTH_IO_SLOW_USEC is not set).
+
+    See Also:
+
+    <myth_io_get_fd_stats>, <myth_io_dump_stats>
+  */
+  int myth_io_get_slow_ops(myth_io_slow_op_t * ops, int n);
+
+  /*
+    Function: myth_io_dump_stats
+
+    Write the counters of all sockets that have them and the
+    slow calls kept, as text. MYTH_IO_STATS_SIGNAL=n makes
+    signal n write them to the standard error.
+
+    Parameters:
+
+    fd - a file descriptor to which they will be written
+
+    Returns:
+
+    Zero if succeed, or an errno when an error occurred.
+
+    See Also:
+
+    <myth_io_get_fd_stats>, <myth_io_get_slow_ops>
+  */
+  int myth_io_dump_stats(int fd);
+
+  /*
+    Function: myth_io_wait
+
+    Block the calling thread, not its worker, until a file
+    descriptor becomes readable or writable. A socket of the I/O
+    layer waits in its epoll or io_uring like the calls made on
+    it; any other file descriptor is polled as with poll.
+    It needs MassiveThreads to multiplex socket calls
+    (libmyth-ld or libmyth-dl with MYTH_WRAP_SOCKIO=1).
+
+    Parameters:
+
+    fd - a file descriptor
+    events - POLLIN to wait until it is readable, or POLLOUT
+    until it is writable
+
+    Returns:
+
+    Zero when it is ready (or has an error to report, which
+    the next call on it will tell), ECANCELED if the thread has
+    been cancelled, EINVAL if events is neither POLLIN nor POLLOUT,
+    or ENOTSUP if socket calls are not multiplexed.
+
+    Note:
+
+    A wait in an io_uring is not interrupted by <myth_cancel>;
+    it returns ECANCELED only if the request came before the call.
+
+    See Also:
+
+    <myth_cancel>
+  */
+  int myth_io_wait(int fd, int events);
+
   typedef pthread_key_t myth_wls_key_t;
 
   /*
@@ -0,0 +1,441 @@
+/*
+ * coro.h
+ */
+
+/*
+ * C++20 coroutines on top of MassiveThreads.
+ *
+ * a coroutine returning mtbb::task<T> is a stackless frame. it runs
+ * on whichever thread resumes it and occupies no MassiveThreads
+ * stack while it is suspended; when it has to wait, it is resumed
+ * later by a detached MassiveThreads thread pushed to the run queue
+ * of the worker, so it goes through the work-stealing queues like
+ * any other thread and may continue on another worker.
+ *
+ *   mtbb::task<int> fib(int n) {
+ *     if (n < 2) co_return n;
+ *     auto a = mtbb::spawn(fib(n - 1));   // may be stolen
+ *     int b = co_await fib(n - 2);        // runs right here
+ *     co_return co_await a + b;
+ *   }
+ *   int main() { printf("%d\n", mtbb::sync_wait(fib(30))); }
+ *
+ * it provides the following.
+ *
+ * task<T>        : the return type of a coroutine. lazily started;
+ *                  co_await on it runs it and gives its result
+ * spawn(t)       : start task t on the scheduler and return a
+ *                  spawned<T>; co_await on it waits for the result
+ * myth_spawn(f)  : co_await myth_spawn(f) calls f() on a thread of
+ *                  its own (so f may block) and gives its result
+ * mutex          : co_await m.lock() ... m.unlock()
+ * recv, send     : co_await recv(fd, buf, len, flags) etc. they try
+ *                  without blocking first and otherwise retry in a
+ *                  thread parked in myth_io_wait until the socket
+ *                  is ready, so a worker is never blocked (as on a
+ *                  nonblocking socket, they may transfer less than
+ *                  len). without the I/O layer (libmyth, or no
+ *                  MYTH_WRAP_SOCKIO=1) nothing would wake it up,
+ *                  so it yields between tries instead
+ * sync_wait(t)   : run task t from a thread and wait for its result
+ *
+ * compile with -std=c++20 (or whatever enables <coroutine>).
+ */
+
+#pragma once
+#if !defined(__cpp_impl_coroutine) || !__has_include(<coroutine>)
+#error "mtbb/coro.h requires C++20 coroutines (e.g., -std=c++20)"
+#endif
+
+#include <assert.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <atomic>
+#include <coroutine>
+#include <exception>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include <myth/myth.h>
+
+namespace mtbb {
+
+  /* resume h on a new detached thread, put to the run queue of
+     this worker (i.e., it may be stolen) */
+  inline void * coro_resume_on_thread(void * h) {
+    std::coroutine_handle<>::from_address(h).resume();
+    return 0;
+  }
+
+  inline void schedule(std::coroutine_handle<> h) {
+    myth_thread_attr_t attr;
+    myth_thread_t th;
+    myth_thread_attr_init(&attr);
+    attr.child_first = 0;
+    int r = myth_create_ex(&th, &attr, coro_resume_on_thread, h.address());
+    assert(r == 0);
+    (void)r;
+    myth_detach(th);
+  }
+
+  /* the value (or exception) a coroutine finished with */
+  template<typename T>
+    struct coro_result {
+      alignas(T) unsigned char v[sizeof(T)];
+      bool has_value = false;
+      std::exception_ptr e;
+      ~coro_result() { if (has_value) value().~T(); }
+      T& value() { return *reinterpret_cast<T *>(v); }
+      template<typename U>
+      void return_value(U&& x) {
+        new (v) T(std::forward<U>(x));
+        has_value = true;
+      }
+      void unhandled_exception() { e = std::current_exception(); }
+      T get() {
+        if (e) std::rethrow_exception(e);
+        return std::move(value());
+      }
+    };
+
+  template<>
+    struct coro_result<void> {
+      std::exception_ptr e;
+      void return_void() { }
+      void unhandled_exception() { e = std::current_exception(); }
+      void get() { if (e) std::rethrow_exception(e); }
+    };
+
+  /* -------- task -------- */
+
+  template<typename T = void>
+    struct task {
+      struct promise_type : coro_result<T> {
+        std::coroutine_handle<> continuation;
+        task get_return_object() {
+          return task(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        /* go on with whoever awaited it, in this thread */
+        struct final_awaiter {
+          bool await_ready() noexcept { return false; }
+          std::coroutine_handle<>
+          await_suspend(std::coroutine_handle<promise_type> h) noexcept {
+            std::coroutine_handle<> c = h.promise().continuation;
+            return c ? c : std::noop_coroutine();
+          }
+          void await_resume() noexcept { }
+        };
+        final_awaiter final_suspend() noexcept { return {}; }
+      };
+
+      std::coroutine_handle<promise_type> h;
+      explicit task(std::coroutine_handle<promise_type> h_) : h(h_) { }
+      task(task&& t) noexcept : h(std::exchange(t.h, nullptr)) { }
+      task(const task&) = delete;
+      task& operator=(const task&) = delete;
+      ~task() { if (h) h.destroy(); }
+
+      /* run it here and get its result */
+      struct awaiter {
+        std::coroutine_handle<promise_type> h;
+        bool await_ready() { return false; }
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<> c) {
+          h.promise().continuation = c;
+          return h;
+        }
+        T await_resume() { return h.promise().get(); }
+      };
+      awaiter operator co_await() && { return awaiter{h}; }
+      awaiter operator co_await() & { return awaiter{h}; }
+    };
+
+  /* -------- spawn -------- */
+
+  /* a task started by spawn. its frame is freed when both it
+     has finished and the spawned object has gone */
+  template<typename T>
+    struct spawned {
+      struct promise_type : coro_result<T> {
+        /* null, the coroutine waiting for it, or done() */
+        std::atomic<void *> waiter{nullptr};
+        std::atomic<int> refs{2};
+        static void * done() { return (void *)1; }
+        spawned get_return_object() {
+          return spawned(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+        /* let it be stolen while the spawner goes on */
+        struct initial_awaiter {
+          bool await_ready() noexcept { return false; }
+          void await_suspend(std::coroutine_handle<> h) noexcept { schedule(h); }
+          void await_resume() noexcept { }
+        };
+        initial_awaiter initial_suspend() noexcept { return {}; }
+        struct final_awaiter {
+          bool await_ready() noexcept { return false; }
+          std::coroutine_handle<>
+          await_suspend(std::coroutine_handle<promise_type> h) noexcept {
+            promise_type& p = h.promise();
+            void * w = p.waiter.exchange(done(), std::memory_order_acq_rel);
+            if (p.refs.fetch_sub(1, std::memory_order_acq_rel) == 1) h.destroy();
+            if (w) return std::coroutine_handle<>::from_address(w);
+            return std::noop_coroutine();
+          }
+          void await_resume() noexcept { }
+        };
+        final_awaiter final_suspend() noexcept { return {}; }
+      };
+
+      std::coroutine_handle<promise_type> h;
+      explicit spawned(std::coroutine_handle<promise_type> h_) : h(h_) { }
+      spawned(spawned&& s) noexcept : h(std::exchange(s.h, nullptr)) { }
+      spawned(const spawned&) = delete;
+      spawned& operator=(const spawned&) = delete;
+      ~spawned() {
+        if (h && h.promise().refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+          h.destroy();
+        }
+      }
+
+      /* wait for it without holding a thread */
+      struct awaiter {
+        std::coroutine_handle<promise_type> h;
+        bool await_ready() {
+          return h.promise().waiter.load(std::memory_order_acquire) == promise_type::done();
+        }
+        bool await_suspend(std::coroutine_handle<> c) {
+          void * w = nullptr;
+          /* fails only if it has finished in the meantime */
+          return h.promise().waiter.compare_exchange_strong(w, c.address(),
+                                                            std::memory_order_acq_rel);
+        }
+        T await_resume() { return h.promise().get(); }
+      };
+      awaiter operator co_await() && { return awaiter{h}; }
+      awaiter operator co_await() & { return awaiter{h}; }
+    };
+
+  template<typename T>
+    spawned<T> spawn(task<T> t) {
+    co_return co_await std::move(t);
+  }
+
+  /* -------- myth_spawn -------- */
+
+  template<typename F>
+    struct myth_spawn_awaiter {
+      typedef std::invoke_result_t<F&> T;
+      F f;
+      coro_result<T> r;
+      std::coroutine_handle<> c;
+      static void * run(void * a_) {
+        myth_spawn_awaiter * a = (myth_spawn_awaiter *)a_;
+        try {
+          if constexpr (std::is_void_v<T>) {
+            a->f();
+            a->r.return_void();
+          } else {
+            a->r.return_value(a->f());
+          }
+        } catch (...) {
+          a->r.unhandled_exception();
+        }
+        /* the coroutine goes on in this thread */
+        a->c.resume();
+        return 0;
+      }
+      bool await_ready() { return false; }
+      void await_suspend(std::coroutine_handle<> c_) {
+        c = c_;
+        myth_thread_t th = myth_create(run, this);
+        myth_detach(th);
+      }
+      T await_resume() { return r.get(); }
+    };
+
+  template<typename F>
+    myth_spawn_awaiter<F> myth_spawn(F f) {
+    return myth_spawn_awaiter<F>{std::move(f), {}, {}};
+  }
+
+  /* -------- mutex -------- */
+
+  struct mutex {
+    struct lock_awaiter;
+    myth_mutex_t m[1];		/* protects the fields below */
+    bool locked;
+    lock_awaiter * head;	/* coroutines waiting for it, in order */
+    lock_awaiter * tail;
+
+    struct lock_awaiter {
+      mutex * mtx;
+      std::coroutine_handle<> c;
+      lock_awaiter * next;
+      bool await_ready() { return mtx->try_lock(); }
+      bool await_suspend(std::coroutine_handle<> c_) {
+        c = c_;
+        next = 0;
+        myth_mutex_lock(mtx->m);
+        if (!mtx->locked) {
+          mtx->locked = true;
+          myth_mutex_unlock(mtx->m);
+          return false;
+        }
+        if (mtx->tail) mtx->tail->next = this;
+        else mtx->head = this;
+        mtx->tail = this;
+        myth_mutex_unlock(mtx->m);
+        return true;
+      }
+      void await_resume() { }
+    };
+
+    mutex() : locked(false), head(0), tail(0) { myth_mutex_init(m, 0); }
+    ~mutex() { myth_mutex_destroy(m); }
+    mutex(const mutex&) = delete;
+    mutex& operator=(const mutex&) = delete;
+
+    bool try_lock() {
+      myth_mutex_lock(m);
+      bool x = !locked;
+      locked = true;
+      myth_mutex_unlock(m);
+      return x;
+    }
+    lock_awaiter lock() { return lock_awaiter{this, {}, 0}; }
+    /* hand it to the first waiter, which is resumed on the
+       scheduler, so that no code of it runs in here. once it
+       is handed over, the mutex may be gone (the waiter may
+       free it), so only the waiter is touched after that */
+    void unlock() {
+      myth_mutex_lock(m);
+      lock_awaiter * w = head;
+      if (w) {
+        head = w->next;
+        if (!head) tail = 0;
+      } else {
+        locked = false;
+      }
+      myth_mutex_unlock(m);
+      if (w) schedule(w->c);
+    }
+  };
+
+  /* -------- recv and send -------- */
+
+  /* try op with MSG_DONTWAIT first and, only if it would block,
+     keep trying in a thread of its own, which waits for the
+     socket to become ready in between */
+  template<typename Op>
+    struct sockio_awaiter {
+      Op op;
+      ssize_t r;
+      int err;
+      std::coroutine_handle<> c;
+      static void * run(void * a_) {
+        sockio_awaiter * a = (sockio_awaiter *)a_;
+        do {
+          int e = myth_io_wait(a->op.fd, Op::events);
+          if (e == ENOTSUP) {
+            myth_yield();
+          } else if (e) {
+            /* cancelled */
+            a->r = -1;
+            a->err = e;
+            break;
+          }
+        } while (!a->await_ready());
+        a->c.resume();
+        return 0;
+      }
+      bool await_ready() {
+        r = op(MSG_DONTWAIT);
+        err = errno;
+        return !(r < 0 && (err == EAGAIN || err == EWOULDBLOCK));
+      }
+      void await_suspend(std::coroutine_handle<> c_) {
+        c = c_;
+        myth_thread_t th = myth_create(run, this);
+        myth_detach(th);
+      }
+      /* the return value of recv/send; errno is set if it failed */
+      ssize_t await_resume() {
+        if (r < 0) errno = err;
+        return r;
+      }
+    };
+
+  struct recv_op {
+    static const int events = POLLIN;
+    int fd; void * buf; size_t len; int flags;
+    ssize_t operator() (int f) { return ::recv(fd, buf, len, flags | f); }
+  };
+
+  struct send_op {
+    static const int events = POLLOUT;
+    int fd; const void * buf; size_t len; int flags;
+    ssize_t operator() (int f) { return ::send(fd, buf, len, flags | f); }
+  };
+
+  inline sockio_awaiter<recv_op> recv(int fd, void * buf, size_t len, int flags) {
+    return sockio_awaiter<recv_op>{recv_op{fd, buf, len, flags}, 0, 0, {}};
+  }
+
+  inline sockio_awaiter<send_op> send(int fd, const void * buf, size_t len, int flags) {
+    return sockio_awaiter<send_op>{send_op{fd, buf, len, flags}, 0, 0, {}};
+  }
+
+  /* -------- sync_wait -------- */
+
+  /* run t and block the calling thread (not the worker) until
+     it finishes, wherever it does */
+  template<typename T>
+    T sync_wait(task<T> t) {
+    struct state {
+      myth_mutex_t m[1];
+      myth_cond_t cv[1];
+      bool done;
+    } s;
+    myth_mutex_init(s.m, 0);
+    myth_cond_init(s.cv, 0);
+    s.done = false;
+    struct waiter {
+      struct promise_type {
+        waiter get_return_object() { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() { }
+        void unhandled_exception() { std::terminate(); }
+      };
+    };
+    /* start t and come back here when it finishes, leaving
+       its result (or exception) for the get below */
+    struct start {
+      std::coroutine_handle<typename task<T>::promise_type> h;
+      bool await_ready() { return false; }
+      std::coroutine_handle<> await_suspend(std::coroutine_handle<> c) {
+        h.promise().continuation = c;
+        return h;
+      }
+      void await_resume() { }
+    };
+    auto run = [](task<T>& t, state& s) -> waiter {
+      co_await start{t.h};
+      myth_mutex_lock(s.m);
+      s.done = true;
+      myth_cond_signal(s.cv);
+      myth_mutex_unlock(s.m);
+    };
+    run(t, s);
+    myth_mutex_lock(s.m);
+    while (!s.done) myth_cond_wait(s.cv, s.m);
+    myth_mutex_unlock(s.m);
+    myth_cond_destroy(s.cv);
+    myth_mutex_destroy(s.m);
+    return t.h.promise().get();
+  }
+
+} /* namespace mtbb */
@@ -258,16 +258,20 @@ void myth_get_available_cpus(void) {
 #endif	/* debug */
 }
 
+//Return the cpu worker RANK is bound to, or -1 if it is not bound
+int myth_get_worker_cpu(int rank) {
 #if defined(HAVE_PTHREAD_AFFINITY_NP)
-static int myth_get_worker_cpu(int rank) {
   assert(n_available_cpus >= 0);
   if (n_available_cpus == 0) {
     return -1;			/* no bind */
   } else {
     return worker_cpu[rank % n_available_cpus];
   }
-}
+#else
+  (void)rank;
+  return -1;
 #endif
+}
 
 void myth_bind_worker(int rank) {
 #if defined(HAVE_PTHREAD_AFFINITY_NP)
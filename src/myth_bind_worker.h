@@ -8,5 +8,6 @@
 void myth_get_available_cpus(void);
 int  myth_get_n_available_cpus(void);
 void myth_bind_worker(int rank);
+int  myth_get_worker_cpu(int rank);
 
 #endif	/* MYTH_BIND_WORKER_H_ */
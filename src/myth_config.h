@@ -44,11 +44,52 @@
 //Split desc and stack allocation
 #define MYTH_SPLIT_STACK_DESC 1
 
+//Keep the descriptor and the stack each worker freed last aside and
+//reuse them before anything in the freelists, so that a spawn/join
+//loop keeps touching the same cache lines
+#define MYTH_HOT_SLOT 1
+
+//Place each worker's env, runqueue, stacks and descriptors
+//on the NUMA node of the core it is bound to
+#define MYTH_NUMA_AWARE 1
+
 //Runqueue length
 #define INITIAL_QUEUE_SIZE (65536*2)
 
-//Wrap and multipelx I/O functions
+//Wrap and multipelx I/O functions.
+//Only libmyth-ld and libmyth-dl wrap them, and only when
+//MYTH_WRAP_SOCKIO=1 (sockets) or MYTH_WRAP_FILEIO=1 (files)
+//is set in the environment. It needs epoll
+#if defined(__linux__)
+#define MYTH_WRAP_SOCKIO 1
+#else
 #define MYTH_WRAP_SOCKIO 0
+#endif
+
+//Let blocked socket calls wait in a per-worker io_uring instead
+//of epoll when the kernel supports it (MYTH_IO_URING=0 disables it)
+#define MYTH_IO_URING 1
+//Number of submission queue entries of each worker's io_uring
+#define MYTH_IO_URING_ENTRIES 256
+//Number of times a full submission queue is passed to the kernel
+//before an op falls back to epoll (or fails, if it cannot)
+#define MYTH_IO_URING_SUBMIT_TRIES 16
+
+//Default number of helper threads performing read, write, pread,
+//pwrite, fsync and open of user threads when MYTH_WRAP_FILEIO=1
+//and io_uring is not used (MYTH_IO_HELPERS overrides it)
+#define MYTH_IO_HELPERS_DEFAULT 4
+
+//Besides when a worker runs out of threads, check I/O between threads
+//every MYTH_IO_POLL_SWITCHES_DEFAULT switches or every
+//MYTH_IO_POLL_INTERVAL_DEFAULT microseconds (by rdtsc), whichever comes
+//first, so ready threads do not wait while workers are busy. 0 disables
+//either (MYTH_IO_POLL_SWITCHES and MYTH_IO_POLL_INTERVAL override them)
+#define MYTH_IO_POLL_SWITCHES_DEFAULT 64
+#define MYTH_IO_POLL_INTERVAL_DEFAULT 100
+//Whether threads made ready by such a check run before (1) or after (0)
+//those already in the runqueue (MYTH_IO_POLL_PRIO overrides it)
+#define MYTH_IO_POLL_PRIO_DEFAULT 1
 
 //Quick emptiness check on io wait list
 #define QUICK_CHECK_IO_WAIT_LIST 1
@@ -56,9 +97,6 @@
 //Quick emptiness check on io fd list
 #define QUICK_CHECK_IO_FD_LIST 1
 
-//Wrapped select() return immediately regardless of I/O readiness
-#define SELECT_ALWAYS_RETURN_IMMEDIATELY 1
-
 //Replace myth_assert() with assert(): used for debugging
 #define MYTH_SANITY_CHECK 1
 
@@ -68,6 +106,25 @@
 //epoll file decriptor size
 #define MYTH_EPOLL_SIZE 256
 
+//Connections an accept() takes from the backlog at once. Those that no
+//waiting thread gets are kept for the next accept() on the socket
+#define MYTH_IO_ACCEPT_BURST 16
+
+//With MYTH_IO_SHARD=1, a listening TCP socket gets a sibling bound to
+//the same address with SO_REUSEPORT for each worker, accept() takes
+//connections from that of the worker calling it first, and every fd
+//stays with the worker that opened or accepted it
+#define MYTH_IO_SHARD_DEFAULT 0
+
+//With MYTH_IO_STATS=1, each registered socket counts the calls made on
+//it and the time threads waited for it (see myth_io_get_fd_stats).
+//With MYTH_IO_SLOW_USEC=n, calls for which a thread waited n
+//microseconds or more are recorded; the last MYTH_IO_SLOW_OPS_DEFAULT
+//of them are kept (MYTH_IO_SLOW_OPS overrides it)
+#define MYTH_IO_STATS_DEFAULT 0
+#define MYTH_IO_SLOW_USEC_DEFAULT 0
+#define MYTH_IO_SLOW_OPS_DEFAULT 1024
+
 //Decide a fd's worker thread at random
 #define MYTH_RANDOM_IO_WORKER 1
 //Make all fds belong to worker thread 0
@@ -115,9 +172,6 @@
 //Display result of each worker thread
 #define MYTH_PROF_SHOW_WORKER 0
 
-//Profile myth_flmalloc
-#define MYTH_FLMALLOC_PROF 0
-
 //Collect and emit sslog
 #define MYTH_COLLECT_LOG 0
 //Log buffer size
@@ -163,6 +217,24 @@
 #define SWITCH_AFTER_CREATE 1
 //When a thread is finished, switch to the thread that waits for it.
 #define SWITCH_AFTER_EXIT 1
+//And leave its stack to that thread to release, so that the switch
+//needs neither a callback nor an atomic exchange
+#define MYTH_JOIN_HANDOFF 1
+
+//Threads myth_create_many puts in a runqueue at a time
+#define MYTH_CREATE_MANY_CHUNK 64
+//Let myth_create_many hand chunks directly to idle workers
+#define MYTH_CREATE_MANY_SPREAD 1
+
+//Cycles myth_create_join_many_grain_ex with MYTH_GRAINSIZE_AUTO
+//aims to spend on elements between checks for an idle worker
+#define MYTH_GRAINSIZE_AUTO_CYCLES 20000
+//Most elements it runs between the checks
+#define MYTH_GRAINSIZE_AUTO_MAX_CHUNK 4096
+
+//With MYTH_STATS_INTERVAL=n, the scheduling counters are written to
+//the standard error every n milliseconds (see myth_get_stats)
+#define MYTH_STATS_INTERVAL_DEFAULT 0
 
 //Scheduling policy of runqueue
 #define MYTH_QUEUE_LIFO 1
@@ -181,16 +253,28 @@
 //turned out very important; never turn off
 #define QUICK_CHECK_ON_STEAL 1
 
-//Check whether the thread is sure to be ready for release before acquiring the lock
-#define QUICK_CHECK_ON_JOIN 0
-
 //Do trylock before work stealing
 //#define TRY_LOCK_BEFORE_STEAL 1
 
 //Use malloc with recycle by freelist
 #define USE_MYTH_FLMALLOC 1
-//Use TLS on malloc with freelist
-#define MYTH_FLMALLOC_TLS 0
+//Blocks up to MYTH_FL_SLAB_BLOCK_MAX bytes are carved from slabs of
+//MYTH_FL_SLAB_SIZE bytes (aligned to their size) owned by a worker;
+//larger ones are mmapped one by one
+#define MYTH_FL_SLAB_SIZE (64 * 1024)
+#define MYTH_FL_SLAB_BLOCK_MAX PAGE_SIZE
+//Each worker caches up to this many bytes (but at least
+//MYTH_FL_CACHE_MIN blocks) per size class; the rest go to a global pool
+#define MYTH_FL_CACHE_BYTES (1024 * 1024)
+#define MYTH_FL_CACHE_MIN 4
+
+//Let malloc and friends of libmyth-ld/libmyth-dl serve blocks up to
+//MYTH_FL_SLAB_BLOCK_MAX bytes from myth_flmalloc when the environment
+//variable MYTH_WRAP_MALLOC=1 is set. Slabs are then carved from an
+//arena of MYTH_WRAP_MALLOC_ARENA_SIZE bytes (address space only)
+//so that free can tell our blocks from those of the real malloc
+#define MYTH_WRAP_MALLOC 1
+#define MYTH_WRAP_MALLOC_ARENA_SIZE (64UL << 30)
 
 //At inlined codes, save callee-saved registers explicitly
 #define MYTH_INLINE_PUSH_CALLEE_SAVED 1
@@ -287,6 +371,15 @@
    leave these two macros (and do not use them) */
 #define MYTH_SAVE_FPCSR 0
 
+/* the inline context switch on amd64 steps over the red zone of
+   the function it is in before pushing registers. set this to 1
+   (e.g., CFLAGS="-mno-red-zone -DMYTH_NO_RED_ZONE=1") only when the
+   library is compiled with -mno-red-zone, which saves a sub and an
+   add per switch */
+#ifndef MYTH_NO_RED_ZONE
+#define MYTH_NO_RED_ZONE 0
+#endif
+
 /* ------------------
    MYTH_CONTEXT choices
    ------------------ */
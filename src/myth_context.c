@@ -9,3 +9,9 @@
 volatile __thread myth_ctx_withcall_param g_ctx_withcall_params;
 
 #endif
+
+#if MYTH_FPCSR_PER_THREAD
+
+myth_fpcsr_t g_myth_fpcsr_default;
+
+#endif
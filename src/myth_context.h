@@ -64,6 +64,32 @@ typedef struct myth_context {
 #endif
 } myth_context, *myth_context_t;
 
+/* FP control registers saved around the switches of a thread made
+   with MYTH_FPCSR_SAVE (see myth_thread_attr_setfpcsr). with the
+   ucontext switch or MYTH_SAVE_FPCSR every switch saves them anyway */
+#if MYTH_CONTEXT == MYTH_CONTEXT_UCONTEXT || MYTH_SAVE_FPCSR
+#define MYTH_FPCSR_PER_THREAD 0
+#elif MYTH_CONTEXT == MYTH_CONTEXT_amd64 || MYTH_CONTEXT == MYTH_CONTEXT_aarch64
+#define MYTH_FPCSR_PER_THREAD 1
+#else
+#define MYTH_FPCSR_PER_THREAD 0
+#endif
+
+#if MYTH_FPCSR_PER_THREAD
+typedef struct myth_fpcsr {
+#if MYTH_CONTEXT == MYTH_CONTEXT_amd64
+  uint32_t mxcsr;
+  uint16_t fpucw;
+#else
+  uint64_t fpcr;
+#endif
+} myth_fpcsr_t;
+
+//Those of the process when it was initialized, with which all
+//threads but those made with MYTH_FPCSR_SAVE run
+extern myth_fpcsr_t g_myth_fpcsr_default;
+#endif
+
 /* typedef required to pass params to swap_context */
 #if MYTH_CONTEXT == MYTH_CONTEXT_UCONTEXT
 typedef struct myth_ctx_withcall_param {
@@ -21,16 +21,72 @@ static inline void myth_make_context_voidcall(myth_context_t ctx, void_func_t fu
 					      void *stack, size_t stacksize);
 
 
+//Count the switch (see myth_get_stats), and log it if asked to
 #if MYTH_COLLECT_LOG && MYTH_COLLECT_CONTEXT_SWITCH
 //static inline void myth_log_add_context_switch(struct myth_running_env *env,struct myth_thread *th);
 #define  myth_context_switch_hook(ctx) \
 { \
 	struct myth_running_env* env = myth_get_current_env(); \
 	myth_thread_t th = myth_context_to_thread(env, ctx); \
+	env->stats.n_switches++; \
 	myth_log_add_context_switch(env, th); \
 }
 #else
-#define myth_context_switch_hook(ctx)
+#define myth_context_switch_hook(ctx) \
+{ \
+	myth_get_current_env()->stats.n_switches++; \
+}
+#endif
+
+#if MYTH_FPCSR_PER_THREAD
+static inline void myth_fpcsr_save(myth_fpcsr_t * f) {
+#if MYTH_CONTEXT == MYTH_CONTEXT_amd64
+  asm volatile("stmxcsr %0\n" "fnstcw %1\n" : "=m"(f->mxcsr), "=m"(f->fpucw));
+#else
+  asm volatile("mrs %0, fpcr\n" : "=r"(f->fpcr));
+#endif
+}
+
+static inline void myth_fpcsr_load(const myth_fpcsr_t * f) {
+#if MYTH_CONTEXT == MYTH_CONTEXT_amd64
+  asm volatile("ldmxcsr %0\n" "fldcw %1\n" : : "m"(f->mxcsr), "m"(f->fpucw));
+#else
+  asm volatile("msr fpcr, %0\n" : : "r"(f->fpcr));
+#endif
+}
+
+//Take the FP control registers of the calling (initializing) thread
+//as those all threads run with by default
+static inline void myth_fpcsr_init(void) {
+  myth_fpcsr_save(&g_myth_fpcsr_default);
+}
+
+//Put back the default ones when a thread made with MYTH_FPCSR_SAVE
+//leaves for good (other threads never change them)
+static inline void myth_fpcsr_reset(myth_thread_t th) {
+  if (th->save_fpcsr) myth_fpcsr_load(&g_myth_fpcsr_default);
+}
+
+/* a switch from a thread made with MYTH_FPCSR_SAVE keeps its FP
+   control registers on its stack and runs the next one with the
+   default ones; they come back when it resumes, on whichever worker.
+   for all other threads it is a single test of th. the scheduler
+   always runs with the default ones, so switches from it (see
+   myth_swap_context) do not test anything */
+#define myth_fpcsr_switch_out(th) \
+  myth_fpcsr_t fpcsr_[1]; \
+  int fpcsr_saved_ = (th)->save_fpcsr; \
+  if (fpcsr_saved_) { \
+    myth_fpcsr_save(fpcsr_); \
+    myth_fpcsr_load(&g_myth_fpcsr_default); \
+  }
+#define myth_fpcsr_switch_in() \
+  if (fpcsr_saved_) myth_fpcsr_load(fpcsr_);
+#else
+static inline void myth_fpcsr_init(void) { }
+static inline void myth_fpcsr_reset(myth_thread_t th) { (void)th; }
+#define myth_fpcsr_switch_out(th)
+#define myth_fpcsr_switch_in()
 #endif
 
 #if  MYTH_CONTEXT == MYTH_CONTEXT_i386 \
@@ -166,9 +222,9 @@ static void voidcall_context_ep(int pfn0, int pfn1) {
     myth_swap_context_uc(from,to); \
 }
 
-#define myth_swap_context_withcall(from,to,fn,a1,a2,a3) { \
+#define myth_swap_context_withcall(th,to,fn,a1,a2,a3) { \
     myth_context_switch_hook(to); \
-    myth_swap_context_withcall_uc(from,to,fn,a1,a2,a3); \
+    myth_swap_context_withcall_uc(&(th)->context,to,fn,a1,a2,a3); \
 }
 
 #define myth_set_context_withcall(ctx,fn,a1,a2,a3) { \
@@ -187,9 +243,11 @@ static void voidcall_context_ep(int pfn0, int pfn1) {
     myth_swap_context_i(from,to); \
 }
 
-#define myth_swap_context_withcall(from,to,fn,a1,a2,a3) { \
+#define myth_swap_context_withcall(th,to,fn,a1,a2,a3) { \
+    myth_fpcsr_switch_out(th); \
     myth_context_switch_hook(to); \
-    myth_swap_context_withcall_i(from,to,fn,a1,a2,a3); \
+    myth_swap_context_withcall_i(&(th)->context,to,fn,a1,a2,a3); \
+    myth_fpcsr_switch_in(); \
 }
 
 #define myth_set_context_withcall(ctx,fn,a1,a2,a3) { \
@@ -208,9 +266,11 @@ static void voidcall_context_ep(int pfn0, int pfn1) {
     myth_swap_context_s(from,to); \
 }
 
-#define myth_swap_context_withcall(from,to,fn,a1,a2,a3) { \
+#define myth_swap_context_withcall(th,to,fn,a1,a2,a3) { \
+    myth_fpcsr_switch_out(th); \
     myth_context_switch_hook(to); \
-    myth_swap_context_withcall_s(from,to,fn,a1,a2,a3); \
+    myth_swap_context_withcall_s(&(th)->context,to,fn,a1,a2,a3); \
+    myth_fpcsr_switch_in(); \
 }
 
 #define myth_set_context_withcall(ctx,fn,a1,a2,a3) { \
@@ -219,6 +279,19 @@ static void voidcall_context_ep(int pfn0, int pfn1) {
 }
 #endif
 
+//Switch between contexts within a thread (coroutines), which is
+//neither counted nor logged as a switch between threads
+#if MYTH_CONTEXT == MYTH_CONTEXT_UCONTEXT
+#define myth_swap_context_raw(from,to) myth_swap_context_uc(from,to)
+#define myth_set_context_raw(ctx) myth_set_context_uc(ctx)
+#elif MYTH_INLINE_CONTEXT
+#define myth_swap_context_raw(from,to) myth_swap_context_i(from,to)
+#define myth_set_context_raw(ctx) myth_set_context_i(ctx)
+#else
+#define myth_swap_context_raw(from,to) myth_swap_context_s(from,to)
+#define myth_set_context_raw(ctx) myth_set_context_s(ctx)
+#endif
+
 
 //Make a context for executing "void foo(void)"
 static inline void myth_make_context_voidcall(myth_context_t ctx,
@@ -492,10 +565,22 @@ static inline void myth_make_context_empty(myth_context_t ctx, void *stack,
 #define POP_FPCSR()
 #endif	/* MYTH_SAVE_FPCSR */
 
+/* an inline switch pushes onto the stack of the function it is in,
+   so it first steps over the 128 byte red zone below rsp, where that
+   function may keep data the compiler does not expect to be touched.
+   code compiled with -mno-red-zone keeps nothing there */
+#if MYTH_NO_RED_ZONE
+#define SKIP_RED_ZONE()
+#define UNSKIP_RED_ZONE()
+#else
+#define SKIP_RED_ZONE() "sub $128,%%rsp\n"
+#define UNSKIP_RED_ZONE() "add $128,%%rsp\n"
+#endif
+
 #if MYTH_INLINE_PUSH_CALLEE_SAVED
 
 #define PUSH_CALLEE_SAVED() \
-	"sub $128,%%rsp\n"\
+	SKIP_RED_ZONE()\
 	"push %%rbp\n"\
 	"push %%rbx\n"\
 	"push %%r12\n"\
@@ -511,7 +596,7 @@ static inline void myth_make_context_empty(myth_context_t ctx, void *stack,
 	"pop %%r12\n"\
 	"pop %%rbx\n"\
 	"pop %%rbp\n"\
-	"add $128,%%rsp\n"
+	UNSKIP_RED_ZONE()
 
 #define DECLARE_DUMMY_VARIABLES int d0,d1,d2,d3,d4;
 #define DUMMY_VARIABLE_CONSTRAINTS \
@@ -532,13 +617,13 @@ static inline void myth_make_context_empty(myth_context_t ctx, void *stack,
 #else
 
 #define PUSH_CALLEE_SAVED() \
-	"sub $128,%%rsp\n"\
+	SKIP_RED_ZONE()\
 	"push %%rbp\n"\
 	PUSH_FPCSR()
 #define POP_CALLEE_SAVED() \
 	POP_FPCSR() \
 	"pop %%rbp\n"\
-	"add $128,%%rsp\n"
+	UNSKIP_RED_ZONE()
 
 #define DECLARE_DUMMY_VARIABLES int d0,d1,d2,d3,d4;
 #define DUMMY_VARIABLE_CONSTRAINTS \
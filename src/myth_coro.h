@@ -0,0 +1,47 @@
+/* 
+ * myth_coro.h
+ */
+#pragma once
+#ifndef MYTH_CORO_H_
+#define MYTH_CORO_H_
+
+#include "myth/myth.h"
+#include "myth_config.h"
+#include "myth_context.h"
+
+/* State of a coroutine */
+typedef enum {
+  //Not started yet, or waiting in myth_coro_yield
+  MYTH_CORO_SUSPENDED = 0,
+  //Between myth_coro_resume and the return from it
+  MYTH_CORO_RUNNING = 1,
+  //Its function returned
+  MYTH_CORO_DONE = 2,
+} myth_coro_status_t;
+
+/* Coroutine descriptor.
+   it lives at the top of its own stack, which comes from the
+   same allocator as thread stacks (get_new_myth_thread_struct_stack) */
+struct myth_coro {
+  //Where it continues when resumed
+  myth_context context;
+  //Where its myth_coro_resume continues when it yields
+  myth_context caller;
+  //The coroutine the thread was in when it was resumed
+  struct myth_coro * parent;
+  myth_func_t func;
+  //Passed by myth_coro_resume and myth_coro_yield both ways
+  void * value;
+  //Top of its stack, for free_myth_stack
+  void * stack;
+  myth_coro_status_t status;
+};
+
+static inline int myth_coro_create_body(myth_coro_t * co, myth_func_t func,
+					size_t stacksize);
+static inline int myth_coro_resume_body(myth_coro_t co, void * x, void ** y);
+static inline int myth_coro_yield_body(void * y, void ** x);
+static inline int myth_coro_done_body(myth_coro_t co);
+static inline int myth_coro_destroy_body(myth_coro_t co);
+
+#endif	/* MYTH_CORO_H_ */
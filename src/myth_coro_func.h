@@ -0,0 +1,100 @@
+/* 
+ * myth_coro_func.h
+ */
+#pragma once
+#ifndef MYTH_CORO_FUNC_H_
+#define MYTH_CORO_FUNC_H_
+
+#include <errno.h>
+
+#include "myth/myth.h"
+
+#include "myth_config.h"
+#include "myth_init.h"
+#include "myth_worker.h"
+#include "myth_thread.h"
+#include "myth_sched.h"
+#include "myth_coro.h"
+
+#include "myth_init_func.h"
+#include "myth_context_func.h"
+#include "myth_sched_func.h"
+
+/* a coroutine runs within the thread that resumes it: the
+   thread's descriptor says which coroutine it is in (coro), and
+   switches between the two do not involve the scheduler. if the
+   coroutine blocks or yields the thread, the thread's context
+   simply points into the coroutine's stack until it resumes */
+
+static void __attribute__((unused)) myth_coro_entry(void) {
+  myth_coro_t co = myth_get_current_env()->this_thread->coro;
+  void * y = co->func(co->value);
+  //It may have been resumed by another thread, on another worker,
+  //since (noinline so that the worker is not taken from before func)
+  myth_thread_t th = myth_get_current_env_noinline()->this_thread;
+  myth_assert(th->coro == co);
+  co->value = y;
+  co->status = MYTH_CORO_DONE;
+  th->coro = co->parent;
+  myth_set_context_raw(&co->caller);
+}
+
+static inline int myth_coro_create_body(myth_coro_t * co_p, myth_func_t func,
+					size_t stacksize) {
+  int _ = myth_ensure_init();
+  (void)_;
+  myth_running_env_t env = myth_get_current_env();
+  void * stk = get_new_myth_thread_struct_stack(env, stacksize);
+  if (!stk) return ENOMEM;
+  if (!stacksize) stacksize = g_attr.stacksize;
+  //The descriptor at the top, the stack for func below it
+  uintptr_t top = ((uintptr_t)stk - sizeof(struct myth_coro)) & ~(uintptr_t)0xF;
+  myth_coro_t co = (myth_coro_t)top;
+  co->parent = NULL;
+  co->func = func;
+  co->value = NULL;
+  co->stack = stk;
+  co->status = MYTH_CORO_SUSPENDED;
+  myth_make_context_voidcall(&co->context, myth_coro_entry, (void *)top,
+			     stacksize - ((uintptr_t)stk + sizeof(void*) * 2 - top));
+  *co_p = co;
+  return 0;
+}
+
+static inline int myth_coro_resume_body(myth_coro_t co, void * x, void ** y) {
+  if (co->status != MYTH_CORO_SUSPENDED) return EINVAL;
+  myth_thread_t th = myth_get_current_env()->this_thread;
+  co->parent = th->coro;
+  co->value = x;
+  co->status = MYTH_CORO_RUNNING;
+  th->coro = co;
+  myth_swap_context_raw(&co->caller, &co->context);
+  if (y) *y = co->value;
+  return 0;
+}
+
+static inline int myth_coro_yield_body(void * y, void ** x) {
+  int _ = myth_ensure_init();
+  (void)_;
+  myth_thread_t th = myth_get_current_env()->this_thread;
+  myth_coro_t co = th->coro;
+  if (!co) return EPERM;
+  co->value = y;
+  co->status = MYTH_CORO_SUSPENDED;
+  th->coro = co->parent;
+  myth_swap_context_raw(&co->context, &co->caller);
+  if (x) *x = co->value;
+  return 0;
+}
+
+static inline int myth_coro_done_body(myth_coro_t co) {
+  return co->status == MYTH_CORO_DONE;
+}
+
+static inline int myth_coro_destroy_body(myth_coro_t co) {
+  if (co->status == MYTH_CORO_RUNNING) return EBUSY;
+  free_myth_stack(myth_get_current_env(), co->stack);
+  return 0;
+}
+
+#endif	/* MYTH_CORO_FUNC_H_ */
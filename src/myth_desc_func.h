@@ -21,9 +21,18 @@ static inline myth_thread_t myth_context_to_thread(myth_running_env_t env,myth_c
   return (myth_thread_t)(&ctx_ptr[-offsetof(struct myth_thread,context)]);
 }
 
-static inline void myth_desc_join_set(myth_thread_t thread,myth_thread_t wait_thread)
+//Make wait_thread the thread to wake when thread finishes.
+//0 if it has finished already
+static inline int myth_desc_join_set(myth_thread_t thread,myth_thread_t wait_thread)
 {
-  thread->join_thread=wait_thread;
+  return __sync_bool_compare_and_swap(&thread->join_thread,NULL,wait_thread);
+}
+
+//The thread waiting for thread, if any
+static inline myth_thread_t myth_desc_get_waiter(myth_thread_t thread)
+{
+  myth_thread_t w=__atomic_load_n(&thread->join_thread,__ATOMIC_ACQUIRE);
+  return (w==MYTH_JOIN_DETACHED)?NULL:w;
 }
 
 static inline void myth_desc_set_not_runnable(myth_thread_t thread)
@@ -38,12 +47,27 @@ static inline int myth_desc_is_runnable(myth_thread_t thread)
 
 static inline int myth_desc_is_finished(myth_thread_t thread)
 {
-  return thread->status>=MYTH_STATUS_FREE_READY;
+  return __atomic_load_n(&thread->join_thread,__ATOMIC_ACQUIRE)==MYTH_JOIN_DONE;
+}
+
+//Mark thread finished, returning the thread waiting for it,
+//MYTH_JOIN_DETACHED or NULL
+static inline myth_thread_t myth_desc_set_finished(myth_thread_t thread)
+{
+  return __atomic_exchange_n(&thread->join_thread,MYTH_JOIN_DONE,__ATOMIC_ACQ_REL);
+}
+
+//Mark thread finished when a thread is already waiting for it.
+//Nobody else changes join_thread then, so a store suffices
+static inline void myth_desc_set_finished_to_waiter(myth_thread_t thread)
+{
+  __atomic_store_n(&thread->join_thread,MYTH_JOIN_DONE,__ATOMIC_RELEASE);
 }
 
-static inline void myth_desc_set_detached(myth_thread_t th)
+//0 if it has finished already
+static inline int myth_desc_set_detached(myth_thread_t th)
 {
-  th->detached=1;
+  return __sync_bool_compare_and_swap(&th->join_thread,NULL,MYTH_JOIN_DETACHED);
 }
 
 #endif /* MYTH_DESC_H_ */
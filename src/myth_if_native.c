@@ -11,6 +11,7 @@
 #include "myth_init_func.h"
 #include "myth_sync_func.h"
 #include "myth_sched_func.h"
+#include "myth_coro_func.h"
 /* TODO: wsapi should be factored out in a separate file */
 #include "myth_wsqueue_func.h"
 #include "myth_wls_func.h"
@@ -105,6 +106,12 @@ int myth_create_ex(myth_thread_t * id, myth_thread_attr_t * attr,
   return myth_create_ex_body(id, attr, func, arg);
 }
 
+int myth_create_many(myth_thread_t * ids, myth_thread_attr_t * attr,
+		     myth_func_t func, void * args, size_t arg_stride,
+		     long nthreads) {
+  return myth_create_many_body(ids, attr, func, args, arg_stride, nthreads);
+}
+
 void myth_exit(void *ret) {
   myth_exit_body(ret);
 }
@@ -113,6 +120,14 @@ int myth_join(myth_thread_t th,void **result) {
   return myth_join_body(th,result);
 }
 
+int myth_task_spawn(myth_task_t * t, myth_func_t func, void * arg) {
+  return myth_task_spawn_body(t, func, arg);
+}
+
+int myth_task_join(myth_task_t * t, void ** result) {
+  return myth_task_join_body(t, result);
+}
+
 int myth_tryjoin(myth_thread_t th,void **result) {
   return myth_tryjoin_body(th, result);
 }
@@ -138,6 +153,22 @@ int myth_create_join_many_ex(myth_thread_t * ids,
 				       nthreads);
 }
 
+int myth_create_join_many_grain_ex(myth_thread_t * ids,
+				   myth_thread_attr_t * attrs,
+				   myth_func_t func,
+				   void * args,
+				   void * results,
+				   size_t id_stride,
+				   size_t attr_stride,
+				   size_t arg_stride,
+				   size_t result_stride,
+				   long nthreads,
+				   long grainsize) {
+  return myth_create_join_many_grain_ex_body(ids, attrs, func, args, results,
+					     id_stride, attr_stride, arg_stride, result_stride,
+					     nthreads, grainsize);
+}
+
 int myth_create_join_various_ex(myth_thread_t * ids,
 				myth_thread_attr_t * attrs,
 				myth_func_t * funcs,
@@ -224,6 +255,24 @@ int myth_thread_attr_setstack(myth_thread_attr_t *attr,
   return myth_thread_attr_setstack_body(attr, stackaddr, stacksize);
 }
 
+int myth_thread_attr_getfpcsr(const myth_thread_attr_t *attr, int *fpcsr) {
+  return myth_thread_attr_getfpcsr_body(attr, fpcsr);
+}
+
+int myth_thread_attr_setfpcsr(myth_thread_attr_t *attr, int fpcsr) {
+  return myth_thread_attr_setfpcsr_body(attr, fpcsr);
+}
+
+int myth_thread_attr_getcancelgroup(const myth_thread_attr_t *attr,
+				    myth_cancel_group_t *g) {
+  return myth_thread_attr_getcancelgroup_body(attr, g);
+}
+
+int myth_thread_attr_setcancelgroup(myth_thread_attr_t *attr,
+				    myth_cancel_group_t g) {
+  return myth_thread_attr_setcancelgroup_body(attr, g);
+}
+
 int myth_getconcurrency(void) {
   return myth_getconcurrency_body();
 }
@@ -256,6 +305,42 @@ void myth_testcancel(void) {
   myth_testcancel_body();
 }
 
+int myth_cancel_group_create(myth_cancel_group_t * g) {
+  return myth_cancel_group_create_body(g);
+}
+
+int myth_cancel_group_destroy(myth_cancel_group_t g) {
+  return myth_cancel_group_destroy_body(g);
+}
+
+int myth_cancel_group(myth_cancel_group_t g) {
+  return myth_cancel_group_body(g);
+}
+
+/* ---------------------------
+   --- coroutines
+   --------------------------- */
+
+int myth_coro_create(myth_coro_t * co, myth_func_t func, size_t stacksize) {
+  return myth_coro_create_body(co, func, stacksize);
+}
+
+int myth_coro_resume(myth_coro_t co, void * x, void ** y) {
+  return myth_coro_resume_body(co, x, y);
+}
+
+int myth_coro_yield(void * y, void ** x) {
+  return myth_coro_yield_body(y, x);
+}
+
+int myth_coro_done(myth_coro_t co) {
+  return myth_coro_done_body(co);
+}
+
+int myth_coro_destroy(myth_coro_t co) {
+  return myth_coro_destroy_body(co);
+}
+
 
 /* ----------------------------------
    --- once 
@@ -599,6 +684,39 @@ int myth_get_num_workers(void) {
   return myth_get_num_workers_body();
 }
 
+int myth_get_alloc_stats(int rank, myth_alloc_stats_t * stats) {
+  return myth_get_alloc_stats_body(rank, stats);
+}
+
+int myth_get_stats(int rank, myth_stats_t * stats) {
+  return myth_get_stats_body(rank, stats);
+}
+
+int myth_get_steal_stats(int rank, unsigned long long * attempts,
+			 unsigned long long * steals) {
+  return myth_get_steal_stats_body(rank, attempts, steals);
+}
+
+int myth_dump_stats(int fd) {
+  return myth_dump_stats_body(fd);
+}
+
+int myth_io_get_fd_stats(int fd, myth_io_fd_stats_t * stats) {
+  return myth_io_get_fd_stats_body(fd, stats);
+}
+
+int myth_io_get_slow_ops(myth_io_slow_op_t * ops, int n) {
+  return myth_io_get_slow_ops_body(ops, n);
+}
+
+int myth_io_dump_stats(int fd) {
+  return myth_io_dump_stats_body(fd);
+}
+
+int myth_io_wait(int fd, int events) {
+  return myth_io_wait_body(fd, events);
+}
+
 /* --------------------------------
    --- thread-related functions 
    -------------------------------- */
@@ -659,19 +777,20 @@ void myth_sched_prof_pause(void) {
 
 size_t myth_wsapi_get_hint_size(myth_thread_t th) {
   if (th==NULL)th=myth_self();
-  return th->custom_data_size;
+  return (th->ext ? th->ext->custom_data_size : 0);
 }
 
 void *myth_wsapi_get_hint_ptr(myth_thread_t th) {
   if (th==NULL)th=myth_self();
-  return th->custom_data_ptr;
+  return (th->ext ? th->ext->custom_data_ptr : 0);
 }
 
 void myth_wsapi_set_hint(myth_thread_t th,void **data,size_t *size) {
   if (th==NULL)th=myth_self();
   void *newdata=*data;size_t newsize=*size;
-  *data=th->custom_data_ptr;*size=th->custom_data_size;
-  th->custom_data_ptr=newdata;th->custom_data_size=newsize;
+  myth_thread_ext_t *ext=myth_thread_ext_get(th);
+  *data=ext->custom_data_ptr;*size=ext->custom_data_size;
+  ext->custom_data_ptr=newdata;ext->custom_data_size=newsize;
 }
 
 int myth_wsapi_rand(void) {
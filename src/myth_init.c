@@ -10,6 +10,7 @@
 #include "myth_init.h"
 #include "myth_log.h"
 #include "myth_bind_worker.h"
+#include "myth_numa.h"
 
 #include "myth_init_func.h"
 #include "myth_log_func.h"
@@ -25,11 +26,19 @@ static int myth_init_ex_body_really(const myth_globalattr_t * attr) {
     if (!g_attr.initialized) myth_globalattr_init_body(&g_attr);
   }
   nw = g_attr.n_workers;
+  //Threads run with the FP control registers of the caller
+  myth_fpcsr_init();
+#if MYTH_NUMA_AWARE
+  //Decide the home node of each worker
+  myth_numa_init(nw);
+#endif
   //Initialize logger
   myth_log_init();
   //Initialize memory allocators
   myth_flmalloc_init(nw);
-  //myth_malloc_wrapper_init(nthreads);
+#if MYTH_WRAP != MYTH_WRAP_VANILLA && MYTH_WRAP_MALLOC && USE_MYTH_FLMALLOC
+  myth_malloc_wrapper_init(nw);
+#endif
 #if MYTH_WRAP_SOCKIO
   //Initialize I/O
   myth_io_init();
@@ -60,6 +69,8 @@ static int myth_init_ex_body_really(const myth_globalattr_t * attr) {
   }
   g_envs[0].worker = real_pthread_self();
   myth_worker_thread_fn((void*)0);
+  //Start writing counters periodically if asked to
+  myth_stats_dumper_init();
   return 0;
 }
 
@@ -355,6 +366,7 @@ void myth_emit_log(FILE *fp_prof_out) {
 }
 
 static void myth_fini_body_really(void) {
+  int i;
   //Output Log
   myth_emit_log(stderr);
   //Destroy barrier
@@ -368,10 +380,19 @@ static void myth_fini_body_really(void) {
   //Finalize logger
   myth_log_fini();
   //Release worker thread descriptors
+  for (i = 0; i < g_attr.n_workers; i++) {
+    myth_free_with_size(g_envs[i].steal_attempts,
+			sizeof(unsigned long long) * g_attr.n_workers * 2);
+  }
   myth_free_with_size(g_envs, sizeof(myth_running_env)*g_attr.n_workers);
   //Release allocator
+#if MYTH_WRAP != MYTH_WRAP_VANILLA && MYTH_WRAP_MALLOC && USE_MYTH_FLMALLOC
+  myth_malloc_wrapper_fini();
+#endif
   myth_flmalloc_fini();
-  //myth_malloc_wrapper_fini();
+#if MYTH_NUMA_AWARE
+  myth_numa_fini();
+#endif
   //Release TLS
   myth_env_fini();
 }
@@ -381,6 +402,7 @@ int myth_fini_body() {
     return 1;			/* OK */
   }
   myth_init_once_ctl_wait(&g_myth_init_state, myth_init_state_initialized);
+  myth_stats_dumper_fini();
   //add context switch as a sentinel for emitting logs
   int i;
   for (i = 0; i < g_attr.n_workers; i++){
@@ -19,6 +19,21 @@
 #define ENV_MYTH_DEF_GUARDSIZE "MYTH_DEF_GUARDSIZE"
 #define ENV_MYTH_BIND_WORKERS  "MYTH_BIND_WORKERS"
 #define ENV_MYTH_CHILD_FIRST   "MYTH_CHILD_FIRST"
+#define ENV_MYTH_NUMA          "MYTH_NUMA"
+#define ENV_MYTH_WRAP_MALLOC   "MYTH_WRAP_MALLOC"
+#define ENV_MYTH_WRAP_SOCKIO   "MYTH_WRAP_SOCKIO"
+#define ENV_MYTH_IO_URING      "MYTH_IO_URING"
+#define ENV_MYTH_WRAP_FILEIO   "MYTH_WRAP_FILEIO"
+#define ENV_MYTH_IO_HELPERS    "MYTH_IO_HELPERS"
+#define ENV_MYTH_IO_POLL_SWITCHES "MYTH_IO_POLL_SWITCHES"
+#define ENV_MYTH_IO_POLL_INTERVAL "MYTH_IO_POLL_INTERVAL"
+#define ENV_MYTH_IO_POLL_PRIO  "MYTH_IO_POLL_PRIO"
+#define ENV_MYTH_IO_SHARD      "MYTH_IO_SHARD"
+#define ENV_MYTH_IO_STATS      "MYTH_IO_STATS"
+#define ENV_MYTH_IO_SLOW_USEC  "MYTH_IO_SLOW_USEC"
+#define ENV_MYTH_IO_SLOW_OPS   "MYTH_IO_SLOW_OPS"
+#define ENV_MYTH_IO_STATS_SIGNAL "MYTH_IO_STATS_SIGNAL"
+#define ENV_MYTH_STATS_INTERVAL "MYTH_STATS_INTERVAL"
 
 enum {
   myth_init_state_uninit,
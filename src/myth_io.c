@@ -3,10 +3,15 @@
  */
 
 #include <assert.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
 
 #include "myth_config.h"
 #include "myth_worker.h"
 #include "myth_io.h"
+#include "myth_real.h"
 
 #include "myth_desc_func.h"
 #include "myth_worker_func.h"
@@ -17,53 +22,279 @@ myth_fd_map_t g_fd_map;
 int g_recvfrom_cnt,g_sendto_cnt;
 int g_n_recvfrom_cnt,g_n_sendto_cnt;
 
-#if MYTH_WRAP_SOCKIO
+/* socket calls are interposed by myth_wrap_socket.c (libmyth-ld
+   and libmyth-dl), which calls myth_*_body of myth_io_func.h
+   while g_myth_io_on is set */
+volatile int g_myth_io_on = 0;
+//Number of workers whose threads wait for I/O readiness with epoll
+volatile int g_myth_io_n_epoll_workers = 0;
+//Check I/O every g_myth_io_poll_switches switches or g_myth_io_poll_ticks
+//cycles (0:never), and let the threads found run first if g_myth_io_poll_prio
+int g_myth_io_poll_switches = 0;
+uint64_t g_myth_io_poll_ticks = 0;
+int g_myth_io_poll_prio = 1;
+//MYTH_IO_SHARD=1 (see myth_io_shard_listen)
+int g_myth_io_shard = 0;
+uint64_t g_myth_io_ticks_per_usec = 0;
+//MYTH_IO_STATS, MYTH_IO_SLOW_USEC and MYTH_IO_STATS_SIGNAL
+//(see myth_io_stat_parked in myth_io_func.h)
+int g_myth_io_stats = 0;
+uint64_t g_myth_io_slow_ticks = 0;
+volatile int g_myth_io_dump_req = 0;
 
-int socket (int domain, int type, int protocol) {
-  return myth_socket_body(domain,type,protocol);
-}
+/* the last slow calls, in a ring of g_myth_io_trace.size entries.
+   the call numbered seq is in ops[seq % size] */
+static struct {
+  myth_spinlock_t lock;
+  myth_io_slow_op_t * ops;
+  int size;
+  unsigned long long n;		/* calls recorded so far */
+  int sig;			/* MYTH_IO_STATS_SIGNAL, or 0 */
+  struct sigaction old_act;
+} g_myth_io_trace;
 
-int connect (int fd, const struct sockaddr *addr, socklen_t len) {
-  return myth_connect_body(fd,addr,len);
+static void myth_io_stats_sighandler(int sig) {
+  (void)sig;
+  g_myth_io_dump_req = 1;
 }
-int accept (int fd, struct sockaddr* addr,
-	    socklen_t * addr_len) {
-  return myth_accept_body(fd,addr,addr_len);
+
+void myth_io_stats_init(int slow_ops, int sig) {
+  myth_spin_init_body(&g_myth_io_trace.lock);
+  g_myth_io_trace.size = slow_ops;
+  g_myth_io_trace.n = 0;
+  g_myth_io_trace.ops = slow_ops ? myth_malloc(sizeof(myth_io_slow_op_t) * slow_ops) : NULL;
+  g_myth_io_trace.sig = sig;
+  g_myth_io_dump_req = 0;
+  if (sig > 0) {
+    struct sigaction act;
+    memset(&act, 0, sizeof(act));
+    act.sa_handler = myth_io_stats_sighandler;
+    act.sa_flags = SA_RESTART;
+    sigemptyset(&act.sa_mask);
+    if (sigaction(sig, &act, &g_myth_io_trace.old_act) != 0) {
+      perror("sigaction (MYTH_IO_STATS_SIGNAL)");
+      g_myth_io_trace.sig = 0;
+    }
+  }
 }
-int listen (int fd, int n) {
-  return myth_listen_body(fd,n);
+
+void myth_io_stats_fini(void) {
+  if (g_myth_io_trace.sig > 0) {
+    sigaction(g_myth_io_trace.sig, &g_myth_io_trace.old_act, NULL);
+    g_myth_io_trace.sig = 0;
+  }
+  g_myth_io_stats = 0;
+  g_myth_io_slow_ticks = 0;
+  myth_spin_lock_body(&g_myth_io_trace.lock);
+  if (g_myth_io_trace.ops) {
+    myth_free_with_size(g_myth_io_trace.ops,
+			sizeof(myth_io_slow_op_t) * g_myth_io_trace.size);
+  }
+  g_myth_io_trace.ops = NULL;
+  g_myth_io_trace.size = 0;
+  myth_spin_unlock_body(&g_myth_io_trace.lock);
 }
-int bind(int fd, const struct sockaddr* addr, socklen_t len) {
-  return myth_bind_body(fd,addr,len);
+
+void myth_io_slow_record(const myth_io_slow_op_t * rec) {
+  myth_spin_lock_body(&g_myth_io_trace.lock);
+  if (g_myth_io_trace.ops) {
+    myth_io_slow_op_t * e = &g_myth_io_trace.ops[g_myth_io_trace.n % g_myth_io_trace.size];
+    *e = *rec;
+    e->seq = g_myth_io_trace.n++;
+  }
+  myth_spin_unlock_body(&g_myth_io_trace.lock);
 }
-int select(int nfds, fd_set *readfds, fd_set *writefds,
-           fd_set *exceptfds, struct timeval *timeout) {
-  return myth_select_body(nfds,readfds,writefds,exceptfds,timeout);
+
+int myth_io_get_fd_stats_body(int fd, myth_io_fd_stats_t * stats) {
+#if MYTH_WRAP_SOCKIO
+  myth_io_struct_perfd_t fd_data;
+  if (!g_myth_io_stats || !(g_myth_io_on & MYTH_IO_ON_SOCK)) return EINVAL;
+  fd_data = myth_fd_map_lookup(g_fd_map, fd);
+  if (!fd_data) return EINVAL;
+  /* not through fd_data, which a close may free meanwhile */
+  *stats = *myth_fd_map_stats(g_fd_map, fd);
+  return 0;
+#else
+  (void)fd; (void)stats;
+  return EINVAL;
+#endif
 }
-ssize_t sendto(int sockfd, const void *buf, size_t len, int flags,
-               const struct sockaddr *dest_addr, socklen_t addrlen) {
-  return myth_sendto_body(sockfd,buf,len,flags,dest_addr,addrlen);
+
+int myth_io_get_slow_ops_body(myth_io_slow_op_t * ops, int n) {
+  unsigned long long first, i;
+  int k = 0;
+  if (n <= 0) return 0;
+  myth_spin_lock_body(&g_myth_io_trace.lock);
+  if (g_myth_io_trace.ops) {
+    first = g_myth_io_trace.n;
+    first = (first > (unsigned long long)g_myth_io_trace.size ?
+	     first - g_myth_io_trace.size : 0);
+    if (g_myth_io_trace.n - first > (unsigned long long)n) first = g_myth_io_trace.n - n;
+    for (i = first; i < g_myth_io_trace.n; i++) {
+      ops[k++] = g_myth_io_trace.ops[i % g_myth_io_trace.size];
+    }
+  }
+  myth_spin_unlock_body(&g_myth_io_trace.lock);
+  return k;
 }
-ssize_t recvfrom(int sockfd, void *buf, size_t len, int flags,
-                 struct sockaddr *src_addr, socklen_t *addrlen) {
-  return myth_recvfrom_body(sockfd,buf,len,flags,src_addr,addrlen);
+
+int myth_io_dump_stats_body(int fd) {
+  char buf[4096];
+  int len = 0, err = 0, size, n, i;
+  myth_io_slow_op_t * ops;
+#define MYTH_IO_DUMP(...) do {						\
+    if (len > (int)sizeof(buf) - 256) err = (err ? err : myth_dump_flush(fd, buf, &len)); \
+    len += snprintf(buf + len, sizeof(buf) - len, __VA_ARGS__);	\
+  } while (0)
+#if MYTH_WRAP_SOCKIO
+  if (g_myth_io_stats && (g_myth_io_on & MYTH_IO_ON_SOCK)) {
+    myth_fd_map_dir_t dir = __atomic_load_n(&g_fd_map->dir, __ATOMIC_ACQUIRE);
+    int c, j;
+    MYTH_IO_DUMP("myth I/O stats: fd reads read_bytes writes written_bytes eagain park_usec\n");
+    for (c = 0; c < dir->n_chunks; c++) {
+      myth_io_struct_perfd_t * chunk = __atomic_load_n(&dir->chunks[c], __ATOMIC_ACQUIRE);
+      if (!chunk) continue;
+      for (j = 0; j < MYTH_FD_MAP_CHUNK; j++) {
+	myth_io_struct_perfd_t fd_data = __atomic_load_n(&chunk[j], __ATOMIC_ACQUIRE);
+	myth_io_fd_stats_t st;
+	if (!fd_data) continue;
+	/* not through fd_data, which a close may free meanwhile */
+	st = myth_fd_map_chunk_stats(chunk)[j];
+	MYTH_IO_DUMP("%d %llu %llu %llu %llu %llu %llu\n",
+		     c * MYTH_FD_MAP_CHUNK + j, st.n_reads, st.read_bytes,
+		     st.n_writes, st.written_bytes, st.n_eagain, st.park_usec);
+      }
+    }
+  }
+#endif
+  /* copied out, so as not to hold the lock while writing */
+  size = g_myth_io_trace.size;
+  if (size > 0) {
+    ops = myth_malloc(sizeof(myth_io_slow_op_t) * size);
+    n = myth_io_get_slow_ops_body(ops, size);
+    MYTH_IO_DUMP("myth I/O slow calls (>= %llu us): seq end op fd worker thread usec ret errno\n",
+		 (unsigned long long)(g_myth_io_slow_ticks / (g_myth_io_ticks_per_usec ? g_myth_io_ticks_per_usec : 1)));
+    for (i = 0; i < n; i++) {
+      MYTH_IO_DUMP("%llu %ld.%06ld %s %d %d %p %llu %ld %d\n",
+		   ops[i].seq, (long)ops[i].end.tv_sec, ops[i].end.tv_nsec / 1000,
+		   ops[i].op, ops[i].fd, ops[i].worker, (void *)ops[i].thread,
+		   ops[i].usec, ops[i].ret, ops[i].err);
+    }
+    myth_free_with_size(ops, sizeof(myth_io_slow_op_t) * size);
+  }
+#undef MYTH_IO_DUMP
+  if (!err) err = myth_dump_flush(fd, buf, &len);
+  return err;
 }
-ssize_t send (int fd, const void *buf, size_t n, int flags) {
-  return myth_send_body(fd,buf,n,flags);
+
+/* park the calling thread until fd is ready for events. a socket
+   of ours waits in the epoll or io_uring of its worker like the
+   calls made on it, other fds along with poll (myth_io_poll_until) */
+int myth_io_wait_body(int fd, int events) {
+#if MYTH_WRAP_SOCKIO
+  myth_running_env_t env;
+  myth_io_op op;
+  if (!(g_myth_io_on & MYTH_IO_ON_SOCK) || g_worker_rank < 0) return ENOTSUP;
+  if (events != POLLIN && events != POLLOUT) return EINVAL;
+  if (!myth_fd_map_lookup(g_fd_map, fd)) {
+    struct pollfd p;
+    p.fd = fd;
+    p.events = events;
+    p.revents = 0;
+    return (myth_io_poll_until(&p, 1, NULL) == -1 ? errno : 0);
+  }
+  op.type = MYTH_IO_WAIT;
+  op.u.w.fd = fd;
+  op.u.w.events = events;
+  env = myth_get_current_env();
+  myth_io_cs_enter(env);
+  if (myth_io_execute(&op)) myth_io_cs_exit(env);
+  /* not counted as a read or write in the stats */
+  else if (events == POLLIN) myth_wait_for_read_0(fd, env, &op);
+  else myth_wait_for_write_0(fd, env, &op);
+  return (op.ret == -1 ? op.errcode : 0);
+#else
+  (void)fd; (void)events;
+  return ENOTSUP;
+#endif
 }
-ssize_t recv (int fd, void *buf, size_t n, int flags) {
-  return myth_recv_body(fd,buf,n,flags);
+
+/* helper threads for MYTH_WRAP_FILEIO=1. a user thread whose
+   worker has no io_uring for files queues its op here after it
+   has been switched out (myth_io_file_wait); a helper performs
+   the blocking call and passes the thread back to the runqueue
+   of that worker */
+int g_myth_io_n_helpers = 0;
+
+static struct {
+  pthread_mutex_t mtx;
+  pthread_cond_t cond;
+  myth_io_op_t head;
+  myth_io_op_t tail;
+  int exit_flag;
+  pthread_t * threads;
+} g_myth_io_helpers;
+
+static void * myth_io_helper_main(void * arg) {
+  (void)arg;
+  real_pthread_mutex_lock(&g_myth_io_helpers.mtx);
+  while (1) {
+    myth_io_op_t op = g_myth_io_helpers.head;
+    myth_thread_t th;
+    if (!op) {
+      if (g_myth_io_helpers.exit_flag) break;
+      real_pthread_cond_wait(&g_myth_io_helpers.cond, &g_myth_io_helpers.mtx);
+      continue;
+    }
+    g_myth_io_helpers.head = op->next;
+    if (!op->next) g_myth_io_helpers.tail = NULL;
+    real_pthread_mutex_unlock(&g_myth_io_helpers.mtx);
+    myth_io_execute_file(op);
+    /* op is on the stack of th, which may run as soon as it is passed */
+    th = op->th;
+    myth_queue_pass(&th->env->runnable_q, th);
+    real_pthread_mutex_lock(&g_myth_io_helpers.mtx);
+  }
+  real_pthread_mutex_unlock(&g_myth_io_helpers.mtx);
+  return 0;
 }
-int close (int fd) {
-  return myth_close_body(fd);
+
+void myth_io_helpers_init(int n) {
+  int i;
+  if (n < 0) n = 0;
+  real_pthread_mutex_init(&g_myth_io_helpers.mtx, NULL);
+  real_pthread_cond_init(&g_myth_io_helpers.cond, NULL);
+  g_myth_io_helpers.head = g_myth_io_helpers.tail = NULL;
+  g_myth_io_helpers.exit_flag = 0;
+  g_myth_io_helpers.threads = n ? myth_malloc(sizeof(pthread_t) * n) : NULL;
+  for (i = 0; i < n; i++) {
+    real_pthread_create(&g_myth_io_helpers.threads[i], NULL,
+			myth_io_helper_main, NULL);
+  }
+  g_myth_io_n_helpers = n;
 }
-int fcntl (int fd, int cmd, ...) {
-  int ret;
-  va_list vl;
-  va_start(vl,cmd);
-  ret=myth_fcntl_body(fd,cmd,vl);
-  va_end(vl);
-  return ret;
+
+void myth_io_helpers_fini(void) {
+  int i, n = g_myth_io_n_helpers;
+  real_pthread_mutex_lock(&g_myth_io_helpers.mtx);
+  g_myth_io_helpers.exit_flag = 1;
+  real_pthread_cond_broadcast(&g_myth_io_helpers.cond);
+  real_pthread_mutex_unlock(&g_myth_io_helpers.mtx);
+  for (i = 0; i < n; i++) {
+    real_pthread_join(g_myth_io_helpers.threads[i], NULL);
+  }
+  if (n) myth_free_with_size(g_myth_io_helpers.threads, sizeof(pthread_t) * n);
+  real_pthread_cond_destroy(&g_myth_io_helpers.cond);
+  real_pthread_mutex_destroy(&g_myth_io_helpers.mtx);
+  g_myth_io_n_helpers = 0;
 }
 
-#endif
+void myth_io_helpers_submit(myth_io_op_t op) {
+  op->next = NULL;
+  real_pthread_mutex_lock(&g_myth_io_helpers.mtx);
+  if (g_myth_io_helpers.tail) g_myth_io_helpers.tail->next = op;
+  else g_myth_io_helpers.head = op;
+  g_myth_io_helpers.tail = op;
+  real_pthread_cond_signal(&g_myth_io_helpers.cond);
+  real_pthread_mutex_unlock(&g_myth_io_helpers.mtx);
+}
@@ -5,12 +5,20 @@
 #ifndef MYTH_IO_H_
 #define MYTH_IO_H_
 
+#include <poll.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/epoll.h>
+#include <sys/select.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <stdint.h>
 #include <stdarg.h>
+#include <time.h>
 
 #include "myth/myth.h"
 #include "myth_config.h"
+#include "myth_io_uring.h"
 #include "myth_spinlock_func.h"
 
 typedef enum myth_io_type {
@@ -20,22 +28,54 @@ typedef enum myth_io_type {
   MYTH_IO_SEND,
   MYTH_IO_RECVFROM,
   MYTH_IO_SENDTO,
-  MYTH_IO_SELECT,
+  MYTH_IO_POLL,//poll, select and epoll_wait
+  MYTH_IO_RECVMSG,
+  MYTH_IO_SENDMSG,
+  MYTH_IO_SENDFILE,
+  MYTH_IO_SPLICE,
+  MYTH_IO_ERRQUEUE,//wait for MSG_ZEROCOPY completions
+  MYTH_IO_RECVMMSG,
+  MYTH_IO_SENDMMSG,
+  MYTH_IO_WAIT,//wait for readiness only (myth_io_wait)
+  //file I/O, performed by helper threads or io_uring
+  MYTH_IO_READ,
+  MYTH_IO_WRITE,
+  MYTH_IO_PREAD,
+  MYTH_IO_PWRITE,
+  MYTH_IO_FSYNC,
+  MYTH_IO_OPEN,
+  MYTH_IO_READV,
+  MYTH_IO_WRITEV,
 } myth_io_type;
 
-typedef struct myth_fd_map_entry {
-  int bufsize;
-  int size;
-  //void **data;
-  struct myth_io_struct_perfd **data;
-  int *key;
-  myth_spinlock_t lock;
-} myth_fd_map_entry,*myth_fd_map_entry_t;
+//Bits of g_myth_io_on
+#define MYTH_IO_ON_SOCK 1 //socket calls are multiplexed (MYTH_WRAP_SOCKIO=1)
+#define MYTH_IO_ON_FILE 2 //file I/O is offloaded (MYTH_WRAP_FILEIO=1)
+
+//send and sendmsg with MSG_ZEROCOPY return once the kernel has released the buffer
+#if defined(MSG_ZEROCOPY) && defined(SO_ZEROCOPY) && defined(HAVE_LINUX_ERRQUEUE_H)
+#define MYTH_IO_ZEROCOPY 1
+#else
+#define MYTH_IO_ZEROCOPY 0
+#endif
+
+//Registered fds, indexed directly by fd. slots are grouped into chunks
+//of MYTH_FD_MAP_CHUNK, allocated as fds come; a chunk never moves, so
+//lookups take no lock. with MYTH_IO_STATS=1, a chunk is followed by
+//the stats of its fds, which outlive their myth_io_struct_perfd so
+//that they can be read while the fd is being closed (see myth_fd_map_stats)
+#define MYTH_FD_MAP_CHUNK_BITS 12
+#define MYTH_FD_MAP_CHUNK (1<<MYTH_FD_MAP_CHUNK_BITS)
+
+typedef struct myth_fd_map_dir {
+  struct myth_fd_map_dir *prev;//The smaller one it replaced, freed with the map
+  int n_chunks;
+  struct myth_io_struct_perfd **chunks[];
+} myth_fd_map_dir,*myth_fd_map_dir_t;
 
 typedef struct myth_fd_map {
-  myth_spinlock_t lock;
-  myth_fd_map_entry *entry;
-  //int size;
+  myth_fd_map_dir_t dir;//Replaced by a larger one when fds go beyond it
+  myth_spinlock_t lock;//Taken only to add a chunk or grow dir
 } myth_fd_map,*myth_fd_map_t;
 
 typedef struct myth_io_fd_list {//File descriptor list
@@ -49,12 +89,14 @@ typedef struct myth_io_fd_list {//File descriptor list
 typedef struct myth_io_op {
   struct myth_thread *th;//The owner thread
   struct myth_io_wait_list *wl_ptr;
+  struct myth_io_wait_list *volatile parked_on;//The list it is in, set under its lock
   myth_io_type type;
   union{
     struct{
       int fd;
       struct sockaddr *addr;
       socklen_t *len;
+      int flags;//SOCK_CLOEXEC of accept4
     } a;//accept
     struct{
       int fd;
@@ -90,15 +132,62 @@ typedef struct myth_io_op {
       socklen_t *addr_len;
     } rf;//recvfrom
     struct{
-      int nfds;
-      fd_set *readfds;
-      fd_set *writefds;
-      fd_set *exceptfds;
-      struct timeval *timeout;
-    } sl;//select
+      struct pollfd *fds;
+      nfds_t nfds;
+      int timed;
+      struct timespec deadline;//wake with 0 at this time if timed
+    } p;//poll
+    struct{
+      int fd;
+      void *buf;
+      size_t n;
+      off_t off;
+      const char *path;
+      int flags;
+      mode_t mode;
+      const struct iovec *iov;
+      int iovcnt;
+    } f;//read, write, pread, pwrite, fsync, open, readv and writev
+    struct{
+      int fd;
+      struct msghdr *msg;
+      int flags;
+    } m;//recvmsg and sendmsg
+    struct{
+      int out_fd;
+      int in_fd;
+      off_t *off;
+      size_t n;
+    } sf;//sendfile
+    struct{
+      int fd_in;
+      loff_t *off_in;
+      int fd_out;
+      loff_t *off_out;
+      size_t n;
+      unsigned int flags;
+      int sock;//the side which is a socket
+    } sp;//splice
+    struct{
+      int fd;
+      uint32_t id;//wait until this send has completed
+    } e;//errqueue
+    struct{
+      int fd;
+      struct mmsghdr *vec;
+      unsigned int vlen;
+      int flags;
+    } mm;//recvmmsg and sendmmsg
+    struct{
+      int fd;
+      int events;//POLLIN or POLLOUT
+    } w;//wait
   } u;
-  int ret;
+  ssize_t ret;
   int errcode;
+  int uring_mode;//How the op waits in io_uring (MYTH_IO_URING_OP or MYTH_IO_URING_POLL)
+  uint32_t zc_id;//The id the kernel gave to a MSG_ZEROCOPY send
+  struct myth_io_op *next;//Link in the queue of helper threads
 } myth_io_op, *myth_io_op_t;
 
 //Pending I/O operation list
@@ -121,6 +210,14 @@ typedef struct myth_io_struct_perenv {
   //myth_io_fd_list notify_list;
   volatile int8_t cs_flag;
   int sig_count;
+  myth_io_uring uring;//Blocked calls wait here instead of epoll when uring.fd!=-1
+  myth_io_op_t poll_waiters;//MYTH_IO_POLL ops linked by next
+  nfds_t poll_nfds;//Number of their fds
+  struct pollfd *poll_buf;//All their fds, to check them with one poll
+  size_t poll_buf_size;
+  struct myth_thread *passed;//Woken by another thread, for the worker to run (see myth_io_pass)
+  int poll_switches;//Switches since I/O was last checked between threads
+  uint64_t poll_next;//rdtsc value after which it is checked again
 #if MYTH_USE_IO_THREAD
   pthread_t thread;
   uint8_t exit_flag;
@@ -140,9 +237,74 @@ typedef struct myth_io_struct_perfd {
   int tmp_for_poll;
   myth_running_env_t env;
   int closed;
+  //MSG_ZEROCOPY sends are numbered from 0 by the kernel.
+  //those before zc_done have completed
+  myth_spinlock_t zc_lock;
+  uint32_t zc_next;
+  uint32_t zc_done;
+  myth_io_op_t zc_waiters;//MYTH_IO_ERRQUEUE ops linked by next (epoll only)
+  int zc_on;//SO_ZEROCOPY is set (see myth_setsockopt_body)
+  //Connections taken from the backlog of a listening socket
+  //but not yet returned by accept (allocated by the first accept)
+  myth_spinlock_t acc_lock;
+  struct myth_io_accepted *acc;
+  //With MYTH_IO_SHARD=1, the listening sockets of all workers
+  //on the address of this one (see myth_io_shard_listen)
+  struct myth_io_shards *shards;
+  //With MYTH_IO_STATS=1, counters of the calls on it (see myth_io_stat_add),
+  //in the fd map
+  myth_io_fd_stats_t *stats;
 } myth_io_struct_perfd, *myth_io_struct_perfd_t;
 
+//Listening sockets sharing an address; fd[i] belongs to worker i (-1: none)
+typedef struct myth_io_shards {
+  int n;
+  int fd[];
+} myth_io_shards, *myth_io_shards_t;
+
+//Connections accepted in one burst (see myth_io_accept)
+typedef struct myth_io_accepted {
+  int head;
+  int n;
+  struct{
+    int fd;
+    int cloexec;
+    socklen_t len;
+    struct sockaddr_storage addr;
+  } c[MYTH_IO_ACCEPT_BURST];
+} myth_io_accepted, *myth_io_accepted_t;
+
 extern myth_fd_map_t g_fd_map;
+extern volatile int g_myth_io_on;
+extern volatile int g_myth_io_n_epoll_workers;
+//When to check I/O between threads (see myth_io_polling_between)
+extern int g_myth_io_poll_switches;
+extern uint64_t g_myth_io_poll_ticks;
+extern int g_myth_io_poll_prio;
+//Listening sockets are sharded and fds stay with their workers
+extern int g_myth_io_shard;
+//rdtsc cycles per microsecond (0 if nothing is timed)
+extern uint64_t g_myth_io_ticks_per_usec;
+//MYTH_IO_STATS=1, and MYTH_IO_SLOW_USEC in cycles (0:off)
+extern int g_myth_io_stats;
+extern uint64_t g_myth_io_slow_ticks;
+//Set by MYTH_IO_STATS_SIGNAL; a worker dumps the stats in myth_io_polling
+extern volatile int g_myth_io_dump_req;
+
+//The ring of slow calls and the stats dump (myth_io.c)
+void myth_io_stats_init(int slow_ops,int sig);
+void myth_io_stats_fini(void);
+void myth_io_slow_record(const myth_io_slow_op_t *rec);
+int myth_io_get_fd_stats_body(int fd,myth_io_fd_stats_t *stats);
+int myth_io_get_slow_ops_body(myth_io_slow_op_t *ops,int n);
+int myth_io_dump_stats_body(int fd);
+int myth_io_wait_body(int fd,int events);
+
+//Helper threads performing blocking file I/O on behalf of user threads
+extern int g_myth_io_n_helpers;
+void myth_io_helpers_init(int n);
+void myth_io_helpers_fini(void);
+void myth_io_helpers_submit(myth_io_op_t op);
 
 
 #if MYTH_WRAP_SOCKIO
@@ -164,13 +326,54 @@ static inline int myth_connect_body (int fd, const struct sockaddr* addr,
 				     socklen_t len);
 static inline int myth_accept_body (int fd, struct sockaddr *addr,
 		   socklen_t * addr_len);
+static inline int myth_accept4_body (int fd, struct sockaddr *addr,
+				     socklen_t * addr_len, int flags);
 static inline int myth_bind_body(int fd, const struct sockaddr* addr, socklen_t len);
 static inline int myth_listen_body (int fd, int n);
+static inline void myth_io_shard_wait(struct myth_io_shards *sh,myth_io_op_t op);
 static inline ssize_t myth_send_body (int fd, const void *buf, size_t n, int flags);
 static inline ssize_t myth_recv_body (int fd, void *buf, size_t n, int flags);
 static inline int myth_close_body (int fd);
+static inline ssize_t myth_read_body (int fd, void *buf, size_t n);
+static inline ssize_t myth_write_body (int fd, const void *buf, size_t n);
+static inline ssize_t myth_pread_body (int fd, void *buf, size_t n, off_t off);
+static inline ssize_t myth_pwrite_body (int fd, const void *buf, size_t n, off_t off);
+static inline int myth_fsync_body (int fd);
+static inline int myth_open_body (const char *path, int flags, mode_t mode);
+static inline ssize_t myth_recvmsg_body (int fd, struct msghdr *msg, int flags);
+static inline ssize_t myth_sendmsg_body (int fd, const struct msghdr *msg, int flags);
+static inline int myth_setsockopt_body (int fd, int level, int optname,
+					const void *optval, socklen_t optlen);
+static inline ssize_t myth_readv_body (int fd, const struct iovec *iov, int iovcnt);
+static inline ssize_t myth_writev_body (int fd, const struct iovec *iov, int iovcnt);
+#if defined(HAVE_SYS_SENDFILE_H)
+static inline ssize_t myth_sendfile_body (int out_fd, int in_fd, off_t *off, size_t n);
+#endif
+#if defined(HAVE_SPLICE)
+static inline ssize_t myth_splice_body (int fd_in, loff_t *off_in, int fd_out,
+					loff_t *off_out, size_t n, unsigned int flags);
+#endif
+#if defined(HAVE_RECVMMSG)
+static inline int myth_recvmmsg_body (int fd, struct mmsghdr *vec, unsigned int vlen,
+				      int flags, struct timespec *timeout);
+#endif
+#if defined(HAVE_SENDMMSG)
+static inline int myth_sendmmsg_body (int fd, struct mmsghdr *vec, unsigned int vlen,
+				      int flags);
+#endif
+static inline int myth_select_body(int nfds, fd_set *readfds, fd_set *writefds,
+				   fd_set *exceptfds, struct timeval *timeout);
+static inline int myth_poll_body (struct pollfd *fds, nfds_t nfds, int timeout);
+#if defined(HAVE_PPOLL)
+static inline int myth_ppoll_body (struct pollfd *fds, nfds_t nfds,
+				   const struct timespec *tmo_p, const sigset_t *sigmask);
+#endif
+static inline int myth_epoll_wait_body (int epfd, struct epoll_event *events,
+					int maxevents, int timeout);
+static inline void myth_io_execute_file(myth_io_op_t op);
 static inline int myth_fcntl_body (int fd, int cmd,va_list vl);
 static inline myth_thread_t myth_io_polling(struct myth_running_env *env);
+static inline myth_thread_t myth_io_polling_between(struct myth_running_env *env,myth_thread_t next);
 static inline int myth_io_execute(myth_io_op_t op);
 
 #endif	/* MYTH_WRAP_SOCKIO */
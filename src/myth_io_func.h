@@ -19,7 +19,10 @@
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <sys/epoll.h>
+#include <sys/stat.h>
+#include <netinet/in.h>
 #include <sys/time.h>
+#include <sys/resource.h>
 #include <pthread.h>
 #include <sched.h>
 
@@ -28,6 +31,10 @@
 #include "myth_io.h"
 #include "myth_init.h"
 
+#if MYTH_IO_ZEROCOPY
+#include <linux/errqueue.h>
+#endif
+
 #include "myth_misc_func.h"
 #include "myth_context_func.h"
 #include "myth_spinlock_func.h"
@@ -36,150 +43,124 @@
 
 /* used to be in myth_io_proto.h */
 
-#define MYTH_FD_MAP_SIZE 65536
-#define MYTH_FD_MAP_KEY(fd) ((fd)%65536)
-//#define MYTH_FD_MAP_KEY(fd) 0
+static inline myth_fd_map_dir_t myth_fd_map_dir_new(int n_chunks,myth_fd_map_dir_t prev) {
+  myth_fd_map_dir_t dir;
+  int i;
+  dir=myth_malloc(sizeof(myth_fd_map_dir)+sizeof(myth_io_struct_perfd_t*)*n_chunks);
+  dir->prev=prev;
+  dir->n_chunks=n_chunks;
+  for (i=0;i<n_chunks;i++)dir->chunks[i]=(prev && i<prev->n_chunks)?prev->chunks[i]:NULL;
+  return dir;
+}
 
-//Map structure for searching a blocked list associated with a fd
+//Map from a fd to its blocked lists, as large as RLIMIT_NOFILE allows
 static inline myth_fd_map_t myth_fd_map_init() {
   myth_fd_map_t ret;
+  struct rlimit rl;
+  long n=65536;
+  if (getrlimit(RLIMIT_NOFILE,&rl)==0){
+    n=(rl.rlim_cur==RLIM_INFINITY || rl.rlim_cur>(1<<20))?(1<<20):(long)rl.rlim_cur;
+  }
   ret=myth_malloc(sizeof(myth_fd_map));
-  ret->entry=myth_malloc(sizeof(myth_fd_map_entry)*MYTH_FD_MAP_SIZE);
-  int i;
-  for (i=0;i<MYTH_FD_MAP_SIZE;i++){
-    ret->entry[i].data=myth_malloc(sizeof(void*));
-    ret->entry[i].key=myth_malloc(sizeof(int));
-    ret->entry[i].size=0;
-    ret->entry[i].bufsize=1;
-    myth_spin_init_body(&ret->entry[i].lock);
-  }
-  //ret->size=0;
+  ret->dir=myth_fd_map_dir_new((n+MYTH_FD_MAP_CHUNK-1)/MYTH_FD_MAP_CHUNK,NULL);
   myth_spin_init_body(&ret->lock);
   return ret;
 }
 
-static inline void myth_fd_map_set(myth_running_env_t env,myth_fd_map_t fm,int fd,myth_io_struct_perfd_t data) {//Set fd_map to entry
+//Slots of a chunk, and their stats if MYTH_IO_STATS=1
+static inline size_t myth_fd_map_chunk_size(void) {
+  return (sizeof(myth_io_struct_perfd_t)
+	  +(g_myth_io_stats?sizeof(myth_io_fd_stats_t):0))*MYTH_FD_MAP_CHUNK;
+}
+
+//The slot of FD, or NULL if it has none and CREATE is 0
+static inline myth_io_struct_perfd_t *myth_fd_map_slot(myth_fd_map_t fm,int fd,int create) {
+  myth_fd_map_dir_t dir;
+  myth_io_struct_perfd_t *chunk;
+  int ci;
+  if (fd<0)return NULL;
+  ci=fd>>MYTH_FD_MAP_CHUNK_BITS;
+  dir=__atomic_load_n(&fm->dir,__ATOMIC_ACQUIRE);
+  chunk=(ci<dir->n_chunks)?__atomic_load_n(&dir->chunks[ci],__ATOMIC_ACQUIRE):NULL;
+  if (!chunk){
+    if (!create)return NULL;
+    //The limit was raised, or the first fd in this chunk
+    myth_spin_lock_body(&fm->lock);
+    dir=fm->dir;
+    if (ci>=dir->n_chunks){
+      dir=myth_fd_map_dir_new((ci+1>dir->n_chunks*2)?ci+1:dir->n_chunks*2,dir);
+      __atomic_store_n(&fm->dir,dir,__ATOMIC_RELEASE);
+    }
+    chunk=dir->chunks[ci];
+    if (!chunk){
+      chunk=myth_malloc(myth_fd_map_chunk_size());
+      memset(chunk,0,myth_fd_map_chunk_size());
+      __atomic_store_n(&dir->chunks[ci],chunk,__ATOMIC_RELEASE);
+    }
+    myth_spin_unlock_body(&fm->lock);
+  }
+  return &chunk[fd&(MYTH_FD_MAP_CHUNK-1)];
+}
+
+static inline void myth_fd_map_set(myth_fd_map_t fm,int fd,myth_io_struct_perfd_t data) {//Set fd_map to entry
   //Setting NULL as value is forbidden because NULL is returned when lookup fails
   myth_assert(data);
-  int i;
-  myth_fd_map_entry_t fe;
-  myth_spin_lock_body(&fm->lock);
-  fe=&fm->entry[MYTH_FD_MAP_KEY(fd)];
-  myth_spin_lock_body(&fe->lock);
-  for (i=0;i<fe->size;i++){
-    if (fe->key[i]==fd){
-      fe->data[i]=data;
-      myth_spin_unlock_body(&fe->lock);
-      myth_spin_unlock_body(&fm->lock);
-      return;
-    }
-  }
-  fe->size++;
-  if (fe->size>fe->bufsize){
-    //If list size is full, reallocate
-    int new_bufsize=fe->bufsize*2;
-    fe->key=myth_flrealloc(env->rank,sizeof(int)*fe->bufsize,fe->key,sizeof(int)*new_bufsize);
-    fe->data=myth_flrealloc(env->rank,sizeof(void*)*fe->bufsize,fe->data,sizeof(void*)*new_bufsize);
-    fe->bufsize=new_bufsize;
-  }
-  fe->key[fe->size-1]=fd;
-  fe->data[fe->size-1]=data;
-  myth_spin_unlock_body(&fe->lock);
-  //fm->size++;
-  myth_spin_unlock_body(&fm->lock);
+  __atomic_store_n(myth_fd_map_slot(fm,fd,1),data,__ATOMIC_RELEASE);
 }
 
 static inline void myth_fd_map_delete(myth_fd_map_t fm,int fd) {
-  int i,j;
-  myth_fd_map_entry_t fe;
-  myth_spin_lock_body(&fm->lock);
-  fe=&fm->entry[MYTH_FD_MAP_KEY(fd)];
-  myth_spin_lock_body(&fe->lock);
-  for (i=0;i<fe->size;i++){
-    if (fe->key[i]==fd){
-      for (j=i+1;j<fe->size;j++){
-	fe->key[j-1]=fe->key[j];
-	fe->data[j-1]=fe->data[j];
-      }
-      fe->size--;
-      myth_spin_unlock_body(&fe->lock);
-      //fm->size--;
-      myth_spin_unlock_body(&fm->lock);
-      return;
-    }
-  }
-  //simply ignore
-  //assert(0);
+  myth_io_struct_perfd_t *slot;
+  slot=myth_fd_map_slot(fm,fd,0);
+  //simply ignore fds not in the map
+  if (slot)__atomic_store_n(slot,NULL,__ATOMIC_RELEASE);
 }
 
 static inline myth_io_struct_perfd_t myth_fd_map_lookup(myth_fd_map_t fm,int fd) {//Lookup blocked list from fd, return NULL if lookup fails
-  int i;
-  myth_fd_map_entry_t fe;
-  myth_spin_lock_body(&fm->lock);
-  fe=&fm->entry[MYTH_FD_MAP_KEY(fd)];
-  myth_spin_lock_body(&fe->lock);
-  for (i=0;i<fe->size;i++){
-    if (fe->key[i]==fd){
-      assert(fe->data[i]);
-      myth_io_struct_perfd_t ret=fe->data[i];
-      myth_spin_unlock_body(&fe->lock);
-      myth_spin_unlock_body(&fm->lock);
-      return ret;
-    }
-  }
-  myth_spin_unlock_body(&fe->lock);
-  myth_spin_unlock_body(&fm->lock);
-  return NULL;
+  myth_io_struct_perfd_t *slot;
+  slot=myth_fd_map_slot(fm,fd,0);
+  return slot?__atomic_load_n(slot,__ATOMIC_ACQUIRE):NULL;
 }
 
-static inline myth_io_struct_perfd_t myth_fd_map_trylookup(myth_fd_map_t fm,int fd) {//Lookup blocked list from fd, return NULL if lookup fails
-  int i;
-  myth_fd_map_entry_t fe;
-  if (!myth_spin_trylock_body(&fm->lock))return NULL;
-  fe=&fm->entry[MYTH_FD_MAP_KEY(fd)];
-  if (!myth_spin_trylock_body(&fe->lock)){
-    myth_spin_unlock_body(&fm->lock);
-    return NULL;
-  }
-  for (i=0;i<fe->size;i++){
-    if (fe->key[i]==fd){
-      assert(fe->data[i]);
-      myth_io_struct_perfd_t ret=fe->data[i];
-      myth_spin_unlock_body(&fe->lock);
-      myth_spin_unlock_body(&fm->lock);
-      return ret;
-    }
-  }
-  myth_spin_unlock_body(&fe->lock);
-  myth_spin_unlock_body(&fm->lock);
-  return NULL;
+//Return 1 if FD, which is not registered, has O_NONBLOCK set by the
+//user, 0 if not, or -1 with errno set if it cannot be asked (e.g., EBADF).
+//Not cached, as ioctl(FIONBIO), dup2 and the like change it behind us
+static inline int myth_io_user_nonblock(int fd) {
+  long fl=real_fcntl(fd,F_GETFL);
+  if (fl==-1)return -1;
+  return (fl&O_NONBLOCK)?1:0;
 }
 
-static inline void myth_fd_map_clear(myth_fd_map_t fm) {//Remove all elements from fd_map
-  int i;
-  myth_spin_lock_body(&fm->lock);
-  for (i=0;i<MYTH_FD_MAP_SIZE;i++){
-    myth_fd_map_entry_t fe;
-    fe=&fm->entry[i];
-    myth_spin_lock_body(&fe->lock);
-    fe->size=0;
-    myth_spin_unlock_body(&fe->lock);
-  }
-  //fm->size=0;
-  myth_spin_unlock_body(&fm->lock);
+//The stats of the fds of CHUNK, when MYTH_IO_STATS=1
+static inline myth_io_fd_stats_t *myth_fd_map_chunk_stats(myth_io_struct_perfd_t *chunk) {
+  return (myth_io_fd_stats_t *)(chunk+MYTH_FD_MAP_CHUNK);
+}
+
+//The stats of FD, when MYTH_IO_STATS=1. they stay in the map
+//after FD is closed, until another fd of that number is registered
+static inline myth_io_fd_stats_t *myth_fd_map_stats(myth_fd_map_t fm,int fd) {
+  myth_io_struct_perfd_t *slot;
+  slot=myth_fd_map_slot(fm,fd,1);
+  return myth_fd_map_chunk_stats(slot-(fd&(MYTH_FD_MAP_CHUNK-1)))+(fd&(MYTH_FD_MAP_CHUNK-1));
+}
+
+//Safe in a signal handler, as lookups take no lock
+static inline myth_io_struct_perfd_t myth_fd_map_trylookup(myth_fd_map_t fm,int fd) {
+  return myth_fd_map_lookup(fm,fd);
 }
 
 static inline void myth_fd_map_destroy(myth_fd_map_t fm) {
+  myth_fd_map_dir_t dir,prev;
   int i;
-  for (i=0;i<MYTH_FD_MAP_SIZE;i++){
-    myth_fd_map_entry_t fe;
-    fe=&fm->entry[i];
-    myth_spin_destroy(&fe->lock);
-    myth_free_with_size(fe->data,0);
-    myth_free_with_size(fe->key,0);
+  dir=fm->dir;
+  for (i=0;i<dir->n_chunks;i++){
+    if (dir->chunks[i])myth_free_with_size(dir->chunks[i],0);
+  }
+  //Older dirs share the chunks
+  for (;dir;dir=prev){
+    prev=dir->prev;
+    myth_free_with_size(dir,0);
   }
   myth_spin_destroy(&fm->lock);
-  myth_free_with_size(fm->entry,0);
   myth_free_with_size(fm,0);
 }
 
@@ -242,6 +223,7 @@ static inline int myth_io_is_in_cs(myth_running_env_t e) {
 
 static inline void myth_io_wait_list_push(myth_running_env_t e,
 					  myth_io_wait_list_t wl, myth_io_op_t op) {
+  myth_thread_t th;
   (void)e;
   myth_spin_lock_body(&wl->lock);
   if (wl->count==wl->size){
@@ -250,7 +232,11 @@ static inline void myth_io_wait_list_push(myth_running_env_t e,
   }
   wl->io_ops[wl->count]=op;
   wl->count++;
+  op->parked_on=wl;
+  th=op->th;//op may be gone once it is unlocked
   myth_spin_unlock_body(&wl->lock);
+  //Its thread may have been cancelled while op was out of any list
+  if (th->wait_cancel)myth_wait_check_cancel(th);
 }
 
 static inline myth_io_op_t myth_io_wait_list_pop(myth_running_env_t e, myth_io_wait_list_t wl) {
@@ -264,6 +250,7 @@ static inline myth_io_op_t myth_io_wait_list_pop(myth_running_env_t e, myth_io_w
     ret=wl->io_ops[wl->count-1];
     //if (ret)printf("popped:%p->%p\n",wl,ret);
     wl->count--;
+    ret->parked_on=NULL;
   }
   else ret=NULL;
   myth_spin_unlock_body(&wl->lock);
@@ -271,6 +258,31 @@ static inline myth_io_op_t myth_io_wait_list_pop(myth_running_env_t e, myth_io_w
   return ret;
 }
 
+//Take the op of a cancelled thread out of the list it waits in
+//and fail it with ECANCELED (see myth_wait_interrupt)
+static inline int myth_io_wait_cancel(myth_thread_t th,void *obj) {
+  myth_io_op_t op=obj;
+  myth_io_wait_list_t wl=op->parked_on;
+  int i,found=0;
+  (void)th;
+  if (!wl)return 0;//Being tried by a worker, which puts it back
+  myth_spin_lock_body(&wl->lock);
+  if (op->parked_on==wl){
+    for (i=0;i<wl->count;i++){
+      if (wl->io_ops[i]==op)break;
+    }
+    myth_assert(i<wl->count);
+    memmove(&wl->io_ops[i],&wl->io_ops[i+1],sizeof(myth_io_op_t)*(wl->count-i-1));
+    wl->count--;
+    op->parked_on=NULL;
+    op->ret=-1;
+    op->errcode=ECANCELED;
+    found=1;
+  }
+  myth_spin_unlock_body(&wl->lock);
+  return found;
+}
+
 static inline void myth_io_fd_list_init(myth_running_env_t env,myth_io_fd_list_t cl) {
   cl->data=myth_flmalloc(env->rank,sizeof(myth_io_struct_perfd_t));
   cl->size=0;
@@ -317,7 +329,7 @@ static inline myth_io_struct_perfd_t myth_io_fd_list_trypop(myth_io_fd_list_t cl
 }
 
 static inline void myth_io_fd_list_destroy(myth_running_env_t env,myth_io_fd_list_t cl) {
-  myth_flfree(env->rank,cl->bufsize,cl->data);
+  myth_flfree(env->rank,cl->bufsize*sizeof(myth_io_struct_perfd_t),cl->data);
   cl->size=0;
   cl->bufsize=0;
   myth_spin_destroy(&cl->lock);
@@ -334,14 +346,91 @@ static inline void myth_io_fd_list_destroy(myth_running_env_t env,myth_io_fd_lis
 
 #define MYTH_IO_EPOLL_FLAG (EPOLLIN|EPOLLOUT|EPOLLRDHUP|EPOLLET)
 
+//rdtsc cycles per microsecond, measured over a millisecond
+//(0 if rdtsc is not available)
+static inline uint64_t myth_io_ticks_per_usec(void) {
+  struct timespec t0,t1;
+  uint64_t c0,c1;
+  double us;
+  hr_gettime(&t0);
+  c0=myth_get_rdtsc();
+  do {
+    hr_gettime(&t1);
+    us=(t1.tv_sec-t0.tv_sec)*1.0e6+(t1.tv_nsec-t0.tv_nsec)*1.0e-3;
+  } while (us<1000.0);
+  c1=myth_get_rdtsc();
+  return (uint64_t)((c1-c0)/us);
+}
+
 static inline void myth_io_init(void) {
-  g_fd_map=myth_fd_map_init();
+#if MYTH_WRAP != MYTH_WRAP_VANILLA
+  char *env;
+  int on=0;
+  int interval,slow,slow_ops,sig;
+  env=getenv(ENV_MYTH_WRAP_SOCKIO);
+  if (env && atoi(env))on|=MYTH_IO_ON_SOCK;
+  env=getenv(ENV_MYTH_WRAP_FILEIO);
+  if (env && atoi(env))on|=MYTH_IO_ON_FILE;
+  if (!on)return;
+  g_myth_io_n_epoll_workers=0;
+  if (on & MYTH_IO_ON_SOCK)g_fd_map=myth_fd_map_init();
+  if (on & MYTH_IO_ON_FILE){
+    env=getenv(ENV_MYTH_IO_HELPERS);
+    myth_io_helpers_init(env?atoi(env):MYTH_IO_HELPERS_DEFAULT);
+  }
+  env=getenv(ENV_MYTH_IO_POLL_SWITCHES);
+  g_myth_io_poll_switches=env?atoi(env):MYTH_IO_POLL_SWITCHES_DEFAULT;
+  env=getenv(ENV_MYTH_IO_POLL_INTERVAL);
+  interval=env?atoi(env):MYTH_IO_POLL_INTERVAL_DEFAULT;
+  env=getenv(ENV_MYTH_IO_POLL_PRIO);
+  g_myth_io_poll_prio=env?atoi(env):MYTH_IO_POLL_PRIO_DEFAULT;
+  env=getenv(ENV_MYTH_IO_SHARD);
+  g_myth_io_shard=env?atoi(env):MYTH_IO_SHARD_DEFAULT;
+  env=getenv(ENV_MYTH_IO_STATS);
+  g_myth_io_stats=env?atoi(env):MYTH_IO_STATS_DEFAULT;
+  env=getenv(ENV_MYTH_IO_SLOW_USEC);
+  slow=env?atoi(env):MYTH_IO_SLOW_USEC_DEFAULT;
+  env=getenv(ENV_MYTH_IO_SLOW_OPS);
+  slow_ops=env?atoi(env):MYTH_IO_SLOW_OPS_DEFAULT;
+  env=getenv(ENV_MYTH_IO_STATS_SIGNAL);
+  sig=env?atoi(env):0;
+  g_myth_io_ticks_per_usec=(interval>0 || g_myth_io_stats || slow>0)?myth_io_ticks_per_usec():0;
+  //rdtsc may not tick
+  if (g_myth_io_ticks_per_usec==0 && (g_myth_io_stats || slow>0))g_myth_io_ticks_per_usec=1;
+  g_myth_io_poll_ticks=(interval>0?interval*g_myth_io_ticks_per_usec:0);
+  g_myth_io_slow_ticks=(slow>0 && slow_ops>0)?slow*g_myth_io_ticks_per_usec:0;
+  myth_io_stats_init(g_myth_io_slow_ticks?slow_ops:0,sig);
+  g_myth_io_on=on;
+#endif
 }
 
 #if MYTH_USE_SIGIO
 static void myth_io_sighandler(int signum,siginfo_t *sinfo,void* ctx);
 #endif
 
+//Give TH, woken by a thread other than the worker of ENV (the I/O
+//thread), to its runqueue. when the bottom of the runqueue is full,
+//which only the worker can remedy, or busy, TH is left for the worker
+//(see myth_io_take_passed); waiting for room there while in the I/O
+//layer would keep the worker out of it for good
+static inline void myth_io_pass(myth_running_env_t env,myth_thread_t th) {
+  if (myth_queue_trypass(&env->runnable_q,th))return;
+  th->next=env->io_struct.passed;
+  env->io_struct.passed=th;
+}
+
+//Run by the worker of ENV in the I/O layer
+static inline myth_thread_t myth_io_take_passed(myth_running_env_t env,myth_thread_t first_runnable) {
+  myth_thread_t th;
+  while ((th=env->io_struct.passed)!=NULL){
+    env->io_struct.passed=th->next;
+    th->next=NULL;
+    if (!first_runnable){first_runnable=th;}
+    else{myth_queue_push(&env->runnable_q,th);}
+  }
+  return first_runnable;
+}
+
 #if MYTH_USE_IO_THREAD
 static inline myth_thread_t myth_io_polling_thread(struct myth_running_env *env);
 static void *myth_io_thread_func(void* args) {
@@ -352,9 +441,8 @@ static void *myth_io_thread_func(void* args) {
   //change scheduling policy
   struct sched_param param;
   param.sched_priority=1;
-  if (pthread_setschedparam(real_pthread_self(), SCHED_RR, &param)!=0){
-    perror(NULL);
-  }
+  //Needs a privilege; without it, the thread keeps the normal policy
+  real_pthread_setschedparam(real_pthread_self(), SCHED_RR, &param);
   while (!io->exit_flag) {
     myth_io_polling_thread(env);
   }
@@ -387,8 +475,18 @@ static void myth_io_worker_init(myth_running_env_t env,myth_io_struct_perenv_t i
   pthread_mutexattr_destroy(&attr);
 #endif
   myth_io_fd_list_init(env,&io->close_list);
+  io->poll_waiters=NULL;
+  io->passed=NULL;
+  io->poll_nfds=0;
+  io->poll_buf=NULL;
+  io->poll_buf_size=0;
+  io->poll_switches=0;
+  io->poll_next=0;
   myth_io_wait_list_init(&io->rd_reserve_list);
   myth_io_wait_list_init(&io->wr_reserve_list);
+  if (myth_io_uring_init(&io->uring,MYTH_IO_URING_ENTRIES)!=0
+      && (g_myth_io_on & MYTH_IO_ON_SOCK))
+    __sync_fetch_and_add(&g_myth_io_n_epoll_workers,1);
 }
 
 static void myth_io_worker_fini(myth_running_env_t env,myth_io_struct_perenv_t io) {
@@ -396,14 +494,388 @@ static void myth_io_worker_fini(myth_running_env_t env,myth_io_struct_perenv_t i
   io->exit_flag=1;
   real_pthread_join(io->thread,NULL);
 #endif
+  myth_io_uring_fini(&io->uring);
   real_close(io->epfd);
   myth_io_fd_list_destroy(env,&io->close_list);
+  if (io->poll_buf)myth_flfree(env->rank,io->poll_buf_size,io->poll_buf);
 }
 
 static inline void myth_io_fini(void) {
-  myth_fd_map_destroy(g_fd_map);
+  int on=g_myth_io_on;
+  if (!on)return;
+  g_myth_io_on=0;
+  myth_io_stats_fini();
+  if (on & MYTH_IO_ON_FILE)myth_io_helpers_fini();
+  if (on & MYTH_IO_ON_SOCK)myth_fd_map_destroy(g_fd_map);
+}
+
+//The socket whose readiness OP waits for
+static inline int myth_io_op_fd(myth_io_op_t op) {
+  switch (op->type){
+  case MYTH_IO_CONNECT:return op->u.c.fd;
+  case MYTH_IO_ACCEPT:return op->u.a.fd;
+  case MYTH_IO_RECV:return op->u.r.fd;
+  case MYTH_IO_SEND:return op->u.s.fd;
+  case MYTH_IO_RECVFROM:return op->u.rf.fd;
+  case MYTH_IO_SENDTO:return op->u.st.fd;
+  case MYTH_IO_RECVMSG:
+  case MYTH_IO_SENDMSG:return op->u.m.fd;
+  case MYTH_IO_SENDFILE:return op->u.sf.out_fd;
+  case MYTH_IO_SPLICE:return op->u.sp.sock;
+  case MYTH_IO_ERRQUEUE:return op->u.e.fd;
+  case MYTH_IO_RECVMMSG:
+  case MYTH_IO_SENDMMSG:return op->u.mm.fd;
+  case MYTH_IO_WAIT:return op->u.w.fd;
+  default:myth_unreachable();return -1;
+  }
+}
+
+static inline int myth_io_op_is_file(myth_io_op_t op) {
+  return op->type>=MYTH_IO_READ;
+}
+
+//1 if OP waits for its socket to become readable, 0 if writable
+static inline int myth_io_op_is_read(myth_io_op_t op) {
+  switch (op->type){
+  case MYTH_IO_ACCEPT:
+  case MYTH_IO_RECV:
+  case MYTH_IO_RECVFROM:
+  case MYTH_IO_RECVMSG:
+  case MYTH_IO_ERRQUEUE:
+  case MYTH_IO_RECVMMSG:
+    return 1;
+  case MYTH_IO_SPLICE:
+    return op->u.sp.sock==op->u.sp.fd_in;
+  case MYTH_IO_WAIT:
+    return op->u.w.events==POLLIN;
+  default:
+    return 0;
+  }
+}
+
+//1 if OP is a send with MSG_ZEROCOPY
+static inline int myth_io_op_is_zerocopy(myth_io_op_t op) {
+#if MYTH_IO_ZEROCOPY
+  return (op->type==MYTH_IO_SEND && (op->u.s.flags & MSG_ZEROCOPY))
+    || (op->type==MYTH_IO_SENDMSG && (op->u.m.flags & MSG_ZEROCOPY));
+#else
+  (void)op;
+  return 0;
+#endif
+}
+
+/* per-fd statistics and slow calls (MYTH_IO_STATS=1, MYTH_IO_SLOW_USEC=n).
+   a call on a registered socket that completes at once is counted by
+   myth_io_stat_done. one that finds it not ready is counted when its
+   thread resumes, with the time from the EAGAIN until then, by
+   myth_io_stat_parked, which also records it in the ring of slow calls
+   (myth_io.c) if that took g_myth_io_slow_ticks or more. calls that
+   complete at once are not timed. counters are updated atomically, as
+   threads on any worker may use a socket */
+static inline const char *myth_io_op_name(myth_io_op_t op) {
+  switch (op->type){
+  case MYTH_IO_CONNECT:return "connect";
+  case MYTH_IO_ACCEPT:return "accept";
+  case MYTH_IO_RECV:return "recv";
+  case MYTH_IO_SEND:return "send";
+  case MYTH_IO_RECVFROM:return "recvfrom";
+  case MYTH_IO_SENDTO:return "sendto";
+  case MYTH_IO_RECVMSG:return "recvmsg";
+  case MYTH_IO_SENDMSG:return "sendmsg";
+  case MYTH_IO_SENDFILE:return "sendfile";
+  case MYTH_IO_SPLICE:return "splice";
+  case MYTH_IO_ERRQUEUE:return "errqueue";
+  case MYTH_IO_RECVMMSG:return "recvmmsg";
+  case MYTH_IO_SENDMMSG:return "sendmmsg";
+  case MYTH_IO_WAIT:return "wait";
+  default:return "?";
+  }
+}
+
+//Bytes OP moved, once it has returned RET
+static inline ssize_t myth_io_op_bytes(myth_io_op_t op,ssize_t ret) {
+  ssize_t n=0;
+  unsigned int i;
+  if (ret<=0)return 0;
+  switch (op->type){
+  case MYTH_IO_CONNECT:
+  case MYTH_IO_ACCEPT:
+  case MYTH_IO_ERRQUEUE:
+    return 0;
+  case MYTH_IO_RECVMMSG:
+  case MYTH_IO_SENDMMSG:
+    //RET is the number of messages
+    for (i=0;i<(unsigned int)ret;i++)n+=op->u.mm.vec[i].msg_len;
+    return n;
+  default:
+    return ret;
+  }
+}
+
+static inline void myth_io_stat_add(myth_io_struct_perfd_t fd_data,int rd,ssize_t bytes) {
+  myth_io_fd_stats_t *st=fd_data->stats;
+  if (rd){
+    __sync_fetch_and_add(&st->n_reads,1);
+    if (bytes>0)__sync_fetch_and_add(&st->read_bytes,(unsigned long long)bytes);
+  }
+  else{
+    __sync_fetch_and_add(&st->n_writes,1);
+    if (bytes>0)__sync_fetch_and_add(&st->written_bytes,(unsigned long long)bytes);
+  }
+}
+
+//A call on FD which moved BYTES without waiting
+static inline void myth_io_stat_done(int fd,int rd,ssize_t bytes) {
+  myth_io_struct_perfd_t fd_data;
+  if (!g_myth_io_stats)return;
+  fd_data=myth_fd_map_lookup(g_fd_map,fd);
+  if (fd_data)myth_io_stat_add(fd_data,rd,bytes);
+}
+
+//OP on FD, made by thread TH on worker RANK, has completed after
+//waiting T cycles
+static inline void myth_io_stat_parked(int fd,myth_io_op_t op,int rd,
+				       myth_thread_t th,int rank,uint64_t t) {
+  myth_io_struct_perfd_t fd_data;
+  uint64_t us=t/g_myth_io_ticks_per_usec;
+  if (g_myth_io_stats && (fd_data=myth_fd_map_lookup(g_fd_map,fd))!=NULL){
+    myth_io_stat_add(fd_data,rd,myth_io_op_bytes(op,op->ret));
+    __sync_fetch_and_add(&fd_data->stats->n_eagain,1);
+    __sync_fetch_and_add(&fd_data->stats->park_usec,us);
+  }
+  if (g_myth_io_slow_ticks && t>=g_myth_io_slow_ticks){
+    myth_io_slow_op_t rec;
+    memset(&rec,0,sizeof(rec));
+    rec.usec=us;
+    clock_gettime(CLOCK_REALTIME,&rec.end);
+    rec.op=myth_io_op_name(op);
+    rec.thread=th;
+    rec.worker=rank;
+    rec.fd=fd;
+    rec.ret=op->ret;
+    rec.err=(op->ret==-1)?op->errcode:0;
+    myth_io_slow_record(&rec);
+  }
+}
+
+#if MYTH_IO_URING_AVAILABLE
+/* io_uring backend.
+   a thread whose call would block queues an SQE on the ring of
+   its worker and switches to another thread, just as with epoll.
+   the worker passes the queued SQEs to the kernel and reaps the
+   CQEs in myth_io_polling, so a whole batch costs a single
+   io_uring_enter, and nothing when there is nothing to submit.
+   recv, send, recvmsg, sendmsg and accept are performed by the
+   kernel itself
+   (MYTH_IO_URING_OP). other calls, and those the kernel answers
+   with EAGAIN, wait for readiness with a poll request and are
+   then retried by myth_io_execute (MYTH_IO_URING_POLL).
+   an op is reaped only by the worker that submitted it, so the
+   thread resumes there (and may be stolen from there) */
+#define MYTH_IO_URING_OP 1
+#define MYTH_IO_URING_POLL 2
+
+static inline int myth_io_uring_on(myth_running_env_t env) {
+  return env->io_struct.uring.fd!=-1;
+}
+
+//Pass queued SQEs to the kernel
+static inline void myth_io_uring_submit(myth_io_uring_t ring) {
+  int n=myth_io_uring_enter(ring,ring->n_unsubmitted,0,0);
+  //On failure (e.g., EINTR or EAGAIN), we try again next time
+  if (n>0)ring->n_unsubmitted-=n;
+}
+
+//Queue an SQE that performs OP (or polls for its readiness if POLL).
+//Return 0, or -1 if the queue stays full, as the kernel keeps
+//refusing what is in it (e.g., with EBUSY while CQEs overflow)
+static inline int myth_io_uring_prep(myth_io_uring_t ring,myth_io_op_t op,int poll) {
+  struct io_uring_sqe *sqe;
+  unsigned tail,idx;
+  int tries=0;
+  tail=*ring->sq_tail;
+  while (tail-__atomic_load_n(ring->sq_head,__ATOMIC_ACQUIRE)==ring->sq_entries){
+    //The queue is full
+    if (tries++==MYTH_IO_URING_SUBMIT_TRIES)return -1;
+    myth_io_uring_submit(ring);
+  }
+  idx=tail&ring->sq_mask;
+  sqe=&((struct io_uring_sqe*)ring->sqes)[idx];
+  memset(sqe,0,sizeof(*sqe));
+  sqe->user_data=(uintptr_t)op;
+  op->uring_mode=MYTH_IO_URING_OP;
+  //The kernel would not tell us the id of a MSG_ZEROCOPY send
+  if (myth_io_op_is_zerocopy(op))poll=1;
+  switch (poll?-1:(int)op->type){
+  case MYTH_IO_ACCEPT:
+    sqe->opcode=IORING_OP_ACCEPT;
+    sqe->fd=op->u.a.fd;
+    sqe->addr=(uintptr_t)op->u.a.addr;
+    sqe->addr2=(uintptr_t)op->u.a.len;
+    sqe->accept_flags=op->u.a.flags;
+    break;
+  case MYTH_IO_RECV:
+    //A short read is fine; the kernel would cap it anyway
+    sqe->opcode=IORING_OP_RECV;
+    sqe->fd=op->u.r.fd;
+    sqe->addr=(uintptr_t)op->u.r.buf;
+    sqe->len=(op->u.r.n<0x7ffff000)?op->u.r.n:0x7ffff000;
+    sqe->msg_flags=op->u.r.flags;
+    break;
+  case MYTH_IO_SEND:
+    sqe->opcode=IORING_OP_SEND;
+    sqe->fd=op->u.s.fd;
+    sqe->addr=(uintptr_t)op->u.s.buf;
+    sqe->len=(op->u.s.n<0x7ffff000)?op->u.s.n:0x7ffff000;
+    sqe->msg_flags=op->u.s.flags;
+    break;
+  case MYTH_IO_RECVMSG:
+  case MYTH_IO_SENDMSG:
+    sqe->opcode=(op->type==MYTH_IO_RECVMSG)?IORING_OP_RECVMSG:IORING_OP_SENDMSG;
+    sqe->fd=op->u.m.fd;
+    sqe->addr=(uintptr_t)op->u.m.msg;
+    sqe->len=1;
+    sqe->msg_flags=op->u.m.flags;
+    break;
+  case MYTH_IO_READ:
+  case MYTH_IO_PREAD:
+  case MYTH_IO_WRITE:
+  case MYTH_IO_PWRITE:
+    sqe->opcode=(op->type==MYTH_IO_READ || op->type==MYTH_IO_PREAD)?IORING_OP_READ:IORING_OP_WRITE;
+    sqe->fd=op->u.f.fd;
+    sqe->addr=(uintptr_t)op->u.f.buf;
+    sqe->len=(op->u.f.n<0x7ffff000)?op->u.f.n:0x7ffff000;
+    //-1 means the file position
+    sqe->off=(op->type==MYTH_IO_PREAD || op->type==MYTH_IO_PWRITE)?(uint64_t)op->u.f.off:(uint64_t)-1;
+    break;
+  case MYTH_IO_FSYNC:
+    sqe->opcode=IORING_OP_FSYNC;
+    sqe->fd=op->u.f.fd;
+    break;
+  case MYTH_IO_OPEN:
+    sqe->opcode=IORING_OP_OPENAT;
+    sqe->fd=AT_FDCWD;
+    sqe->addr=(uintptr_t)op->u.f.path;
+    sqe->len=op->u.f.mode;
+    sqe->open_flags=op->u.f.flags;
+    break;
+  case MYTH_IO_READV:
+  case MYTH_IO_WRITEV:
+    sqe->opcode=(op->type==MYTH_IO_READV)?IORING_OP_READV:IORING_OP_WRITEV;
+    sqe->fd=op->u.f.fd;
+    sqe->addr=(uintptr_t)op->u.f.iov;
+    sqe->len=op->u.f.iovcnt;
+    sqe->off=(uint64_t)-1;
+    break;
+  default:
+    sqe->opcode=IORING_OP_POLL_ADD;
+    sqe->fd=myth_io_op_fd(op);
+    //POLLERR is always reported; it means the error queue is not empty
+    if (op->type==MYTH_IO_ERRQUEUE)sqe->poll32_events=POLLERR;
+    else sqe->poll32_events=myth_io_op_is_read(op)?POLLIN:POLLOUT;
+    op->uring_mode=MYTH_IO_URING_POLL;
+    break;
+  }
+  ring->sq_array[idx]=idx;
+  __atomic_store_n(ring->sq_tail,tail+1,__ATOMIC_RELEASE);
+  ring->n_unsubmitted++;
+  return 0;
 }
 
+MYTH_CTX_CALLBACK void myth_io_uring_wait_1(void *arg1,void *arg2,void *arg3) {
+  myth_running_env_t env;
+  env=arg1;
+  (void)arg2;(void)arg3;
+  myth_io_cs_exit(env);
+}
+
+//Queue OP on the ring of ENV and switch to another thread until it
+//completes. Return 0, or -1 if the ring is full, in which case
+//nothing has been done and the caller is still in the critical section
+static inline int myth_io_uring_wait(myth_running_env_t env,myth_io_op_t op) {
+  myth_thread_t this_thread,next;
+  if (myth_io_uring_prep(&env->io_struct.uring,op,0)!=0){
+    //Workers check epoll from now on (see myth_io_polling)
+    if (!env->io_struct.uring.epoll_fallback){
+      env->io_struct.uring.epoll_fallback=1;
+      __sync_fetch_and_add(&g_myth_io_n_epoll_workers,1);
+    }
+    return -1;
+  }
+  this_thread=env->this_thread;
+  op->th=this_thread;
+  op->wl_ptr=NULL;
+  next=myth_queue_pop(&env->runnable_q);
+  if (next){
+    assert(next->status==MYTH_STATUS_READY);//sanity check
+    next->env=env;
+    env->this_thread=next;
+    myth_swap_context_withcall(this_thread,&next->context,
+			       myth_io_uring_wait_1,(void*)env,(void*)op,NULL);
+  }
+  else{
+    //Switch to scheduler, which reaps the ring
+    myth_swap_context_withcall(this_thread,&env->sched.context,
+			       myth_io_uring_wait_1,(void*)env,(void*)op,NULL);
+  }
+  return 0;
+}
+
+//Record the outcome of OP, whose CQE says RES.
+//Return 1 if OP has finished, or 0 if it has been queued again
+static inline int myth_io_uring_complete(myth_io_uring_t ring,myth_io_op_t op,int res) {
+  if (op->uring_mode==MYTH_IO_URING_OP && res==-EAGAIN && !myth_io_op_is_file(op)){
+    //The kernel did not wait for the fd (O_NONBLOCK on an old kernel).
+    //For files, it means the user opened the file with O_NONBLOCK
+    if (myth_io_uring_prep(ring,op,1)==0)return 0;
+    //The ring is full; the op fails as the kernel told us
+  }
+  else if (op->uring_mode==MYTH_IO_URING_POLL && res>=0){
+    //Ready, perform the op
+    if (myth_io_execute(op))return 1;
+    //Someone else consumed the readiness
+    if (myth_io_uring_prep(ring,op,1)==0)return 0;
+    //The ring is full
+    res=-EAGAIN;
+  }
+  op->ret=(res<0)?-1:res;
+  op->errcode=(res<0)?-res:0;
+  return 1;
+}
+
+//Submit queued SQEs, reap CQEs, and return one of the threads
+//whose ops have finished (FIRST_RUNNABLE if it is not null).
+//Others are pushed into the runqueue
+static inline myth_thread_t myth_io_uring_polling(myth_running_env_t env,myth_thread_t first_runnable) {
+  myth_io_uring_t ring=&env->io_struct.uring;
+  struct io_uring_cqe *cqes=ring->cqes;
+  unsigned head,tail;
+  if (ring->n_unsubmitted)myth_io_uring_submit(ring);
+  if (__atomic_load_n(ring->sq_flags,__ATOMIC_ACQUIRE) & IORING_SQ_CQ_OVERFLOW){
+    //Let the kernel move overflown CQEs into the ring
+    myth_io_uring_enter(ring,0,0,IORING_ENTER_GETEVENTS);
+  }
+  head=*ring->cq_head;
+  tail=__atomic_load_n(ring->cq_tail,__ATOMIC_ACQUIRE);
+  while (head!=tail){
+    struct io_uring_cqe *cqe=&cqes[head&ring->cq_mask];
+    myth_io_op_t op=(myth_io_op_t)(uintptr_t)cqe->user_data;
+    int res=cqe->res;
+    head++;
+    if (myth_io_uring_complete(ring,op,res)){
+      myth_thread_t th=op->th;
+      th->env=env;
+      if (!first_runnable){first_runnable=th;}
+      else{myth_queue_push(&env->runnable_q,th);}
+    }
+  }
+  __atomic_store_n(ring->cq_head,head,__ATOMIC_RELEASE);
+  //Ops queued again above
+  if (ring->n_unsubmitted)myth_io_uring_submit(ring);
+  return first_runnable;
+}
+#endif	/* MYTH_IO_URING_AVAILABLE */
+
 MYTH_CTX_CALLBACK void myth_wait_for_read_1(void *arg1,void *arg2,void *arg3) {
   //Add current thread to blocked list after context switch finishes
   myth_running_env_t env;
@@ -420,17 +892,47 @@ MYTH_CTX_CALLBACK void myth_wait_for_read_1(void *arg1,void *arg2,void *arg3) {
   //myth_io_fd_list_push(env,&fd_data->env->io_struct.notify_list,fd_data);
 }
 
-static inline void myth_wait_for_read(int fd,myth_running_env_t env,myth_io_op_t op) {
+static inline void myth_wait_for_read_0(int fd,myth_running_env_t env,myth_io_op_t op) {
   //Add current thread to blocked list
   myth_fd_map_t fd_map;
   myth_io_struct_perfd_t fd_data;
   myth_io_wait_list_t wl;
+  int nb;
   fd_map=env->io_struct.fd_map;
   //Lookup blocked list from fd_map
   fd_data=myth_fd_map_lookup(fd_map,fd);
+  if (!fd_data && (nb=myth_io_user_nonblock(fd))!=0){
+    //The fd was not made non-blocking by us but by the user,
+    //who expects EAGAIN
+    op->ret=-1;
+    op->errcode=(nb<0)?errno:EAGAIN;
+    myth_io_cs_exit(env);
+    return;
+  }
+  //Cancelled (see myth_cancel_body)
+  if (myth_cancel_pending(env->this_thread)){
+    op->ret=-1;
+    op->errcode=ECANCELED;
+    myth_io_cs_exit(env);
+    return;
+  }
+#if MYTH_IO_URING_AVAILABLE
+  //Wait in epoll instead when the ring is full
+  if (myth_io_uring_on(env) && myth_io_uring_wait(env,op)==0){
+    return;
+  }
+#endif
   if (!fd_data){
+    myth_thread_t th=env->this_thread;
+    //Not in the I/O layer while yielding; the worker may change
+    myth_io_cs_exit(env);
     while (1){
       myth_yield_body();
+      if (myth_cancel_pending(th)){
+	op->ret=-1;
+	op->errcode=ECANCELED;
+	break;
+      }
       if (myth_io_execute(op))break;
     }
     return;
@@ -438,6 +940,8 @@ static inline void myth_wait_for_read(int fd,myth_running_env_t env,myth_io_op_t
   wl=&(fd_data->rd_list);
   op->th=env->this_thread;
   op->wl_ptr=wl;
+  op->parked_on=NULL;
+  myth_wait_cancellable(op->th,myth_io_wait_cancel,op);
   //Switch to next thread
   myth_thread_t this_thread,next;
   this_thread=op->th;
@@ -447,14 +951,16 @@ static inline void myth_wait_for_read(int fd,myth_running_env_t env,myth_io_op_t
     //Switch context
     next->env=env;
     env->this_thread=next;
-    myth_swap_context_withcall(&this_thread->context,&next->context,
+    myth_swap_context_withcall(this_thread,&next->context,
 			       myth_wait_for_read_1,(void*)env,(void*)op,(void*)fd_data);
   }
   else{
     //Switch to scheduler for work stealing
-    myth_swap_context_withcall(&this_thread->context,&env->sched.context,
+    myth_swap_context_withcall(this_thread,&env->sched.context,
 			       myth_wait_for_read_1,(void*)env,(void*)op,(void*)fd_data);
   }
+  //op->ret is ECANCELED if it has been woken by cancellation
+  myth_wait_done(this_thread);
 }
 
 MYTH_CTX_CALLBACK void myth_wait_for_write_1(void *arg1,void *arg2,void *arg3) {
@@ -473,18 +979,48 @@ MYTH_CTX_CALLBACK void myth_wait_for_write_1(void *arg1,void *arg2,void *arg3) {
   //myth_io_fd_list_push(env,&fd_data->env->io_struct.notify_list,fd_data);
 }
 
-static inline void myth_wait_for_write(int fd,myth_running_env_t env,myth_io_op_t op) {
+static inline void myth_wait_for_write_0(int fd,myth_running_env_t env,myth_io_op_t op) {
   //Add current thread to blocked list
   myth_fd_map_t fd_map;
   myth_io_struct_perfd_t fd_data;
   myth_io_wait_list_t wl;
+  int nb;
   fd_map=env->io_struct.fd_map;
   assert(fd_map);
   //Lookup blocked list from fd_map
   fd_data=myth_fd_map_lookup(fd_map,fd);
+  if (!fd_data && (nb=myth_io_user_nonblock(fd))!=0){
+    //The fd was not made non-blocking by us but by the user,
+    //who expects EAGAIN
+    op->ret=-1;
+    op->errcode=(nb<0)?errno:EAGAIN;
+    myth_io_cs_exit(env);
+    return;
+  }
+  //Cancelled (see myth_cancel_body)
+  if (myth_cancel_pending(env->this_thread)){
+    op->ret=-1;
+    op->errcode=ECANCELED;
+    myth_io_cs_exit(env);
+    return;
+  }
+#if MYTH_IO_URING_AVAILABLE
+  //Wait in epoll instead when the ring is full
+  if (myth_io_uring_on(env) && myth_io_uring_wait(env,op)==0){
+    return;
+  }
+#endif
   if (!fd_data){
+    myth_thread_t th=env->this_thread;
+    //Not in the I/O layer while yielding; the worker may change
+    myth_io_cs_exit(env);
     while (1){
       myth_yield_body();
+      if (myth_cancel_pending(th)){
+	op->ret=-1;
+	op->errcode=ECANCELED;
+	break;
+      }
       if (myth_io_execute(op))break;
     }
     return;
@@ -493,6 +1029,8 @@ static inline void myth_wait_for_write(int fd,myth_running_env_t env,myth_io_op_
   assert(wl);
   op->th=env->this_thread;
   op->wl_ptr=wl;
+  op->parked_on=NULL;
+  myth_wait_cancellable(op->th,myth_io_wait_cancel,op);
   //Switch to next thread
   myth_thread_t this_thread,next;
   this_thread=op->th;
@@ -502,22 +1040,262 @@ static inline void myth_wait_for_write(int fd,myth_running_env_t env,myth_io_op_
     //Switch context
     next->env=env;
     env->this_thread=next;
-    myth_swap_context_withcall(&this_thread->context,&next->context,
+    myth_swap_context_withcall(this_thread,&next->context,
 			       myth_wait_for_write_1,(void*)env,(void*)op,(void*)fd_data);
   }
   else{
     //Switch to scheduler for work stealing
-    myth_swap_context_withcall(&this_thread->context,&env->sched.context,
+    myth_swap_context_withcall(this_thread,&env->sched.context,
 			       myth_wait_for_write_1,(void*)env,(void*)op,(void*)fd_data);
   }
+  //op->ret is ECANCELED if it has been woken by cancellation
+  myth_wait_done(this_thread);
+}
+
+//Wait until OP on FD has been performed, timing the wait if asked to
+static inline void myth_io_wait_timed(int fd,myth_running_env_t env,myth_io_op_t op,int rd) {
+  myth_thread_t th=env->this_thread;
+  int rank=env->rank;
+  uint64_t t0=myth_get_rdtsc();
+  if (rd)myth_wait_for_read_0(fd,env,op);
+  else myth_wait_for_write_0(fd,env,op);
+  //We may be on another worker now
+  myth_io_stat_parked(fd,op,rd,th,rank,myth_get_rdtsc()-t0);
+}
+
+static inline void myth_wait_for_read(int fd,myth_running_env_t env,myth_io_op_t op) {
+  if (g_myth_io_stats || g_myth_io_slow_ticks)myth_io_wait_timed(fd,env,op,1);
+  else myth_wait_for_read_0(fd,env,op);
+}
+
+static inline void myth_wait_for_write(int fd,myth_running_env_t env,myth_io_op_t op) {
+  if (g_myth_io_stats || g_myth_io_slow_ticks)myth_io_wait_timed(fd,env,op,0);
+  else myth_wait_for_write_0(fd,env,op);
+}
+
+#if MYTH_IO_ZEROCOPY
+/*
+   MSG_ZEROCOPY. the kernel numbers the zerocopy sends on a socket
+   from 0 and, once it no longer needs their buffers, reports
+   ranges of the numbers on the error queue of the socket. a send
+   returns to the user thread only after its number is reported,
+   so the buffer may be reused as with any other send. messages
+   on the error queue are consumed by us
+ */
+
+//Send OP with MSG_ZEROCOPY on the registered socket FD and record
+//the number the kernel gives it. sends on a socket are serialized
+//so that our count follows that of the kernel
+static inline ssize_t myth_io_zc_send(myth_io_op_t op,int fd) {
+  myth_io_struct_perfd_t fd_data=myth_fd_map_lookup(g_fd_map,fd);
+  ssize_t ret;
+  myth_spin_lock_body(&fd_data->zc_lock);
+  if (op->type==MYTH_IO_SEND)
+    ret=real_send(fd,op->u.s.buf,op->u.s.n,op->u.s.flags|MSG_DONTWAIT);
+  else
+    ret=real_sendmsg(fd,op->u.m.msg,op->u.m.flags|MSG_DONTWAIT);
+  //A send that fails (or sends nothing) does not consume a number
+  if (ret>0)op->zc_id=fd_data->zc_next++;
+  myth_spin_unlock_body(&fd_data->zc_lock);
+  return ret;
+}
+
+//Consume the error queue of the socket of FD_DATA
+static inline void myth_io_zc_reap(myth_io_struct_perfd_t fd_data) {
+  char control[128];
+  struct msghdr msg;
+  struct cmsghdr *cm;
+  int saved_errno=errno;
+  while (1){
+    memset(&msg,0,sizeof(msg));
+    msg.msg_control=control;
+    msg.msg_controllen=sizeof(control);
+    if (real_recvmsg(fd_data->fd,&msg,MSG_ERRQUEUE|MSG_DONTWAIT)==-1)break;
+    for (cm=CMSG_FIRSTHDR(&msg);cm;cm=CMSG_NXTHDR(&msg,cm)){
+      struct sock_extended_err *serr;
+      if (!(cm->cmsg_level==SOL_IP && cm->cmsg_type==IP_RECVERR)
+	  && !(cm->cmsg_level==SOL_IPV6 && cm->cmsg_type==IPV6_RECVERR))continue;
+      serr=(struct sock_extended_err*)CMSG_DATA(cm);
+      if (serr->ee_origin!=SO_EE_ORIGIN_ZEROCOPY)continue;
+      //[ee_info,ee_data] have completed; a stream completes them in order
+      myth_spin_lock_body(&fd_data->zc_lock);
+      if ((int32_t)(serr->ee_data+1-fd_data->zc_done)>0)fd_data->zc_done=serr->ee_data+1;
+      myth_spin_unlock_body(&fd_data->zc_lock);
+    }
+  }
+  errno=saved_errno;
+}
+
+//Return 1 if send ID on the socket of FD_DATA has completed
+static inline int myth_io_zc_done(myth_io_struct_perfd_t fd_data,uint32_t id) {
+  return (int32_t)(__atomic_load_n(&fd_data->zc_done,__ATOMIC_ACQUIRE)-id)>0;
+}
+
+//Resume the threads waiting on FD_DATA whose sends have completed.
+//The first of them is returned if FIRST_RUNNABLE is null, and the
+//others are pushed into the runqueue of ENV
+static inline myth_thread_t myth_io_zc_wake(myth_running_env_t env,myth_io_struct_perfd_t fd_data,
+					    myth_thread_t first_runnable) {
+  myth_io_op_t op,next,keep,keep_tail;
+  myth_spin_lock_body(&fd_data->zc_lock);
+  op=fd_data->zc_waiters;
+  fd_data->zc_waiters=NULL;
+  myth_spin_unlock_body(&fd_data->zc_lock);
+  if (!op)return first_runnable;
+  myth_io_zc_reap(fd_data);
+  keep=keep_tail=NULL;
+  for (;op;op=next){
+    next=op->next;
+    if (myth_io_zc_done(fd_data,op->u.e.id)){
+      myth_thread_t th=op->th;
+      th->env=env;
+      if (!first_runnable){first_runnable=th;}
+      else{myth_queue_push(&env->runnable_q,th);}
+    }
+    else{
+      op->next=keep;
+      keep=op;
+      if (!keep_tail)keep_tail=op;
+    }
+  }
+  if (keep){
+    myth_spin_lock_body(&fd_data->zc_lock);
+    keep_tail->next=fd_data->zc_waiters;
+    fd_data->zc_waiters=keep;
+    myth_spin_unlock_body(&fd_data->zc_lock);
+  }
+  return first_runnable;
+}
+
+MYTH_CTX_CALLBACK void myth_io_zc_wait_1(void *arg1,void *arg2,void *arg3) {
+  myth_running_env_t env;
+  myth_io_op_t op;
+  myth_io_struct_perfd_t fd_data;
+  myth_thread_t th;
+  env=arg1;
+  op=arg2;
+  fd_data=arg3;
+  myth_spin_lock_body(&fd_data->zc_lock);
+  if (fd_data->closed){
+    //Closed meanwhile; myth_io_execute tells it
+    myth_spin_unlock_body(&fd_data->zc_lock);
+    myth_queue_push(&env->runnable_q,op->th);
+    myth_io_cs_exit(env);
+    return;
+  }
+  op->next=fd_data->zc_waiters;
+  fd_data->zc_waiters=op;
+  myth_spin_unlock_body(&fd_data->zc_lock);
+  //The notification may have come before the op was on the list
+  th=myth_io_zc_wake(env,fd_data,NULL);
+  if (th)myth_queue_push(&env->runnable_q,th);
+  myth_io_cs_exit(env);
 }
 
+//Switch to another thread until the worker owning the socket of
+//OP sees EPOLLERR (a notification) and resumes us
+static inline void myth_io_zc_park(myth_running_env_t env,myth_io_op_t op) {
+  myth_io_struct_perfd_t fd_data;
+  myth_thread_t this_thread,next;
+  fd_data=myth_fd_map_lookup(g_fd_map,op->u.e.fd);
+  if (!fd_data){
+    //Closed since myth_io_execute looked at it; it is told next time
+    myth_io_cs_exit(env);
+    return;
+  }
+  this_thread=env->this_thread;
+  op->th=this_thread;
+  op->wl_ptr=NULL;
+  next=myth_queue_pop(&env->runnable_q);
+  if (next){
+    assert(next->status==MYTH_STATUS_READY);//sanity check
+    next->env=env;
+    env->this_thread=next;
+    myth_swap_context_withcall(this_thread,&next->context,
+			       myth_io_zc_wait_1,(void*)env,(void*)op,(void*)fd_data);
+  }
+  else{
+    //Switch to scheduler for work stealing
+    myth_swap_context_withcall(this_thread,&env->sched.context,
+			       myth_io_zc_wait_1,(void*)env,(void*)op,(void*)fd_data);
+  }
+}
+
+//Return 1 if a send with MSG_ZEROCOPY on FD is to be waited for
+static inline int myth_io_zc_enabled(int fd) {
+  myth_io_struct_perfd_t fd_data=myth_fd_map_lookup(g_fd_map,fd);
+  //Without SO_ZEROCOPY, the kernel ignores MSG_ZEROCOPY
+  return fd_data && fd_data->zc_on;
+}
+
+//Resume the threads waiting on FD_DATA, which is being closed, with
+//EBADF (see myth_io_polling)
+static inline myth_thread_t myth_io_zc_close(myth_running_env_t env,myth_io_struct_perfd_t fd_data,
+					     myth_thread_t first_runnable) {
+  myth_io_op_t op,next;
+  myth_spin_lock_body(&fd_data->zc_lock);
+  op=fd_data->zc_waiters;
+  fd_data->zc_waiters=NULL;
+  //No one waits on it from now on (see myth_io_zc_wait_1)
+  fd_data->closed=1;
+  myth_spin_unlock_body(&fd_data->zc_lock);
+  for (;op;op=next){
+    myth_thread_t th=op->th;
+    next=op->next;
+    op->ret=-1;
+    op->errcode=EBADF;
+    th->env=env;
+    if (!first_runnable){first_runnable=th;}
+    else{myth_queue_push(&env->runnable_q,th);}
+  }
+  return first_runnable;
+}
+
+//Switch to other threads until send ID on FD has completed
+static inline void myth_io_zc_wait(int fd,uint32_t id) {
+  myth_io_op op;
+  op.type=MYTH_IO_ERRQUEUE;
+  op.u.e.fd=fd;
+  op.u.e.id=id;
+  while (!myth_io_execute(&op)){
+    myth_running_env_t env=myth_get_current_env();
+    myth_io_cs_enter(env);
+#if MYTH_IO_URING_AVAILABLE
+    if (myth_io_uring_on(env) && myth_io_uring_wait(env,&op)==0){
+      continue;
+    }
+#endif
+    myth_io_zc_park(env,&op);
+  }
+}
+
+//Send OP with MSG_ZEROCOPY on FD and wait until the buffer is released
+static inline ssize_t myth_io_zc_send_body(int fd,myth_io_op_t op) {
+  myth_running_env_t env=myth_get_current_env();
+  myth_io_cs_enter(env);
+  if (myth_io_execute(op)){
+    myth_io_cs_exit(env);
+    myth_io_stat_done(fd,0,op->ret);
+  }
+  else myth_wait_for_write(fd,env,op);
+  if (op->ret>0)myth_io_zc_wait(fd,op->zc_id);
+  else if (op->ret==-1)errno=op->errcode;
+  return op->ret;
+}
+#else
+static inline ssize_t myth_io_zc_send(myth_io_op_t op,int fd) {
+  (void)op;(void)fd;
+  myth_unreachable();
+  return -1;
+}
+#endif
+
 extern myth_running_env_t g_envs;
 extern int g_sched_prof;
 
-static inline void myth_io_register_fd(int fd) {
-  //register a file descriptor to the epoll instance in a worker thread
-  myth_running_env_t env,w_env;
+static inline void myth_io_register_fd_on(int fd,myth_running_env_t w_env) {
+  //register a file descriptor to the epoll instance of worker thread W_ENV
+  myth_running_env_t env;
   myth_io_struct_perfd *fd_data;
   struct epoll_event ee;
   env=myth_get_current_env();
@@ -528,23 +1306,29 @@ static inline void myth_io_register_fd(int fd) {
   myth_io_wait_list_init(&fd_data->wr_list);
   fd_data->closed=0;fd_data->fd=fd;
   fd_data->tmp_for_poll=0;
-  myth_fd_map_set(env,env->io_struct.fd_map,fd,fd_data);
-  ee.events=MYTH_IO_EPOLL_FLAG;
-  ee.data.ptr=fd_data;
-#if MYTH_ONE_IO_WORKER
-  //Register all the file descriptors to worker thread #0
-  w_env=&g_envs[0];
-#elif MYTH_RANDOM_IO_WORKER
-  //The worker thread is chosen randomly
+  myth_spin_init_body(&fd_data->zc_lock);
+  fd_data->zc_next=0;fd_data->zc_done=0;
+  fd_data->zc_waiters=NULL;
+  fd_data->zc_on=0;
+#if MYTH_IO_ZEROCOPY
   {
-    int worker_id;
-    worker_id=myth_random(0, g_attr.n_workers);
-    w_env=&g_envs[worker_id];
+    //An accepted socket inherits it from the listening one
+    int on=0;
+    socklen_t len=sizeof(on);
+    if (getsockopt(fd,SOL_SOCKET,SO_ZEROCOPY,&on,&len)==0)fd_data->zc_on=(on!=0);
   }
-#else
-  //Register to the worker thread that issued the call
-  w_env=env;
 #endif
+  myth_spin_init_body(&fd_data->acc_lock);
+  fd_data->acc=NULL;
+  fd_data->shards=NULL;
+  fd_data->stats=NULL;
+  if (g_myth_io_stats){
+    fd_data->stats=myth_fd_map_stats(env->io_struct.fd_map,fd);
+    memset(fd_data->stats,0,sizeof(myth_io_fd_stats_t));
+  }
+  myth_fd_map_set(env->io_struct.fd_map,fd,fd_data);
+  ee.events=MYTH_IO_EPOLL_FLAG;
+  ee.data.ptr=fd_data;
   fd_data->env=w_env;
   fd_data->rd_reserve_list_ptr=&(w_env->io_struct.rd_reserve_list);
   fd_data->wr_reserve_list_ptr=&(w_env->io_struct.wr_reserve_list);
@@ -573,11 +1357,30 @@ static inline void myth_io_register_fd(int fd) {
 #endif
 }
 
+static inline void myth_io_register_fd(int fd) {
+  myth_running_env_t w_env;
+#if MYTH_ONE_IO_WORKER
+  //Register all the file descriptors to worker thread #0
+  w_env=&g_envs[0];
+#else
+  //Register to the worker thread that issued the call
+  w_env=myth_get_current_env();
+#if MYTH_RANDOM_IO_WORKER
+  //The worker thread is chosen randomly, unless fds are sharded
+  if (!g_myth_io_shard)w_env=&g_envs[myth_random(0, g_attr.n_workers)];
+#endif
+#endif
+  myth_io_register_fd_on(fd,w_env);
+}
+
 static inline int myth_socket_body (int domain, int type, int protocol) {
   int sock;
-  //TODO:Handle SOCK_NONBLOCK option(after 2.6.27)
   sock=real_socket(domain,type,protocol);
   if (sock==-1)return -1;
+#ifdef SOCK_NONBLOCK
+  //The user polls it by itself
+  if (type & SOCK_NONBLOCK)return sock;
+#endif
   //Register a new file descriptor
   myth_io_register_fd(sock);
   return sock;
@@ -594,6 +1397,20 @@ static inline int myth_connect_body (int fd, const struct sockaddr *addr, sockle
     env=myth_get_current_env();
     if (errno!=EINPROGRESS)return -1;
     //Connection is in progress, wait for write ready
+#if MYTH_IO_URING_AVAILABLE
+    if (myth_io_uring_on(env) && myth_fd_map_lookup(env->io_struct.fd_map,fd)){
+      myth_io_op op;
+      op.type=MYTH_IO_CONNECT;
+      op.u.c.fd=fd;
+      myth_io_cs_enter(env);
+      if (myth_io_uring_wait(env,&op)==0){
+	errno=op.errcode;
+	return op.ret;
+      }
+      //The ring is full; poll below
+      myth_io_cs_exit(env);
+    }
+#endif
 #if 0
     myth_io_op op;
     op.type=MYTH_IO_CONNECT;
@@ -607,7 +1424,7 @@ static inline int myth_connect_body (int fd, const struct sockaddr *addr, sockle
     pf.events=POLLOUT;
     pf.revents=0;
     MAY_BE_UNUSED int ready;
-    ready=poll(&pf,1,-1);
+    ready=real_poll(&pf,1,-1);
     myth_assert(ready==1);
     myth_assert(pf.revents & POLLOUT);
     ret_len=sizeof(int);
@@ -616,95 +1433,597 @@ static inline int myth_connect_body (int fd, const struct sockaddr *addr, sockle
     ret=(errcode==0)?0:-1;
 #endif
   }
-  return ret;
+  return ret;
+}
+
+//accept, or accept4 where there is one
+static inline int myth_io_accept_1(int fd,struct sockaddr *addr,socklen_t *len,int flags) {
+#if defined(HAVE_ACCEPT4)
+  return real_accept4(fd,addr,len,flags);
+#else
+  (void)flags;
+  return real_accept(fd,addr,len);
+#endif
+}
+
+/*
+   accept in bursts. the first accept on a listening socket that
+   finds no connection kept takes up to MYTH_IO_ACCEPT_BURST of them
+   from the backlog, so when the socket becomes readable, the
+   threads waiting on it in myth_io_polling get theirs in one pass
+   with a system call per burst rather than per thread. those left
+   over are returned by the next accept calls.
+   returns the new socket or -1 with errno, like accept4
+ */
+static inline int myth_io_accept_fd(myth_io_op_t op,int fd) {
+  myth_io_struct_perfd_t fd_data;
+  myth_io_accepted_t acc;
+  int sock,cloexec;
+  fd_data=myth_fd_map_lookup(g_fd_map,fd);
+  if (!fd_data){
+    return myth_io_accept_1(fd,op->u.a.addr,op->u.a.len,op->u.a.flags);
+  }
+  myth_spin_lock_body(&fd_data->acc_lock);
+  if (fd_data->closed){
+    //Threads still waiting when the socket was closed
+    myth_spin_unlock_body(&fd_data->acc_lock);
+    errno=EBADF;
+    return -1;
+  }
+  acc=fd_data->acc;
+  if (!acc || acc->n==0){
+    if (!acc){
+      acc=myth_flmalloc(myth_get_current_env()->rank,sizeof(myth_io_accepted));
+      fd_data->acc=acc;
+    }
+    acc->head=0;acc->n=0;
+    //They are registered (and made non-blocking) by the thread taking them
+    while (acc->n<MYTH_IO_ACCEPT_BURST){
+      int s;
+      acc->c[acc->n].len=sizeof(acc->c[acc->n].addr);
+      s=myth_io_accept_1(fd,(struct sockaddr*)&acc->c[acc->n].addr,
+			 &acc->c[acc->n].len,
+#if defined(SOCK_NONBLOCK)
+			 SOCK_NONBLOCK|
+#endif
+			 (op->u.a.flags & SOCK_CLOEXEC));
+      if (s==-1)break;
+      acc->c[acc->n].fd=s;
+      acc->c[acc->n].cloexec=(op->u.a.flags & SOCK_CLOEXEC)!=0;
+      acc->n++;
+    }
+    if (acc->n==0){
+      myth_spin_unlock_body(&fd_data->acc_lock);
+      return -1;
+    }
+  }
+  sock=acc->c[acc->head].fd;
+  cloexec=acc->c[acc->head].cloexec;
+  if (op->u.a.addr && op->u.a.len){
+    socklen_t len=acc->c[acc->head].len;
+    memcpy(op->u.a.addr,&acc->c[acc->head].addr,(*op->u.a.len<len)?*op->u.a.len:len);
+    *op->u.a.len=len;
+  }
+  acc->head++;acc->n--;
+  myth_spin_unlock_body(&fd_data->acc_lock);
+  //Taken in a burst for a caller that wanted the other
+  if (cloexec!=((op->u.a.flags & SOCK_CLOEXEC)!=0)){
+    real_fcntl(sock,F_SETFD,cloexec?0:FD_CLOEXEC);
+  }
+  return sock;
+}
+
+//Accept a connection for OP. from a sharded socket, it is taken from
+//the shard of this worker if there is one, or else from any other.
+//those are not taken in bursts, as threads waiting for them poll the
+//shards (myth_io_shard_wait), which would not see connections kept
+static inline int myth_io_accept(myth_io_op_t op) {
+  myth_io_struct_perfd_t fd_data;
+  myth_io_shards_t sh;
+  int i,k,s;
+  fd_data=myth_fd_map_lookup(g_fd_map,op->u.a.fd);
+  if (!fd_data || !(sh=fd_data->shards))return myth_io_accept_fd(op,op->u.a.fd);
+  k=myth_get_current_env()->rank;
+  errno=EAGAIN;
+  for (i=0;i<sh->n;i++,k=(k+1)%sh->n){
+    if (sh->fd[k]==-1)continue;
+    s=myth_io_accept_1(sh->fd[k],op->u.a.addr,op->u.a.len,op->u.a.flags);
+    if (s!=-1 || (errno!=EAGAIN && errno!=EWOULDBLOCK))return s;
+  }
+  return -1;
+}
+
+//Close connections FD_DATA kept, as its socket is being closed
+static inline void myth_io_accepted_discard(myth_running_env_t env,myth_io_struct_perfd_t fd_data) {
+  myth_io_accepted_t acc;
+  myth_spin_lock_body(&fd_data->acc_lock);
+  fd_data->closed=1;
+  acc=fd_data->acc;
+  fd_data->acc=NULL;
+  myth_spin_unlock_body(&fd_data->acc_lock);
+  if (fd_data->shards){
+    myth_flfree(env->rank,sizeof(myth_io_shards)+sizeof(int)*fd_data->shards->n,
+		fd_data->shards);
+    fd_data->shards=NULL;
+  }
+  if (!acc)return;
+  while (acc->n>0){
+    real_close(acc->c[acc->head].fd);
+    acc->head++;acc->n--;
+  }
+  myth_flfree(env->rank,sizeof(myth_io_accepted),acc);
+}
+
+static inline int myth_accept4_body (int fd, struct sockaddr* addr,
+				     socklen_t * addr_len, int flags) {
+  int sock;
+  myth_io_op op;
+  myth_running_env_t env;
+  myth_io_struct_perfd_t fd_data;
+  env=myth_get_current_env();
+  op.type=MYTH_IO_ACCEPT;
+  op.u.a.addr=addr;
+  op.u.a.fd=fd;
+  op.u.a.len=addr_len;
+  op.u.a.flags=flags;
+  //try to accept
+  myth_io_cs_enter(env);
+  if (myth_io_execute(&op)){
+    myth_io_cs_exit(env);
+    myth_io_stat_done(fd,1,0);
+  }
+  else if ((fd_data=myth_fd_map_lookup(g_fd_map,fd)) && fd_data->shards){
+    //Wait for any of the shards
+    myth_io_cs_exit(env);
+    myth_io_shard_wait(fd_data->shards,&op);
+  }
+  else{
+    //Wait for the socket ready to read
+    myth_wait_for_read(fd,env,&op);
+  }
+  if (op.ret==-1){
+    errno=op.errcode;
+    return -1;
+  }
+  sock=op.ret;
+  //Done
+#ifdef SOCK_NONBLOCK
+  //The user polls it by itself
+  if (flags & SOCK_NONBLOCK)return sock;
+#endif
+  myth_io_register_fd(sock);
+  return sock;
+}
+
+static inline int myth_accept_body (int fd, struct sockaddr* addr,
+				    socklen_t * addr_len) {
+  return myth_accept4_body(fd,addr,addr_len,0);
+}
+
+static inline int myth_bind_body(int fd, const struct sockaddr *addr, socklen_t len) {
+#if defined(SO_REUSEPORT)
+  //Let listen() bind a socket for each worker to the same address
+  if (g_myth_io_shard && addr && len>=sizeof(sa_family_t)
+      && (addr->sa_family==AF_INET || addr->sa_family==AF_INET6)
+      && myth_fd_map_lookup(g_fd_map,fd)){
+    int type=0,one=1;
+    socklen_t tl=sizeof(type);
+    if (getsockopt(fd,SOL_SOCKET,SO_TYPE,&type,&tl)==0 && type==SOCK_STREAM)
+      setsockopt(fd,SOL_SOCKET,SO_REUSEPORT,&one,sizeof(one));
+  }
+#endif
+  return real_bind(fd,addr,len);
+}
+
+/*
+   with MYTH_IO_SHARD=1, a listening TCP socket bound with SO_REUSEPORT
+   (which bind sets) gets a sibling bound to the same address for each
+   other worker, with which it is registered. the kernel spreads
+   incoming connections over them, accept takes them from the socket
+   of its own worker first (myth_io_accept), and the connections stay
+   with that worker, as does the thread handling one, which is woken
+   there. the user sees only the original socket; closing it closes
+   the others. workers for which a sibling cannot be made have none
+ */
+static inline void myth_io_shard_listen(int fd,int n) {
+#if defined(SO_REUSEPORT)
+  myth_running_env_t env;
+  myth_io_struct_perfd_t fd_data;
+  myth_io_shards_t sh;
+  struct sockaddr_storage addr;
+  socklen_t len=sizeof(addr),ol=sizeof(int);
+  int on=0,type=0,v6only=0,one=1,w;
+  fd_data=myth_fd_map_lookup(g_fd_map,fd);
+  if (!fd_data)return;
+  if ((sh=fd_data->shards)!=NULL){
+    //The backlog changed
+    for (w=0;w<sh->n;w++){
+      if (sh->fd[w]!=-1 && sh->fd[w]!=fd)real_listen(sh->fd[w],n);
+    }
+    return;
+  }
+  if (getsockopt(fd,SOL_SOCKET,SO_REUSEPORT,&on,&ol)!=0 || !on)return;
+  ol=sizeof(int);
+  if (getsockopt(fd,SOL_SOCKET,SO_TYPE,&type,&ol)!=0 || type!=SOCK_STREAM)return;
+  if (getsockname(fd,(struct sockaddr*)&addr,&len)!=0)return;
+  if (addr.ss_family!=AF_INET && addr.ss_family!=AF_INET6)return;
+  if (addr.ss_family==AF_INET6){
+    ol=sizeof(int);
+    getsockopt(fd,IPPROTO_IPV6,IPV6_V6ONLY,&v6only,&ol);
+  }
+  env=myth_get_current_env();
+  sh=myth_flmalloc(env->rank,sizeof(myth_io_shards)+sizeof(int)*g_attr.n_workers);
+  sh->n=g_attr.n_workers;
+  for (w=0;w<sh->n;w++){
+    int s;
+    if (w==fd_data->env->rank){
+      sh->fd[w]=fd;
+      continue;
+    }
+    s=real_socket(addr.ss_family,SOCK_STREAM|SOCK_CLOEXEC,0);
+    if (s!=-1
+	&& (setsockopt(s,SOL_SOCKET,SO_REUSEPORT,&one,sizeof(one))!=0
+	    || (v6only && setsockopt(s,IPPROTO_IPV6,IPV6_V6ONLY,&one,sizeof(one))!=0)
+	    || real_bind(s,(struct sockaddr*)&addr,len)!=0
+	    || real_listen(s,n)!=0)){
+      real_close(s);
+      s=-1;
+    }
+    if (s!=-1)myth_io_register_fd_on(s,&g_envs[w]);
+    sh->fd[w]=s;
+  }
+  fd_data->shards=sh;
+#else
+  (void)fd;(void)n;
+#endif
+}
+
+static inline int myth_setsockopt_body (int fd, int level, int optname,
+					const void *optval, socklen_t optlen) {
+  int ret;
+  ret=real_setsockopt(fd,level,optname,optval,optlen);
+#if MYTH_IO_ZEROCOPY
+  //Remember it, so that sends need not ask (see myth_io_zc_enabled)
+  if (ret==0 && level==SOL_SOCKET && optname==SO_ZEROCOPY && optlen>=sizeof(int)){
+    myth_io_struct_perfd_t fd_data=myth_fd_map_lookup(g_fd_map,fd);
+    if (fd_data)fd_data->zc_on=(*(const int*)optval!=0);
+  }
+#endif
+  return ret;
+}
+
+static inline int myth_listen_body (int fd, int n) {
+  int ret;
+  ret=real_listen(fd,n);
+  if (ret==0 && g_myth_io_shard)myth_io_shard_listen(fd,n);
+  return ret;
+}
+
+/*
+   poll, select and epoll_wait. a thread none of whose fds is ready
+   parks on the poll_waiters list of its worker, which checks the
+   fds of all of them with a single poll each time it polls for I/O
+   (myth_io_poll_wake), and wakes those with an fd ready, a
+   deadline passed or a cancellation request. the buffer for their
+   fds grows as they park, so waking them allocates nothing and is
+   also done from the SIGIO handler and the I/O thread. any fd can be
+   waited for this way, whether or not the I/O layer made it
+   non-blocking; an epoll instance of the user is readable when
+   it has events to report
+ */
+
+MYTH_CTX_CALLBACK void myth_io_poll_wait_1(void *arg1,void *arg2,void *arg3) {
+  myth_running_env_t env;
+  myth_io_op_t op;
+  myth_io_struct_perenv_t io;
+  env=arg1;
+  op=arg2;
+  (void)arg3;
+  io=&env->io_struct;
+  io->poll_nfds+=op->u.p.nfds;
+  if (io->poll_nfds*sizeof(struct pollfd)>io->poll_buf_size){
+    size_t sz=io->poll_buf_size*2;
+    if (sz<io->poll_nfds*sizeof(struct pollfd))sz=io->poll_nfds*sizeof(struct pollfd);
+    if (io->poll_buf)myth_flfree(env->rank,io->poll_buf_size,io->poll_buf);
+    io->poll_buf=myth_flmalloc(env->rank,sz);
+    io->poll_buf_size=sz;
+  }
+  op->next=io->poll_waiters;
+  io->poll_waiters=op;
+  myth_io_cs_exit(env);
+}
+
+//Switch to another thread until the worker wakes OP
+static inline void myth_io_poll_park(myth_running_env_t env,myth_io_op_t op) {
+  myth_thread_t this_thread,next;
+  this_thread=env->this_thread;
+  op->th=this_thread;
+  op->wl_ptr=NULL;
+  next=myth_queue_pop(&env->runnable_q);
+  if (next){
+    assert(next->status==MYTH_STATUS_READY);//sanity check
+    next->env=env;
+    env->this_thread=next;
+    myth_swap_context_withcall(this_thread,&next->context,
+			       myth_io_poll_wait_1,(void*)env,(void*)op,NULL);
+  }
+  else{
+    //Switch to scheduler for work stealing
+    myth_swap_context_withcall(this_thread,&env->sched.context,
+			       myth_io_poll_wait_1,(void*)env,(void*)op,NULL);
+  }
+}
+
+//Wake threads in poll whose fds are ready or whose time is up. all but
+//the first are pushed to the runqueue, or given with myth_io_pass if
+//PASS is set (when the caller is not the worker owning it)
+static inline myth_thread_t myth_io_poll_wake(myth_running_env_t env,myth_thread_t first_runnable,int pass) {
+  myth_io_struct_perenv_t io;
+  myth_io_op_t op,*p;
+  struct timespec now;
+  nfds_t n,k,i;
+  int ready,errcode,timed;
+  io=&env->io_struct;
+  if (!io->poll_waiters)return first_runnable;
+  n=io->poll_nfds;timed=0;
+  for (op=io->poll_waiters;op;op=op->next){
+    timed|=op->u.p.timed;
+  }
+  k=0;
+  for (op=io->poll_waiters;op;op=op->next){
+    memcpy(io->poll_buf+k,op->u.p.fds,op->u.p.nfds*sizeof(struct pollfd));
+    k+=op->u.p.nfds;
+  }
+  ready=real_poll(io->poll_buf,n,0);
+  errcode=errno;
+  //Interrupted; try again next time
+  if (ready==-1 && (errcode==EINTR || errcode==EAGAIN))return first_runnable;
+  if (timed)hr_gettime(&now);
+  k=0;
+  p=&io->poll_waiters;
+  while ((op=*p)!=NULL){
+    int cnt=0;
+    if (ready>0){
+      for (i=0;i<op->u.p.nfds;i++){
+	if (io->poll_buf[k+i].revents)cnt++;
+      }
+    }
+    if (myth_cancel_pending(op->th)){
+      //Cancelled (see myth_cancel_body)
+      myth_thread_t th;
+      op->ret=-1;
+      op->errcode=ECANCELED;
+      *p=op->next;
+      io->poll_nfds-=op->u.p.nfds;
+      th=op->th;
+      th->env=env;
+      if (!first_runnable){first_runnable=th;}
+      else if (pass){myth_io_pass(env,th);}
+      else{myth_queue_push(&env->runnable_q,th);}
+    }
+    else if (ready==-1 || cnt>0
+	|| (op->u.p.timed && !myth_timespec_gt(&op->u.p.deadline,&now))){
+      myth_thread_t th;
+      for (i=0;i<op->u.p.nfds;i++){
+	op->u.p.fds[i].revents=(ready>0)?io->poll_buf[k+i].revents:0;
+      }
+      op->ret=(ready==-1)?-1:cnt;
+      op->errcode=errcode;
+      *p=op->next;
+      io->poll_nfds-=op->u.p.nfds;
+      th=op->th;
+      th->env=env;
+      if (!first_runnable){first_runnable=th;}
+      else if (pass){myth_io_pass(env,th);}
+      else{myth_queue_push(&env->runnable_q,th);}
+    }
+    else{
+      p=&op->next;
+    }
+    k+=op->u.p.nfds;
+  }
+  return first_runnable;
 }
 
-static inline int myth_accept_body (int fd, struct sockaddr* addr,
-				    socklen_t * addr_len) {
-  //fprintf(stderr,"accept\n");
-  int sock;
+//poll until DEADLINE (or forever if it is NULL)
+static inline int myth_io_poll_until(struct pollfd *fds,nfds_t nfds,
+				     const struct timespec *deadline) {
   myth_running_env_t env;
+  myth_io_op op;
+  int ret;
+  ret=real_poll(fds,nfds,0);
+  if (ret!=0)return ret;
+  //Cancelled (see myth_cancel_body)
+  if (myth_cancel_pending(myth_self_body())){
+    errno=ECANCELED;
+    return -1;
+  }
+  if (deadline){
+    struct timespec now;
+    hr_gettime(&now);
+    if (!myth_timespec_gt(deadline,&now))return 0;
+    op.u.p.deadline=*deadline;
+  }
+  op.type=MYTH_IO_POLL;
+  op.u.p.fds=fds;
+  op.u.p.nfds=nfds;
+  op.u.p.timed=(deadline!=NULL);
   env=myth_get_current_env();
-  //try to accept
   myth_io_cs_enter(env);
-  sock=real_accept(fd,addr,addr_len);
-  if (sock==-1){
-    myth_io_op op;
-    if (errno!=EAGAIN && errno!=EWOULDBLOCK){
-      //error
-      myth_io_cs_exit(env);
-      return -1;
-    }
-    //Wait for the socket ready to read
-    op.type=MYTH_IO_ACCEPT;
-    op.u.a.addr=addr;
-    op.u.a.fd=fd;
-    op.u.a.len=addr_len;
-    //fprintf(stderr,"%d %p\n",fd,env);
-    myth_wait_for_read(fd,env,&op);
-    //fprintf(stderr,"%d %p\n",fd,myth_get_current_env());
-    if (op.ret==-1){
-      errno=op.errcode;
-      return -1;
-    }
-    sock=op.ret;
+  myth_io_poll_park(env,&op);
+  if (op.ret==-1)errno=op.errcode;
+  return op.ret;
+}
+
+//Wait until OP accepts a connection from any of the sockets SH.
+//those of all workers are polled, so none is left unattended
+static inline void myth_io_shard_wait(myth_io_shards_t sh,myth_io_op_t op) {
+  struct pollfd *fds;
+  size_t size;
+  nfds_t n;
+  int i,done;
+  size=sizeof(struct pollfd)*sh->n;
+  fds=myth_flmalloc(myth_get_current_env()->rank,size);
+  n=0;
+  for (i=0;i<sh->n;i++){
+    if (sh->fd[i]==-1)continue;
+    fds[n].fd=sh->fd[i];
+    fds[n].events=POLLIN;
+    n++;
   }
-  else{myth_io_cs_exit(env);}
-  //Done
-  myth_io_register_fd(sock);
-  return sock;
+  do {
+    myth_running_env_t env;
+    if (myth_io_poll_until(fds,n,NULL)==-1 && errno!=EINTR){
+      op->ret=-1;
+      op->errcode=errno;
+      break;
+    }
+    //Possibly on another worker by now
+    env=myth_get_current_env();
+    myth_io_cs_enter(env);
+    done=myth_io_execute(op);
+    myth_io_cs_exit(env);
+  } while (!done);
+  myth_flfree(myth_get_current_env()->rank,size,fds);
 }
 
-static inline int myth_bind_body(int fd, const struct sockaddr *addr, socklen_t len) {
-  //Have to do nothing extra
-  return real_bind(fd,addr,len);
+//The time REL from now
+static inline void myth_io_deadline(const struct timespec *rel,struct timespec *deadline) {
+  struct timespec now;
+  hr_gettime(&now);
+  myth_timespec_add(&now,rel,deadline);
 }
 
-static inline int myth_listen_body (int fd, int n) {
-  //Have to do nothing extra
-  return real_listen(fd,n);
+static inline int myth_poll_body (struct pollfd *fds, nfds_t nfds, int timeout) {
+  struct timespec rel,deadline;
+  if (timeout==0)return real_poll(fds,nfds,0);
+  if (timeout<0)return myth_io_poll_until(fds,nfds,NULL);
+  rel.tv_sec=timeout/1000;
+  rel.tv_nsec=(timeout%1000)*1000000L;
+  myth_io_deadline(&rel,&deadline);
+  return myth_io_poll_until(fds,nfds,&deadline);
+}
+
+#if defined(HAVE_PPOLL)
+static inline int myth_ppoll_body (struct pollfd *fds, nfds_t nfds,
+				   const struct timespec *tmo_p, const sigset_t *sigmask) {
+  struct timespec deadline;
+  //A thread cannot change the signal mask of its worker while switched out
+  if (sigmask)return real_ppoll(fds,nfds,tmo_p,sigmask);
+  if (!tmo_p)return myth_io_poll_until(fds,nfds,NULL);
+  if (tmo_p->tv_sec<0 || tmo_p->tv_nsec<0 || tmo_p->tv_nsec>999999999){
+    errno=EINVAL;
+    return -1;
+  }
+  myth_io_deadline(tmo_p,&deadline);
+  return myth_io_poll_until(fds,nfds,&deadline);
 }
+#endif
 
 static inline int myth_select_body(int nfds, fd_set *readfds, fd_set *writefds,
 				   fd_set *exceptfds, struct timeval *timeout) {
-  //get current time
-  struct timeval tv={0,0};
-  int64_t t_start,t_goal,t_current,t_rest;
-  t_current=t_start=tv.tv_sec*1000*1000+tv.tv_usec;
+  struct pollfd fds_buf[64],*fds;
+  struct timespec rel,deadline;
+  int fd,n,i,ret;
+  if (nfds<0 || nfds>FD_SETSIZE
+      || (timeout && (timeout->tv_sec<0 || timeout->tv_usec<0))){
+    //Let the system tell the error
+    return real_select(nfds,readfds,writefds,exceptfds,timeout);
+  }
+  n=0;
+  for (fd=0;fd<nfds;fd++){
+    if ((readfds && FD_ISSET(fd,readfds)) || (writefds && FD_ISSET(fd,writefds))
+	|| (exceptfds && FD_ISSET(fd,exceptfds)))n++;
+  }
+  fds=(n<=(int)(sizeof(fds_buf)/sizeof(fds_buf[0])))?fds_buf:myth_malloc(n*sizeof(struct pollfd));
+  i=0;
+  for (fd=0;fd<nfds;fd++){
+    short ev=0;
+    if (readfds && FD_ISSET(fd,readfds))ev|=POLLIN;
+    if (writefds && FD_ISSET(fd,writefds))ev|=POLLOUT;
+    if (exceptfds && FD_ISSET(fd,exceptfds))ev|=POLLPRI;
+    if (!ev)continue;
+    fds[i].fd=fd;
+    fds[i].events=ev;
+    fds[i].revents=0;
+    i++;
+  }
   if (timeout){
-    gettimeofday(&tv,NULL);
-    t_goal=t_start+timeout->tv_sec*1000*1000+timeout->tv_usec;
+    rel.tv_sec=timeout->tv_sec;
+    rel.tv_nsec=timeout->tv_usec*1000L;
+    myth_io_deadline(&rel,&deadline);
+    ret=myth_io_poll_until(fds,n,&deadline);
   }
-  else t_goal=0;
-  int ret=0;
-  struct timeval tv_immediate;
-  while (1){
-    tv_immediate.tv_sec=0;tv_immediate.tv_usec=0;
-    ret=real_select(nfds,readfds,writefds,exceptfds,&tv_immediate);
-#if SELECT_ALWAYS_RETURN_IMMEDIATELY
-    if (ret!=0)myth_yield_body();
-    break;
-#endif
-    if (ret!=0)break;
-    if (timeout){
-      int errno_save=errno;
-      gettimeofday(&tv,NULL);
-      errno=errno_save;
-      t_current=tv.tv_sec*1000*1000+tv.tv_usec;
-      if (t_goal<=t_current)break;
+  else{
+    ret=myth_io_poll_until(fds,n,NULL);
+  }
+  for (i=0;i<n && ret>0;i++){
+    if (fds[i].revents & POLLNVAL){
+      errno=EBADF;
+      ret=-1;
+    }
+  }
+  if (ret>=0){
+    //Count the fds in the sets, as select does
+    if (readfds)FD_ZERO(readfds);
+    if (writefds)FD_ZERO(writefds);
+    if (exceptfds)FD_ZERO(exceptfds);
+    ret=0;
+    for (i=0;i<n;i++){
+      short r=fds[i].revents;
+      if ((fds[i].events & POLLIN) && (r & (POLLIN|POLLHUP|POLLERR))){
+	FD_SET(fds[i].fd,readfds);ret++;
+      }
+      if ((fds[i].events & POLLOUT) && (r & (POLLOUT|POLLERR))){
+	FD_SET(fds[i].fd,writefds);ret++;
+      }
+      if ((fds[i].events & POLLPRI) && (r & POLLPRI)){
+	FD_SET(fds[i].fd,exceptfds);ret++;
+      }
     }
-    myth_yield_body();
   }
   if (timeout){
-    //rewrite timeval
-    t_rest=t_goal-t_current;
-    if (t_rest<0)t_rest=0;
-    timeout->tv_sec=t_rest/(1000*1000);
-    timeout->tv_usec=t_rest%(1000*1000);
+    //Linux tells the time left
+    struct timespec now;
+    int errno_save=errno;
+    hr_gettime(&now);
+    errno=errno_save;
+    if (myth_timespec_gt(&deadline,&now)){
+      long ns=(deadline.tv_sec-now.tv_sec)*1000000000L+(deadline.tv_nsec-now.tv_nsec);
+      timeout->tv_sec=ns/1000000000L;
+      timeout->tv_usec=(ns%1000000000L)/1000;
+    }
+    else{
+      timeout->tv_sec=0;
+      timeout->tv_usec=0;
+    }
   }
+  if (fds!=fds_buf)myth_free_with_size(fds,n*sizeof(struct pollfd));
   return ret;
 }
 
+static inline int myth_epoll_wait_body (int epfd, struct epoll_event *events,
+					int maxevents, int timeout) {
+  struct timespec rel,deadline;
+  struct pollfd pfd;
+  int ret;
+  if (timeout>0){
+    rel.tv_sec=timeout/1000;
+    rel.tv_nsec=(timeout%1000)*1000000L;
+    myth_io_deadline(&rel,&deadline);
+  }
+  while (1){
+    ret=real_epoll_wait(epfd,events,maxevents,0);
+    if (ret!=0 || timeout==0)return ret;
+    //Another thread may take the events before we wake up
+    pfd.fd=epfd;
+    pfd.events=POLLIN;
+    pfd.revents=0;
+    ret=myth_io_poll_until(&pfd,1,(timeout>0)?&deadline:NULL);
+    if (ret<=0)return ret;
+  }
+}
+
 static inline ssize_t myth_sendto_body(int sockfd, const void *buf, 
 				       size_t len, int flags,
 				       const struct sockaddr *dest_addr, 
@@ -725,8 +2044,8 @@ static inline ssize_t myth_sendto_body(int sockfd, const void *buf,
 #endif
   if (ret==-1){
     myth_io_op op;
-    if (errno!=EAGAIN && errno!=EWOULDBLOCK){
-      //error
+    if ((errno!=EAGAIN && errno!=EWOULDBLOCK) || (flags & MSG_DONTWAIT)){
+      //error, or the caller does not wait
       myth_io_cs_exit(env);
       return -1;
     }
@@ -752,6 +2071,7 @@ static inline ssize_t myth_sendto_body(int sockfd, const void *buf,
   }
   else{
     myth_io_cs_exit(env);
+    myth_io_stat_done(sockfd,0,ret);
 #if MYTH_IO_PROF_DETAIL
     env->prof_data.io_succ_send_cycles+=t1-t0;
     env->prof_data.io_succ_send_cnt++;
@@ -781,8 +2101,8 @@ static inline ssize_t myth_recvfrom_body(int sockfd, void *buf, size_t len,
 #endif
   if (ret==-1){
     myth_io_op op;
-    if (errno!=EAGAIN && errno!=EWOULDBLOCK){
-      //error
+    if ((errno!=EAGAIN && errno!=EWOULDBLOCK) || (flags & MSG_DONTWAIT)){
+      //error, or the caller does not wait
       myth_io_cs_exit(env);
       return -1;
     }
@@ -808,6 +2128,7 @@ static inline ssize_t myth_recvfrom_body(int sockfd, void *buf, size_t len,
   }
   else{
     myth_io_cs_exit(env);
+    myth_io_stat_done(sockfd,1,ret);
 #if MYTH_IO_PROF_DETAIL
     env->prof_data.io_succ_recv_cycles+=t1-t0;
     env->prof_data.io_succ_recv_cnt++;
@@ -822,6 +2143,17 @@ static inline ssize_t myth_send_body (int fd, const void *buf, size_t n, int fla
   ssize_t ret;
   t0=0;t1=0;t2=0;t3=0;
   myth_running_env_t env;
+#if MYTH_IO_ZEROCOPY
+  if ((flags & MSG_ZEROCOPY) && myth_io_zc_enabled(fd)){
+    myth_io_op op;
+    op.type=MYTH_IO_SEND;
+    op.u.s.fd=fd;
+    op.u.s.buf=buf;
+    op.u.s.n=n;
+    op.u.s.flags=flags;
+    return myth_io_zc_send_body(fd,&op);
+  }
+#endif
 #if MYTH_IO_PROF_DETAIL
   t0=myth_get_rdtsc();
 #endif
@@ -834,8 +2166,8 @@ static inline ssize_t myth_send_body (int fd, const void *buf, size_t n, int fla
 #endif
   if (ret==-1){
     myth_io_op op;
-    if (errno!=EAGAIN && errno!=EWOULDBLOCK){
-      //error
+    if ((errno!=EAGAIN && errno!=EWOULDBLOCK) || (flags & MSG_DONTWAIT)){
+      //error, or the caller does not wait
       myth_io_cs_exit(env);
       return -1;
     }
@@ -860,6 +2192,7 @@ static inline ssize_t myth_send_body (int fd, const void *buf, size_t n, int fla
   }
   else{
     myth_io_cs_exit(env);
+    myth_io_stat_done(fd,0,ret);
 #if MYTH_IO_PROF_DETAIL
     env->prof_data.io_succ_send_cycles+=t1-t0;
     env->prof_data.io_succ_send_cnt++;
@@ -886,8 +2219,8 @@ static inline ssize_t myth_recv_body (int fd, void *buf, size_t n, int flags) {
 #endif
   if (ret==-1){
     myth_io_op op;
-    if (errno!=EAGAIN && errno!=EWOULDBLOCK){
-      //error
+    if ((errno!=EAGAIN && errno!=EWOULDBLOCK) || (flags & MSG_DONTWAIT)){
+      //error, or the caller does not wait
       myth_io_cs_exit(env);
       return -1;
     }
@@ -911,6 +2244,7 @@ static inline ssize_t myth_recv_body (int fd, void *buf, size_t n, int flags) {
   }
   else{
     myth_io_cs_exit(env);
+    myth_io_stat_done(fd,1,ret);
 #if MYTH_IO_PROF_DETAIL
     env->prof_data.io_succ_recv_cycles+=t1-t0;
     env->prof_data.io_succ_recv_cnt++;
@@ -920,6 +2254,410 @@ static inline ssize_t myth_recv_body (int fd, void *buf, size_t n, int flags) {
   return ret;
 }
 
+static inline ssize_t myth_recvmsg_body (int fd, struct msghdr *msg, int flags) {
+  ssize_t ret;
+  myth_running_env_t env;
+  env=myth_get_current_env();
+  myth_io_cs_enter(env);
+  //Perform non-blocking recvmsg
+  ret=real_recvmsg(fd,msg,flags);
+  if (ret==-1){
+    myth_io_op op;
+    if ((errno!=EAGAIN && errno!=EWOULDBLOCK) || (flags & MSG_DONTWAIT)){
+      //error, or the caller does not wait
+      myth_io_cs_exit(env);
+      return -1;
+    }
+    //Wait for I/O ready
+    op.type=MYTH_IO_RECVMSG;
+    op.u.m.fd=fd;
+    op.u.m.msg=msg;
+    op.u.m.flags=flags;
+    myth_wait_for_read(fd,env,&op);
+    errno=op.errcode;
+    ret=op.ret;
+  }
+  else{
+    myth_io_cs_exit(env);
+    myth_io_stat_done(fd,1,ret);
+  }
+  //Done
+  return ret;
+}
+
+static inline ssize_t myth_sendmsg_body (int fd, const struct msghdr *msg, int flags) {
+  ssize_t ret;
+  myth_running_env_t env;
+  myth_io_op op;
+  op.type=MYTH_IO_SENDMSG;
+  op.u.m.fd=fd;
+  op.u.m.msg=(struct msghdr*)msg;
+  op.u.m.flags=flags;
+#if MYTH_IO_ZEROCOPY
+  if ((flags & MSG_ZEROCOPY) && myth_io_zc_enabled(fd))
+    return myth_io_zc_send_body(fd,&op);
+#endif
+  env=myth_get_current_env();
+  myth_io_cs_enter(env);
+  //Perform non-blocking sendmsg
+  ret=real_sendmsg(fd,msg,flags);
+  if (ret==-1){
+    if ((errno!=EAGAIN && errno!=EWOULDBLOCK) || (flags & MSG_DONTWAIT)){
+      //error, or the caller does not wait
+      myth_io_cs_exit(env);
+      return -1;
+    }
+    //Wait for I/O ready
+    myth_wait_for_write(fd,env,&op);
+    errno=op.errcode;
+    ret=op.ret;
+  }
+  else{
+    myth_io_cs_exit(env);
+    myth_io_stat_done(fd,0,ret);
+  }
+  //Done
+  return ret;
+}
+
+//Perform OP, which waits for SOCK, switching to other threads until it is ready
+static inline ssize_t myth_io_sock_op_body(int sock,myth_io_op_t op) {
+  myth_running_env_t env;
+  env=myth_get_current_env();
+  myth_io_cs_enter(env);
+  if (myth_io_execute(op)){
+    myth_io_cs_exit(env);
+    myth_io_stat_done(sock,myth_io_op_is_read(op),myth_io_op_bytes(op,op->ret));
+  }
+  else if (myth_io_op_is_read(op)){
+    myth_wait_for_read(sock,env,op);
+  }
+  else{
+    myth_wait_for_write(sock,env,op);
+  }
+  if (op->ret==-1)errno=op->errcode;
+  return op->ret;
+}
+
+#if defined(HAVE_RECVMMSG)
+/* each batch is a single recvmmsg. as with the kernel, the call
+   returns when VLEN messages have arrived, or after the first batch
+   with MSG_WAITFORONE, and the timeout is checked only after a batch */
+static inline int myth_recvmmsg_body (int fd, struct mmsghdr *vec, unsigned int vlen,
+				      int flags, struct timespec *timeout) {
+  myth_io_op op;
+  struct timespec deadline={0,0},now;
+  unsigned int got;
+  if ((flags & MSG_DONTWAIT) || !myth_fd_map_lookup(g_fd_map,fd))
+    return real_recvmmsg(fd,vec,vlen,flags,timeout);
+  if (timeout)myth_io_deadline(timeout,&deadline);
+  op.type=MYTH_IO_RECVMMSG;
+  op.u.mm.fd=fd;
+  op.u.mm.flags=flags;
+  got=0;
+  while (got<vlen){
+    ssize_t r;
+    op.u.mm.vec=vec+got;
+    op.u.mm.vlen=vlen-got;
+    r=myth_io_sock_op_body(fd,&op);
+    if (r==-1){
+      //The error is reported by the next call, if some arrived
+      if (got)break;
+      return -1;
+    }
+    got+=r;
+    if (r==0 || (flags & MSG_WAITFORONE))break;
+    if (timeout){
+      hr_gettime(&now);
+      if (!myth_timespec_gt(&deadline,&now))break;
+    }
+  }
+  return got;
+}
+#endif
+
+#if defined(HAVE_SENDMMSG)
+//Send all the messages, a batch at a time, as a blocking sendmmsg does
+static inline int myth_sendmmsg_body (int fd, struct mmsghdr *vec, unsigned int vlen,
+				      int flags) {
+  myth_io_op op;
+  unsigned int sent;
+  if ((flags & MSG_DONTWAIT) || !myth_fd_map_lookup(g_fd_map,fd))
+    return real_sendmmsg(fd,vec,vlen,flags);
+  op.type=MYTH_IO_SENDMMSG;
+  op.u.mm.fd=fd;
+  op.u.mm.flags=flags;
+  sent=0;
+  while (sent<vlen){
+    ssize_t r;
+    op.u.mm.vec=vec+sent;
+    op.u.mm.vlen=vlen-sent;
+    r=myth_io_sock_op_body(fd,&op);
+    if (r==-1){
+      if (sent)break;
+      return -1;
+    }
+    if (r==0)break;
+    sent+=r;
+  }
+  return sent;
+}
+#endif
+
+#if defined(HAVE_SYS_SENDFILE_H)
+static inline ssize_t myth_sendfile_body (int out_fd, int in_fd, off_t *off, size_t n) {
+  myth_io_op op;
+  //Only a socket is waited for; in_fd is a file
+  if (!myth_fd_map_lookup(g_fd_map,out_fd))return real_sendfile(out_fd,in_fd,off,n);
+  op.type=MYTH_IO_SENDFILE;
+  op.u.sf.out_fd=out_fd;
+  op.u.sf.in_fd=in_fd;
+  op.u.sf.off=off;
+  op.u.sf.n=n;
+  return myth_io_sock_op_body(out_fd,&op);
+}
+#endif
+
+#if defined(HAVE_SPLICE)
+static inline ssize_t myth_splice_body (int fd_in, loff_t *off_in, int fd_out,
+					loff_t *off_out, size_t n, unsigned int flags) {
+  myth_io_op op;
+  //One side is a pipe. A socket on the other side is waited for,
+  //unless the user asked for SPLICE_F_NONBLOCK
+  if (flags & SPLICE_F_NONBLOCK)op.u.sp.sock=-1;
+  else if (myth_fd_map_lookup(g_fd_map,fd_in))op.u.sp.sock=fd_in;
+  else if (myth_fd_map_lookup(g_fd_map,fd_out))op.u.sp.sock=fd_out;
+  else op.u.sp.sock=-1;
+  if (op.u.sp.sock==-1)return real_splice(fd_in,off_in,fd_out,off_out,n,flags);
+  op.type=MYTH_IO_SPLICE;
+  op.u.sp.fd_in=fd_in;
+  op.u.sp.off_in=off_in;
+  op.u.sp.fd_out=fd_out;
+  op.u.sp.off_out=off_out;
+  op.u.sp.n=n;
+  op.u.sp.flags=flags;
+  return myth_io_sock_op_body(op.u.sp.sock,&op);
+}
+#endif
+
+/*
+   file I/O (MYTH_WRAP_FILEIO=1). regular files are always
+   "ready", so readiness-based multiplexing does not help; the
+   call itself is handed to the worker's io_uring if it takes
+   file ops, or else to a helper thread, and the calling thread
+   is switched out until it is done
+ */
+
+//Perform the blocking call OP describes, recording its outcome in OP
+static inline void myth_io_execute_file(myth_io_op_t op) {
+  ssize_t ret;
+  switch (op->type) {
+  case MYTH_IO_READ:
+    ret=real_read(op->u.f.fd,op->u.f.buf,op->u.f.n);
+    break;
+  case MYTH_IO_WRITE:
+    ret=real_write(op->u.f.fd,op->u.f.buf,op->u.f.n);
+    break;
+  case MYTH_IO_PREAD:
+    ret=real_pread(op->u.f.fd,op->u.f.buf,op->u.f.n,op->u.f.off);
+    break;
+  case MYTH_IO_PWRITE:
+    ret=real_pwrite(op->u.f.fd,op->u.f.buf,op->u.f.n,op->u.f.off);
+    break;
+  case MYTH_IO_FSYNC:
+    ret=real_fsync(op->u.f.fd);
+    break;
+  case MYTH_IO_OPEN:
+    ret=real_open(op->u.f.path,op->u.f.flags,op->u.f.mode);
+    break;
+  case MYTH_IO_READV:
+    ret=real_readv(op->u.f.fd,op->u.f.iov,op->u.f.iovcnt);
+    break;
+  case MYTH_IO_WRITEV:
+    ret=real_writev(op->u.f.fd,op->u.f.iov,op->u.f.iovcnt);
+    break;
+  default:
+    myth_unreachable();
+    ret=-1;
+    break;
+  }
+  op->ret=ret;
+  op->errcode=(ret==-1)?errno:0;
+}
+
+MYTH_CTX_CALLBACK void myth_io_file_wait_1(void *arg1,void *arg2,void *arg3) {
+  (void)arg1;(void)arg3;
+  //The context is saved, so a helper may resume the thread from now on
+  myth_io_helpers_submit((myth_io_op_t)arg2);
+}
+
+//Perform OP on behalf of the current thread, switching to another thread meanwhile
+static inline void myth_io_file_wait(myth_running_env_t env,myth_io_op_t op) {
+  myth_thread_t this_thread,next;
+#if MYTH_IO_URING_AVAILABLE
+  if (myth_io_uring_on(env) && env->io_struct.uring.file_ops){
+    myth_io_cs_enter(env);
+    if (myth_io_uring_wait(env,op)==0)return;
+    //The ring is full; use helpers
+    myth_io_cs_exit(env);
+  }
+#endif
+  if (g_myth_io_n_helpers==0){
+    //MYTH_IO_HELPERS=0; block the worker
+    myth_io_execute_file(op);
+    return;
+  }
+  this_thread=env->this_thread;
+  op->th=this_thread;
+  op->wl_ptr=NULL;
+  next=myth_queue_pop(&env->runnable_q);
+  if (next){
+    assert(next->status==MYTH_STATUS_READY);//sanity check
+    next->env=env;
+    env->this_thread=next;
+    myth_swap_context_withcall(this_thread,&next->context,
+			       myth_io_file_wait_1,(void*)env,(void*)op,NULL);
+  }
+  else{
+    //Switch to scheduler for work stealing
+    myth_swap_context_withcall(this_thread,&env->sched.context,
+			       myth_io_file_wait_1,(void*)env,(void*)op,NULL);
+  }
+}
+
+static inline ssize_t myth_io_file_body(myth_io_op_t op) {
+  myth_io_file_wait(myth_get_current_env(),op);
+  if (op->ret==-1)errno=op->errcode;
+  return op->ret;
+}
+
+/* read and write on an fd that is not a file (a pipe, a tty, an
+   eventfd, a socket we have not registered, ...) may wait for as
+   long as the other end likes, and would hold a helper meanwhile,
+   so that enough of them could leave none for the other end. such
+   a call waits for readiness with poll instead (myth_io_poll_until)
+   and is then performed by the thread itself */
+static inline int myth_io_fd_is_file(int fd) {
+  struct stat st;
+  //A bad fd is told by the call itself
+  if (fstat(fd,&st)==-1)return 1;
+  return S_ISREG(st.st_mode) || S_ISBLK(st.st_mode);
+}
+
+static inline ssize_t myth_io_stream_body(myth_io_op_t op,short events) {
+  struct pollfd p;
+  p.fd=op->u.f.fd;
+  p.events=events;
+  p.revents=0;
+  if (real_poll(&p,1,0)==0){
+    int fl=real_fcntl(p.fd,F_GETFL);
+    //Unless the user made it non-blocking and expects EAGAIN
+    if (fl!=-1 && !(fl & O_NONBLOCK) && myth_io_poll_until(&p,1,NULL)==-1)return -1;
+  }
+  myth_io_execute_file(op);
+  if (op->ret==-1)errno=op->errcode;
+  return op->ret;
+}
+
+static inline ssize_t myth_read_body (int fd, void *buf, size_t n) {
+  myth_io_op op;
+  if ((g_myth_io_on & MYTH_IO_ON_SOCK) && myth_fd_map_lookup(g_fd_map,fd))
+    return myth_recv_body(fd,buf,n,0);
+  if (!(g_myth_io_on & MYTH_IO_ON_FILE))return real_read(fd,buf,n);
+  op.type=MYTH_IO_READ;
+  op.u.f.fd=fd;
+  op.u.f.buf=buf;
+  op.u.f.n=n;
+  if (!myth_io_fd_is_file(fd))return myth_io_stream_body(&op,POLLIN);
+  return myth_io_file_body(&op);
+}
+
+static inline ssize_t myth_write_body (int fd, const void *buf, size_t n) {
+  myth_io_op op;
+  if ((g_myth_io_on & MYTH_IO_ON_SOCK) && myth_fd_map_lookup(g_fd_map,fd))
+    return myth_send_body(fd,buf,n,0);
+  if (!(g_myth_io_on & MYTH_IO_ON_FILE))return real_write(fd,buf,n);
+  op.type=MYTH_IO_WRITE;
+  op.u.f.fd=fd;
+  op.u.f.buf=(void*)buf;
+  op.u.f.n=n;
+  if (!myth_io_fd_is_file(fd))return myth_io_stream_body(&op,POLLOUT);
+  return myth_io_file_body(&op);
+}
+
+static inline ssize_t myth_pread_body (int fd, void *buf, size_t n, off_t off) {
+  myth_io_op op;
+  op.type=MYTH_IO_PREAD;
+  op.u.f.fd=fd;
+  op.u.f.buf=buf;
+  op.u.f.n=n;
+  op.u.f.off=off;
+  return myth_io_file_body(&op);
+}
+
+static inline ssize_t myth_pwrite_body (int fd, const void *buf, size_t n, off_t off) {
+  myth_io_op op;
+  op.type=MYTH_IO_PWRITE;
+  op.u.f.fd=fd;
+  op.u.f.buf=(void*)buf;
+  op.u.f.n=n;
+  op.u.f.off=off;
+  return myth_io_file_body(&op);
+}
+
+static inline int myth_fsync_body (int fd) {
+  myth_io_op op;
+  op.type=MYTH_IO_FSYNC;
+  op.u.f.fd=fd;
+  return (int)myth_io_file_body(&op);
+}
+
+static inline int myth_open_body (const char *path, int flags, mode_t mode) {
+  myth_io_op op;
+  op.type=MYTH_IO_OPEN;
+  op.u.f.path=path;
+  op.u.f.flags=flags;
+  op.u.f.mode=mode;
+  return (int)myth_io_file_body(&op);
+}
+
+//readv and writev on a socket become recvmsg and sendmsg
+static inline ssize_t myth_readv_body (int fd, const struct iovec *iov, int iovcnt) {
+  myth_io_op op;
+  if ((g_myth_io_on & MYTH_IO_ON_SOCK) && myth_fd_map_lookup(g_fd_map,fd)){
+    struct msghdr msg;
+    memset(&msg,0,sizeof(msg));
+    msg.msg_iov=(struct iovec*)iov;
+    msg.msg_iovlen=iovcnt;
+    return myth_recvmsg_body(fd,&msg,0);
+  }
+  if (!(g_myth_io_on & MYTH_IO_ON_FILE))return real_readv(fd,iov,iovcnt);
+  op.type=MYTH_IO_READV;
+  op.u.f.fd=fd;
+  op.u.f.iov=iov;
+  op.u.f.iovcnt=iovcnt;
+  if (!myth_io_fd_is_file(fd))return myth_io_stream_body(&op,POLLIN);
+  return myth_io_file_body(&op);
+}
+
+static inline ssize_t myth_writev_body (int fd, const struct iovec *iov, int iovcnt) {
+  myth_io_op op;
+  if ((g_myth_io_on & MYTH_IO_ON_SOCK) && myth_fd_map_lookup(g_fd_map,fd)){
+    struct msghdr msg;
+    memset(&msg,0,sizeof(msg));
+    msg.msg_iov=(struct iovec*)iov;
+    msg.msg_iovlen=iovcnt;
+    return myth_sendmsg_body(fd,&msg,0);
+  }
+  if (!(g_myth_io_on & MYTH_IO_ON_FILE))return real_writev(fd,iov,iovcnt);
+  op.type=MYTH_IO_WRITEV;
+  op.u.f.fd=fd;
+  op.u.f.iov=iov;
+  op.u.f.iovcnt=iovcnt;
+  if (!myth_io_fd_is_file(fd))return myth_io_stream_body(&op,POLLOUT);
+  return myth_io_file_body(&op);
+}
+
 static inline int myth_close_body (int fd) {
   int ret;
   myth_running_env_t env,dest_env;
@@ -928,6 +2666,14 @@ static inline int myth_close_body (int fd) {
   fd_data=myth_fd_map_lookup(env->io_struct.fd_map,fd);
   if (fd_data){
     myth_assert(fd_data);
+    //Close the sockets of other workers a sharded one has
+    if (fd_data->shards){
+      int w;
+      for (w=0;w<fd_data->shards->n;w++){
+	int s=fd_data->shards->fd[w];
+	if (s!=-1 && s!=fd)myth_close_body(s);
+      }
+    }
     //Remove entry from fd_map
     myth_fd_map_delete(env->io_struct.fd_map,fd);
     //unregister from epoll instance
@@ -993,17 +2739,18 @@ static inline int myth_fcntl_body (int fd, int cmd,va_list vl) {
 #define EPOLLRDHUP 0x2000
 #endif
 
-//Perform I/O operation. Return 0 if the operation failed because of blocking, or 1
+//Perform I/O operation. Return 0 if the operation failed because of blocking, or 1.
+//The fd may not have been made non-blocking by us, hence MSG_DONTWAIT
 static inline int myth_io_execute(myth_io_op_t op) {
   MAY_BE_UNUSED uint64_t t0,t1;
   MAY_BE_UNUSED myth_running_env_t env;
-  int ret;
+  MAY_BE_UNUSED myth_io_struct_perfd_t fd_data;
+  ssize_t ret;
   t0=0;t1=0;
   env=NULL;
   switch (op->type) {
   case MYTH_IO_CONNECT:{
-    //In current version, connect is not multiplexed. Therefore this part is unreachable
-    myth_unreachable();
+    //connect is multiplexed only with io_uring, which polls for write ready
     socklen_t ret_len;
     int errcode;
     ret_len=sizeof(int);
@@ -1018,7 +2765,8 @@ static inline int myth_io_execute(myth_io_op_t op) {
 #if MYTH_IO_PROF_DETAIL
     t0=myth_get_rdtsc();
 #endif
-    ret=real_send(op->u.s.fd,op->u.s.buf,op->u.s.n,op->u.s.flags);
+    if (myth_io_op_is_zerocopy(op))ret=myth_io_zc_send(op,op->u.s.fd);
+    else ret=real_send(op->u.s.fd,op->u.s.buf,op->u.s.n,op->u.s.flags|MSG_DONTWAIT);
     //assert(myth_fd_map_lookup(op->th->env->io_struct.fd_map,op->u.s.fd));
 #if MYTH_IO_PROF_DETAIL
     t1=myth_get_rdtsc();
@@ -1037,7 +2785,7 @@ static inline int myth_io_execute(myth_io_op_t op) {
 #if MYTH_IO_PROF_DETAIL
     t0=myth_get_rdtsc();
 #endif
-    ret=real_recv(op->u.r.fd,op->u.r.buf,op->u.r.n,op->u.r.flags);
+    ret=real_recv(op->u.r.fd,op->u.r.buf,op->u.r.n,op->u.r.flags|MSG_DONTWAIT);
     //assert(myth_fd_map_lookup(op->th->env->io_struct.fd_map,op->u.r.fd));
 #if MYTH_IO_PROF_DETAIL
     t1=myth_get_rdtsc();
@@ -1053,19 +2801,72 @@ static inline int myth_io_execute(myth_io_op_t op) {
 #endif
     break;
   case MYTH_IO_SENDTO:
-    ret=real_sendto(op->u.st.fd,op->u.st.buf,op->u.st.n,op->u.st.flags,op->u.st.addr,op->u.st.addr_len);
+    ret=real_sendto(op->u.st.fd,op->u.st.buf,op->u.st.n,op->u.st.flags|MSG_DONTWAIT,op->u.st.addr,op->u.st.addr_len);
     break;
   case MYTH_IO_RECVFROM:
-    ret=real_recvfrom(op->u.rf.fd,op->u.rf.buf,op->u.rf.n,op->u.rf.flags,op->u.rf.addr,op->u.rf.addr_len);
+    ret=real_recvfrom(op->u.rf.fd,op->u.rf.buf,op->u.rf.n,op->u.rf.flags|MSG_DONTWAIT,op->u.rf.addr,op->u.rf.addr_len);
     break;
-  case MYTH_IO_SELECT:
-    //Not implemented yet
-    assert(0);
+  case MYTH_IO_RECVMSG:
+    ret=real_recvmsg(op->u.m.fd,op->u.m.msg,op->u.m.flags|MSG_DONTWAIT);
+    break;
+  case MYTH_IO_SENDMSG:
+    if (myth_io_op_is_zerocopy(op))ret=myth_io_zc_send(op,op->u.m.fd);
+    else ret=real_sendmsg(op->u.m.fd,op->u.m.msg,op->u.m.flags|MSG_DONTWAIT);
+    break;
+#if defined(HAVE_SYS_SENDFILE_H)
+  case MYTH_IO_SENDFILE:
+    //out_fd is a socket we made non-blocking
+    ret=real_sendfile(op->u.sf.out_fd,op->u.sf.in_fd,op->u.sf.off,op->u.sf.n);
+    break;
+#endif
+#if defined(HAVE_SPLICE)
+  case MYTH_IO_SPLICE:
+    //Only the socket side is non-blocking; the pipe side blocks as it would
+    ret=real_splice(op->u.sp.fd_in,op->u.sp.off_in,op->u.sp.fd_out,op->u.sp.off_out,
+		    op->u.sp.n,op->u.sp.flags);
+    break;
+#endif
+#if MYTH_IO_ZEROCOPY
+  case MYTH_IO_ERRQUEUE:
+    //Just tell whether the send has completed, unless the socket is closed
+    fd_data=myth_fd_map_lookup(g_fd_map,op->u.e.fd);
+    if (!fd_data){
+      op->ret=-1;
+      op->errcode=EBADF;
+      return 1;
+    }
+    myth_io_zc_reap(fd_data);
+    if (!myth_io_zc_done(fd_data,op->u.e.id))return 0;
+    op->ret=0;
+    op->errcode=0;
+    return 1;
+#endif
+#if defined(HAVE_RECVMMSG)
+  case MYTH_IO_RECVMMSG:
+    ret=real_recvmmsg(op->u.mm.fd,op->u.mm.vec,op->u.mm.vlen,op->u.mm.flags|MSG_DONTWAIT,NULL);
+    break;
+#endif
+#if defined(HAVE_SENDMMSG)
+  case MYTH_IO_SENDMMSG:
+    ret=real_sendmmsg(op->u.mm.fd,op->u.mm.vec,op->u.mm.vlen,op->u.mm.flags|MSG_DONTWAIT);
     break;
+#endif
   case MYTH_IO_ACCEPT:
-    ret=real_accept(op->u.a.fd,op->u.a.addr,op->u.a.len);
+    ret=myth_io_accept(op);
     //assert(myth_fd_map_lookup(op->th->env->io_struct.fd_map,op->u.a.fd));
     break;
+  case MYTH_IO_WAIT:{
+    //Just tell whether it is ready; the user performs the call
+    struct pollfd p;
+    p.fd=op->u.w.fd;
+    p.events=op->u.w.events;
+    p.revents=0;
+    ret=real_poll(&p,1,0);
+    if (ret==0)return 0;
+    op->ret=(ret==-1)?-1:0;
+    op->errcode=errno;
+    return 1;
+  }
   default:
     assert(0);
     break;
@@ -1115,12 +2916,28 @@ static inline myth_thread_t myth_io_polling(struct myth_running_env *env) {
   first_runnable=NULL;
   t0=0;t1=0;t2=0;t3=0;
   hit=0;
+  //Asked for by MYTH_IO_STATS_SIGNAL
+  if (g_myth_io_dump_req && __sync_lock_test_and_set(&g_myth_io_dump_req,0))
+    myth_io_dump_stats_body(2);
   myth_io_cs_enter(env);
 #if MYTH_IO_PROF_DETAIL
   t0=myth_get_rdtsc();
+#endif
+  //Those the I/O thread could not pass
+  first_runnable=myth_io_take_passed(env,first_runnable);
+#if MYTH_IO_URING_AVAILABLE
+  //Threads blocked on this worker wait in its io_uring
+  if (myth_io_uring_on(env)){
+    first_runnable=myth_io_uring_polling(env,first_runnable);
+  }
 #endif
 #if MYTH_ONE_IO_WORKER
-  if (env->rank!=0)return NULL;
+  //Threads in poll still wait on their own worker
+  if (env->rank!=0){
+    first_runnable=myth_io_poll_wake(env,first_runnable,0);
+    myth_io_cs_exit(env);
+    return first_runnable;
+  }
 #endif
   //Pop a blocked read I/O operation from the list
   while ((op=myth_io_wait_list_pop(env,&env->io_struct.rd_reserve_list))!=NULL){
@@ -1166,11 +2983,16 @@ static inline myth_thread_t myth_io_polling(struct myth_running_env *env) {
   freed_fds=myth_flmalloc(env->rank,freed_fds_buf_size);freed_fds_size=0;
   while ((fd_data=myth_io_fd_list_pop(&env->io_struct.close_list))!=NULL){
     hit=1;
+    myth_io_accepted_discard(env,fd_data);
     //Set all the suspended threads ready
     myth_thread_t th;
     while ((op=myth_io_wait_list_pop(env,&fd_data->rd_list))!=NULL){
       th=op->th;
-      assert(op->type==MYTH_IO_ACCEPT || op->type==MYTH_IO_RECV);
+      //A canceller that found op in the list is done with it
+      //once it releases th->lock (see myth_io_wait_cancel)
+      myth_spin_lock_body(&th->lock);
+      myth_spin_unlock_body(&th->lock);
+      assert(myth_io_op_is_read(op));
       int b;
       b=myth_io_execute(op);
       assert(b);
@@ -1181,7 +3003,9 @@ static inline myth_thread_t myth_io_polling(struct myth_running_env *env) {
     myth_io_wait_list_destroy(&fd_data->rd_list);
     while ((op=myth_io_wait_list_pop(env,&fd_data->wr_list))!=NULL){
       th=op->th;
-      assert(op->type==MYTH_IO_CONNECT || op->type==MYTH_IO_SEND);
+      myth_spin_lock_body(&th->lock);
+      myth_spin_unlock_body(&th->lock);
+      assert(!myth_io_op_is_read(op));
       int b;
       b=myth_io_execute(op);
       assert(b);
@@ -1190,6 +3014,9 @@ static inline myth_thread_t myth_io_polling(struct myth_running_env *env) {
       else{myth_queue_push(&env->runnable_q,th);}
     }
     myth_io_wait_list_destroy(&fd_data->wr_list);
+#if MYTH_IO_ZEROCOPY
+    first_runnable=myth_io_zc_close(env,fd_data,first_runnable);
+#endif
     fd_data->closed=1;
     //Since fds can be used in epoll_wait, they are not released here
     freed_fds=myth_flrealloc(env->rank,freed_fds_buf_size,freed_fds,sizeof(myth_io_struct_perfd_t)*(freed_fds_size+1));
@@ -1200,8 +3027,11 @@ static inline myth_thread_t myth_io_polling(struct myth_running_env *env) {
 #if MYTH_IO_PROF_DETAIL
   t2=myth_get_rdtsc();
 #endif
-  //Check I/O readiness
-  ready=epoll_wait(env->io_struct.epfd,events,MYTH_EPOLL_SIZE,0);
+  //Check I/O readiness, unless all workers use io_uring
+  //and none has had a full ring (see myth_io_uring_wait)
+  ready=0;
+  if (g_myth_io_n_epoll_workers)
+    ready=real_epoll_wait(env->io_struct.epfd,events,MYTH_EPOLL_SIZE,0);
 #if MYTH_IO_PROF_DETAIL
   t3=myth_get_rdtsc();
 #endif
@@ -1218,13 +3048,17 @@ static inline myth_thread_t myth_io_polling(struct myth_running_env *env) {
     ef=events[i].events;
     fd_data=events[i].data.ptr;
     if (fd_data->closed)continue;//Ignore closed fds
+#if MYTH_IO_ZEROCOPY
+    //Notifications of MSG_ZEROCOPY
+    if (ef & EPOLLERR)first_runnable=myth_io_zc_wake(env,fd_data,first_runnable);
+#endif
     if (ef & EPOLLRDHUP){
       //Put all the threads waiting for I/O ready
       myth_thread_t th;
       while ((op=myth_io_wait_list_pop(env,&fd_data->rd_list))!=NULL){
 	th=op->th;
 	MAY_BE_UNUSED int b;
-	myth_assert(op->type==MYTH_IO_ACCEPT || op->type==MYTH_IO_RECV);
+	myth_assert(myth_io_op_is_read(op));
 	b=myth_io_execute(op);
 	myth_assert(b);
 	th->env=env;
@@ -1234,7 +3068,7 @@ static inline myth_thread_t myth_io_polling(struct myth_running_env *env) {
       while ((op=myth_io_wait_list_pop(env,&fd_data->wr_list))!=NULL){
 	th=op->th;
 	MAY_BE_UNUSED int b;
-	myth_assert(op->type==MYTH_IO_CONNECT || op->type==MYTH_IO_SEND);
+	myth_assert(!myth_io_op_is_read(op));
 	b=myth_io_execute(op);
 	myth_assert(b);
 	th->env=env;
@@ -1247,7 +3081,7 @@ static inline myth_thread_t myth_io_polling(struct myth_running_env *env) {
 	myth_thread_t th;
 	while ((op=myth_io_wait_list_pop(env,&fd_data->rd_list))!=NULL){
 	  th=op->th;
-	  myth_assert(op->type==MYTH_IO_ACCEPT || op->type==MYTH_IO_RECV);
+	  myth_assert(myth_io_op_is_read(op));
 	  //Try again and put into the runqueue if succeeded
 	  if (myth_io_execute(op)){
 	    th->env=env;
@@ -1264,7 +3098,7 @@ static inline myth_thread_t myth_io_polling(struct myth_running_env *env) {
 	myth_thread_t th;
 	while ((op=myth_io_wait_list_pop(env,&fd_data->wr_list))!=NULL){
 	  th=op->th;
-	  myth_assert(op->type==MYTH_IO_CONNECT || op->type==MYTH_IO_SEND);
+	  myth_assert(!myth_io_op_is_read(op));
 	  //Try again and put into the runqueue if succeeded
 	  if (myth_io_execute(op)){
 	    th->env=env;
@@ -1279,6 +3113,8 @@ static inline myth_thread_t myth_io_polling(struct myth_running_env *env) {
       }
     }
   }
+  //Threads in poll, select and epoll_wait
+  first_runnable=myth_io_poll_wake(env,first_runnable,0);
   for (i=0;i<freed_fds_size;i++){
     myth_flfree(env->rank,sizeof(myth_io_struct_perfd),freed_fds[i]);
   }
@@ -1304,6 +3140,47 @@ static inline myth_thread_t myth_io_polling(struct myth_running_env *env) {
   return first_runnable;
 }
 
+//Called between threads while NEXT is ready to run. Checks I/O if the
+//worker has switched g_myth_io_poll_switches times or g_myth_io_poll_ticks
+//cycles have passed since it last did, and returns the thread to run.
+//the threads found run before those in the runqueue, or after them
+//if g_myth_io_poll_prio is 0
+static inline myth_thread_t myth_io_polling_between(struct myth_running_env *env,myth_thread_t next) {
+  myth_io_struct_perenv_t io=&env->io_struct;
+  myth_thread_queue_t q=&env->runnable_q;
+  myth_thread_t th;
+  uint64_t now=0;
+  int top;
+  if (!(g_myth_io_poll_switches && ++io->poll_switches>=g_myth_io_poll_switches)){
+    if (!g_myth_io_poll_ticks)return next;
+    now=myth_get_rdtsc();
+    if (now<io->poll_next)return next;
+  }
+  io->poll_switches=0;
+  if (g_myth_io_poll_ticks)
+    io->poll_next=(now?now:myth_get_rdtsc())+g_myth_io_poll_ticks;
+  top=q->top;
+  th=myth_io_polling(env);
+  if (!th)return next;
+  if (!next)return th;
+  if (g_myth_io_poll_prio){
+    myth_queue_push(q,next);
+    return th;
+  }
+#if MYTH_QUEUE_LIFO
+  {
+    //Others were pushed above TOP; move them all to the bottom
+    int n=q->top-top;
+    myth_queue_put(q,th);
+    while (n-->0 && (th=myth_queue_pop(q))!=NULL)myth_queue_put(q,th);
+  }
+#else
+  (void)top;
+  myth_queue_push(q,th);
+#endif
+  return next;
+}
+
 static inline myth_thread_t myth_io_polling_sig(struct myth_running_env *env) {
   MAY_BE_UNUSED uint64_t t0,t1,t2,t3;
   int i;
@@ -1322,12 +3199,16 @@ static inline myth_thread_t myth_io_polling_sig(struct myth_running_env *env) {
   t0=myth_get_rdtsc();
 #endif
 #if MYTH_ONE_IO_WORKER
-  if (env->rank!=0)return NULL;
+  if (env->rank!=0){
+    first_runnable=myth_io_poll_wake(env,first_runnable,0);
+    myth_io_cs_exit(env);
+    return first_runnable;
+  }
 #endif
 #if MYTH_IO_PROF_DETAIL
   t2=myth_get_rdtsc();
 #endif
-  ready=epoll_wait(env->io_struct.epfd,events,MYTH_EPOLL_SIZE,0);
+  ready=real_epoll_wait(env->io_struct.epfd,events,MYTH_EPOLL_SIZE,0);
 #if MYTH_IO_PROF_DETAIL
   t3=myth_get_rdtsc();
 #endif
@@ -1344,12 +3225,15 @@ static inline myth_thread_t myth_io_polling_sig(struct myth_running_env *env) {
     ef=events[i].events;
     fd_data=events[i].data.ptr;
     if (fd_data->closed)continue;
+#if MYTH_IO_ZEROCOPY
+    if (ef & EPOLLERR)first_runnable=myth_io_zc_wake(env,fd_data,first_runnable);
+#endif
     if (ef & EPOLLRDHUP){
       myth_thread_t th;
       while ((op=myth_io_wait_list_pop(env,&fd_data->rd_list))!=NULL){
 	th=op->th;
 	MAY_BE_UNUSED int b;
-	myth_assert(op->type==MYTH_IO_ACCEPT || op->type==MYTH_IO_RECV);
+	myth_assert(myth_io_op_is_read(op));
 	b=myth_io_execute(op);
 	myth_assert(b);
 	th->env=env;
@@ -1359,7 +3243,7 @@ static inline myth_thread_t myth_io_polling_sig(struct myth_running_env *env) {
       while ((op=myth_io_wait_list_pop(env,&fd_data->wr_list))!=NULL){
 	th=op->th;
 	MAY_BE_UNUSED int b;
-	myth_assert(op->type==MYTH_IO_CONNECT || op->type==MYTH_IO_SEND);
+	myth_assert(!myth_io_op_is_read(op));
 	b=myth_io_execute(op);
 	myth_assert(b);
 	th->env=env;
@@ -1372,7 +3256,7 @@ static inline myth_thread_t myth_io_polling_sig(struct myth_running_env *env) {
 	myth_thread_t th;
 	while ((op=myth_io_wait_list_pop(env,&fd_data->rd_list))!=NULL){
 	  th=op->th;
-	  myth_assert(op->type==MYTH_IO_ACCEPT || op->type==MYTH_IO_RECV);
+	  myth_assert(myth_io_op_is_read(op));
 	  if (myth_io_execute(op)){
 	    th->env=env;
 	    if (!first_runnable){first_runnable=th;}
@@ -1388,7 +3272,7 @@ static inline myth_thread_t myth_io_polling_sig(struct myth_running_env *env) {
 	myth_thread_t th;
 	while ((op=myth_io_wait_list_pop(env,&fd_data->wr_list))!=NULL){
 	  th=op->th;
-	  myth_assert(op->type==MYTH_IO_CONNECT || op->type==MYTH_IO_SEND);
+	  myth_assert(!myth_io_op_is_read(op));
 	  if (myth_io_execute(op)){
 	    th->env=env;
 	    if (!first_runnable){first_runnable=th;}
@@ -1419,6 +3303,8 @@ static inline myth_thread_t myth_io_polling_sig(struct myth_running_env *env) {
     }
   }
 #endif
+  //Threads in poll, select and epoll_wait
+  first_runnable=myth_io_poll_wake(env,first_runnable,0);
   myth_io_cs_exit(env);
   return first_runnable;
 }
@@ -1452,7 +3338,7 @@ static void myth_io_sighandler(int signum,siginfo_t *sinfo,void* ctx) {
       //lookup data from fd
       while ((op=myth_io_wait_list_pop(env,&fd_data->rd_list))!=NULL){
 	th=op->th;
-	myth_assert(op->type==MYTH_IO_ACCEPT || op->type==MYTH_IO_RECV);
+	myth_assert(myth_io_op_is_read(op));
 	if (myth_io_execute(op)){
 	  th->env=env;
 	  {myth_queue_push(&env->runnable_q,th);}
@@ -1466,7 +3352,7 @@ static void myth_io_sighandler(int signum,siginfo_t *sinfo,void* ctx) {
     case POLL_OUT:
       while ((op=myth_io_wait_list_pop(env,&fd_data->wr_list))!=NULL){
 	th=op->th;
-	myth_assert(op->type==MYTH_IO_CONNECT || op->type==MYTH_IO_SEND);
+	myth_assert(!myth_io_op_is_read(op));
 	if (myth_io_execute(op)){
 	  th->env=env;
 	  {myth_queue_push(&env->runnable_q,th);}
@@ -1507,7 +3393,12 @@ static inline myth_thread_t myth_io_polling_thread(struct myth_running_env *env)
   t0=myth_get_rdtsc();
 #endif
 #if MYTH_ONE_IO_WORKER
-  if (env->rank!=0)return NULL;
+  if (env->rank!=0){
+    first_runnable=myth_io_poll_wake(env,NULL,1);
+    if (first_runnable)myth_io_pass(env,first_runnable);
+    myth_io_cs_exit(env);
+    return NULL;
+  }
 #endif
   while ((op=myth_io_wait_list_pop(env,&env->io_struct.rd_reserve_list))!=NULL){
     hit=1;
@@ -1516,7 +3407,7 @@ static inline myth_thread_t myth_io_polling_thread(struct myth_running_env *env)
       th=op->th;
       th->env=env;
       if (!first_runnable){first_runnable=th;}
-      else{myth_queue_push(&env->runnable_q,th);}
+      else{myth_io_pass(env,th);}
     }
     else{
       myth_io_wait_list_push(env,op->wl_ptr,op);
@@ -1529,7 +3420,7 @@ static inline myth_thread_t myth_io_polling_thread(struct myth_running_env *env)
       th=op->th;
       th->env=env;
       if (!first_runnable){first_runnable=th;}
-      else{myth_queue_push(&env->runnable_q,th);}
+      else{myth_io_pass(env,th);}
     }
     else{
       myth_io_wait_list_push(env,op->wl_ptr,op);
@@ -1541,7 +3432,7 @@ static inline myth_thread_t myth_io_polling_thread(struct myth_running_env *env)
 #endif
   //wait by epoll
   myth_io_cs_exit(env);
-  ready = epoll_wait(env->io_struct.epfd, events, MYTH_EPOLL_SIZE, MYTH_IO_THREAD_PERIOD);
+  ready = real_epoll_wait(env->io_struct.epfd, events, MYTH_EPOLL_SIZE, MYTH_IO_THREAD_PERIOD);
   myth_io_cs_enter(env);
 #if MYTH_IO_PROF_DETAIL
   t3=myth_get_rdtsc();
@@ -1559,27 +3450,30 @@ static inline myth_thread_t myth_io_polling_thread(struct myth_running_env *env)
     ef=events[i].events;
     fd_data=events[i].data.ptr;
     if (fd_data->closed)continue;
+#if MYTH_IO_ZEROCOPY
+    if (ef & EPOLLERR)first_runnable=myth_io_zc_wake(env,fd_data,first_runnable);
+#endif
     if (ef & EPOLLRDHUP){
       myth_thread_t th;
       while ((op=myth_io_wait_list_pop(env,&fd_data->rd_list))!=NULL){
 	th=op->th;
 	int b;
-	myth_assert(op->type==MYTH_IO_ACCEPT || op->type==MYTH_IO_RECV);
+	myth_assert(myth_io_op_is_read(op));
 	b=myth_io_execute(op);
 	myth_assert(b);
 	th->env=env;
 	if (!first_runnable){first_runnable=th;}
-	else{myth_queue_push(&env->runnable_q,th);}
+	else{myth_io_pass(env,th);}
       }
       while ((op=myth_io_wait_list_pop(env,&fd_data->wr_list))!=NULL){
 	th=op->th;
 	int b;
-	myth_assert(op->type==MYTH_IO_CONNECT || op->type==MYTH_IO_SEND);
+	myth_assert(!myth_io_op_is_read(op));
 	b=myth_io_execute(op);
 	myth_assert(b);
 	th->env=env;
 	if (!first_runnable){first_runnable=th;}
-	else{myth_queue_push(&env->runnable_q,th);}
+	else{myth_io_pass(env,th);}
       }
     }
     else{
@@ -1587,11 +3481,11 @@ static inline myth_thread_t myth_io_polling_thread(struct myth_running_env *env)
 	myth_thread_t th;
 	while ((op=myth_io_wait_list_pop(env,&fd_data->rd_list))!=NULL){
 	  th=op->th;
-	  myth_assert(op->type==MYTH_IO_ACCEPT || op->type==MYTH_IO_RECV);
+	  myth_assert(myth_io_op_is_read(op));
 	  if (myth_io_execute(op)){
 	    th->env=env;
 	    if (!first_runnable){first_runnable=th;}
-	    else{myth_queue_push(&env->runnable_q,th);}
+	    else{myth_io_pass(env,th);}
 	  }
 	  else{
 	    myth_io_wait_list_push(env,&fd_data->rd_list,op);
@@ -1603,11 +3497,11 @@ static inline myth_thread_t myth_io_polling_thread(struct myth_running_env *env)
 	myth_thread_t th;
 	while ((op=myth_io_wait_list_pop(env,&fd_data->wr_list))!=NULL){
 	  th=op->th;
-	  myth_assert(op->type==MYTH_IO_CONNECT || op->type==MYTH_IO_SEND);
+	  myth_assert(!myth_io_op_is_read(op));
 	  if (myth_io_execute(op)){
 	    th->env=env;
 	    if (!first_runnable){first_runnable=th;}
-	    else{myth_queue_push(&env->runnable_q,th);}
+	    else{myth_io_pass(env,th);}
 	  }
 	  else{
 	    myth_io_wait_list_push(env,&fd_data->wr_list,op);
@@ -1634,7 +3528,10 @@ static inline myth_thread_t myth_io_polling_thread(struct myth_running_env *env)
     }
   }
 #endif
-  myth_queue_push(&env->runnable_q,first_runnable);
+  //Threads in poll, select and epoll_wait
+  first_runnable=myth_io_poll_wake(env,first_runnable,1);
+  //This is not the worker owning the runqueue
+  if (first_runnable)myth_io_pass(env,first_runnable);
   myth_io_cs_exit(env);
   return NULL;
 }
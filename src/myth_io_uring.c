@@ -0,0 +1,173 @@
+/*
+ * myth_io_uring.c
+ */
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "myth_config.h"
+#include "myth_init.h"
+#include "myth_io_uring.h"
+#include "myth_misc.h"
+#include "myth_real.h"
+
+#include "myth_init_func.h"
+#include "myth_misc_func.h"
+
+#if MYTH_IO_URING_AVAILABLE
+/* operations the I/O layer submits for sockets and for files;
+   all of them appeared in 5.6 */
+static const int myth_io_uring_socket_ops[] = {
+  IORING_OP_POLL_ADD, IORING_OP_ACCEPT, IORING_OP_SEND, IORING_OP_RECV,
+  IORING_OP_SENDMSG, IORING_OP_RECVMSG,
+};
+static const int myth_io_uring_file_ops[] = {
+  IORING_OP_READ, IORING_OP_WRITE, IORING_OP_FSYNC, IORING_OP_OPENAT,
+  IORING_OP_READV, IORING_OP_WRITEV,
+};
+
+//Return 1 if PROBE says all the N operations in OPS are supported
+static int myth_io_uring_supports(struct io_uring_probe * probe,
+				  const int * ops, int n) {
+  int i;
+  for (i = 0; i < n; i++) {
+    if (ops[i] > probe->last_op
+	|| !(probe->ops[ops[i]].flags & IO_URING_OP_SUPPORTED)) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+/* return 1 if the kernel behind RING_FD supports the socket
+   operations, and set *FILE_OPS to 1 if it supports the file
+   operations as well */
+static int myth_io_uring_probe(int ring_fd, int * file_ops) {
+  const int n_ops = 256;
+  size_t sz = sizeof(struct io_uring_probe) + n_ops * sizeof(struct io_uring_probe_op);
+  struct io_uring_probe * probe = myth_malloc(sz);
+  int ok = 0;
+  memset(probe, 0, sz);
+  *file_ops = 0;
+  if (syscall(SYS_io_uring_register, ring_fd, IORING_REGISTER_PROBE,
+	      probe, n_ops) >= 0) {
+    ok = myth_io_uring_supports(probe, myth_io_uring_socket_ops,
+				sizeof(myth_io_uring_socket_ops) / sizeof(int));
+    *file_ops = myth_io_uring_supports(probe, myth_io_uring_file_ops,
+				       sizeof(myth_io_uring_file_ops) / sizeof(int));
+  }
+  myth_free_with_size(probe, sz);
+  return ok;
+}
+#endif	/* MYTH_IO_URING_AVAILABLE */
+
+/* set up an io_uring with ENTRIES submission queue entries.
+   return 0 on success. otherwise return -1 and leave
+   ring->fd -1, so that the caller uses epoll instead */
+int myth_io_uring_init(myth_io_uring_t ring, unsigned entries) {
+  memset(ring, 0, sizeof(*ring));
+  ring->fd = -1;
+#if MYTH_IO_URING_AVAILABLE
+  char * env = getenv(ENV_MYTH_IO_URING);
+  struct io_uring_params p;
+  char * sq;
+  char * cq;
+  int fd;
+  int file_ops;
+  if (env && atoi(env) == 0) return -1;
+  memset(&p, 0, sizeof(p));
+  /* ENOSYS, or EPERM under seccomp or kernel.io_uring_disabled */
+  fd = syscall(SYS_io_uring_setup, entries, &p);
+  if (fd < 0) return -1;
+  /* we let completions overflow into the kernel rather than
+     bounding the number of threads blocked at a time */
+  if (!(p.features & IORING_FEAT_NODROP) || !myth_io_uring_probe(fd, &file_ops)) {
+    real_close(fd);
+    return -1;
+  }
+  /* read and write use the file position (offset -1) */
+  if (!(p.features & IORING_FEAT_RW_CUR_POS)) file_ops = 0;
+  ring->sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+  ring->cq_ring_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+  if (p.features & IORING_FEAT_SINGLE_MMAP) {
+    if (ring->cq_ring_size > ring->sq_ring_size) {
+      ring->sq_ring_size = ring->cq_ring_size;
+    }
+    ring->cq_ring_size = ring->sq_ring_size;
+  }
+  sq = mmap(0, ring->sq_ring_size, PROT_READ | PROT_WRITE,
+	    MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+  if (sq == MAP_FAILED) {
+    real_close(fd);
+    return -1;
+  }
+  if (p.features & IORING_FEAT_SINGLE_MMAP) {
+    cq = sq;
+  } else {
+    cq = mmap(0, ring->cq_ring_size, PROT_READ | PROT_WRITE,
+	      MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+    if (cq == MAP_FAILED) {
+      munmap(sq, ring->sq_ring_size);
+      real_close(fd);
+      return -1;
+    }
+  }
+  ring->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+  ring->sqes = mmap(0, ring->sqes_size, PROT_READ | PROT_WRITE,
+		    MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+  if (ring->sqes == MAP_FAILED) {
+    if (cq != sq) munmap(cq, ring->cq_ring_size);
+    munmap(sq, ring->sq_ring_size);
+    real_close(fd);
+    ring->sqes = 0;
+    return -1;
+  }
+  ring->sq_ring = sq;
+  ring->cq_ring = cq;
+  ring->sq_entries = p.sq_entries;
+  ring->sq_mask = *(unsigned *)(sq + p.sq_off.ring_mask);
+  ring->sq_head = (unsigned *)(sq + p.sq_off.head);
+  ring->sq_tail = (unsigned *)(sq + p.sq_off.tail);
+  ring->sq_flags = (unsigned *)(sq + p.sq_off.flags);
+  ring->sq_array = (unsigned *)(sq + p.sq_off.array);
+  ring->cq_mask = *(unsigned *)(cq + p.cq_off.ring_mask);
+  ring->cq_head = (unsigned *)(cq + p.cq_off.head);
+  ring->cq_tail = (unsigned *)(cq + p.cq_off.tail);
+  ring->cqes = cq + p.cq_off.cqes;
+  ring->n_unsubmitted = 0;
+  ring->epoll_fallback = 0;
+  ring->file_ops = file_ops;
+  ring->fd = fd;
+  return 0;
+#else
+  (void)entries;
+  return -1;
+#endif
+}
+
+void myth_io_uring_fini(myth_io_uring_t ring) {
+  if (ring->fd < 0) return;
+  munmap(ring->sqes, ring->sqes_size);
+  if (ring->cq_ring != ring->sq_ring) munmap(ring->cq_ring, ring->cq_ring_size);
+  munmap(ring->sq_ring, ring->sq_ring_size);
+  real_close(ring->fd);
+  ring->fd = -1;
+}
+
+/* pass TO_SUBMIT queued SQEs to the kernel and/or wait for
+   MIN_COMPLETE completions (with IORING_ENTER_GETEVENTS).
+   return the number of SQEs consumed, or -1 with errno set */
+int myth_io_uring_enter(myth_io_uring_t ring, unsigned to_submit,
+			unsigned min_complete, unsigned flags) {
+#if MYTH_IO_URING_AVAILABLE
+  return syscall(SYS_io_uring_enter, ring->fd, to_submit, min_complete,
+		 flags, NULL, 0);
+#else
+  (void)ring; (void)to_submit; (void)min_complete; (void)flags;
+  errno = ENOSYS;
+  return -1;
+#endif
+}
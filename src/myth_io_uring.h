@@ -0,0 +1,67 @@
+/*
+ * myth_io_uring.h
+ */
+#pragma once
+#ifndef MYTH_IO_URING_H_
+#define MYTH_IO_URING_H_
+
+#include <stddef.h>
+
+#include "myth_config.h"
+
+#if MYTH_IO_URING && defined(__linux__) && defined(HAVE_LINUX_IO_URING_H)
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#endif
+
+/* a signal handler or a separate I/O thread would reap the
+   rings concurrently with the worker filling them */
+#if MYTH_IO_URING && defined(__linux__) && defined(HAVE_LINUX_IO_URING_H) \
+  && defined(SYS_io_uring_setup) && defined(SYS_io_uring_enter) \
+  && defined(SYS_io_uring_register) \
+  && !MYTH_USE_SIGIO && !MYTH_USE_SIGHANDLER && !MYTH_USE_IO_THREAD
+#define MYTH_IO_URING_AVAILABLE 1
+#else
+#define MYTH_IO_URING_AVAILABLE 0
+#endif
+
+/*
+   an io_uring instance owned by a single worker, which is the
+   only thread filling its submission queue and reaping its
+   completion queue. we do not depend on liburing; the rings
+   are set up by raw system calls and mapped into our memory.
+
+   fd is -1 when io_uring is not used (not compiled in, not
+   supported by the kernel, or MYTH_IO_URING=0), in which case
+   the I/O layer falls back to epoll for sockets and to helper
+   threads for files.
+ */
+typedef struct myth_io_uring {
+  int fd;
+  int file_ops;			/* 1 if file I/O can be submitted too */
+  unsigned sq_entries;
+  unsigned sq_mask;
+  unsigned cq_mask;
+  unsigned n_unsubmitted;	/* SQEs queued but not yet passed to the kernel */
+  int epoll_fallback;		/* 1 once a thread has waited in epoll as it was full */
+  unsigned * sq_head;
+  unsigned * sq_tail;
+  unsigned * sq_flags;
+  unsigned * sq_array;
+  unsigned * cq_head;
+  unsigned * cq_tail;
+  void * sqes;			/* struct io_uring_sqe[sq_entries] */
+  void * cqes;			/* struct io_uring_cqe[cq_entries] */
+  void * sq_ring;
+  size_t sq_ring_size;
+  void * cq_ring;		/* == sq_ring with IORING_FEAT_SINGLE_MMAP */
+  size_t cq_ring_size;
+  size_t sqes_size;
+} myth_io_uring, *myth_io_uring_t;
+
+int  myth_io_uring_init(myth_io_uring_t ring, unsigned entries);
+void myth_io_uring_fini(myth_io_uring_t ring);
+int  myth_io_uring_enter(myth_io_uring_t ring, unsigned to_submit,
+			 unsigned min_complete, unsigned flags);
+
+#endif	/* MYTH_IO_URING_H_ */
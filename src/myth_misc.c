@@ -2,16 +2,12 @@
  * myth_misc.c
  */
 #include <ctype.h>
+#include <errno.h>
 
 #include "myth_config.h"
 #include "myth_misc.h"
 #include "myth_misc_func.h"
-
-#if MYTH_FLMALLOC_TLS
-__thread myth_freelist_t *g_myth_freelist;
-#else
-myth_freelist_t **g_myth_freelist;
-#endif
+#include "myth_spinlock_func.h"
 
 //Global variabled declaration
 
@@ -19,7 +15,238 @@ myth_freelist_t **g_myth_freelist;
 
 __thread unsigned int g_myth_random_temp = 0;
 
-__thread uint64_t g_myth_flmalloc_cycles = 0, g_myth_flmalloc_cnt = 0;
-__thread uint64_t g_myth_flfree_cycles = 0, g_myth_flfree_cnt = 0;
+#if USE_MYTH_FLMALLOC
+myth_flmalloc_worker_t ** g_myth_flmalloc;
+myth_freelist_t ** g_myth_flremote;
+
+//Blocks spilled from full per-worker caches, one per size class
+typedef struct myth_flpool {
+  myth_spinlock_t lock;
+  myth_freelist_t fl;
+  long n;
+} __attribute__((aligned(CACHE_LINE_SIZE))) myth_flpool_t;
+
+static myth_flpool_t g_myth_flpool[FREE_LIST_NUM];
+static int g_myth_flmalloc_n_workers;
+
+/* address range slabs are carved from, once myth_flarena_init
+   has succeeded. it is never released, as the application may
+   still hold (and free) blocks in it after myth_fini */
+uintptr_t g_myth_flarena_begin = 0;
+uintptr_t g_myth_flarena_size = 0;
+static uintptr_t g_myth_flarena_next = 0;
+
+int myth_flarena_init(size_t size) {
+  size_t sz = MYTH_FL_SLAB_SIZE;
+  int flags = MAP_PRIVATE|MYTH_MAP_ANON;
+  char * p;
+  if (g_myth_flarena_begin) return 0;
+#if defined(MAP_NORESERVE)
+  flags |= MAP_NORESERVE;
+#endif
+  //Just reserve address space; pages are allocated as slabs are touched
+  p = mmap(NULL, size + sz, PROT_READ|PROT_WRITE, flags, -1, 0);
+  if (p == MAP_FAILED) return -1;
+  g_myth_flarena_next = ((uintptr_t)p + sz - 1) & ~((uintptr_t)sz - 1);
+  g_myth_flarena_size = size;
+  g_myth_flarena_begin = g_myth_flarena_next;
+  return 0;
+}
+
+//Take a slab from the arena, or return null if there is none left
+static char * myth_flarena_slab_new(void) {
+  uintptr_t a;
+  if (!g_myth_flarena_begin) return 0;
+  if (g_myth_flarena_next - g_myth_flarena_begin >= g_myth_flarena_size) return 0;
+  a = __sync_fetch_and_add(&g_myth_flarena_next, (uintptr_t)MYTH_FL_SLAB_SIZE);
+  if (a - g_myth_flarena_begin >= g_myth_flarena_size) return 0;
+  return (char *)a;
+}
+
+void myth_flmalloc_init(int nthreads) {
+  int i;
+  g_myth_flmalloc = myth_malloc(sizeof(myth_flmalloc_worker_t *) * nthreads);
+  g_myth_flremote = myth_malloc(sizeof(myth_freelist_t *) * nthreads);
+  memset(g_myth_flmalloc, 0, sizeof(myth_flmalloc_worker_t *) * nthreads);
+  memset(g_myth_flremote, 0, sizeof(myth_freelist_t *) * nthreads);
+  g_myth_flmalloc_n_workers = nthreads;
+  /* blocks left from a previous myth_init may refer to
+     owners that no longer exist; just forget them */
+  for (i = 0; i < FREE_LIST_NUM; i++) {
+    myth_spin_init_body(&g_myth_flpool[i].lock);
+    myth_freelist_init(&g_myth_flpool[i].fl);
+    g_myth_flpool[i].n = 0;
+  }
+}
+
+void myth_flmalloc_init_worker(int rank) {
+  int i;
+  myth_flmalloc_worker_t * w = myth_malloc(sizeof(myth_flmalloc_worker_t));
+  myth_freelist_t * remote = myth_malloc(sizeof(myth_freelist_t) * FREE_LIST_NUM);
+  memset(w, 0, sizeof(myth_flmalloc_worker_t));
+  for (i = 0; i < FREE_LIST_NUM; i++) {
+    myth_freelist_init(&remote[i]);
+  }
+  g_myth_flremote[rank] = remote;
+  g_myth_flmalloc[rank] = w;
+}
+
+/* other workers may still return blocks to us while they
+   clean up, so per-worker data are released in myth_flmalloc_fini */
+void myth_flmalloc_fini_worker(int rank) {
+  (void)rank;
+}
+
+//Unmap the blocks of a list of class idx, which are not from slabs
+static void myth_flunmap_list(myth_freelist_cell_t * h, int idx) {
+  size_t rsize = MYTH_MALLOC_INDEX_TO_RSIZE(idx);
+  myth_freelist_cell_t * t;
+  rsize = (rsize + PAGE_SIZE - 1) & ~((size_t)PAGE_SIZE - 1);
+  for (; h; h = t) {
+    t = h->next;
+    myth_munmap(h, rsize);
+  }
+}
+
+/* blocks still in use (by threads nobody joined) go away with their
+   slabs; those of the arena are kept, as the application may hold
+   them (see myth_flarena_init) */
+void myth_flmalloc_fini(void) {
+  int i, j;
+  myth_flslab_t * s, * next;
+  for (i = 0; i < g_myth_flmalloc_n_workers; i++) {
+    myth_flmalloc_worker_t * w = g_myth_flmalloc[i];
+    if (!w) continue;
+    for (s = w->slabs; s; s = next) {
+      next = s->next;
+      myth_munmap(s, MYTH_FL_SLAB_SIZE);
+    }
+    for (j = 0; j < FREE_LIST_NUM; j++) {
+      if (MYTH_MALLOC_INDEX_TO_RSIZE(j) > MYTH_FL_SLAB_BLOCK_MAX) {
+	myth_flunmap_list(w->cache[j].fl.head, j);
+      }
+    }
+  }
+  for (j = 0; j < FREE_LIST_NUM; j++) {
+    if (MYTH_MALLOC_INDEX_TO_RSIZE(j) > MYTH_FL_SLAB_BLOCK_MAX) {
+      myth_flunmap_list(g_myth_flpool[j].fl.head, j);
+    }
+    myth_freelist_init(&g_myth_flpool[j].fl);
+    g_myth_flpool[j].n = 0;
+  }
+  for (i = 0; i < g_myth_flmalloc_n_workers; i++) {
+    if (g_myth_flmalloc[i]) myth_free(g_myth_flmalloc[i]);
+    if (g_myth_flremote[i]) myth_free(g_myth_flremote[i]);
+  }
+  myth_free(g_myth_flmalloc);
+  myth_free(g_myth_flremote);
+  g_myth_flmalloc = 0;
+  g_myth_flremote = 0;
+  g_myth_flmalloc_n_workers = 0;
+}
+
+//Carve a new slab of class idx owned by rank.
+//Return one block and put the rest into the cache
+static void * myth_flslab_new(myth_flmalloc_worker_t * w, int rank, int idx) {
+  myth_flcache_t * c = &w->cache[idx];
+  size_t rsize = MYTH_MALLOC_INDEX_TO_RSIZE(idx);
+  size_t sz = MYTH_FL_SLAB_SIZE;
+  char * a = myth_flarena_slab_new();
+  if (!a) {
+    //Map twice as much and trim it to an aligned slab
+    char * p = myth_mmap(NULL, sz * 2, PROT_READ|PROT_WRITE,
+			 MAP_PRIVATE|MYTH_MAP_ANON, -1, 0);
+    a = (char *)(((uintptr_t)p + sz - 1) & ~((uintptr_t)sz - 1));
+    if (a > p) myth_munmap(p, a - p);
+    if (a + sz < p + sz * 2) myth_munmap(a + sz, (p + sz * 2) - (a + sz));
+  }
+  myth_flslab_t * slab = (myth_flslab_t *)a;
+  slab->owner = rank;
+  slab->idx = idx;
+  if (myth_flarena_contains(a)) {
+    slab->next = 0;
+  } else {
+    slab->next = w->slabs;
+    w->slabs = slab;
+  }
+  w->stats.n_maps++;
+  w->stats.mapped_bytes += sz;
+  //The first block holds the header
+  char * ret = a + rsize;
+  char * b;
+  for (b = ret + rsize; b + rsize <= a + sz; b += rsize) {
+    myth_freelist_push(&c->fl, b);
+    c->n++;
+  }
+  return ret;
+}
 
+//Slow path of myth_flmalloc, called when the cache of class idx is empty
+void * myth_flmalloc_refill(int rank, int idx) {
+  myth_flmalloc_worker_t * w = g_myth_flmalloc[rank];
+  myth_flcache_t * c = &w->cache[idx];
+  myth_flpool_t * pool = &g_myth_flpool[idx];
+  myth_freelist_cell_t * h, * t;
+  long n;
+  //Blocks other workers returned to us
+  h = myth_freelist_take_all(&g_myth_flremote[rank][idx]);
+  if (h) {
+    n = 0;
+    for (t = h->next; t; t = t->next) n++;
+    c->fl.head = h->next;
+    c->n = n;
+    return h;
+  }
+  //Blocks in the global pool
+  if (pool->n > 0) {
+    long want = (myth_flcache_cap(idx) + 1) / 2;
+    myth_spin_lock_body(&pool->lock);
+    h = pool->fl.head;
+    if (h) {
+      n = 1;
+      for (t = h; t->next && n < want; t = t->next) n++;
+      pool->fl.head = t->next;
+      pool->n -= n;
+      t->next = 0;
+    }
+    myth_spin_unlock_body(&pool->lock);
+    if (h) {
+      w->stats.n_refills += n;
+      c->fl.head = h->next;
+      c->n = n - 1;
+      return h;
+    }
+  }
+  //Fresh memory
+  size_t rsize = MYTH_MALLOC_INDEX_TO_RSIZE(idx);
+  if (rsize <= MYTH_FL_SLAB_BLOCK_MAX) {
+    return myth_flslab_new(w, rank, idx);
+  }
+  rsize = (rsize + PAGE_SIZE - 1) & ~((size_t)PAGE_SIZE - 1);
+  w->stats.n_maps++;
+  w->stats.mapped_bytes += rsize;
+  return myth_mmap(NULL, rsize, PROT_READ|PROT_WRITE,
+		   MAP_PRIVATE|MYTH_MAP_ANON, -1, 0);
+}
 
+//Move blocks of class idx beyond half the cache capacity to the global pool
+void myth_flcache_spill(int rank, int idx) {
+  myth_flmalloc_worker_t * w = g_myth_flmalloc[rank];
+  myth_flcache_t * c = &w->cache[idx];
+  myth_flpool_t * pool = &g_myth_flpool[idx];
+  long keep = myth_flcache_cap(idx) / 2;
+  long n = c->n - keep;
+  long i;
+  myth_freelist_cell_t * h = c->fl.head, * t = h;
+  myth_assert(n > 0);
+  for (i = 1; i < n; i++) t = t->next;
+  c->fl.head = t->next;
+  c->n = keep;
+  myth_spin_lock_body(&pool->lock);
+  t->next = pool->fl.head;
+  pool->fl.head = h;
+  pool->n += n;
+  myth_spin_unlock_body(&pool->lock);
+  w->stats.n_spills += n;
+}
+#endif	/* USE_MYTH_FLMALLOC */
@@ -15,6 +15,7 @@
 #include <sys/mman.h>
 #include <sched.h>
 
+#include "myth/myth.h"
 #include "myth_config.h"
 
 //Variable attribute which may be unused to supress warnings
@@ -66,6 +67,33 @@ typedef struct {
 static inline void myth_freelist_init(myth_freelist_t * fl);
 static inline void myth_freelist_push(myth_freelist_t * fl, void * h_);
 static inline void * myth_freelist_pop(myth_freelist_t * fl);
+static inline void myth_freelist_push_atomic(myth_freelist_t * fl, void * h_);
+static inline myth_freelist_cell_t * myth_freelist_take_all(myth_freelist_t * fl);
+static inline void * myth_freelist_pop_with_remote(myth_freelist_t * fl,
+						   myth_freelist_t * remote);
+
+//Number of size classes of myth_flmalloc (16 bytes to 1GB)
+#define FREE_LIST_NUM 100
+
+//A per-worker cache of free blocks of one size class
+typedef struct myth_flcache {
+  myth_freelist_t fl;
+  long n;			/* number of blocks in fl */
+} myth_flcache_t;
+
+//Header at the beginning of each slab of small blocks
+typedef struct myth_flslab {
+  int owner;			/* rank of the worker that carved it */
+  int idx;			/* size class */
+  struct myth_flslab * next;	/* next one its owner mapped */
+} myth_flslab_t;
+
+typedef struct myth_flmalloc_worker {
+  myth_flcache_t cache[FREE_LIST_NUM];
+  myth_alloc_stats_t stats;
+  //Slabs mapped outside the arena, unmapped in myth_flmalloc_fini
+  myth_flslab_t * slabs;
+} myth_flmalloc_worker_t;
 
 static inline void * myth_malloc(size_t size);
 static inline void myth_free_with_size(void *ptr,size_t size);
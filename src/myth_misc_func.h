@@ -5,6 +5,7 @@
 #ifndef MYTH_MISC_FUNC_H_
 #define MYTH_MISC_FUNC_H_
 
+#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -62,6 +63,30 @@ static inline int hr_gettime(struct timespec * ts) {
 #endif
 }
 
+static inline void myth_timespec_add(const struct timespec * a,
+				     const struct timespec * b,
+				     struct timespec * c) {
+  long ns = a->tv_nsec + b->tv_nsec;
+  c->tv_nsec = ns % 1000000000;
+  c->tv_sec = a->tv_sec + b->tv_sec + ns / 1000000000;
+}
+
+//c = a - b, where a is not earlier than b
+static inline void myth_timespec_sub(const struct timespec * a,
+				     const struct timespec * b,
+				     struct timespec * c) {
+  long ns = a->tv_nsec - b->tv_nsec;
+  c->tv_sec = a->tv_sec - b->tv_sec - (ns < 0);
+  c->tv_nsec = (ns < 0 ? ns + 1000000000 : ns);
+}
+
+static inline int myth_timespec_gt(const struct timespec * a,
+				   const struct timespec * b) {
+  if (a->tv_sec > b->tv_sec) return 1;
+  if (a->tv_sec == b->tv_sec) return a->tv_nsec > b->tv_nsec;
+  return 0;
+}
+
 //Worker-thread-safe RNG for randomized work-stealing
 extern __thread unsigned int g_myth_random_temp;
 static inline void myth_random_init(unsigned int seed) {
@@ -97,89 +122,37 @@ static inline void * myth_freelist_pop(myth_freelist_t * fl) {
   }
 }
 
-#if MYTH_FLMALLOC_PROF
-extern __thread uint64_t g_myth_flmalloc_cycles,g_myth_flmalloc_cnt;
-extern __thread uint64_t g_myth_flfree_cycles,g_myth_flfree_cnt;
-#endif
-
-//Internal simple memory allocator using worker-thread-local freelist
-//Each entry is a linked-list of 1,2,4,8,...2^(FREE_LIST_NUM-1) bytes
-//All alloc/free is done with this granularity
-#define FREE_LIST_NUM 31
-
-#if SIZEOF_INT==4
-//size_t=uin32_t
-#define MYTH_MALLOC_SIZE_TO_INDEX(s) (32-__builtin_clz((s)-1))
-#elif SIZEOF_INT==8
-//size_t=uint64_t
-#define MYTH_MALLOC_SIZE_TO_INDEX(s) (64-__builtin_clz((s)-1))
-#else
-#error
-#endif
-#define MYTH_MALLOC_INDEX_TO_RSIZE(s) (1<<(s))
-#define MYTH_MALLOC_SIZE_TO_RSIZE(s) (MYTH_MALLOC_INDEX_TO_RSIZE(MYTH_MALLOC_SIZE_TO_INDEX(s)))
-
-#define MYTH_MALLOC_FLSIZE_MAX (MYTH_MALLOC_INDEX_TO_RSIZE(FREE_LIST_NUM-1)-1)
-
-#if USE_MYTH_FLMALLOC
-
-#if MYTH_FLMALLOC_TLS
-extern __thread myth_freelist_t *g_myth_freelist;
-#else
-extern myth_freelist_t **g_myth_freelist;
-#endif
-
-static inline void myth_flmalloc_init(int nthreads) {
-#if !MYTH_FLMALLOC_TLS
-  g_myth_freelist = myth_malloc(sizeof(myth_freelist_t*)*nthreads);
-#endif
-}
-
-static inline void myth_flmalloc_init_worker(int rank) {
-  int i;
-  //Allocate freelists
-#if MYTH_FLMALLOC_TLS
-  g_myth_freelist = myth_malloc(sizeof(myth_freelist_t)*FREE_LIST_NUM);
-  //Initialize
-  for (i=0;i<FREE_LIST_NUM;i++){
-    myth_freelist_init(&g_myth_freelist[i]);
-  }
-#else
-  g_myth_freelist[rank] = myth_malloc(sizeof(myth_freelist_t)*FREE_LIST_NUM);
-  //Initialize
-  for (i=0;i<FREE_LIST_NUM;i++){
-    myth_freelist_init(&g_myth_freelist[rank][i]);
-  }
-#endif
+//Push onto a freelist owned by another worker.
+//Any worker may push concurrently, but only the owner pops,
+//and it always detaches the whole list at once (so no ABA)
+static inline void myth_freelist_push_atomic(myth_freelist_t * fl, void * h_) {
+  myth_freelist_cell_t * h = h_;
+  myth_freelist_cell_t * head;
+  do {
+    head = fl->head;
+    h->next = head;
+  } while (!__sync_bool_compare_and_swap(&fl->head, head, h));
 }
 
-extern uint64_t g_mmap_total,g_mmap_count;
-static inline void myth_flmalloc_fini() {
-#if !MYTH_FLMALLOC_TLS
-  myth_free(g_myth_freelist);
-#endif
+//Detach and return everything other workers pushed onto fl
+static inline myth_freelist_cell_t * myth_freelist_take_all(myth_freelist_t * fl) {
+  if (!*(myth_freelist_cell_t * volatile *)&fl->head) return 0;
+  return __sync_lock_test_and_set(&fl->head, 0);
 }
 
-static inline void myth_flmalloc_fini_worker(int rank) {
-  //Release freelist contents
-  /*for (i=0;i<FREE_LIST_NUM;i++){
-    void **ptr=g_myth_freelist[i];
-
-    }*/
-  //Release the array
-#if MYTH_FLMALLOC_TLS
-  myth_free(g_myth_freelist);
-#else
-  myth_free(g_myth_freelist[rank]);
-#endif
-#if MYTH_FLMALLOC_PROF
-  fprintf(stderr,"%lu mallocs : %lf cycles/malloc\n",(unsigned long)g_myth_flmalloc_cnt,g_myth_flmalloc_cycles/(double)g_myth_flmalloc_cnt);
-  fprintf(stderr,"%lu frees : %lf cycles/free\n",(unsigned long)g_myth_flfree_cnt,g_myth_flfree_cycles/(double)g_myth_flfree_cnt);
-#endif
+//Pop from fl; when it is empty, move everything other workers
+//pushed onto remote into fl and try again
+static inline void * myth_freelist_pop_with_remote(myth_freelist_t * fl,
+						   myth_freelist_t * remote) {
+  myth_freelist_cell_t * h = fl->head;
+  if (!h) {
+    h = myth_freelist_take_all(remote);
+    if (!h) return 0;
+  }
+  fl->head = h->next;
+  return (void *)h;
 }
 
-//extern __thread int g_worker_rank;
-
 #if defined(MAP_ANONYMOUS)
 #define MYTH_MAP_ANON MAP_ANONYMOUS
 #elif defined(MAP_ANON)
@@ -194,81 +167,113 @@ static inline void myth_flmalloc_fini_worker(int rank) {
 #define MYTH_MAP_STACK 0
 #endif
 
+//Size classes of the internal allocator:
+//multiples of 16 bytes up to 128 bytes, and then four classes
+//per power of two (160, 192, 224, 256, 320, ...), so that
+//rounding up wastes at most 25% of a block
+static inline int myth_malloc_size_to_index(size_t s) {
+  int p;
+  if (s <= 128) return (int)((s + 15) >> 4) - 1;
+  //p = floor(log2(s-1)) >= 7
+  p = (int)(sizeof(unsigned long) * 8) - 1 - __builtin_clzl((unsigned long)(s - 1));
+  return 8 + (p - 7) * 4 + (int)((s - 1) >> (p - 2)) - 4;
+}
+
+static inline size_t myth_malloc_index_to_rsize(int i) {
+  if (i < 8) return (size_t)(i + 1) << 4;
+  i -= 8;
+  return ((size_t)(i % 4 + 5)) << (i / 4 + 5);
+}
+
+#define MYTH_MALLOC_SIZE_TO_INDEX(s) myth_malloc_size_to_index(s)
+#define MYTH_MALLOC_INDEX_TO_RSIZE(i) myth_malloc_index_to_rsize(i)
+#define MYTH_MALLOC_SIZE_TO_RSIZE(s) (MYTH_MALLOC_INDEX_TO_RSIZE(MYTH_MALLOC_SIZE_TO_INDEX(s)))
+
+#define MYTH_MALLOC_FLSIZE_MAX (MYTH_MALLOC_INDEX_TO_RSIZE(FREE_LIST_NUM-1))
+
+#if USE_MYTH_FLMALLOC
+
+/* per-worker caches, indexed by rank; see myth_misc.c */
+extern myth_flmalloc_worker_t ** g_myth_flmalloc;
+/* blocks freed by other workers, indexed by [owner rank][class] */
+extern myth_freelist_t ** g_myth_flremote;
+
+void myth_flmalloc_init(int nthreads);
+void myth_flmalloc_fini(void);
+void myth_flmalloc_init_worker(int rank);
+void myth_flmalloc_fini_worker(int rank);
+void * myth_flmalloc_refill(int rank, int idx);
+void myth_flcache_spill(int rank, int idx);
+
+/* optional arena slabs are carved from (see myth_flarena_init) */
+extern uintptr_t g_myth_flarena_begin;
+extern uintptr_t g_myth_flarena_size;
+int myth_flarena_init(size_t size);
+
+//True if ptr was carved from the arena
+static inline int myth_flarena_contains(void * ptr) {
+  return ((uintptr_t)ptr - g_myth_flarena_begin < g_myth_flarena_size);
+}
+
+/* malloc and friends on top of myth_flmalloc; see myth_wrap_malloc.c */
+void myth_malloc_wrapper_init(int nthreads);
+void myth_malloc_wrapper_fini(void);
+
+//Slab a small block belongs to; its header tells the owner
+static inline myth_flslab_t * myth_flslab_of(void * ptr) {
+  return (myth_flslab_t *)((uintptr_t)ptr & ~((uintptr_t)MYTH_FL_SLAB_SIZE - 1));
+}
 
-static inline void * myth_mmap(void *addr, size_t length, int prot,
-			       int flags, int fd, off_t offset);
+//Number of blocks of class idx a worker keeps before spilling
+static inline long myth_flcache_cap(int idx) {
+  long cap = MYTH_FL_CACHE_BYTES / (long)MYTH_MALLOC_INDEX_TO_RSIZE(idx);
+  return (cap < MYTH_FL_CACHE_MIN ? MYTH_FL_CACHE_MIN : cap);
+}
 
+//Freelist-based internal allocator.
+//rank is the calling worker; blocks may be freed on any worker
 static inline void * myth_flmalloc(int rank, size_t size) {
-  //Freelist-based Internal allocator
-  
-#if MYTH_FLMALLOC_PROF
-  uint64_t t0 = myth_get_rdtsc();
-#endif
-  if (size < 8) size = 8;
+  myth_flmalloc_worker_t * w = g_myth_flmalloc[rank];
+  if (size == 0) size = 1;
   int idx = MYTH_MALLOC_SIZE_TO_INDEX(size);
-#if MYTH_FLMALLOC_TLS
-  void * ptr = myth_freelist_pop(&g_myth_freelist[idx]);
-#else
-  void * ptr = myth_freelist_pop(&g_myth_freelist[rank][idx]);
-#endif
-  if (!ptr){
-    //Freelist is empty, allocate
-    size_t realsize = MYTH_MALLOC_INDEX_TO_RSIZE(idx);
-    if (realsize < PAGE_SIZE) {
-      assert(PAGE_SIZE % realsize == 0);
-      ptr = myth_mmap(NULL, PAGE_SIZE, PROT_READ|PROT_WRITE,
-		      MAP_PRIVATE|MYTH_MAP_ANON, -1, 0);
-      char * p = ptr;
-      char * p2 = p + PAGE_SIZE;
-      p += realsize;
-      while (p < p2){
-#if MYTH_FLMALLOC_TLS
-	myth_freelist_push(&g_myth_freelist[idx], p);
-#else
-	myth_freelist_push(&g_myth_freelist[rank][idx], p);
-#endif
-	p += realsize;
-      }
-    } else {
-      //Just allocate by mmap and return
-      assert(realsize % 4096 == 0);
-      ptr = myth_mmap(NULL, realsize, PROT_READ|PROT_WRITE,
-		      MAP_PRIVATE|MYTH_MAP_ANON, -1, 0);
-    }
-    //ptr=real_malloc(realsize);//fprintf(stderr,"M %lu %s:%d\n",(unsigned long)realsize,f,l);
-    myth_assert(ptr);
+  myth_flcache_t * c = &w->cache[idx];
+  void * ptr = myth_freelist_pop(&c->fl);
+  w->stats.n_allocs++;
+  if (ptr) {
+    c->n--;
+    return ptr;
   }
-#if MYTH_FLMALLOC_PROF
-  uint64_t t1 = myth_get_rdtsc();
-  g_myth_flmalloc_cycles += t1 - t0;
-  g_myth_flmalloc_cnt++;
-#endif
-  return ptr;
+  return myth_flmalloc_refill(rank, idx);
 }
 
 static inline void myth_flfree(int rank, size_t size, void *ptr) {
-  //Put into the freelist
-  int idx;
-#if MYTH_FLMALLOC_PROF
-  uint64_t t0 = myth_get_rdtsc();
-#endif
-  if (size < 8) size = 8;
-  idx = MYTH_MALLOC_SIZE_TO_INDEX(size);
-#if MYTH_FLMALLOC_TLS
-  myth_freelist_push(&g_myth_freelist[idx], ptr);
-#else
-  myth_freelist_push(& g_myth_freelist[rank][idx], ptr);
-#endif
-#if MYTH_FLMALLOC_PROF
-  uint64_t t1=myth_get_rdtsc();
-  g_myth_flfree_cycles += t1 - t0;
-  g_myth_flfree_cnt++;
-#endif
+  myth_flmalloc_worker_t * w = g_myth_flmalloc[rank];
+  if (size == 0) size = 1;
+  int idx = MYTH_MALLOC_SIZE_TO_INDEX(size);
+  w->stats.n_frees++;
+  if (MYTH_MALLOC_INDEX_TO_RSIZE(idx) <= MYTH_FL_SLAB_BLOCK_MAX) {
+    //Return a block of someone else's slab to its owner
+    int owner = myth_flslab_of(ptr)->owner;
+    if (owner != rank) {
+      myth_freelist_push_atomic(&g_myth_flremote[owner][idx], ptr);
+      w->stats.n_remote_frees++;
+      return;
+    }
+  }
+  myth_flcache_t * c = &w->cache[idx];
+  myth_freelist_push(&c->fl, ptr);
+  if (++c->n > myth_flcache_cap(idx)) {
+    myth_flcache_spill(rank, idx);
+  }
 }
 
 static inline void *myth_flrealloc(int rank,size_t oldsize,void *ptr,size_t size) {
   void *ret;
   size_t cp_size;
+  if (MYTH_MALLOC_SIZE_TO_INDEX(size ? size : 1)
+      == MYTH_MALLOC_SIZE_TO_INDEX(oldsize ? oldsize : 1)) {
+    return ptr;
+  }
   ret = myth_flmalloc(rank, size);
   myth_assert(ret);
   cp_size = (size < oldsize) ? size : oldsize;
@@ -287,36 +292,14 @@ static inline void myth_flmalloc_fini(void) {
 }
 
 static inline void myth_flmalloc_fini_worker(int rank) {
-#if MYTH_FLMALLOC_PROF
-  fprintf(stderr,"%lu mallocs : %lf cycles/malloc\n",(unsigned long)g_myth_flmalloc_cnt,g_myth_flmalloc_cycles/(double)g_myth_flmalloc_cnt);
-  fprintf(stderr,"%lu frees : %lf cycles/free\n",(unsigned long)g_myth_flfree_cnt,g_myth_flfree_cycles/(double)g_myth_flfree_cnt);
-#endif
 }
 static inline void *myth_malloc(size_t size);
 static inline void myth_free_with_size(void *ptr,size_t size);
 static inline void* myth_flmalloc(int rank,size_t s) {
-  void *ret;
-#if MYTH_FLMALLOC_PROF
-  uint64_t t0,t1;
-  t0=myth_get_rdtsc();
-#endif
-  ret=myth_malloc(s);
-#if MYTH_FLMALLOC_PROF
-  t1=myth_get_rdtsc();
-  g_myth_flmalloc_cycles+=t1-t0;g_myth_flmalloc_cnt++;
-#endif
-  return ret;
+  return myth_malloc(s);
 }
 static inline void myth_flfree(int rank,size_t size,void *ptr) {
-#if MYTH_FLMALLOC_PROF
-  uint64_t t0,t1;
-  t0=myth_get_rdtsc();
-#endif
-  myth_free(ptr,size);
-#if MYTH_FLMALLOC_PROF
-  t1=myth_get_rdtsc();
-  g_myth_flfree_cycles+=t1-t0;g_myth_flfree_cnt++;
-#endif
+  myth_free_with_size(ptr,size);
 }
 #define myth_flrealloc(rank,os,p,ns) myth_realloc(p,ns)
 #endif
@@ -374,4 +357,21 @@ static inline int myth_munmap(void *addr,size_t length)
 #endif
 }
 
+/* write what snprintf wrote to BUF to FD, and start BUF over.
+   the stats dumps format into a buffer on the stack and write
+   it with this whenever it fills up */
+static inline int myth_dump_flush(int fd, char * buf, int * len) {
+  int i = 0;
+  while (i < *len) {
+    ssize_t w = real_write(fd, buf + i, *len - i);
+    if (w == -1) {
+      if (errno == EINTR) continue;
+      return errno;
+    }
+    i += w;
+  }
+  *len = 0;
+  return 0;
+}
+
 #endif /* MYTH_MISC_H_ */
@@ -0,0 +1,170 @@
+/*
+ * myth_numa.c
+ */
+#include <dirent.h>
+#include <limits.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "myth_config.h"
+#include "myth_init.h"
+#include "myth_bind_worker.h"
+#include "myth_numa.h"
+#include "myth_misc.h"
+
+#include "myth_init_func.h"
+#include "myth_misc_func.h"
+
+#if MYTH_NUMA_AWARE && defined(__linux__)
+#include <sys/syscall.h>
+#endif
+
+#if MYTH_NUMA_AWARE && defined(__linux__) && defined(SYS_mbind) && defined(SYS_set_mempolicy)
+#define MYTH_NUMA_SYSCALLS 1
+#else
+#define MYTH_NUMA_SYSCALLS 0
+#endif
+
+#if defined(CPU_SETSIZE)
+#define N_MAX_CPUS CPU_SETSIZE
+#else
+#define N_MAX_CPUS 1024
+#endif
+
+#define N_MAX_NODES 1024
+#define N_NODE_MASK_BITS (8 * sizeof(unsigned long))
+
+/* values from linux/mempolicy.h, which we do not want to depend on */
+#define MYTH_MPOL_DEFAULT   0
+#define MYTH_MPOL_PREFERRED 1
+#define MYTH_MPOL_MF_MOVE   (1 << 1)
+
+/* worker rank -> node; null when NUMA placement is disabled */
+static int * worker_node = 0;
+
+#if MYTH_NUMA_SYSCALLS
+static int cpu_node[N_MAX_CPUS];
+
+/* read a sysfs cpu list (e.g., "0-3,8-11\n"; ranges are inclusive)
+   and record that those cpus belong to NODE.
+   return the number of cpus found */
+static int myth_numa_read_cpulist(const char * path, int node) {
+  FILE * fp = fopen(path, "r");
+  int n = 0;
+  int a, b, x, c;
+  if (!fp) return 0;
+  while (fscanf(fp, "%d", &a) == 1) {
+    b = a;
+    c = fgetc(fp);
+    if (c == '-') {
+      if (fscanf(fp, "%d", &b) != 1) break;
+      c = fgetc(fp);
+    }
+    for (x = a; x <= b && x < N_MAX_CPUS; x++) {
+      cpu_node[x] = node;
+      n++;
+    }
+    if (c != ',') break;
+  }
+  fclose(fp);
+  return n;
+}
+
+/* fill cpu_node[] and return the number of nodes having cpus */
+static int myth_numa_read_topology(void) {
+  DIR * d = opendir("/sys/devices/system/node");
+  struct dirent * e;
+  int n_nodes = 0;
+  int i;
+  if (!d) return 0;
+  for (i = 0; i < N_MAX_CPUS; i++) cpu_node[i] = -1;
+  while ((e = readdir(d)) != NULL) {
+    char path[sizeof("/sys/devices/system/node//cpulist") + NAME_MAX];
+    int node;
+    if (sscanf(e->d_name, "node%d", &node) != 1) continue;
+    if (node < 0 || node >= N_MAX_NODES) continue;
+    snprintf(path, sizeof(path),
+	     "/sys/devices/system/node/%s/cpulist", e->d_name);
+    if (myth_numa_read_cpulist(path, node) > 0) n_nodes++;
+  }
+  closedir(d);
+  return n_nodes;
+}
+#endif	/* MYTH_NUMA_SYSCALLS */
+
+/* decide the home node of each worker. this must be called
+   after g_attr and the worker -> cpu assignment are fixed */
+void myth_numa_init(int n_workers) {
+  worker_node = 0;
+#if MYTH_NUMA_SYSCALLS
+  char * env = getenv(ENV_MYTH_NUMA);
+  int i;
+  if (env && atoi(env) == 0) return;
+  /* we cannot tell where unbound workers run */
+  if (g_attr.bind_workers <= 0) return;
+  /* nothing to gain on a single node */
+  if (myth_numa_read_topology() <= 1) return;
+  worker_node = myth_malloc(sizeof(int) * n_workers);
+  for (i = 0; i < n_workers; i++) {
+    int cpu = myth_get_worker_cpu(i);
+    worker_node[i] = ((cpu >= 0 && cpu < N_MAX_CPUS) ? cpu_node[cpu] : -1);
+  }
+#else
+  (void)n_workers;
+#endif
+}
+
+void myth_numa_fini(void) {
+  if (worker_node) {
+    myth_free(worker_node);
+    worker_node = 0;
+  }
+}
+
+//Return the home node of worker RANK, or -1 if it has none
+int myth_numa_worker_node(int rank) {
+  return (worker_node ? worker_node[rank] : -1);
+}
+
+/* place pages overlapping [addr,addr+len) on NODE, migrating
+   those already touched. a page shared with a neighbouring
+   object ends up on the node of whoever binds it last.
+   placement is just a hint, so errors are ignored */
+void myth_numa_bind_memory(void * addr, size_t len, int node) {
+#if MYTH_NUMA_SYSCALLS
+  unsigned long mask[N_MAX_NODES / N_NODE_MASK_BITS];
+  uintptr_t a, b;
+  if (node < 0 || len == 0) return;
+  memset(mask, 0, sizeof(mask));
+  mask[node / N_NODE_MASK_BITS] = 1UL << (node % N_NODE_MASK_BITS);
+  a = ((uintptr_t)addr) & ~((uintptr_t)PAGE_SIZE - 1);
+  b = ((uintptr_t)addr + len + PAGE_SIZE - 1) & ~((uintptr_t)PAGE_SIZE - 1);
+  /* the kernel expects the number of bits in the mask plus one */
+  syscall(SYS_mbind, a, b - a, MYTH_MPOL_PREFERRED,
+	  mask, N_MAX_NODES + 1, MYTH_MPOL_MF_MOVE);
+#else
+  (void)addr; (void)len; (void)node;
+#endif
+}
+
+/* make the calling thread allocate pages from NODE
+   (or restore the default policy if NODE is -1) */
+void myth_numa_set_preferred(int node) {
+#if MYTH_NUMA_SYSCALLS
+  unsigned long mask[N_MAX_NODES / N_NODE_MASK_BITS];
+  if (!worker_node) return;
+  if (node < 0) {
+    syscall(SYS_set_mempolicy, MYTH_MPOL_DEFAULT, NULL, 0);
+    return;
+  }
+  memset(mask, 0, sizeof(mask));
+  mask[node / N_NODE_MASK_BITS] = 1UL << (node % N_NODE_MASK_BITS);
+  syscall(SYS_set_mempolicy, MYTH_MPOL_PREFERRED, mask, N_MAX_NODES + 1);
+#else
+  (void)node;
+#endif
+}
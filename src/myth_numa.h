@@ -0,0 +1,29 @@
+/*
+ * myth_numa.h
+ */
+#pragma once
+#ifndef MYTH_NUMA_H_
+#define MYTH_NUMA_H_
+
+#include <stddef.h>
+
+/*
+   NUMA-aware placement of per-worker data structures.
+   we do not depend on libnuma; memory policies are set
+   by raw mbind/set_mempolicy system calls and the
+   cpu -> node map is read from /sys/devices/system/node.
+
+   myth_numa_worker_node returns -1 when NUMA placement
+   is disabled (single node machine, workers not bound
+   to cores, MYTH_NUMA=0, or non-Linux platforms), and
+   myth_numa_bind_memory does nothing for node -1.
+   myth_numa_set_preferred(-1) restores the default policy.
+ */
+
+void myth_numa_init(int n_workers);
+void myth_numa_fini(void);
+int  myth_numa_worker_node(int rank);
+void myth_numa_bind_memory(void * addr, size_t len, int node);
+void myth_numa_set_preferred(int node);
+
+#endif	/* MYTH_NUMA_H_ */
@@ -310,8 +310,38 @@ typedef struct {
   ssize_t (*sendto)(int sockfd, const void *buf, size_t len, int flags,
 		    const struct sockaddr *dest_addr, socklen_t addrlen);
   ssize_t (*sendmsg)(int sockfd, const struct msghdr *msg, int flags);
+  int (*setsockopt)(int sockfd, int level, int optname,
+		    const void *optval, socklen_t optlen);
   ssize_t (*write)(int fd, const void *buf, size_t count);
 
+  /* file */
+  int (*open)(const char *pathname, int flags, ...);
+  ssize_t (*pread)(int fd, void *buf, size_t count, off_t offset);
+  ssize_t (*pwrite)(int fd, const void *buf, size_t count, off_t offset);
+  int (*fsync)(int fd);
+  ssize_t (*readv)(int fd, const struct iovec *iov, int iovcnt);
+  ssize_t (*writev)(int fd, const struct iovec *iov, int iovcnt);
+#if defined(HAVE_SYS_SENDFILE_H)
+  ssize_t (*sendfile)(int out_fd, int in_fd, off_t *offset, size_t count);
+#endif
+#if defined(HAVE_SPLICE)
+  ssize_t (*splice)(int fd_in, loff_t *off_in, int fd_out, loff_t *off_out,
+		    size_t len, unsigned int flags);
+#endif
+#if defined(HAVE_RECVMMSG)
+  int (*recvmmsg)(int sockfd, struct mmsghdr *msgvec, unsigned int vlen,
+		  int flags, struct timespec *timeout);
+#endif
+#if defined(HAVE_SENDMMSG)
+  int (*sendmmsg)(int sockfd, struct mmsghdr *msgvec, unsigned int vlen, int flags);
+#endif
+  int (*poll)(struct pollfd *fds, nfds_t nfds, int timeout);
+#if defined(HAVE_PPOLL)
+  int (*ppoll)(struct pollfd *fds, nfds_t nfds,
+	       const struct timespec *tmo_p, const sigset_t *sigmask);
+#endif
+  int (*epoll_wait)(int epfd, struct epoll_event *events, int maxevents, int timeout);
+
 } real_function_table_t;
 
 enum {
@@ -591,7 +621,33 @@ static shared_object_symbol s_so_syms[] = {
   so_symbol_entry(sendto, libc),
 
   so_symbol_entry(sendmsg, libc),
+  so_symbol_entry(setsockopt, libc),
   so_symbol_entry(write, libc),
+
+  /* file */
+  so_symbol_entry(open, libc),
+  so_symbol_entry(pread, libc),
+  so_symbol_entry(pwrite, libc),
+  so_symbol_entry(fsync, libc),
+  so_symbol_entry(readv, libc),
+  so_symbol_entry(writev, libc),
+#if defined(HAVE_SYS_SENDFILE_H)
+  so_symbol_entry(sendfile, libc),
+#endif
+#if defined(HAVE_SPLICE)
+  so_symbol_entry(splice, libc),
+#endif
+#if defined(HAVE_RECVMMSG)
+  so_symbol_entry(recvmmsg, libc),
+#endif
+#if defined(HAVE_SENDMMSG)
+  so_symbol_entry(sendmmsg, libc),
+#endif
+  so_symbol_entry(poll, libc),
+#if defined(HAVE_PPOLL)
+  so_symbol_entry(ppoll, libc),
+#endif
+  so_symbol_entry(epoll_wait, libc),
 };
 
 enum {
@@ -2964,7 +3020,7 @@ int real_sched_yield(void) {
 #if MYTH_WRAP == MYTH_WRAP_VANILLA
   return sched_yield();
 #elif MYTH_WRAP == MYTH_WRAP_LD
-  return sched_yield();
+  return __real_sched_yield();
 #elif MYTH_WRAP == MYTH_WRAP_DL
   if (!real_function_table.sched_yield) ensure_real_functions();
   assert(real_function_table.sched_yield);
@@ -2981,7 +3037,7 @@ unsigned int real_sleep(useconds_t seconds) {
 #if MYTH_WRAP == MYTH_WRAP_VANILLA
   return sleep(seconds);
 #elif MYTH_WRAP == MYTH_WRAP_LD
-  return sleep(seconds);
+  return __real_sleep(seconds);
 #elif MYTH_WRAP == MYTH_WRAP_DL
   if (!real_function_table.sleep) ensure_real_functions();
   assert(real_function_table.sleep);
@@ -2998,7 +3054,7 @@ int real_usleep(useconds_t usec) {
 #if MYTH_WRAP == MYTH_WRAP_VANILLA
   return usleep(usec);
 #elif MYTH_WRAP == MYTH_WRAP_LD
-  return usleep(usec);
+  return __real_usleep(usec);
 #elif MYTH_WRAP == MYTH_WRAP_DL
   if (!real_function_table.usleep) ensure_real_functions();
   assert(real_function_table.usleep);
@@ -3015,7 +3071,7 @@ int real_nanosleep(const struct timespec *req, struct timespec *rem) {
 #if MYTH_WRAP == MYTH_WRAP_VANILLA
   return nanosleep(req, rem);
 #elif MYTH_WRAP == MYTH_WRAP_LD
-  return nanosleep(req, rem);
+  return __real_nanosleep(req, rem);
 #elif MYTH_WRAP == MYTH_WRAP_DL
   if (!real_function_table.nanosleep) ensure_real_functions();
   assert(real_function_table.nanosleep);
@@ -3669,6 +3725,25 @@ ssize_t real_sendmsg(int sockfd, const struct msghdr *msg, int flags) {
 #endif
 }
 
+#if MYTH_WRAP == MYTH_WRAP_LD
+int __real_setsockopt(int sockfd, int level, int optname,
+		      const void *optval, socklen_t optlen);
+#endif
+int real_setsockopt(int sockfd, int level, int optname,
+		    const void *optval, socklen_t optlen) {
+#if MYTH_WRAP == MYTH_WRAP_VANILLA
+  return setsockopt(sockfd, level, optname, optval, optlen);
+#elif MYTH_WRAP == MYTH_WRAP_LD
+  return __real_setsockopt(sockfd, level, optname, optval, optlen);
+#elif MYTH_WRAP == MYTH_WRAP_DL
+  if (!real_function_table.setsockopt) ensure_real_functions();
+  assert(real_function_table.setsockopt);
+  return real_function_table.setsockopt(sockfd, level, optname, optval, optlen);
+#else
+#error "MYTH_WRAP must be MYTH_WRAP_VANILLA, MYTH_WRAP_LD, or MYTH_WRAP_DL"
+#endif
+}
+
 #if MYTH_WRAP == MYTH_WRAP_LD
 ssize_t __real_write(int fd, const void *buf, size_t count);
 #endif
@@ -3686,3 +3761,254 @@ ssize_t real_write(int fd, const void *buf, size_t count) {
 #endif
 }
 
+/* file */
+
+#if MYTH_WRAP == MYTH_WRAP_LD
+int __real_open(const char *pathname, int flags, ...);
+#endif
+int real_open(const char *pathname, int flags, ...) {
+  /* mode is there only when a file may be created */
+  mode_t mode = 0;
+  if (flags & (O_CREAT
+#if defined(O_TMPFILE)
+	       | O_TMPFILE
+#endif
+	       )) {
+    va_list ap;
+    va_start(ap, flags);
+    mode = va_arg(ap, mode_t);
+    va_end(ap);
+  }
+#if MYTH_WRAP == MYTH_WRAP_VANILLA
+  return open(pathname, flags, mode);
+#elif MYTH_WRAP == MYTH_WRAP_LD
+  return __real_open(pathname, flags, mode);
+#elif MYTH_WRAP == MYTH_WRAP_DL
+  if (!real_function_table.open) ensure_real_functions();
+  assert(real_function_table.open);
+  return real_function_table.open(pathname, flags, mode);
+#else
+#error "MYTH_WRAP must be MYTH_WRAP_VANILLA, MYTH_WRAP_LD, or MYTH_WRAP_DL"
+#endif
+}
+
+#if MYTH_WRAP == MYTH_WRAP_LD
+ssize_t __real_pread(int fd, void *buf, size_t count, off_t offset);
+#endif
+ssize_t real_pread(int fd, void *buf, size_t count, off_t offset) {
+#if MYTH_WRAP == MYTH_WRAP_VANILLA
+  return pread(fd, buf, count, offset);
+#elif MYTH_WRAP == MYTH_WRAP_LD
+  return __real_pread(fd, buf, count, offset);
+#elif MYTH_WRAP == MYTH_WRAP_DL
+  if (!real_function_table.pread) ensure_real_functions();
+  assert(real_function_table.pread);
+  return real_function_table.pread(fd, buf, count, offset);
+#else
+#error "MYTH_WRAP must be MYTH_WRAP_VANILLA, MYTH_WRAP_LD, or MYTH_WRAP_DL"
+#endif
+}
+
+#if MYTH_WRAP == MYTH_WRAP_LD
+ssize_t __real_pwrite(int fd, const void *buf, size_t count, off_t offset);
+#endif
+ssize_t real_pwrite(int fd, const void *buf, size_t count, off_t offset) {
+#if MYTH_WRAP == MYTH_WRAP_VANILLA
+  return pwrite(fd, buf, count, offset);
+#elif MYTH_WRAP == MYTH_WRAP_LD
+  return __real_pwrite(fd, buf, count, offset);
+#elif MYTH_WRAP == MYTH_WRAP_DL
+  if (!real_function_table.pwrite) ensure_real_functions();
+  assert(real_function_table.pwrite);
+  return real_function_table.pwrite(fd, buf, count, offset);
+#else
+#error "MYTH_WRAP must be MYTH_WRAP_VANILLA, MYTH_WRAP_LD, or MYTH_WRAP_DL"
+#endif
+}
+
+#if MYTH_WRAP == MYTH_WRAP_LD
+int __real_fsync(int fd);
+#endif
+int real_fsync(int fd) {
+#if MYTH_WRAP == MYTH_WRAP_VANILLA
+  return fsync(fd);
+#elif MYTH_WRAP == MYTH_WRAP_LD
+  return __real_fsync(fd);
+#elif MYTH_WRAP == MYTH_WRAP_DL
+  if (!real_function_table.fsync) ensure_real_functions();
+  assert(real_function_table.fsync);
+  return real_function_table.fsync(fd);
+#else
+#error "MYTH_WRAP must be MYTH_WRAP_VANILLA, MYTH_WRAP_LD, or MYTH_WRAP_DL"
+#endif
+}
+
+#if MYTH_WRAP == MYTH_WRAP_LD
+ssize_t __real_readv(int fd, const struct iovec *iov, int iovcnt);
+#endif
+ssize_t real_readv(int fd, const struct iovec *iov, int iovcnt) {
+#if MYTH_WRAP == MYTH_WRAP_VANILLA
+  return readv(fd, iov, iovcnt);
+#elif MYTH_WRAP == MYTH_WRAP_LD
+  return __real_readv(fd, iov, iovcnt);
+#elif MYTH_WRAP == MYTH_WRAP_DL
+  if (!real_function_table.readv) ensure_real_functions();
+  assert(real_function_table.readv);
+  return real_function_table.readv(fd, iov, iovcnt);
+#else
+#error "MYTH_WRAP must be MYTH_WRAP_VANILLA, MYTH_WRAP_LD, or MYTH_WRAP_DL"
+#endif
+}
+
+#if MYTH_WRAP == MYTH_WRAP_LD
+ssize_t __real_writev(int fd, const struct iovec *iov, int iovcnt);
+#endif
+ssize_t real_writev(int fd, const struct iovec *iov, int iovcnt) {
+#if MYTH_WRAP == MYTH_WRAP_VANILLA
+  return writev(fd, iov, iovcnt);
+#elif MYTH_WRAP == MYTH_WRAP_LD
+  return __real_writev(fd, iov, iovcnt);
+#elif MYTH_WRAP == MYTH_WRAP_DL
+  if (!real_function_table.writev) ensure_real_functions();
+  assert(real_function_table.writev);
+  return real_function_table.writev(fd, iov, iovcnt);
+#else
+#error "MYTH_WRAP must be MYTH_WRAP_VANILLA, MYTH_WRAP_LD, or MYTH_WRAP_DL"
+#endif
+}
+
+#if defined(HAVE_SYS_SENDFILE_H)
+#if MYTH_WRAP == MYTH_WRAP_LD
+ssize_t __real_sendfile(int out_fd, int in_fd, off_t *offset, size_t count);
+#endif
+ssize_t real_sendfile(int out_fd, int in_fd, off_t *offset, size_t count) {
+#if MYTH_WRAP == MYTH_WRAP_VANILLA
+  return sendfile(out_fd, in_fd, offset, count);
+#elif MYTH_WRAP == MYTH_WRAP_LD
+  return __real_sendfile(out_fd, in_fd, offset, count);
+#elif MYTH_WRAP == MYTH_WRAP_DL
+  if (!real_function_table.sendfile) ensure_real_functions();
+  assert(real_function_table.sendfile);
+  return real_function_table.sendfile(out_fd, in_fd, offset, count);
+#else
+#error "MYTH_WRAP must be MYTH_WRAP_VANILLA, MYTH_WRAP_LD, or MYTH_WRAP_DL"
+#endif
+}
+#endif
+
+#if defined(HAVE_SPLICE)
+#if MYTH_WRAP == MYTH_WRAP_LD
+ssize_t __real_splice(int fd_in, loff_t *off_in, int fd_out, loff_t *off_out,
+		    size_t len, unsigned int flags);
+#endif
+ssize_t real_splice(int fd_in, loff_t *off_in, int fd_out, loff_t *off_out,
+		    size_t len, unsigned int flags) {
+#if MYTH_WRAP == MYTH_WRAP_VANILLA
+  return splice(fd_in, off_in, fd_out, off_out, len, flags);
+#elif MYTH_WRAP == MYTH_WRAP_LD
+  return __real_splice(fd_in, off_in, fd_out, off_out, len, flags);
+#elif MYTH_WRAP == MYTH_WRAP_DL
+  if (!real_function_table.splice) ensure_real_functions();
+  assert(real_function_table.splice);
+  return real_function_table.splice(fd_in, off_in, fd_out, off_out, len, flags);
+#else
+#error "MYTH_WRAP must be MYTH_WRAP_VANILLA, MYTH_WRAP_LD, or MYTH_WRAP_DL"
+#endif
+}
+#endif
+
+#if defined(HAVE_RECVMMSG)
+#if MYTH_WRAP == MYTH_WRAP_LD
+int __real_recvmmsg(int sockfd, struct mmsghdr *msgvec, unsigned int vlen,
+		    int flags, struct timespec *timeout);
+#endif
+int real_recvmmsg(int sockfd, struct mmsghdr *msgvec, unsigned int vlen,
+		  int flags, struct timespec *timeout) {
+#if MYTH_WRAP == MYTH_WRAP_VANILLA
+  return recvmmsg(sockfd, msgvec, vlen, flags, timeout);
+#elif MYTH_WRAP == MYTH_WRAP_LD
+  return __real_recvmmsg(sockfd, msgvec, vlen, flags, timeout);
+#elif MYTH_WRAP == MYTH_WRAP_DL
+  if (!real_function_table.recvmmsg) ensure_real_functions();
+  assert(real_function_table.recvmmsg);
+  return real_function_table.recvmmsg(sockfd, msgvec, vlen, flags, timeout);
+#else
+#error "MYTH_WRAP must be MYTH_WRAP_VANILLA, MYTH_WRAP_LD, or MYTH_WRAP_DL"
+#endif
+}
+#endif
+
+#if defined(HAVE_SENDMMSG)
+#if MYTH_WRAP == MYTH_WRAP_LD
+int __real_sendmmsg(int sockfd, struct mmsghdr *msgvec, unsigned int vlen, int flags);
+#endif
+int real_sendmmsg(int sockfd, struct mmsghdr *msgvec, unsigned int vlen, int flags) {
+#if MYTH_WRAP == MYTH_WRAP_VANILLA
+  return sendmmsg(sockfd, msgvec, vlen, flags);
+#elif MYTH_WRAP == MYTH_WRAP_LD
+  return __real_sendmmsg(sockfd, msgvec, vlen, flags);
+#elif MYTH_WRAP == MYTH_WRAP_DL
+  if (!real_function_table.sendmmsg) ensure_real_functions();
+  assert(real_function_table.sendmmsg);
+  return real_function_table.sendmmsg(sockfd, msgvec, vlen, flags);
+#else
+#error "MYTH_WRAP must be MYTH_WRAP_VANILLA, MYTH_WRAP_LD, or MYTH_WRAP_DL"
+#endif
+}
+#endif
+
+#if MYTH_WRAP == MYTH_WRAP_LD
+int __real_poll(struct pollfd *fds, nfds_t nfds, int timeout);
+#endif
+int real_poll(struct pollfd *fds, nfds_t nfds, int timeout) {
+#if MYTH_WRAP == MYTH_WRAP_VANILLA
+  return poll(fds, nfds, timeout);
+#elif MYTH_WRAP == MYTH_WRAP_LD
+  return __real_poll(fds, nfds, timeout);
+#elif MYTH_WRAP == MYTH_WRAP_DL
+  if (!real_function_table.poll) ensure_real_functions();
+  assert(real_function_table.poll);
+  return real_function_table.poll(fds, nfds, timeout);
+#else
+#error "MYTH_WRAP must be MYTH_WRAP_VANILLA, MYTH_WRAP_LD, or MYTH_WRAP_DL"
+#endif
+}
+
+#if defined(HAVE_PPOLL)
+#if MYTH_WRAP == MYTH_WRAP_LD
+int __real_ppoll(struct pollfd *fds, nfds_t nfds,
+		 const struct timespec *tmo_p, const sigset_t *sigmask);
+#endif
+int real_ppoll(struct pollfd *fds, nfds_t nfds,
+	       const struct timespec *tmo_p, const sigset_t *sigmask) {
+#if MYTH_WRAP == MYTH_WRAP_VANILLA
+  return ppoll(fds, nfds, tmo_p, sigmask);
+#elif MYTH_WRAP == MYTH_WRAP_LD
+  return __real_ppoll(fds, nfds, tmo_p, sigmask);
+#elif MYTH_WRAP == MYTH_WRAP_DL
+  if (!real_function_table.ppoll) ensure_real_functions();
+  assert(real_function_table.ppoll);
+  return real_function_table.ppoll(fds, nfds, tmo_p, sigmask);
+#else
+#error "MYTH_WRAP must be MYTH_WRAP_VANILLA, MYTH_WRAP_LD, or MYTH_WRAP_DL"
+#endif
+}
+#endif
+
+#if MYTH_WRAP == MYTH_WRAP_LD
+int __real_epoll_wait(int epfd, struct epoll_event *events, int maxevents, int timeout);
+#endif
+int real_epoll_wait(int epfd, struct epoll_event *events, int maxevents, int timeout) {
+#if MYTH_WRAP == MYTH_WRAP_VANILLA
+  return epoll_wait(epfd, events, maxevents, timeout);
+#elif MYTH_WRAP == MYTH_WRAP_LD
+  return __real_epoll_wait(epfd, events, maxevents, timeout);
+#elif MYTH_WRAP == MYTH_WRAP_DL
+  if (!real_function_table.epoll_wait) ensure_real_functions();
+  assert(real_function_table.epoll_wait);
+  return real_function_table.epoll_wait(epfd, events, maxevents, timeout);
+#else
+#error "MYTH_WRAP must be MYTH_WRAP_VANILLA, MYTH_WRAP_LD, or MYTH_WRAP_DL"
+#endif
+}
+
@@ -9,16 +9,22 @@
 #if HAVE_MALLOC_H
 #include <malloc.h>
 #endif
+#include <poll.h>
 #include <pthread.h>
 #include <sched.h>
 #include <signal.h>
 #include <stdlib.h>
 #include <time.h>
 #include <unistd.h>
+#include <sys/epoll.h>
 #include <sys/select.h>
 #include <sys/socket.h>
 #include <sys/time.h>
 #include <sys/types.h>
+#include <sys/uio.h>
+#if defined(HAVE_SYS_SENDFILE_H)
+#include <sys/sendfile.h>
+#endif
 
 #include "myth_config.h"
 
@@ -274,8 +280,42 @@ ssize_t real_send(int sockfd, const void *buf, size_t len, int flags);
 ssize_t real_sendto(int sockfd, const void *buf, size_t len, int flags,
 		    const struct sockaddr *dest_addr, socklen_t addrlen);
 ssize_t real_sendmsg(int sockfd, const struct msghdr *msg, int flags);
+int real_setsockopt(int sockfd, int level, int optname,
+		    const void *optval, socklen_t optlen);
 ssize_t real_write(int fd, const void *buf, size_t count);
 
+/* file */
+int real_open(const char *pathname, int flags, ... /* mode */ );
+ssize_t real_pread(int fd, void *buf, size_t count, off_t offset);
+ssize_t real_pwrite(int fd, const void *buf, size_t count, off_t offset);
+int real_fsync(int fd);
+ssize_t real_readv(int fd, const struct iovec *iov, int iovcnt);
+ssize_t real_writev(int fd, const struct iovec *iov, int iovcnt);
+#if defined(HAVE_SYS_SENDFILE_H)
+ssize_t real_sendfile(int out_fd, int in_fd, off_t *offset, size_t count);
+#endif
+#if defined(HAVE_SPLICE)
+ssize_t real_splice(int fd_in, loff_t *off_in, int fd_out, loff_t *off_out,
+		    size_t len, unsigned int flags);
+#endif
+#if defined(HAVE_RECVMMSG) || defined(HAVE_SENDMMSG)
+/* defined by <sys/socket.h> only with _GNU_SOURCE */
+struct mmsghdr;
+#endif
+#if defined(HAVE_RECVMMSG)
+int real_recvmmsg(int sockfd, struct mmsghdr *msgvec, unsigned int vlen,
+		  int flags, struct timespec *timeout);
+#endif
+#if defined(HAVE_SENDMMSG)
+int real_sendmmsg(int sockfd, struct mmsghdr *msgvec, unsigned int vlen, int flags);
+#endif
+int real_poll(struct pollfd *fds, nfds_t nfds, int timeout);
+#if defined(HAVE_PPOLL)
+int real_ppoll(struct pollfd *fds, nfds_t nfds,
+	       const struct timespec *tmo_p, const sigset_t *sigmask);
+#endif
+int real_epoll_wait(int epfd, struct epoll_event *events, int maxevents, int timeout);
+
 #endif /* MYTH_REAL_H_ */
 
 
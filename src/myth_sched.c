@@ -75,7 +75,7 @@ void myth_alrm_sighandler(int signum, siginfo_t *sinfo, void* ctx) {
     {
 #if MYTH_WRAP_SOCKIO
       myth_thread_t ret;
-      ret=myth_io_polling_sig(env);
+      ret=(g_myth_io_on?myth_io_polling_sig(env):NULL);
       if (ret)myth_queue_push(&env->runnable_q,ret);
 #endif
     }
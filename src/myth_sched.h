@@ -42,6 +42,21 @@ static inline int myth_create_ex_body(myth_thread_t * id,
 				      myth_thread_attr_t * attr,
 				      myth_func_t func, void *arg);
 MYTH_CTX_CALLBACK void myth_yield_ex_1(void * arg1, void * arg2, void * arg3);
+static inline myth_thread_t myth_create_alloc(myth_running_env_t env,
+					      myth_thread_attr_t * attr,
+					      void * arg, void ** stk_p,
+					      size_t * stk_size_p);
+static inline myth_thread_t myth_task_materialize(myth_running_env_t env,
+						  myth_task_t * t);
+static inline int myth_create_many_body(myth_thread_t * ids,
+					myth_thread_attr_t * attr,
+					myth_func_t func, void * args,
+					size_t arg_stride, long nthreads);
+static inline int myth_task_spawn_body(myth_task_t * t,
+				       myth_func_t func, void * arg);
+static inline int myth_task_join_body(myth_task_t * t, void ** result);
+static inline myth_thread_t myth_task_take_other(myth_running_env_t env);
+static inline myth_thread_t myth_task_steal(myth_running_env_t env);
 static inline int myth_yield_ex_body(int yield_opt);
 static inline int myth_yield_body(void);
 static inline void myth_join_1(myth_running_env_t e,myth_thread_t th,void **result);
@@ -54,6 +69,13 @@ MYTH_CTX_CALLBACK void myth_entry_point_1(void *arg1,void *arg2,void *arg3);
 MYTH_CTX_CALLBACK void myth_entry_point_2(void *arg1,void *arg2,void *arg3);
 static void __attribute__((unused)) myth_entry_point(void);
 static inline void myth_entry_point_cleanup(myth_thread_t this_thread);
+static inline int myth_cancel_pending(myth_thread_t th);
+static inline void myth_wait_cancellable(myth_thread_t th,
+					 int (*fn)(struct myth_thread *, void *),
+					 void * obj);
+static inline void myth_wait_interrupt(myth_thread_t th);
+static inline void myth_wait_check_cancel(myth_thread_t th);
+static inline int myth_wait_done(myth_thread_t th);
 static inline void myth_log_start_body(void);
 static inline void myth_log_pause_body(void);
 static inline void myth_sched_prof_start_body(void);
@@ -63,8 +85,17 @@ static inline myth_thread_t get_new_myth_thread_struct_desc(myth_running_env_t e
 static inline void *get_new_myth_thread_struct_stack(myth_running_env_t env,size_t size_in_bytes);
 static inline void init_myth_thread_struct(myth_running_env_t env,myth_thread_t th);
 static inline void free_myth_thread_struct_desc(myth_running_env_t e,myth_thread_t th);
+static inline void free_myth_stack(myth_running_env_t e,void *stack);
 static inline void free_myth_thread_struct_stack(myth_running_env_t e,myth_thread_t th);
 
+//The word next to the freelist link at the top of each stack
+//holds either its size (stacks from myth_flmalloc, always a
+//multiple of the page size) or, for default-sized stacks,
+//the rank of the worker that allocated it with the lowest bit set
+#define MYTH_STACK_BLK_DEFAULT(rank) ((((uintptr_t)(rank)) << 1) | 1)
+#define MYTH_STACK_BLK_IS_DEFAULT(b) ((b) & 1)
+#define MYTH_STACK_BLK_HOME(b) ((int)((b) >> 1))
+
 
 
 #endif //MYTH_SCHED_H_
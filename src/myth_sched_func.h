@@ -31,6 +31,7 @@
 #include "myth_spinlock_func.h"
 #include "myth_desc_func.h"
 #include "myth_tls_func.h"
+#include "myth_numa.h"
 
 #ifndef PAGE_ALIGN
 #define PAGE_ALIGN(n) ((((n)+(PAGE_SIZE)-1)/(PAGE_SIZE))*PAGE_SIZE)
@@ -49,6 +50,15 @@ static inline myth_thread_t get_new_myth_thread_struct_desc(myth_running_env_t e
   myth_thread_t ret;
 #if MYTH_ALLOC_PROF
   env->prof_data.dalloc_cnt++;
+#endif
+#if MYTH_HOT_SLOT
+  ret = env->hot_desc;
+  if (ret) {
+    env->hot_desc = NULL;
+    env->hot_desc_hits++;
+    return ret;
+  }
+  env->hot_desc_misses++;
 #endif
   void * v_ret = myth_freelist_pop(&env->freelist_desc);
   if (v_ret){
@@ -70,6 +80,9 @@ static inline myth_thread_t get_new_myth_thread_struct_desc(myth_running_env_t e
     char * th_ptr 
       = myth_mmap(NULL, alloc_size, PROT_READ|PROT_WRITE,
 		  MAP_PRIVATE|MYTH_MAP_ANON|MYTH_MAP_STACK, -1, 0);
+#if MYTH_NUMA_AWARE
+    myth_numa_bind_memory(th_ptr, alloc_size, env->numa_node);
+#endif
 #endif
 #if MYTH_ALLOC_PROF
     uint64_t t1 = myth_get_rdtsc();
@@ -176,7 +189,21 @@ th_ptr -> 4080-4087:
     *blk_size = size_in_bytes;
     return th_ptr;
   }
+#if MYTH_HOT_SLOT
+  if (env->hot_stack) {
+    void * hot = env->hot_stack;
+    env->hot_stack = NULL;
+    env->hot_stack_hits++;
+    return hot;
+  }
+  env->hot_stack_misses++;
+#endif
+#if MYTH_NUMA_AWARE
+  void * ret = myth_freelist_pop_with_remote(&env->freelist_stack,
+					     &env->freelist_stack_remote);
+#else
   void * ret = myth_freelist_pop(&env->freelist_stack);
+#endif
   if (ret) {
     return ret;
   } else {
@@ -200,6 +227,9 @@ th_ptr -> 4080-4087:
     alloc_size &= ~0xFFF;
     char * th_ptr = myth_mmap(NULL, alloc_size, PROT_READ|PROT_WRITE, 
 			      MAP_PRIVATE|MYTH_MAP_ANON|MYTH_MAP_STACK, -1, 0);
+#if MYTH_NUMA_AWARE
+    myth_numa_bind_memory(th_ptr, alloc_size, env->numa_node);
+#endif
 #endif /* ALLOCATE_STACK_BY_MALLOC */
 
 #if MYTH_ALLOC_PROF
@@ -218,7 +248,7 @@ th_ptr -> 4080-4087:
     for (i = 0; i < STACK_ALLOC_UNIT; i++){
       ret = (void**) th_ptr;
       uintptr_t *blk_size = (uintptr_t*)(th_ptr + sizeof(void*));
-      *blk_size = 0;	  //indicates default
+      *blk_size = MYTH_STACK_BLK_DEFAULT(env->rank);
       if (i < STACK_ALLOC_UNIT - 1) {
 	myth_freelist_push(&env->freelist_stack, ret);
 	th_ptr += th_size;
@@ -238,9 +268,13 @@ th_ptr -> 4080-4087:
 static inline void init_myth_thread_struct(myth_running_env_t env, myth_thread_t th) {
   th->status = MYTH_STATUS_READY;
   th->join_thread = NULL;
-  th->detached = 0;
   th->cancel_enabled = 1;
   th->cancelled = 0;
+  th->save_fpcsr = 0;
+  th->interrupted = 0;
+  th->coro = NULL;
+  th->wait_cancel = NULL;
+  th->cancel_group = NULL;
   //th->pickle_ptr=NULL;
   th->env = env;
 #if MYTH_ENABLE_THREAD_ANNOTATION && MYTH_COLLECT_LOG
@@ -272,6 +306,13 @@ static inline void free_myth_thread_struct_desc(myth_running_env_t e,myth_thread
 #endif
 #if MYTH_DESC_REUSE_CHECK
   myth_spin_unlock_body(&th->sanity_check);
+#endif
+#if MYTH_HOT_SLOT
+  //Put it in the hot slot and the one it replaces to the freelist
+  myth_thread_t cold = e->hot_desc;
+  e->hot_desc = th;
+  if (!cold) return;
+  th = cold;
 #endif
   //Add to a freelist
   myth_freelist_push(&e->freelist_desc,(void*)th);
@@ -285,6 +326,35 @@ static inline void free_myth_thread_struct_desc(myth_running_env_t e,myth_thread
 #endif
 }
 
+//Release a stack from get_new_myth_thread_struct_stack
+static inline void free_myth_stack(myth_running_env_t e, void * stack)
+{
+  //Add to a freelist
+  void **ptr = (void**)stack;
+
+  uintptr_t *blk_size = (uintptr_t*)(((uint8_t*)ptr) + sizeof(void*));
+  if (MYTH_STACK_BLK_IS_DEFAULT(*blk_size)) {
+#if MYTH_NUMA_AWARE
+    //Send a stack stolen from another node back to its home
+    myth_running_env_t home = &g_envs[MYTH_STACK_BLK_HOME(*blk_size)];
+    if (home->numa_node != e->numa_node) {
+      myth_freelist_push_atomic(&home->freelist_stack_remote, ptr);
+      return;
+    }
+#endif
+#if MYTH_HOT_SLOT
+    void ** cold = e->hot_stack;
+    e->hot_stack = ptr;
+    if (!cold) return;
+    ptr = cold;
+#endif
+    myth_freelist_push(&e->freelist_stack, ptr);
+  } else {
+    void *stack_start=(((uint8_t*)ptr)-(*blk_size)+(sizeof(void*)*2));
+    myth_flfree(e->rank,(size_t)(*blk_size),stack_start);
+  }
+}
+
 //Release thread descriptor
 static inline void free_myth_thread_struct_stack(myth_running_env_t e,myth_thread_t th)
 {
@@ -293,23 +363,11 @@ static inline void free_myth_thread_struct_stack(myth_running_env_t e,myth_threa
     assert(0);
     }*/
 #if MYTH_SPLIT_STACK_DESC
-  void **ptr;
   myth_assert(th);
 #if FREE_MYTH_THREAD_STRUCT_DEBUG
   myth_dprintf("thread stack %p is freed\n",th);
 #endif
-  if (th->stack) {
-    //Add to a freelist
-    ptr = (void**)th->stack;
-
-    uintptr_t *blk_size = (uintptr_t*)(((uint8_t*)ptr) + sizeof(void*));
-    if (*blk_size == 0) {
-      myth_freelist_push(&e->freelist_stack, ptr);
-    } else {
-      void *stack_start=(((uint8_t*)ptr)-(*blk_size)+(sizeof(void*)*2));
-      myth_flfree(e->rank,(size_t)(*blk_size),stack_start);
-    }
-  }
+  if (th->stack) free_myth_stack(e, th->stack);
 #endif
 }
 
@@ -373,30 +431,119 @@ MYTH_CTX_CALLBACK void myth_create_1(void *arg1,void *arg2,void *arg3) {
 
 
 /* --------
-   create
+   cancellation
    -------- */
 
-static inline int myth_create_ex_body(myth_thread_t * id,
-				      myth_thread_attr_t * attr,
-				      myth_func_t func, void *arg) {
-#if MYTH_CREATE_PROF
-  uint64_t t0 = myth_get_rdtsc();
-#endif /* MYTH_CREATE_PROF */
-#if MYTH_CREATE_PROF_DETAIL
-  uint64_t t0 = myth_get_rdtsc();
-#endif /* MYTH_CREATE_PROF_DETAIL */
+//A cancellation request the thread is to act on
+static inline int myth_cancel_pending(myth_thread_t th) {
+  myth_cancel_group_t g = th->cancel_group;
+  return th->cancel_enabled && (th->cancelled || (g && g->cancelled));
+}
 
-  int _ = myth_ensure_init();
+/* cancellable waits. a thread about to park registers with
+   myth_wait_cancellable how to take it out of what it waits on,
+   and myth_wait_check_cancel is called once it is visible there.
+   a canceller sets the request and calls myth_wait_interrupt.
+   with a full barrier between the two steps on both sides, one
+   of them at least sees the other's, so no request is missed.
+   whichever takes the thread out of the wait, under the lock of
+   what it waits on, makes it runnable. cancellers hold th->lock
+   while they look at the wait and the thread takes it in
+   myth_wait_done when it resumes, so the wait outlives them */
+
+static inline void myth_wait_cancellable(myth_thread_t th,
+					 myth_wait_cancel_t fn, void * obj) {
+  th->interrupted = 0;
+  th->wait_obj = obj;
+  myth_wbarrier();
+  th->wait_cancel = fn;
+}
+
+//With th->lock held, take th out of the cancellable wait it is
+//parked in, if any, and make it runnable on this worker
+static inline void myth_wait_interrupt(myth_thread_t th) {
+  myth_wait_cancel_t fn = th->wait_cancel;
+  if (fn && fn(th, th->wait_obj)) {
+    myth_running_env_t env = myth_get_current_env();
+    th->wait_cancel = 0;
+    th->interrupted = 1;
+    th->env = env;
+    myth_queue_push(&env->runnable_q, th);
+  }
+}
+
+//Act on a request that came before th became visible in its wait
+static inline void myth_wait_check_cancel(myth_thread_t th) {
+  myth_rwbarrier();
+  if (myth_cancel_pending(th)) {
+    myth_spin_lock_body(&th->lock);
+    myth_wait_interrupt(th);
+    myth_spin_unlock_body(&th->lock);
+  }
+}
+
+//Called by th resumed from a cancellable wait.
+//1 if it was woken by cancellation
+static inline int myth_wait_done(myth_thread_t th) {
+  myth_spin_lock_body(&th->lock);
+  th->wait_cancel = 0;
+  myth_spin_unlock_body(&th->lock);
+  return th->interrupted;
+}
+
+/* --------
+   cancel groups
+   -------- */
+
+//Put a thread being created in the cancel group of attr,
+//or else in that of its creator, if any
+static inline void myth_cancel_group_enter(myth_running_env_t env,
+					   myth_thread_attr_t * attr,
+					   myth_thread_t creator,
+					   myth_thread_t th) {
+  myth_cancel_group_t g = (attr ? attr->cancel_group : 0);
+  myth_cancel_group_list_t * l;
+  if (!g && creator) g = creator->cancel_group;
+  if (!g) return;
+  l = &g->lists[env->rank];
+  th->cancel_group = g;
+  th->group_slot = env->rank;
+  th->group_prev = 0;
+  myth_spin_lock_body(&l->lock);
+  th->group_next = l->head;
+  if (l->head) l->head->group_prev = th;
+  l->head = th;
+  myth_spin_unlock_body(&l->lock);
+}
+
+//Take a finishing thread out of its cancel group
+static inline void myth_cancel_group_leave(myth_thread_t th) {
+  myth_cancel_group_list_t * l = &th->cancel_group->lists[th->group_slot];
+  myth_spin_lock_body(&l->lock);
+  if (th->group_prev) th->group_prev->group_next = th->group_next;
+  else l->head = th->group_next;
+  if (th->group_next) th->group_next->group_prev = th->group_prev;
+  myth_spin_unlock_body(&l->lock);
+  th->cancel_group = 0;
+}
+
+/* --------
+   create
+   -------- */
+
+//Allocate and initialize the descriptor and the stack of a
+//thread about to be created, leaving its context to the caller
+static inline myth_thread_t myth_create_alloc(myth_running_env_t env,
+					      myth_thread_attr_t * attr,
+					      void * arg, void ** stk_p,
+					      size_t * stk_size_p) {
   size_t stack_size       = (attr ? attr->stacksize : 0);
   size_t custom_data_size = (attr ? attr->custom_data_size : 0);
   void * custom_data      = (attr ? attr->custom_data : 0);
-  int child_first         = (attr ? attr->child_first : 1);
-  myth_running_env_t env = myth_get_current_env();
-  //myth_log_add(env,MYTH_LOG_INT);
   // Allocate new thread descriptor
   myth_thread_t new_thread = get_new_myth_thread_struct_desc(env);
-  (void)_;
   new_thread->next = 0;
+  env->stats.n_creates++;
 #if MYTH_DEBUG_JOIN_FCC
   new_thread->join_called_at = 0;
   new_thread->child_status_when_join_was_called = "";
@@ -404,9 +551,6 @@ static inline int myth_create_ex_body(myth_thread_t * id,
   new_thread->waiter = (struct myth_thread *)-1;
   new_thread->when_I_finished = "";
 #endif
-  /* todo: make this a part of allocation and unify 
-     with myth_startpoint_init_ex_body */
-  myth_tls_tree_init(new_thread->tls);
 
 #if MYTH_SPLIT_STACK_DESC /* default */
   // allocate stack and get pointer
@@ -419,22 +563,49 @@ static inline int myth_create_ex_body(myth_thread_t * id,
 
   //Allocate custom data region on stack
   if (custom_data_size > 0){
-    new_thread->custom_data_size = custom_data_size;
+    myth_thread_ext_t * ext = myth_thread_ext_get(new_thread);
+    ext->custom_data_size = custom_data_size;
     intptr_t i_stk = (intptr_t)stk;
     //Align 16byte
     i_stk -= 16 + (((custom_data_size + 15) >> 4) << 4);
-    new_thread->custom_data_ptr = (void*)(i_stk + 16);
+    ext->custom_data_ptr = (void*)(i_stk + 16);
     memcpy((void*)(i_stk + 16), custom_data, custom_data_size);
     stk = (void*)i_stk;
-  } else {
-    new_thread->custom_data_size = 0;
+  } else if (new_thread->ext) {
+    //Left by the previous user of this descriptor
+    new_thread->ext->custom_data_size = 0;
   }
 
   // Initialize thread descriptor
   init_myth_thread_struct(env, new_thread);
   new_thread->result = arg;
+  if (attr && attr->fpcsr == MYTH_FPCSR_SAVE) new_thread->save_fpcsr = 1;
+
+  stk_p[0] = stk;
+  stk_size_p[0] = stack_size - sizeof(void*) * 2;
+  return new_thread;
+}
+
+static inline int myth_create_ex_body(myth_thread_t * id,
+				      myth_thread_attr_t * attr,
+				      myth_func_t func, void *arg) {
+#if MYTH_CREATE_PROF
+  uint64_t t0 = myth_get_rdtsc();
+#endif /* MYTH_CREATE_PROF */
+#if MYTH_CREATE_PROF_DETAIL
+  uint64_t t0 = myth_get_rdtsc();
+#endif /* MYTH_CREATE_PROF_DETAIL */
 
-  size_t stk_size = stack_size - sizeof(void*) * 2;
+  int _ = myth_ensure_init();
+  int child_first         = (attr ? attr->child_first : 1);
+  myth_running_env_t env = myth_get_current_env();
+  void * stk;
+  size_t stk_size;
+  //myth_log_add(env,MYTH_LOG_INT);
+  myth_thread_t new_thread = myth_create_alloc(env, attr, arg,
+					       &stk, &stk_size);
+  (void)_;
+  myth_cancel_group_enter(env, attr, env->this_thread, new_thread);
   if (child_first){
     myth_make_context_empty(&new_thread->context, stk, stk_size);
 
@@ -453,7 +624,7 @@ static inline int myth_create_ex_body(myth_thread_t * id,
 #if MYTH_CREATE_PROF_DETAIL
     env->prof_data.create_d_tmp = myth_get_rdtsc();
 #endif /* MYTH_CREATE_PROF_DETAIL */
-    myth_swap_context_withcall(&this_thread->context,
+    myth_swap_context_withcall(this_thread,
 			       &new_thread->context,
 			       myth_create_1,
 			       (void*)env, (void*)func, (void*)new_thread);
@@ -484,6 +655,157 @@ static inline int myth_create_ex_body(myth_thread_t * id,
   return 0;
 }
 
+/* --------
+   create_many
+   -------- */
+
+//Put threads created by myth_create_many in a runqueue,
+//that of an idle worker if there is one
+static inline void myth_create_many_put(myth_thread_t * th, int n,
+					int * next_target) {
+  myth_running_env_t env = myth_get_current_env();
+  int j;
+#if MYTH_CREATE_MANY_SPREAD
+  int nw = g_attr.n_workers;
+  int i;
+  for (i = 0; i < nw - 1; i++) {
+    myth_running_env_t target = &g_envs[next_target[0]];
+    next_target[0] = (next_target[0] + 1) % nw;
+    if (target == env) continue;
+    if (target->runnable_q.top > target->runnable_q.base) continue;
+    //Threads in a runqueue belong to its worker
+    for (j = 0; j < n; j++) th[j]->env = target;
+    if (myth_queue_trypass_many(&target->runnable_q, th, n)) return;
+    for (j = 0; j < n; j++) th[j]->env = env;
+  }
+#else
+  (void)next_target;
+#endif
+  //Let those created so far run while there is no room for more
+  while (env->runnable_q.size - (env->runnable_q.top - env->runnable_q.base) < n) {
+    myth_yield_ex_body(myth_yield_option_local_only);
+    env = myth_get_current_env();
+    for (j = 0; j < n; j++) th[j]->env = env;
+  }
+  myth_queue_push_many(&env->runnable_q, th, n);
+}
+
+static inline int myth_create_many_body(myth_thread_t * ids,
+					myth_thread_attr_t * attr,
+					myth_func_t func, void * args,
+					size_t arg_stride, long nthreads) {
+  int _ = myth_ensure_init();
+  myth_running_env_t env = myth_get_current_env();
+  myth_thread_t th[MYTH_CREATE_MANY_CHUNK];
+  int next_target = env->rank;
+  long i;
+  int n = 0;
+  (void)_;
+  for (i = 0; i < nthreads; i++) {
+    void * stk;
+    size_t stk_size;
+    void * arg = (char *)args + i * arg_stride;
+    myth_thread_t new_thread = myth_create_alloc(env, attr, arg,
+						 &stk, &stk_size);
+    myth_cancel_group_enter(env, attr, env->this_thread, new_thread);
+    new_thread->entry_func = func;
+    myth_make_context_voidcall(&new_thread->context, myth_entry_point,
+			       stk, stk_size);
+    if (ids) {
+      ids[i] = new_thread;
+    } else {
+      //Nobody is to join it
+      new_thread->join_thread = MYTH_JOIN_DETACHED;
+    }
+    th[n++] = new_thread;
+    if (n == MYTH_CREATE_MANY_CHUNK) {
+      myth_create_many_put(th, n, &next_target);
+      //We may have moved to another worker
+      env = myth_get_current_env();
+      n = 0;
+    }
+  }
+  if (n) myth_create_many_put(th, n, &next_target);
+  return 0;
+}
+
+/* --------
+   lazily created tasks
+   -------- */
+
+/* a spawned task is only a record in the spawner's task queue.
+   the spawner joining it finds it on top and calls it on its own
+   stack; a worker that takes it instead (see myth_task_steal)
+   gives it a descriptor and a stack first */
+
+//Make a thread for a task taken from a task queue.
+//The task may be gone as soon as its state is set
+static inline myth_thread_t myth_task_materialize(myth_running_env_t env,
+						  myth_task_t * t) {
+  void * stk;
+  size_t stk_size;
+  myth_thread_t th = myth_create_alloc(env, 0, t->arg, &stk, &stk_size);
+  //The spawner is alive until it joins t
+  myth_cancel_group_enter(env, 0, t->spawner, th);
+  th->entry_func = t->func;
+  myth_make_context_voidcall(&th->context, myth_entry_point,
+			     stk, stk_size);
+  t->thread = th;
+  myth_wbarrier();
+  t->state = MYTH_TASK_TAKEN;
+  return th;
+}
+
+//1 if t is among the tasks in q not yet taken
+static inline int myth_task_queued(myth_thread_queue_t q, myth_task_t * t) {
+  int i;
+  for (i = q->top - 1; i >= q->base; i--) {
+    if (q->ptr[i] == (myth_thread_t)t) return 1;
+  }
+  return 0;
+}
+
+static inline int myth_task_spawn_body(myth_task_t * t,
+				       myth_func_t func, void * arg) {
+  int _ = myth_ensure_init();
+  myth_running_env_t env = myth_get_current_env();
+  (void)_;
+  t->func = func;
+  t->arg = arg;
+  t->thread = 0;
+  t->spawner = env->this_thread;
+  t->state = MYTH_TASK_PENDING;
+  myth_queue_push(&env->task_q, (myth_thread_t)t);
+  env->stats.n_task_spawns++;
+  return 0;
+}
+
+static inline int myth_task_join_body(myth_task_t * t, void ** result) {
+  while (t->state == MYTH_TASK_PENDING) {
+    myth_running_env_t env = myth_get_current_env();
+    myth_task_t * o;
+    if (myth_task_queued(&env->task_q, t)) {
+      //Usually on top. Otherwise tasks spawned after it
+      //are handed out until it is
+      o = (myth_task_t *)myth_queue_pop(&env->task_q);
+      if (o == t) {
+	void * r = t->func(t->arg);
+	if (result) *result = r;
+	return 0;
+      }
+      if (o) myth_queue_push(&env->runnable_q, myth_task_materialize(env, o));
+    } else {
+      //Being taken, or left on the queue of a worker we
+      //migrated from; help whoever is to run it
+      myth_thread_t th = myth_task_take_other(env);
+      if (th) myth_queue_push(&env->runnable_q, th);
+      myth_yield_body();
+    }
+  }
+  myth_rbarrier();
+  return myth_join_body(t->thread, result);
+}
+
 /* --------
    exit
    -------- */
@@ -506,18 +828,34 @@ static inline void myth_join_1(myth_running_env_t e,myth_thread_t th,void **resu
   if (result!=NULL){
     *result=th->result;
   }
+  //Handed over to us with its stack (see myth_entry_point_cleanup)
+  if (th->status==MYTH_STATUS_FREE_READY)
+    free_myth_thread_struct_stack(e,th);
   free_myth_thread_struct_desc(e,th);
 }
 
+//Called once this_thread, which is to wait for th, is off its
+//stack. Should th have finished in the meantime, this_thread
+//goes back to the runqueue rather than waiting
+static inline void myth_join_park(myth_running_env_t env,
+				  myth_thread_t this_thread,
+				  myth_thread_t th)
+{
+  if (!myth_desc_join_set(th,this_thread)){
+    this_thread->status=MYTH_STATUS_READY;
+    myth_queue_push(&env->runnable_q,this_thread);
+  }
+}
+
 MYTH_CTX_CALLBACK void myth_join_2(void *arg1,void *arg2,void *arg3)
 {
   myth_running_env_t env=arg1;
   myth_thread_t th=arg2,next_thread=arg3;
-  //Set join target
-  myth_desc_join_set(th,env->this_thread);
-  myth_spin_unlock_body(&th->lock);
+  myth_thread_t this_thread=env->this_thread;
   //Change current running thread
   env->this_thread=next_thread;
+  //Set join target
+  myth_join_park(env,this_thread,th);
   //myth_log_add(env,MYTH_LOG_USER);
 }
 
@@ -526,9 +864,7 @@ MYTH_CTX_CALLBACK void myth_join_3(void *arg1,void *arg2,void *arg3)
   myth_thread_t this_thread=arg1,th=arg2;
   (void)arg3;
   //Set join target
-  myth_desc_join_set(th,this_thread);
-  //Change current running thread
-  myth_spin_unlock_body(&th->lock);
+  myth_join_park(this_thread->env,this_thread,th);
 }
 
 //Wait until the finish of a thread
@@ -551,40 +887,6 @@ static inline int myth_join_body(myth_thread_t th,void **result) {
 #if MYTH_JOIN_DEBUG
   myth_dprintf("myth_join:join started\n");
 #endif
-#if QUICK_CHECK_ON_JOIN
-
-#error "I told you to turn this off"
-  
-  //If target is finished, return immediately
-  if (th->status == MYTH_STATUS_FREE_READY2){
-#if MYTH_JOIN_DEBUG
-    myth_dprintf("myth_join:join thread (%p) is already finished. Return immediately\n",th);
-#endif
-    //guarantee that successive read starts after this line
-    myth_rbarrier();
-#if MYTH_JOIN_PROF_DETAIL
-    if (result) *result = th->result;
-    t1 = myth_get_rdtsc();
-    env->prof_data.join_join += t1 - t0;
-    t0 = myth_get_rdtsc();
-    free_myth_thread_struct_desc(env,th);
-    t1 = myth_get_rdtsc();
-    env->prof_data.join_release += t1 - t0;
-    env->prof_data.join_d_cnt++;
-#else
-    myth_join_1(env,th,result);
-#endif
-#if MYTH_JOIN_PROF
-    t1 = myth_get_rdtsc();
-    env->prof_data.join_cycles += t1-t0;
-    env->prof_data.join_cnt++;
-#endif
-    //myth_log_add(env,MYTH_LOG_USER);
-    return 0;
-  }
-#endif
-  //Obtain lock and check again
-  myth_spin_lock_body(&th->lock);
   //If target is finished, return
   if (myth_desc_is_finished(th)){
 #if MYTH_DEBUG_JOIN_FCC
@@ -595,8 +897,6 @@ static inline int myth_join_body(myth_thread_t th,void **result) {
 #if MYTH_JOIN_DEBUG
     myth_dprintf("myth_join:join thread (%p) is already finished. Return immediately\n",th);
 #endif
-    myth_spin_unlock_body(&th->lock);
-    while (th->status != MYTH_STATUS_FREE_READY2);
 #if MYTH_JOIN_PROF_DETAIL
     if (result) *result = th->result;
     t1 = myth_get_rdtsc();
@@ -619,6 +919,7 @@ static inline int myth_join_body(myth_thread_t th,void **result) {
   }
   //Set current thread as blocked
   myth_desc_set_not_runnable(this_thread);
+  env->stats.n_join_blocks++;
 #if MYTH_JOIN_DEBUG
   myth_dprintf("myth_join:%p is added to %p's waiting list\n",this_thread,th);
 #endif
@@ -635,7 +936,7 @@ static inline int myth_join_body(myth_thread_t th,void **result) {
 #endif
     next->env=env;
     //Switch to next runnable thread
-    myth_swap_context_withcall(&this_thread->context,&next->context,myth_join_2,
+    myth_swap_context_withcall(this_thread,&next->context,myth_join_2,
 			       (void*)env,(void*)th,(void*)next);
   }
   else{
@@ -645,7 +946,7 @@ static inline int myth_join_body(myth_thread_t th,void **result) {
 #endif
     //myth_log_add(this_thread->env,MYTH_LOG_WS);
     //Since there is no runnable thread, switch to scheduler and do work-steaing
-    myth_swap_context_withcall(&this_thread->context,&env->sched.context,myth_join_3,
+    myth_swap_context_withcall(this_thread,&env->sched.context,myth_join_3,
 			       (void*)this_thread,(void*)th,NULL);
   }
 #if MYTH_JOIN_PROF
@@ -655,15 +956,8 @@ static inline int myth_join_body(myth_thread_t th,void **result) {
 #if MYTH_JOIN_DEBUG
   myth_dprintf("myth_join:%p is resumed\n",this_thread);
 #endif
-#if 0
-  myth_spin_lock_body(&th->lock);
-  //In this position, target is guaranteed to be finished
-  myth_assert(myth_desc_is_runnable(this_thread));
+  //Resumed only after th was marked finished (see myth_entry_point_finish)
   myth_assert(myth_desc_is_finished(th));
-  //Get return value
-  myth_spin_unlock_body(&th->lock);
-#endif
-  while (th->status != MYTH_STATUS_FREE_READY2) { }
   // use myth_get_current_env_noinline here to prevent compiler from sharing
   // the same g_worker_rank before and after context switching
   myth_join_1(myth_get_current_env_noinline(),th,result);
@@ -685,17 +979,12 @@ static inline int myth_tryjoin_body(myth_thread_t th,void **result) {
   //TODO:Fix th->status is blocked after join
   myth_running_env_t env;
   env = myth_get_current_env();
-  //Obtain lock and check again
-  myth_spin_lock_body(&th->lock);
   //If target is finished, return
   if (myth_desc_is_finished(th)){
-    myth_spin_unlock_body(&th->lock);
-    while (th->status != MYTH_STATUS_FREE_READY2) { }
     myth_join_1(env,th,result);
     //myth_log_add(env,MYTH_LOG_USER);
     return 0;
   } else {
-    myth_spin_unlock_body(&th->lock);
     return EBUSY;
   }
 }
@@ -704,21 +993,6 @@ static inline int myth_tryjoin_body(myth_thread_t th,void **result) {
    timedjoin
    -------- */
 
-static inline void myth_timespec_add(const struct timespec * a,
-				     const struct timespec * b,
-				     struct timespec * c) {
-  long ns = a->tv_nsec + b->tv_nsec;
-  c->tv_nsec = ns % 1000000000;
-  c->tv_sec = a->tv_sec + b->tv_sec + ns / 1000000000;
-}
-
-static inline int myth_timespec_gt(const struct timespec * a,
-				   const struct timespec * b) {
-  if (a->tv_sec > b->tv_sec) return 1;
-  if (a->tv_sec == b->tv_sec) return a->tv_nsec > b->tv_nsec;
-  return 0;
-}
-
 //Wait until the finish of a thread
 static inline int myth_timedjoin_body(myth_thread_t th,
 				      void **result,
@@ -755,32 +1029,84 @@ typedef struct {
   size_t func_stride;		/* stride of funcs between consecutive threads */
   size_t arg_stride;            /* stride of args  between consecutive threads */
   size_t result_stride;		/* stride of results between consecutive threads */
+  long grain;			/* ranges up to this long run on one thread,
+				   or MYTH_GRAINSIZE_AUTO */
+  long chunk;			/* elements run between checks in auto mode */
   long a;			/* from  */
   long b;			/* to */
 } myth_create_join_various_arg;
 
+/* call f(x) for the a-th element */
+static inline void myth_create_join_various_ex_one(myth_create_join_various_arg * meta_arg,
+						   long a) {
+  void * ids     = (meta_arg->ids   ? (char *)meta_arg->ids   + a * meta_arg->id_stride : 0);
+  void * funcs   = (char *)meta_arg->funcs   + a * meta_arg->func_stride;
+  void * args    = (char *)meta_arg->args    + a * meta_arg->arg_stride;
+  void * results = (meta_arg->results ? (char *)meta_arg->results + a * meta_arg->result_stride : 0);
+  if (ids) {
+    ((myth_thread_t *)ids)[0] = myth_self();
+  }
+  myth_func_t func = ((myth_func_t *)funcs)[0]; /* call f(x) */
+  void * y = func(args);
+  if (results) {
+    ((void **)results)[0] = y;
+  }
+}
+
+/* in auto mode, a range is split only while a thread made for
+   half of it may be taken by an idle worker: one is in its
+   scheduler and nothing else is left here to take */
+static inline int myth_create_join_should_split(void) {
+  myth_running_env_t env = myth_get_current_env();
+  int i;
+  if (env->runnable_q.top > env->runnable_q.base) return 0;
+  for (i = 0; i < g_attr.n_workers; i++) {
+    if (!*(myth_thread_t volatile *)&g_envs[i].this_thread) return 1;
+  }
+  return 0;
+}
+
+/* run elements from the left of the range until it is worth
+   splitting the rest, checking after chunks of elements that
+   take about MYTH_GRAINSIZE_AUTO_CYCLES. returns where it stopped */
+static inline long myth_create_join_various_ex_lazy(myth_create_join_various_arg * meta_arg) {
+  long a = meta_arg->a;
+  long b = meta_arg->b;
+  while (a < b) {
+    if (b - a > 1 && myth_create_join_should_split()) break;
+    long e = (b - a < meta_arg->chunk ? b : a + meta_arg->chunk);
+    uint64_t t0 = myth_get_rdtsc();
+    for (; a < e; a++) {
+      myth_create_join_various_ex_one(meta_arg, a);
+    }
+    uint64_t t = myth_get_rdtsc() - t0;
+    if (t < MYTH_GRAINSIZE_AUTO_CYCLES / 2) {
+      if (meta_arg->chunk < MYTH_GRAINSIZE_AUTO_MAX_CHUNK) meta_arg->chunk *= 2;
+    } else if (t > MYTH_GRAINSIZE_AUTO_CYCLES * 2) {
+      if (meta_arg->chunk > 1) meta_arg->chunk /= 2;
+    }
+  }
+  return a;
+}
+
 static inline void * myth_create_join_various_ex_aux(void * meta_arg_) {
   myth_create_join_various_arg * meta_arg = meta_arg_;
   long a               = meta_arg->a;
   long b               = meta_arg->b;
+  long grain           = meta_arg->grain;
   size_t id_stride     = meta_arg->id_stride;
   size_t attr_stride   = meta_arg->attr_stride;
   size_t func_stride   = meta_arg->func_stride;
   size_t arg_stride    = meta_arg->arg_stride;
   size_t result_stride = meta_arg->result_stride;
 
-  if (b - a == 1) {
-    void * ids     = (meta_arg->ids   ? (char *)meta_arg->ids   + a * id_stride : 0);
-    void * funcs   = (char *)meta_arg->funcs   + a * func_stride;
-    void * args    = (char *)meta_arg->args    + a * arg_stride; 
-    void * results = (meta_arg->results ? (char *)meta_arg->results + a * result_stride : 0);  
-    if (ids) {
-      ((myth_thread_t *)ids)[0] = myth_self();
-    }
-    myth_func_t func = ((myth_func_t *)funcs)[0]; /* call f(x) */
-    void * y = func(args);
-    if (results) {
-      ((void **)results)[0] = y;
+  if (grain == MYTH_GRAINSIZE_AUTO) {
+    a = myth_create_join_various_ex_lazy(meta_arg);
+    grain = 1;
+  }
+  if (b - a <= grain) {
+    for (; a < b; a++) {
+      myth_create_join_various_ex_one(meta_arg, a);
     }
   } else {
     long c = (a + b) / 2;
@@ -789,13 +1115,13 @@ static inline void * myth_create_join_various_ex_aux(void * meta_arg_) {
     void * funcs  = meta_arg->funcs;
     void * args   = meta_arg->args;
     void * results = meta_arg->results;
-    myth_create_join_various_arg carg[2] = { 
-      { ids, attrs, funcs, args, results, 
-	id_stride, attr_stride, func_stride, arg_stride, result_stride, 
-	a, c },
-      { ids, attrs, funcs, args, results, 
-	id_stride, attr_stride, func_stride, arg_stride, result_stride, 
-	c, b }
+    myth_create_join_various_arg carg[2] = {
+      { ids, attrs, funcs, args, results,
+	id_stride, attr_stride, func_stride, arg_stride, result_stride,
+	meta_arg->grain, meta_arg->chunk, a, c },
+      { ids, attrs, funcs, args, results,
+	id_stride, attr_stride, func_stride, arg_stride, result_stride,
+	meta_arg->grain, meta_arg->chunk, c, b }
     };
     myth_thread_attr_t * attr_a = (myth_thread_attr_t *)(attrs ? (char *)attrs + a * attr_stride : 0);
     myth_thread_t cid = 0;
@@ -809,6 +1135,32 @@ static inline void * myth_create_join_various_ex_aux(void * meta_arg_) {
   return 0;
 }
 
+static inline int myth_create_join_various_grain_ex_body(myth_thread_t * ids,
+							 myth_thread_attr_t * attrs,
+							 myth_func_t * funcs,
+							 void * args,
+							 void * results,
+							 size_t id_stride,
+							 size_t attr_stride,
+							 size_t func_stride,
+							 size_t arg_stride,
+							 size_t result_stride,
+							 long nthreads,
+							 long grainsize) {
+  if (nthreads == 0) return 0;
+  if (grainsize < 0) return EINVAL;
+  myth_create_join_various_arg arg[1] = {
+    {
+      ids,       attrs,       funcs,       args,       results,
+      id_stride, attr_stride, func_stride, arg_stride, result_stride,
+      grainsize, 1, 0, nthreads
+    }
+  };
+  void * r = myth_create_join_various_ex_aux(arg);
+  assert(r == 0);
+  return 0;
+}
+
 static inline int myth_create_join_various_ex_body(myth_thread_t * ids,
 						   myth_thread_attr_t * attrs,
 						   myth_func_t * funcs,
@@ -820,17 +1172,27 @@ static inline int myth_create_join_various_ex_body(myth_thread_t * ids,
 						   size_t arg_stride,
 						   size_t result_stride,
 						   long nthreads) {
-  if (nthreads == 0) return 0;
-  myth_create_join_various_arg arg[1] = {
-    { 
-      ids,       attrs,       funcs,       args,       results, 
-      id_stride, attr_stride, func_stride, arg_stride, result_stride,
-      0, nthreads 
-    }
-  };
-  void * r = myth_create_join_various_ex_aux(arg);
-  assert(r == 0);
-  return 0;
+  return myth_create_join_various_grain_ex_body(ids, attrs, funcs, args, results,
+						id_stride, attr_stride, func_stride,
+						arg_stride, result_stride,
+						nthreads, 1);
+}
+
+static inline int myth_create_join_many_grain_ex_body(myth_thread_t * ids,
+						      myth_thread_attr_t * attrs,
+						      myth_func_t func,
+						      void * args,
+						      void * results,
+						      size_t id_stride,
+						      size_t attr_stride,
+						      size_t arg_stride,
+						      size_t result_stride,
+						      long nthreads,
+						      long grainsize) {
+  myth_func_t funcs[1] = { func };
+  return myth_create_join_various_grain_ex_body(ids, attrs, funcs, args, results,
+						id_stride, attr_stride, 0, arg_stride, result_stride,
+						nthreads, grainsize);
 }
 
 static inline int myth_create_join_many_ex_body(myth_thread_t * ids,
@@ -843,10 +1205,9 @@ static inline int myth_create_join_many_ex_body(myth_thread_t * ids,
 						size_t arg_stride,
 						size_t result_stride,
 						long nthreads) {
-  myth_func_t funcs[1] = { func };
-  return myth_create_join_various_ex_body(ids, attrs, funcs, args, results,
-					  id_stride, attr_stride, 0, arg_stride, result_stride,
-					  nthreads);
+  return myth_create_join_many_grain_ex_body(ids, attrs, func, args, results,
+					     id_stride, attr_stride, arg_stride, result_stride,
+					     nthreads, 1);
 }
 
 /* --------
@@ -855,21 +1216,11 @@ static inline int myth_create_join_many_ex_body(myth_thread_t * ids,
 
 static inline int myth_detach_body(myth_thread_t th)
 {
-  if (th->status==MYTH_STATUS_FREE_READY2){
+  //Set a thread as detached, unless it is finished
+  if (!myth_desc_set_detached(th)){
     //If a thread is finished, just release resource
+    myth_assert(myth_desc_is_finished(th));
     free_myth_thread_struct_desc(myth_get_current_env(),th);
-    return 0;
-  }
-  //Obtain lock
-  myth_spin_lock_body(&th->lock);
-  if (myth_desc_is_finished(th)){//If a thread is finished, release resource
-    myth_spin_unlock_body(&th->lock);
-    while (th->status!=MYTH_STATUS_FREE_READY2);
-    free_myth_thread_struct_desc(myth_get_current_env(),th);
-  }
-  else{//Set a thread as detached
-    myth_desc_set_detached(th);
-    myth_spin_unlock_body(&th->lock);
   }
   return 0;
 }
@@ -884,6 +1235,10 @@ static inline int myth_thread_attr_init_body(myth_thread_attr_t * attr) {
   attr->detachstate = 0;
   myth_globalattr_get_guardsize_body(0, &attr->guardsize);
   myth_globalattr_get_child_first_body(0, &attr->child_first);
+  attr->fpcsr = MYTH_FPCSR_SHARED;
+  attr->cancel_group = 0;
+  attr->custom_data_size = 0;
+  attr->custom_data = 0;
   return 0;
 }
 
@@ -937,12 +1292,49 @@ static inline int myth_thread_attr_setstack_body(myth_thread_attr_t *attr,
   return 0;
 }
 
+static inline int myth_thread_attr_getfpcsr_body(const myth_thread_attr_t *attr,
+						 int *fpcsr) {
+  *fpcsr = attr->fpcsr;
+  return 0;
+}
+
+static inline int myth_thread_attr_setfpcsr_body(myth_thread_attr_t *attr,
+						 int fpcsr) {
+  if (fpcsr != MYTH_FPCSR_SHARED && fpcsr != MYTH_FPCSR_SAVE) return EINVAL;
+  attr->fpcsr = fpcsr;
+  return 0;
+}
+
+static inline int
+myth_thread_attr_getcancelgroup_body(const myth_thread_attr_t *attr,
+				     myth_cancel_group_t *g) {
+  *g = attr->cancel_group;
+  return 0;
+}
+
+static inline int
+myth_thread_attr_setcancelgroup_body(myth_thread_attr_t *attr,
+				     myth_cancel_group_t g) {
+  attr->cancel_group = g;
+  return 0;
+}
+
 static inline int myth_getattr_default_body(myth_thread_attr_t *attr) {
   return myth_thread_attr_init_body(attr);
 }
 
+/* attributes are not kept in descriptors; rebuild them
+   from what the descriptor knows */
 static inline int myth_getattr_body(myth_thread_t thread, myth_thread_attr_t *attr) {
-  *attr = thread->attr;
+  myth_thread_attr_init_body(attr);
+  if (thread->stack_size) attr->stacksize = thread->stack_size;
+  attr->detachstate = (thread->join_thread == MYTH_JOIN_DETACHED);
+  attr->fpcsr = (thread->save_fpcsr ? MYTH_FPCSR_SAVE : MYTH_FPCSR_SHARED);
+  attr->cancel_group = thread->cancel_group;
+  if (thread->ext) {
+    attr->custom_data_size = thread->ext->custom_data_size;
+    attr->custom_data = thread->ext->custom_data_ptr;
+  }
   return 0;
 }
 
@@ -1017,10 +1409,13 @@ static inline int myth_yield_ex_body(int opt) {
   default:
     assert(0);
   }
+#if MYTH_WRAP_SOCKIO
+  if (g_myth_io_on)next=myth_io_polling_between(env,next);
+#endif
   if (next) {
     next->env=env;
     //Switch context and push current thread to runqueue
-    myth_swap_context_withcall(&th->context, &next->context,
+    myth_swap_context_withcall(th, &next->context,
 			       myth_yield_ex_1,
 			       (void*)env, (void*)th, (void*)next);
   }
@@ -1034,10 +1429,10 @@ static inline int myth_yield_body(void) {
   return myth_yield_ex_body(myth_yield_option_half_half);
 }
 
+//Return 0, EINVAL, or ECANCELED with the time left in REM (if not NULL)
 static inline int myth_nanosleep_body(const struct timespec *req,
 				      struct timespec *rem) {
   struct timespec unt[1], cur[1];
-  (void)rem;
   if (req->tv_sec < 0) return EINVAL;
   if (req->tv_nsec < 0) return EINVAL;
   if (req->tv_nsec > 999999999) return EINVAL;
@@ -1046,6 +1441,11 @@ static inline int myth_nanosleep_body(const struct timespec *req,
   while (1) {
     hr_gettime(cur);
     if (myth_timespec_gt(cur, unt)) break;
+    //Woken up by cancellation (see myth_cancel_body)
+    if (myth_cancel_pending(myth_self_body())) {
+      if (rem) myth_timespec_sub(unt, cur, rem);
+      return ECANCELED;
+    }
     myth_yield_body();
   }
   return 0;
@@ -1058,11 +1458,13 @@ static inline int myth_usleep_body(useconds_t usec) {
   return myth_nanosleep_body(req, 0);
 }
 
+//Return the seconds left when cancelled, rounded as glibc's sleep does
 static inline unsigned int myth_sleep_body(unsigned int s) {
-  struct timespec req[1];
+  struct timespec req[1], rem[1];
   req->tv_sec = s;
   req->tv_nsec = 0;
-  return myth_nanosleep_body(req, 0);
+  if (myth_nanosleep_body(req, rem) != ECANCELED) return 0;
+  return rem->tv_sec + (rem->tv_nsec >= 500000000);
 }
 
 
@@ -1089,6 +1491,31 @@ static void __attribute__((unused)) myth_entry_point(void)
   myth_entry_point_cleanup(this_thread);
 }
 
+//Mark this_thread finished once it is off its stack. It may be
+//released by its joiner right after that, so this is the last
+//access to it unless it is detached. A thread that started
+//waiting for it after it chose next_thread is woken here
+static inline void myth_entry_point_finish(myth_running_env_t env,
+					   myth_thread_t this_thread,
+					   myth_thread_t next_thread)
+{
+  myth_thread_t wait_thread;
+  free_myth_thread_struct_stack(env,this_thread);
+  this_thread->status=MYTH_STATUS_FREE_READY2;
+  wait_thread=myth_desc_set_finished(this_thread);
+  if (wait_thread==MYTH_JOIN_DETACHED){
+    //The thread is detached. Release resource
+#if MYTH_ENTRY_POINT_DEBUG
+    myth_dprintf("Thread %p is detached.Freed resource\n",this_thread);
+#endif
+    free_myth_thread_struct_desc(env,this_thread);
+  } else if (wait_thread && wait_thread!=next_thread){
+    wait_thread->env=env;
+    wait_thread->status=MYTH_STATUS_READY;
+    myth_queue_push(&env->runnable_q,wait_thread);
+  }
+}
+
 //Switch to next_thread
 MYTH_CTX_CALLBACK void myth_entry_point_1(void *arg1,void *arg2,void *arg3)
 {
@@ -1101,25 +1528,7 @@ MYTH_CTX_CALLBACK void myth_entry_point_1(void *arg1,void *arg2,void *arg3)
   env->prof_data.ep_switch += t1-env->prof_data.ep_d_tmp;
   t0 = myth_get_rdtsc();
 #endif
-  free_myth_thread_struct_stack(env,this_thread);
-  if (this_thread->detached){
-    //The thread is detached. Release resource
-#if MYTH_ENTRY_POINT_DEBUG
-    myth_dprintf("Thread %p is detached.Freed resource\n",this_thread);
-#endif
-    myth_spin_unlock_body(&this_thread->lock);
-    free_myth_thread_struct_desc(env,this_thread);
-  }
-  else{
-#if QUICK_CHECK_ON_JOIN
-    this_thread->status = MYTH_STATUS_FREE_READY;
-    myth_spin_unlock_body(&this_thread->lock);
-    this_thread->status = MYTH_STATUS_FREE_READY2;
-#else
-    this_thread->status=MYTH_STATUS_FREE_READY2;
-    myth_spin_unlock_body(&this_thread->lock);
-#endif
-  }
+  myth_entry_point_finish(env,this_thread,next_thread);
   env->this_thread = next_thread;
 #if MYTH_EP_PROF_DETAIL
   t1=myth_get_rdtsc();
@@ -1150,25 +1559,7 @@ MYTH_CTX_CALLBACK void myth_entry_point_2(void *arg1,void *arg2,void *arg3)
   env->prof_data.ep_switch+=t1-env->prof_data.ep_d_tmp;
   t0=myth_get_rdtsc();
 #endif
-  free_myth_thread_struct_stack(env,this_thread);
-  if (this_thread->detached){
-    //The thread is detached. Release resource
-#if MYTH_ENTRY_POINT_DEBUG
-    myth_dprintf("Thread %p is detached.Freed resource\n",this_thread);
-#endif
-    myth_spin_unlock_body(&this_thread->lock);
-    free_myth_thread_struct_desc(env,this_thread);
-  }
-  else{
-#if QUICK_CHECK_ON_JOIN
-    this_thread->status=MYTH_STATUS_FREE_READY;
-    myth_spin_unlock_body(&this_thread->lock);
-    this_thread->status=MYTH_STATUS_FREE_READY2;
-#else
-    this_thread->status=MYTH_STATUS_FREE_READY2;
-    myth_spin_unlock_body(&this_thread->lock);
-#endif
-  }
+  myth_entry_point_finish(env,this_thread,NULL);
 #if MYTH_EP_PROF_DETAIL
   t1=myth_get_rdtsc();
   env->prof_data.ep_join+=t1-t0;
@@ -1183,9 +1574,12 @@ MYTH_CTX_CALLBACK void myth_entry_point_2(void *arg1,void *arg2,void *arg3)
 }
 
 static inline void myth_entry_point_cleanup(myth_thread_t this_thread) {
-  myth_tls_tree_fini(this_thread->tls, g_myth_tls_key_allocator);
+  if (this_thread->ext) {
+    //Make TLS empty for the next user of this descriptor
+    myth_tls_tree_fini(this_thread->ext->tls, g_myth_tls_key_allocator);
+    myth_tls_tree_init(this_thread->ext->tls);
+  }
   myth_running_env_t env;
-  myth_thread_t this_thread_v;
 #if MYTH_EP_PROF_DETAIL
   MAY_BE_UNUSED uint64_t t0,t1;
   t0 = 0; t1 = 0;
@@ -1203,12 +1597,15 @@ static inline void myth_entry_point_cleanup(myth_thread_t this_thread) {
   env = this_thread->env;
   myth_assert(this_thread->env == env);
   myth_assert(this_thread == env->this_thread);
+  //Whoever runs next on this worker expects the default FP control
+  myth_fpcsr_reset(this_thread);
+  if (this_thread->cancel_group) myth_cancel_group_leave(this_thread);
 #if MYTH_ENTRY_POINT_PROF
   env->prof_data.ep_cycles_tmp = t2;
 #endif
-  this_thread_v = this_thread;
-  myth_spin_lock_body(&this_thread->lock);
-  myth_thread_t wait_thread = this_thread_v->join_thread;
+  //A thread already waiting for current thread stays waiting
+  //until we mark current thread finished, so we can switch to it
+  myth_thread_t wait_thread = myth_desc_get_waiter(this_thread);
   //Execute a thread waiting for current thread
   if (wait_thread){
 #if MYTH_DEBUG_JOIN_FCC
@@ -1218,12 +1615,21 @@ static inline void myth_entry_point_cleanup(myth_thread_t this_thread) {
 #endif
     //sanity check
     myth_assert(wait_thread->status == MYTH_STATUS_BLOCKED);
-    wait_thread->env = env;
-    wait_thread->status = MYTH_STATUS_READY;
 #if MYTH_ENTRY_POINT_DEBUG
     myth_dprintf("Join process completed %p\n",this_thread);
 #endif
 #if SWITCH_AFTER_EXIT
+    wait_thread->env = env;
+    wait_thread->status = MYTH_STATUS_READY;
+#if MYTH_JOIN_HANDOFF
+    //Only wait_thread looks at current thread from now on, and it
+    //runs only after we leave this stack, so it can be told we
+    //finished before that and release the stack itself
+    this_thread->status = MYTH_STATUS_FREE_READY;
+    myth_desc_set_finished_to_waiter(this_thread);
+    env->this_thread = wait_thread;
+    myth_set_context(&wait_thread->context);
+#else
 #if MYTH_EP_PROF_DETAIL
     t1 = myth_get_rdtsc();
     env->prof_data.ep_join += t1 - t0;
@@ -1233,9 +1639,9 @@ static inline void myth_entry_point_cleanup(myth_thread_t this_thread) {
     myth_set_context_withcall(&wait_thread->context,
 			      myth_entry_point_1,
 			      (void*)env, this_thread, wait_thread);
+#endif
 #else
-    //Push to the runqueue
-    myth_queue_push(&env->runnable_q, wait_thread);
+    //Pushed to the runqueue by myth_entry_point_finish
 #endif
   }
 #if MYTH_EP_PROF_DETAIL
@@ -1284,13 +1690,67 @@ static inline void myth_entry_point_cleanup(myth_thread_t this_thread) {
 }
 
 static inline int myth_cancel_body(myth_thread_t th) {
-  //send cancel request
+  //send cancel request, and wake it up if it waits for something
   myth_spin_lock_body(&th->lock);
   th->cancelled = 1;
+  myth_rwbarrier();
+  if (th->cancel_enabled) myth_wait_interrupt(th);
   myth_spin_unlock_body(&th->lock);
   return 0;
 }
 
+static inline int myth_cancel_group_create_body(myth_cancel_group_t * gp) {
+  int _ = myth_ensure_init();
+  int n = g_attr.n_workers;
+  myth_cancel_group_t g;
+  void * p;
+  int i;
+  (void)_;
+  if (real_posix_memalign(&p, CACHE_LINE_SIZE,
+			  sizeof(struct myth_cancel_group)
+			  + sizeof(myth_cancel_group_list_t) * n))
+    return ENOMEM;
+  g = p;
+  g->cancelled = 0;
+  g->n_lists = n;
+  for (i = 0; i < n; i++) {
+    myth_spin_init_body(&g->lists[i].lock);
+    g->lists[i].head = 0;
+  }
+  *gp = g;
+  return 0;
+}
+
+static inline int myth_cancel_group_destroy_body(myth_cancel_group_t g) {
+  int i;
+  for (i = 0; i < g->n_lists; i++) {
+    if (g->lists[i].head) return EBUSY;
+  }
+  for (i = 0; i < g->n_lists; i++) myth_spin_destroy_body(&g->lists[i].lock);
+  real_free(g);
+  return 0;
+}
+
+//Threads joining g from now on see the request in
+//myth_cancel_pending; wake up those waiting
+static inline int myth_cancel_group_body(myth_cancel_group_t g) {
+  int i;
+  g->cancelled = 1;
+  myth_rwbarrier();
+  for (i = 0; i < g->n_lists; i++) {
+    myth_cancel_group_list_t * l = &g->lists[i];
+    myth_thread_t th;
+    myth_spin_lock_body(&l->lock);
+    for (th = l->head; th; th = th->group_next) {
+      myth_spin_lock_body(&th->lock);
+      if (th->cancel_enabled) myth_wait_interrupt(th);
+      myth_spin_unlock_body(&th->lock);
+    }
+    myth_spin_unlock_body(&l->lock);
+  }
+  return 0;
+}
+
 static inline int myth_setcancelstate_body(int state, int *oldstate) {
   //enable/disable cancel
   myth_thread_t th = myth_self_body();
@@ -1316,7 +1776,7 @@ static inline int myth_is_canceled(myth_thread_t th) {
   int c;
   //Is a thread cancelled?
   myth_spin_lock_body(&th->lock);
-  c = (th->cancel_enabled && th->cancelled) ? 1 : 0;
+  c = myth_cancel_pending(th);
   myth_spin_unlock_body(&th->lock);
   return c;
 }
@@ -110,6 +110,30 @@ static inline myth_sleep_queue_item_t myth_sleep_queue_deq(myth_sleep_queue_t *
   return head;		/* done */
 }
 
+/* take t out of q if it is there. 1 if it was */
+static inline int myth_sleep_queue_remove(myth_sleep_queue_t * q,
+					  myth_sleep_queue_item_t t) {
+  myth_spin_lock_body(q->ilock);
+  myth_sleep_queue_item_t prev = 0;
+  myth_sleep_queue_item_t x = q->head;
+  while (x && x != t) {
+    prev = x;
+    x = x->next;
+  }
+  if (x) {
+    if (prev) {
+      prev->next = x->next;
+    } else {
+      q->head = x->next;
+    }
+    if (q->tail == x) {
+      q->tail = prev;
+    }
+  }
+  myth_spin_unlock_body(q->ilock);
+  return x != 0;
+}
+
 
 #if 0				/* non-blocking version */
 
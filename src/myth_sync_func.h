@@ -74,6 +74,11 @@ MYTH_CTX_CALLBACK void myth_block_on_queue_cb(void *arg1,void *arg2,void *arg3)
      cur data structure before the context
      has been saved  */
   myth_sleep_queue_enq_th(q, cur);
+  /* it may have been cancelled before it entered q
+     (see myth_cond_wait_body) */
+  if (cur->wait_cancel) {
+    myth_wait_check_cancel(cur);
+  }
   if (m) {
     myth_mutex_unlock_body(m);
   }
@@ -100,7 +105,7 @@ static inline void myth_block_on_queue(myth_sleep_queue_t * q,
   }
   /* now save the current context, myth_sleep_queue_enq_th(q, cur)
      to put cur in the q, and jump to next_ctx */
-  myth_swap_context_withcall(&cur->context, next_ctx,
+  myth_swap_context_withcall(cur, next_ctx,
 			     myth_block_on_queue_cb, q, cur, m);
 }
 
@@ -148,7 +153,7 @@ static inline void myth_block_on_stack(myth_sleep_stack_t * s,
   }
   /* now save the current context, myth_sleep_queue_enq_th(q, cur)
      to put cur in the q, and jump to next_ctx */
-  myth_swap_context_withcall(&cur->context, next_ctx,
+  myth_swap_context_withcall(cur, next_ctx,
 			     myth_block_on_stack_cb, s, cur, m);
 }
 
@@ -794,9 +799,21 @@ static inline int myth_cond_signal_body(myth_cond_t * cond) {
   return 0;
 }
 
+/* take a thread waiting on a condition variable out of it
+   when it is cancelled (see myth_cancel_body) */
+static inline int myth_cond_wait_cancel(myth_thread_t th, void * q) {
+  return myth_sleep_queue_remove(q, (myth_sleep_queue_item_t)th);
+}
+
 static inline int myth_cond_wait_body(myth_cond_t * cond, myth_mutex_t * mutex) {
+  myth_thread_t th = myth_self_body();
+  int r;
+  if (myth_cancel_pending(th)) return ECANCELED;
+  myth_wait_cancellable(th, myth_cond_wait_cancel, cond->sleep_q);
   myth_block_on_queue(cond->sleep_q, mutex);
-  return myth_mutex_lock(mutex);
+  r = myth_mutex_lock(mutex);
+  if (myth_wait_done(th)) return ECANCELED;
+  return r;
 }
 
 static inline int
@@ -1080,7 +1097,7 @@ static inline int myth_uncond_wait_body(myth_uncond_t * u) {
   }
   /* now save the current context, myth_sleep_queue_enq_th(q, cur)
      to put cur in the q, and jump to next_ctx */
-  myth_swap_context_withcall(&cur->context, next_ctx,
+  myth_swap_context_withcall(cur, next_ctx,
 			     myth_uncond_wait_cb, u, cur, 0);
   return 0;
 }
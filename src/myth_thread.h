@@ -21,35 +21,105 @@ typedef enum {
   MYTH_STATUS_READY = 0,
   // Blocked
   MYTH_STATUS_BLOCKED = 1,
-  // Execution finished. But you have to obtain lock before release
+  //Execution finished and handed over to its joiner, which
+  //releases its stack too (see myth_entry_point_cleanup)
   MYTH_STATUS_FREE_READY = 2,
-  //Execution finished. Feel free to release
+  //Execution finished and off its stack. Whether it may be
+  //released is told by join_thread (see MYTH_JOIN_DONE)
   MYTH_STATUS_FREE_READY2 = 3,
 } myth_status_t;
 
-/* Thread descriptor */
+/* Values of join_thread other than the waiting thread.
+   it is changed only by compare-and-swap or exchange (or by a
+   store once a waiter is set), so a thread is released exactly
+   once: by its joiner or detacher
+   once it is MYTH_JOIN_DONE, or by the thread itself if it
+   finds MYTH_JOIN_DETACHED on finishing */
+//Finished, and no longer touching its descriptor
+#define MYTH_JOIN_DONE ((struct myth_thread *)1)
+//Nobody is to join it
+#define MYTH_JOIN_DETACHED ((struct myth_thread *)2)
+
+/* State of a lazily created task (see myth_task_spawn_body) */
+typedef enum {
+  //Only a record in a task queue, or being taken from it
+  MYTH_TASK_PENDING = 1,
+  //Taken by a worker and given a thread descriptor
+  MYTH_TASK_TAKEN = 2,
+} myth_task_state_t;
+
+/* Rarely used parts of a thread descriptor, allocated on first
+   use (see myth_thread_ext_get) and kept with the descriptor
+   when it is recycled, until its worker finishes
+   (myth_cleanup_worker) */
+typedef struct myth_thread_ext {
+  /* TODO: get rid of them */
+  void *custom_data_ptr;
+  int custom_data_size;
+
+  myth_tls_tree_t tls[1];
+} myth_thread_ext_t;
+
+/* Takes a thread out of the cancellable wait it is parked in
+   (obj is what it waits on). returns 1 if it did, 0 if the thread
+   is not there (not yet, or no longer) */
+typedef int (*myth_wait_cancel_t)(struct myth_thread * th, void * obj);
+
+/* A cancel group (see myth_cancel_group_body). members are kept
+   in one list per worker, that of the worker that created them,
+   so that threads entering and leaving it do not all contend */
+typedef struct myth_cancel_group_list {
+  myth_spinlock_t lock;
+  struct myth_thread * head;
+} __attribute__((aligned(CACHE_LINE_SIZE))) myth_cancel_group_list_t;
+
+struct myth_cancel_group {
+  volatile int cancelled;
+  int n_lists;
+  myth_cancel_group_list_t lists[];
+};
+
+/* Thread descriptor.
+   fields accessed on every create, switch and join come first
+   and fit in a cache line (with native contexts on 64 bit machines) */
 // typedef 
 struct myth_thread {
   struct myth_thread * next;
-  // A thread which is waiting for this
+  // A thread which is waiting for this, or MYTH_JOIN_DONE/DETACHED
   struct myth_thread* join_thread;
-  myth_func_t entry_func;
   // Return value
   void *result;
-  // Context
-  myth_context context;
-  // Pointer to stack
-  void *stack;
-  size_t stack_size;
   // Pointer to worker thread
   struct myth_running_env* env;
+  // Context
+  myth_context context;
   // Lock
   myth_spinlock_t lock;
   // Status
   volatile myth_status_t status;
-  uint8_t detached;
   uint8_t cancelled;
   uint8_t cancel_enabled;
+  // Save FP control registers when it switches (MYTH_FPCSR_SAVE)
+  uint8_t save_fpcsr;
+  // Woken from a cancellable wait by cancellation (see myth_wait_interrupt)
+  uint8_t interrupted;
+  myth_func_t entry_func;
+  /* the first cache line ends here */
+  // Pointer to stack
+  void *stack;
+  size_t stack_size;
+  // Custom data and TLS (null until needed)
+  myth_thread_ext_t * ext;
+  // Coroutine it is running in (see myth_coro_resume_body)
+  struct myth_coro * coro;
+  // The cancellable wait it is parked in, if any (see myth_wait_cancellable)
+  myth_wait_cancel_t wait_cancel;
+  void * wait_obj;
+  // Cancel group, and links in the list of its members it is in
+  struct myth_cancel_group * cancel_group;
+  struct myth_thread * group_next;
+  struct myth_thread * group_prev;
+  int group_slot;
 #if MYTH_ENABLE_THREAD_ANNOTATION && MYTH_COLLECT_LOG
   char annotation_str[MYTH_THREAD_ANNOTATION_MAXLEN];
   int recycle_count;
@@ -57,13 +127,6 @@ struct myth_thread {
 #if MYTH_DESC_REUSE_CHECK
   myth_spinlock_t sanity_check;
 #endif
-  /* TODO: get rid of them */
-  void *custom_data_ptr;
-  int custom_data_size;
-
-  myth_thread_attr_t attr;
-
-  myth_tls_tree_t tls[1];
 
 #if MYTH_DEBUG_JOIN_FCC
   uint64_t join_called_at;
@@ -73,9 +136,12 @@ struct myth_thread {
   char * when_I_finished;
 #endif
   
-} ;
+} __attribute__((aligned(CACHE_LINE_SIZE)));
+
+// myth_thread, *myth_thread_t;
 
-// __attribute__((aligned(CACHE_LINE_SIZE))) myth_thread, *myth_thread_t;
+static inline myth_thread_ext_t * myth_thread_ext_get(myth_thread_t th);
+static inline void myth_thread_ext_free(myth_thread_t th);
 
 // typedef 
 struct myth_pickle {
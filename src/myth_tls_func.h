@@ -97,6 +97,28 @@ static inline void myth_tls_tree_init(myth_tls_tree_t * t) {
 #endif
 }
 
+/* return the cold part of th, allocating it if th has none yet */
+static inline myth_thread_ext_t * myth_thread_ext_get(myth_thread_t th) {
+  myth_thread_ext_t * ext = th->ext;
+  if (!ext) {
+    ext = myth_malloc(sizeof(myth_thread_ext_t));
+    ext->custom_data_ptr = 0;
+    ext->custom_data_size = 0;
+    myth_tls_tree_init(ext->tls);
+    th->ext = ext;
+  }
+  return ext;
+}
+
+/* release the cold part of th, if any (descriptors keep it
+   while they are recycled, until the worker finishes) */
+static inline void myth_thread_ext_free(myth_thread_t th) {
+  if (th->ext) {
+    myth_free(th->ext);
+    th->ext = 0;
+  }
+}
+
 /* --------------------------------------- */
 
 /* call destructors on all nodes under n */
@@ -345,12 +367,13 @@ static inline int myth_equal_body(myth_thread_t t1, myth_thread_t t2) {
 
 static inline int myth_setspecific_body(myth_key_t key, const void * val) {
   myth_thread_t th = myth_self_body();
-  return myth_tls_tree_set(th->tls, key, val);
+  return myth_tls_tree_set(myth_thread_ext_get(th)->tls, key, val);
 }
 
 static inline void * myth_getspecific_body(myth_key_t key) {
   myth_thread_t th = myth_self_body();
-  return myth_tls_tree_get(th->tls, key);
+  if (!th->ext) return 0;
+  return myth_tls_tree_get(th->ext->tls, key);
 }
 
 #endif /* MYTH_TLS_FUNC_H_ */
@@ -51,7 +51,9 @@ myth_thread_t myth_default_steal_func(int rank) {
     //ws_victim=busy_env->rank;
     //Try to steal thread
     next_run = myth_queue_take(&busy_env->runnable_q);
+    env->steal_attempts[busy_env->rank]++;
     if (next_run){
+      env->steals[busy_env->rank]++;
 #if MYTH_SCHED_LOOP_DEBUG
       myth_dprintf("env %p is stealing thread %p from %p...\n",env,steal_th,busy_env);
 #endif
@@ -119,7 +121,9 @@ static myth_thread_t myth_steal_func_with_prob(int rank) {
   myth_running_env_t busy_env = myth_env_choose_victim(env);
   if (busy_env){
     myth_thread_t next_run = myth_queue_take(&busy_env->runnable_q);
+    env->steal_attempts[busy_env->rank]++;
     if (next_run){
+      env->steals[busy_env->rank]++;
       myth_assert(next_run->status == MYTH_STATUS_READY);
     }
     return next_run;
@@ -256,3 +260,165 @@ int myth_scheduler_worker_init(int rank, int nw) {
 }
 
 #endif	/* EXPERIMENTAL_SCHEDULER */
+
+/* scheduling counters (see myth_get_stats). each worker updates
+   its own without synchronization; they are read likewise */
+
+int myth_get_stats_body(int rank, myth_stats_t * stats) {
+  int i, j, a, b;
+  if (g_myth_init_state != myth_init_state_initialized) return EINVAL;
+  if (rank < -1 || rank >= g_attr.n_workers) return EINVAL;
+  memset(stats, 0, sizeof(myth_stats_t));
+  a = (rank < 0 ? 0 : rank);
+  b = (rank < 0 ? g_attr.n_workers : rank + 1);
+  for (i = a; i < b; i++) {
+    myth_running_env_t env = &g_envs[i];
+    stats->n_creates     += env->stats.n_creates;
+    stats->n_task_spawns += env->stats.n_task_spawns;
+    stats->n_local_pops  += env->runnable_q.n_pops;
+    stats->n_task_steals += env->stats.n_task_steals;
+    stats->n_join_blocks += env->stats.n_join_blocks;
+    stats->n_switches    += env->stats.n_switches;
+    for (j = 0; j < g_attr.n_workers; j++) {
+      stats->n_steal_attempts += env->steal_attempts[j];
+      stats->n_steals         += env->steals[j];
+    }
+  }
+  return 0;
+}
+
+/* allocator counters (see myth_get_alloc_stats): those of the
+   hot slots of each env, and of its myth_flmalloc caches */
+
+int myth_get_alloc_stats_body(int rank, myth_alloc_stats_t * stats) {
+  int i, a, b;
+  if (g_myth_init_state != myth_init_state_initialized) return EINVAL;
+  if (rank < -1 || rank >= g_attr.n_workers) return EINVAL;
+  memset(stats, 0, sizeof(myth_alloc_stats_t));
+  a = (rank < 0 ? 0 : rank);
+  b = (rank < 0 ? g_attr.n_workers : rank + 1);
+  for (i = a; i < b; i++) {
+#if MYTH_SPLIT_STACK_DESC && MYTH_HOT_SLOT
+    stats->n_desc_hot_hits    += g_envs[i].hot_desc_hits;
+    stats->n_desc_hot_misses  += g_envs[i].hot_desc_misses;
+    stats->n_stack_hot_hits   += g_envs[i].hot_stack_hits;
+    stats->n_stack_hot_misses += g_envs[i].hot_stack_misses;
+#endif
+#if USE_MYTH_FLMALLOC
+    myth_flmalloc_worker_t * w = g_myth_flmalloc[i];
+    if (!w) continue;
+    stats->n_allocs       += w->stats.n_allocs;
+    stats->n_frees        += w->stats.n_frees;
+    stats->n_remote_frees += w->stats.n_remote_frees;
+    stats->n_spills       += w->stats.n_spills;
+    stats->n_refills      += w->stats.n_refills;
+    stats->n_maps         += w->stats.n_maps;
+    stats->mapped_bytes   += w->stats.mapped_bytes;
+#endif
+  }
+  return 0;
+}
+
+int myth_get_steal_stats_body(int rank, unsigned long long * attempts,
+			      unsigned long long * steals) {
+  int i, j, a, b, nw;
+  if (g_myth_init_state != myth_init_state_initialized) return EINVAL;
+  nw = g_attr.n_workers;
+  if (rank < -1 || rank >= nw) return EINVAL;
+  memset(attempts, 0, sizeof(unsigned long long) * nw);
+  if (steals) memset(steals, 0, sizeof(unsigned long long) * nw);
+  a = (rank < 0 ? 0 : rank);
+  b = (rank < 0 ? nw : rank + 1);
+  for (i = a; i < b; i++) {
+    for (j = 0; j < nw; j++) {
+      attempts[j] += g_envs[i].steal_attempts[j];
+      if (steals) steals[j] += g_envs[i].steals[j];
+    }
+  }
+  return 0;
+}
+
+int myth_dump_stats_body(int fd) {
+  char buf[4096];
+  int len = 0, err = 0, i, nw;
+  myth_stats_t st;
+  if (g_myth_init_state != myth_init_state_initialized) return EINVAL;
+  nw = g_attr.n_workers;
+  len += snprintf(buf + len, sizeof(buf) - len,
+		  "myth stats: worker creates task_spawns local_pops"
+		  " steal_attempts steals task_steals join_blocks switches\n");
+  /* each worker, then the sum */
+  for (i = 0; i <= nw; i++) {
+    char name[16];
+    myth_get_stats_body(i < nw ? i : -1, &st);
+    if (i < nw) snprintf(name, sizeof(name), "%d", i);
+    else snprintf(name, sizeof(name), "all");
+    if (len > (int)sizeof(buf) - 256) err = (err ? err : myth_dump_flush(fd, buf, &len));
+    len += snprintf(buf + len, sizeof(buf) - len,
+		    "%s %llu %llu %llu %llu %llu %llu %llu %llu\n",
+		    name, st.n_creates, st.n_task_spawns, st.n_local_pops,
+		    st.n_steal_attempts, st.n_steals, st.n_task_steals,
+		    st.n_join_blocks, st.n_switches);
+  }
+  if (!err) err = myth_dump_flush(fd, buf, &len);
+  return err;
+}
+
+/* MYTH_STATS_INTERVAL=n: a native thread writing the counters
+   to the standard error every n milliseconds */
+static struct {
+  pthread_mutex_t mtx;
+  pthread_cond_t cond;
+  int interval;			/* milliseconds, or 0 if not running */
+  int exit_flag;
+  pthread_t thread;
+} g_myth_stats_dumper;
+
+static void * myth_stats_dumper_main(void * arg) {
+  struct timespec ts;
+  (void)arg;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  real_pthread_mutex_lock(&g_myth_stats_dumper.mtx);
+  while (!g_myth_stats_dumper.exit_flag) {
+    ts.tv_sec += g_myth_stats_dumper.interval / 1000;
+    ts.tv_nsec += (g_myth_stats_dumper.interval % 1000) * 1000000L;
+    if (ts.tv_nsec >= 1000000000L) {
+      ts.tv_sec++;
+      ts.tv_nsec -= 1000000000L;
+    }
+    while (!g_myth_stats_dumper.exit_flag
+	   && real_pthread_cond_timedwait(&g_myth_stats_dumper.cond,
+					  &g_myth_stats_dumper.mtx, &ts) != ETIMEDOUT) ;
+    if (g_myth_stats_dumper.exit_flag) break;
+    real_pthread_mutex_unlock(&g_myth_stats_dumper.mtx);
+    myth_dump_stats_body(2);
+    real_pthread_mutex_lock(&g_myth_stats_dumper.mtx);
+  }
+  real_pthread_mutex_unlock(&g_myth_stats_dumper.mtx);
+  return 0;
+}
+
+void myth_stats_dumper_init(void) {
+  char * env = getenv(ENV_MYTH_STATS_INTERVAL);
+  int interval = (env ? atoi(env) : MYTH_STATS_INTERVAL_DEFAULT);
+  g_myth_stats_dumper.interval = 0;
+  if (interval <= 0) return;
+  real_pthread_mutex_init(&g_myth_stats_dumper.mtx, NULL);
+  real_pthread_cond_init(&g_myth_stats_dumper.cond, NULL);
+  g_myth_stats_dumper.exit_flag = 0;
+  g_myth_stats_dumper.interval = interval;
+  real_pthread_create(&g_myth_stats_dumper.thread, NULL,
+		      myth_stats_dumper_main, NULL);
+}
+
+void myth_stats_dumper_fini(void) {
+  if (!g_myth_stats_dumper.interval) return;
+  real_pthread_mutex_lock(&g_myth_stats_dumper.mtx);
+  g_myth_stats_dumper.exit_flag = 1;
+  real_pthread_cond_signal(&g_myth_stats_dumper.cond);
+  real_pthread_mutex_unlock(&g_myth_stats_dumper.mtx);
+  real_pthread_join(g_myth_stats_dumper.thread, NULL);
+  real_pthread_cond_destroy(&g_myth_stats_dumper.cond);
+  real_pthread_mutex_destroy(&g_myth_stats_dumper.mtx);
+  g_myth_stats_dumper.interval = 0;
+}
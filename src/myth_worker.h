@@ -105,6 +105,14 @@ typedef struct myth_running_env {
 #if MYTH_SPLIT_STACK_DESC
   myth_freelist_t freelist_desc;//Freelist of thread descriptor
   myth_freelist_t freelist_stack;//Freelist of stack
+#if MYTH_HOT_SLOT
+  //The descriptor and the default stack freed last (or null)
+  struct myth_thread *hot_desc;
+  void *hot_stack;
+  //Allocations served by them and by anything else
+  unsigned long long hot_desc_hits, hot_desc_misses;
+  unsigned long long hot_stack_hits, hot_stack_misses;
+#endif
 #else
   myth_freelist_t freelist_ds;//Freelis
 #endif
@@ -113,13 +121,24 @@ typedef struct myth_running_env {
   myth_spinlock_t log_lock;
   struct myth_log_entry *log_data;
   struct myth_prof_data prof_data;
+  //Scheduling counters, always kept (see myth_get_stats).
+  //Pops and steals are counted in runnable_q and below
+  myth_stats_t stats;
+  //Steal attempts on and steals from each worker (n_workers each)
+  unsigned long long *steal_attempts, *steals;
   struct myth_sched sched;	//Scheduler descriptor
   //The following entries may be read from other worker threads
   pthread_t worker;
   int rank;
+  int numa_node;//Home NUMA node (-1 if unknown)
   //The following entries may be written by other worker threads
   //Appropriate synchronization is required
   myth_thread_queue runnable_q;//Runqueue
+  myth_thread_queue task_q;//Tasks not yet given a thread (myth_task_t *)
+#if MYTH_SPLIT_STACK_DESC
+  //Stacks freed by workers on other NUMA nodes
+  myth_freelist_t freelist_stack_remote;
+#endif
   //Reference to Global free list
 #if MYTH_SPLIT_STACK_DESC
   myth_freelist_t *freelist_desc_g;//Freelist of thread descriptor
@@ -155,6 +174,15 @@ typedef struct myth_running_env {
 int myth_scheduler_global_init(int nw);
 #endif
 
+/* defined in myth_worker.c */
+int myth_get_stats_body(int rank, myth_stats_t * stats);
+int myth_get_alloc_stats_body(int rank, myth_alloc_stats_t * stats);
+int myth_get_steal_stats_body(int rank, unsigned long long * attempts,
+			      unsigned long long * steals);
+int myth_dump_stats_body(int fd);
+void myth_stats_dumper_init(void);
+void myth_stats_dumper_fini(void);
+
 // myth_running_env, * myth_running_env_t;
 
 //typedef struct myth_thread* (*myth_steal_func_t)(int);
@@ -12,6 +12,7 @@
 #include "myth_init.h"
 #include "myth_misc.h"
 #include "myth_bind_worker.h"
+#include "myth_numa.h"
 #include "myth_worker.h"
 #include "myth_sched.h"
 #include "myth_log.h"
@@ -142,6 +143,14 @@ static void myth_setup_worker(int rank) {
   env->rank = rank;
   env->exit_flag = 0;
   memset(&env->prof_data, 0, sizeof(myth_prof_data));
+#if MYTH_NUMA_AWARE
+  //Move this env to our node and allocate from it from now on
+  env->numa_node = myth_numa_worker_node(rank);
+  myth_numa_set_preferred(env->numa_node);
+  myth_numa_bind_memory(env, sizeof(myth_running_env), env->numa_node);
+#else
+  env->numa_node = -1;
+#endif
   //Initialize allocators
   myth_flmalloc_init_worker(rank);
   //myth_malloc_wrapper_init_worker(rank);
@@ -154,10 +163,30 @@ static void myth_setup_worker(int rank) {
   //Initialize runqueue
   myth_queue_init(&env->runnable_q);
   myth_queue_clear(&env->runnable_q);
+  //Initialize queue of tasks not yet given a thread
+  myth_queue_init(&env->task_q);
+  myth_queue_clear(&env->task_q);
+  //Initialize scheduling counters
+  memset(&env->stats, 0, sizeof(myth_stats_t));
+  env->steal_attempts = myth_malloc(sizeof(unsigned long long) * g_attr.n_workers * 2);
+  memset(env->steal_attempts, 0, sizeof(unsigned long long) * g_attr.n_workers * 2);
+  env->steals = env->steal_attempts + g_attr.n_workers;
+#if MYTH_NUMA_AWARE
+  myth_numa_bind_memory(env->runnable_q.ptr,
+			sizeof(myth_thread_t) * env->runnable_q.size,
+			env->numa_node);
+#endif
   //Initialize freelist for thread descriptor
 #if MYTH_SPLIT_STACK_DESC
   myth_freelist_init(&env->freelist_desc);
   myth_freelist_init(&env->freelist_stack);
+  myth_freelist_init(&env->freelist_stack_remote);
+#if MYTH_HOT_SLOT
+  env->hot_desc = NULL;
+  env->hot_stack = NULL;
+  env->hot_desc_hits = env->hot_desc_misses = 0;
+  env->hot_stack_hits = env->hot_stack_misses = 0;
+#endif
 #if (INITIAL_STACK_ALLOC_UNIT>0)
   {
     //Allocate
@@ -207,7 +236,7 @@ static void myth_setup_worker(int rank) {
     for (i = 0; i < STACK_ALLOC_UNIT; i++) {
       void** ret = (void**)th_ptr;
       uintptr_t * blk_size = (uintptr_t*)(th_ptr + sizeof(void*));
-      *blk_size = 0; //indicates default
+      *blk_size = MYTH_STACK_BLK_DEFAULT(env->rank);
       myth_freelist_push(env->freelist_stack, ret);
       th_ptr += th_size;
     }
@@ -218,7 +247,8 @@ static void myth_setup_worker(int rank) {
 #endif
 #if MYTH_WRAP_SOCKIO
   //Initialize I/O
-  myth_io_worker_init(env,&env->io_struct);
+  if (g_myth_io_on)
+    myth_io_worker_init(env,&env->io_struct);
 #endif //MYTH_WRAP_SOCKIO
   env->this_thread = NULL;
   //Wait for other worker threads
@@ -275,12 +305,25 @@ static inline void myth_cleanup_worker(int rank)
     myth_free_with_size(env->sched.stack,0);
 #if MYTH_WRAP_SOCKIO
   //Release I/O
-  myth_io_worker_fini(env,&env->io_struct);
+  if (g_myth_io_on)
+    myth_io_worker_fini(env,&env->io_struct);
 #endif
   //Release runqueue
   myth_queue_fini(&env->runnable_q);
+  myth_queue_fini(&env->task_q);
   //Release thread descriptor of current thread
   if (env->this_thread)free_myth_thread_struct_desc(env,env->this_thread);			//Found in a freelist-ds
+#if MYTH_SPLIT_STACK_DESC
+  //Release the cold parts of the descriptors kept by this worker
+  {
+    myth_freelist_cell_t * c;
+#if MYTH_HOT_SLOT
+    if (env->hot_desc)myth_thread_ext_free(env->hot_desc);
+#endif
+    for (c=env->freelist_desc.head;c;c=c->next)
+      myth_thread_ext_free((myth_thread_t)c);
+  }
+#endif
   //Count freelist entry
 #if MYTH_FL_PROF
   int fl_num=0;
@@ -298,6 +341,9 @@ static inline void myth_cleanup_worker(int rank)
   //myth_malloc_wrapper_fini_worker(rank);
   //finalize logger
   myth_log_worker_fini(env);
+#if MYTH_NUMA_AWARE
+  myth_numa_set_preferred(-1);
+#endif
 }
 
 //Execute worker thread scheduling loop
@@ -337,19 +383,20 @@ static inline void myth_startpoint_init_ex_body(int rank)
 #if MYTH_ENABLE_THREAD_ANNOTATION && MYTH_COLLECT_LOG
   sprintf(this_th->annotation_str,"%p(main)",this_th);
 #endif
-  /* todo: make this a part of allocation and unify 
-     with myth_create_ex_body */
-  myth_tls_tree_init(this_th->tls);
+  if (this_th->ext) {
+    this_th->ext->custom_data_size = 0;
+    myth_tls_tree_init(this_th->ext->tls);
+  }
   
-  //Set worker thread descrptor
-  this_th->env = env;
+  //Set worker thread descrptor (and clear what the last user left)
+  init_myth_thread_struct(env, this_th);
   //Initialize context for scheduler
   env->sched.stack = myth_malloc(MYTH_SCHED_STACK_SIZE);
   myth_make_context_voidcall(&env->sched.context, myth_sched_loop,
 			     (void*)(((char*)env->sched.stack) + MYTH_SCHED_STACK_SIZE - sizeof(void*)),
 			     MYTH_SCHED_STACK_SIZE - sizeof(void*));
   //Switch to scheduler
-  myth_swap_context_withcall(&this_th->context, &env->sched.context,
+  myth_swap_context_withcall(this_th, &env->sched.context,
 			     myth_startpoint_init_ex_1, env, this_th, NULL);
 }
 
@@ -413,7 +460,7 @@ static inline void myth_startpoint_exit_ex_body(int rank)
     intptr_t rank_ = rank;
     myth_thread_t th;
     th = env->this_thread;
-    myth_swap_context_withcall(&th->context, &env->sched.context, 
+    myth_swap_context_withcall(th, &env->sched.context, 
 			       myth_startpoint_exit_ex_1,
 			       (void*)th, (void*) rank_, NULL);
     myth_rwbarrier();
@@ -474,6 +521,27 @@ static inline myth_thread_t myth_steal_body(void)
   return ret;
 }
 
+//Take a task from another worker and make a thread for it
+static inline myth_thread_t myth_task_take_other(myth_running_env_t env)
+{
+  myth_running_env_t target = myth_env_get_randomly();
+  myth_task_t * t;
+  if (target == env) return NULL;
+  t = (myth_task_t *)myth_queue_take(&target->task_q);
+  if (!t) return NULL;
+  env->stats.n_task_steals++;
+  return myth_task_materialize(env, t);
+}
+
+//Make a thread for a task spawned on this worker or, if there
+//is none, on another one
+static inline myth_thread_t myth_task_steal(myth_running_env_t env)
+{
+  myth_task_t * t = (myth_task_t *)myth_queue_pop(&env->task_q);
+  if (t) return myth_task_materialize(env, t);
+  return myth_task_take_other(env);
+}
+
 static inline void myth_import_body(myth_thread_t th)
 {
   myth_running_env_t e = myth_get_current_env();
@@ -500,9 +568,11 @@ static void myth_eco_sched_loop(myth_running_env_t env) {
     //Get runnable thread
     next_run = myth_queue_pop(&env->runnable_q);
 #if MYTH_WRAP_SOCKIO
-    //If there is no runnable thread, check I/O
-    if (!next_run){
-      next_run = myth_io_polling(env);
+    //If there is no runnable thread, check I/O.
+    //Otherwise check it now and then
+    if (g_myth_io_on){
+      if (!next_run)next_run = myth_io_polling(env);
+      else next_run = myth_io_polling_between(env,next_run);
     }
 #endif
     //If there is no runnable thread after I/O checking, try work-stealing
@@ -514,6 +584,9 @@ static void myth_eco_sched_loop(myth_running_env_t env) {
 	env->finish_ready = 2;
       }
     }
+    //Then for tasks not yet given a thread
+    if (!next_run)
+      next_run = myth_task_steal(env);
     if ( ((intptr_t)next_run) == ((intptr_t)FINISH) ) { //next_run == FINISH
       if (env->rank != 0) {
 	env->this_thread = NULL;
@@ -617,9 +690,11 @@ static void myth_sched_loop(void)
     //Get runnable thread
     next_run=myth_queue_pop(&env->runnable_q);
 #if MYTH_WRAP_SOCKIO
-    //If there is no runnable thread, check I/O
-    if (!next_run){
-      next_run=myth_io_polling(env);
+    //If there is no runnable thread, check I/O.
+    //Otherwise check it now and then
+    if (g_myth_io_on){
+      if (!next_run)next_run=myth_io_polling(env);
+      else next_run=myth_io_polling_between(env,next_run);
     }
 #endif
     //If there is no runnable thread after I/O checking, try work-stealing
@@ -627,6 +702,9 @@ static void myth_sched_loop(void)
       //next_run=myth_steal_from_others(env);
       next_run=g_myth_steal_func(env->rank);
     }
+    //Then for tasks not yet given a thread
+    if (!next_run)
+      next_run=myth_task_steal(env);
     if (next_run)
       {
 	//sanity check
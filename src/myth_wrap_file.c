@@ -0,0 +1,113 @@
+/*
+ * myth_wrap_file.c : file I/O
+ */
+
+#include <fcntl.h>
+#include <stdarg.h>
+#include <unistd.h>
+
+#include "myth_config.h"
+#include "myth_real.h"
+#include "myth_wrap_util_func.h"
+
+#if MYTH_WRAP_SOCKIO
+#include "myth_worker.h"
+#include "myth_io.h"
+#include "myth_sched_func.h"
+#include "myth_io_func.h"
+
+/* with MYTH_WRAP_FILEIO=1, these calls are performed by io_uring
+   or a helper thread while the calling user thread is switched
+   out (myth_io_func.h). read, write, readv and writev on a socket
+   follow MYTH_WRAP_SOCKIO instead; their bodies tell them apart */
+#define myth_fileio(body, real) \
+  (((g_myth_io_on & MYTH_IO_ON_FILE) && g_worker_rank >= 0) ? (body) : (real))
+#define myth_rwio(body, real) \
+  ((g_myth_io_on && g_worker_rank >= 0) ? (body) : (real))
+#else
+#define myth_fileio(body, real) (real)
+#define myth_rwio(body, real) (real)
+#endif
+
+int __wrap(open)(const char *pathname, int flags, ...) {
+  /* mode is there only when a file may be created */
+  mode_t mode = 0;
+  if (flags & (O_CREAT
+#if defined(O_TMPFILE)
+	       | O_TMPFILE
+#endif
+	       )) {
+    va_list ap;
+    va_start(ap, flags);
+    mode = va_arg(ap, mode_t);
+    va_end(ap);
+  }
+  int _ = enter_wrapped_func("%s, %d, %o", pathname, flags, mode);
+  int x = myth_fileio(myth_open_body(pathname, flags, mode),
+		      real_open(pathname, flags, mode));
+  (void)_;
+  leave_wrapped_func("%d", x);
+  return x;
+}
+
+ssize_t __wrap(read)(int fd, void *buf, size_t count) {
+  int _ = enter_wrapped_func("%d, %p, %lu", fd, buf, count);
+  ssize_t x = myth_rwio(myth_read_body(fd, buf, count),
+			real_read(fd, buf, count));
+  (void)_;
+  leave_wrapped_func("%p", x);
+  return x;
+}
+
+ssize_t __wrap(write)(int fd, const void *buf, size_t count) {
+  int _ = enter_wrapped_func("%d, %p, %lu", fd, buf, count);
+  ssize_t x = myth_rwio(myth_write_body(fd, buf, count),
+			real_write(fd, buf, count));
+  (void)_;
+  leave_wrapped_func("%p", x);
+  return x;
+}
+
+ssize_t __wrap(readv)(int fd, const struct iovec *iov, int iovcnt) {
+  int _ = enter_wrapped_func("%d, %p, %d", fd, iov, iovcnt);
+  ssize_t x = myth_rwio(myth_readv_body(fd, iov, iovcnt),
+			real_readv(fd, iov, iovcnt));
+  (void)_;
+  leave_wrapped_func("%p", x);
+  return x;
+}
+
+ssize_t __wrap(writev)(int fd, const struct iovec *iov, int iovcnt) {
+  int _ = enter_wrapped_func("%d, %p, %d", fd, iov, iovcnt);
+  ssize_t x = myth_rwio(myth_writev_body(fd, iov, iovcnt),
+			real_writev(fd, iov, iovcnt));
+  (void)_;
+  leave_wrapped_func("%p", x);
+  return x;
+}
+
+ssize_t __wrap(pread)(int fd, void *buf, size_t count, off_t offset) {
+  int _ = enter_wrapped_func("%d, %p, %lu, %ld", fd, buf, count, (long)offset);
+  ssize_t x = myth_fileio(myth_pread_body(fd, buf, count, offset),
+			  real_pread(fd, buf, count, offset));
+  (void)_;
+  leave_wrapped_func("%p", x);
+  return x;
+}
+
+ssize_t __wrap(pwrite)(int fd, const void *buf, size_t count, off_t offset) {
+  int _ = enter_wrapped_func("%d, %p, %lu, %ld", fd, buf, count, (long)offset);
+  ssize_t x = myth_fileio(myth_pwrite_body(fd, buf, count, offset),
+			  real_pwrite(fd, buf, count, offset));
+  (void)_;
+  leave_wrapped_func("%p", x);
+  return x;
+}
+
+int __wrap(fsync)(int fd) {
+  int _ = enter_wrapped_func("%d", fd);
+  int x = myth_fileio(myth_fsync_body(fd), real_fsync(fd));
+  (void)_;
+  leave_wrapped_func("%d", x);
+  return x;
+}
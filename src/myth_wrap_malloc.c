@@ -2,13 +2,133 @@
  * myth_wrap_malloc.c : malloc and friends
  */
 
+#include <errno.h>
+
 #include "myth_config.h"
 #include "myth_real.h"
 #include "myth_wrap_util_func.h"
+#include "myth_init.h"
+#include "myth_worker.h"
+#include "myth_init_func.h"
+#include "myth_sched_func.h"
+
+#if MYTH_WRAP_MALLOC && USE_MYTH_FLMALLOC
+/* when MYTH_WRAP_MALLOC=1, a block up to MYTH_FL_SLAB_BLOCK_MAX
+   bytes requested by a worker comes from that worker's cache of
+   myth_flmalloc, so neither allocation nor free takes a lock and
+   a block freed after its thread was stolen goes back to the
+   worker that allocated it. such blocks are carved from the
+   arena; anything outside it belongs to the real malloc.
+   everything else (larger blocks, aligned allocations, calls
+   from threads that are not workers, and calls before myth_init)
+   is served by the real malloc.
+
+   caveat: with libmyth-ld, only the objects linked with it are
+   redirected, so a block must not be passed to a function of
+   another library that frees or reallocates it (e.g., getline).
+   malloc_usable_size is not supported on our blocks either */
+static volatile int g_myth_wrap_malloc_on = 0;
+static int g_myth_wrap_malloc_n_workers = 0;
+
+void myth_malloc_wrapper_init(int nthreads) {
+  char * env = getenv(ENV_MYTH_WRAP_MALLOC);
+  if (!env || atoi(env) == 0) return;
+  if (myth_flarena_init(MYTH_WRAP_MALLOC_ARENA_SIZE) != 0) return;
+  g_myth_wrap_malloc_n_workers = nthreads;
+  g_myth_wrap_malloc_on = 1;
+}
+
+/* blocks freed after this are simply dropped, as
+   the caches they would go to are about to be released */
+void myth_malloc_wrapper_fini(void) {
+  g_myth_wrap_malloc_on = 0;
+}
+
+//Allocate a block from the cache of the calling worker, or return null
+static inline void * myth_wrap_flmalloc(size_t size) {
+  int rank = g_worker_rank;
+  void * ptr;
+  if (!g_myth_wrap_malloc_on || rank < 0 || size > MYTH_FL_SLAB_BLOCK_MAX) {
+    return 0;
+  }
+  ptr = myth_flmalloc(rank, size);
+  if (myth_flarena_contains(ptr)) return ptr;
+  //The arena is exhausted and this one came from a plain mmap
+  myth_flfree(rank, size, ptr);
+  return 0;
+}
+
+//Free a block of the arena
+static inline void myth_wrap_flfree(void * ptr) {
+  myth_flslab_t * slab = myth_flslab_of(ptr);
+  int rank = g_worker_rank;
+  if (!g_myth_wrap_malloc_on) return;
+  //A leftover of a previous myth_init having more workers
+  if (slab->owner >= g_myth_wrap_malloc_n_workers) return;
+  if (rank >= 0) {
+    myth_flfree(rank, MYTH_MALLOC_INDEX_TO_RSIZE(slab->idx), ptr);
+  } else {
+    myth_freelist_push_atomic(&g_myth_flremote[slab->owner][slab->idx], ptr);
+  }
+}
+
+static void * myth_wrap_malloc(size_t size) {
+  void * x = myth_wrap_flmalloc(size);
+  return (x ? x : real_malloc(size));
+}
+
+static void myth_wrap_free(void * ptr) {
+  if (myth_flarena_contains(ptr)) {
+    myth_wrap_flfree(ptr);
+  } else {
+    real_free(ptr);
+  }
+}
+
+static void * myth_wrap_calloc(size_t nmemb, size_t size) {
+  void * x;
+  if (size && nmemb > MYTH_FL_SLAB_BLOCK_MAX / size) {
+    return real_calloc(nmemb, size);
+  }
+  x = myth_wrap_flmalloc(nmemb * size);
+  if (!x) return real_calloc(nmemb, size);
+  memset(x, 0, nmemb * size);
+  return x;
+}
+
+static void * myth_wrap_realloc(void * ptr, size_t size) {
+  size_t rsize;
+  void * x;
+  if (!myth_flarena_contains(ptr)) {
+    if (ptr || !(x = myth_wrap_flmalloc(size))) {
+      x = real_realloc(ptr, size);
+    }
+    return x;
+  }
+  //Same as the real realloc, size 0 frees the block
+  if (size == 0) {
+    myth_wrap_flfree(ptr);
+    return 0;
+  }
+  //Keep the block unless it is too small or more than twice as large
+  rsize = MYTH_MALLOC_INDEX_TO_RSIZE(myth_flslab_of(ptr)->idx);
+  if (size <= rsize && size > rsize / 2) return ptr;
+  x = myth_wrap_malloc(size);
+  if (!x) return 0;
+  memcpy(x, ptr, (size < rsize ? size : rsize));
+  myth_wrap_flfree(ptr);
+  return x;
+}
+#else
+#define myth_wrap_malloc(size) real_malloc(size)
+#define myth_wrap_free(ptr) real_free(ptr)
+#define myth_wrap_calloc(nmemb, size) real_calloc(nmemb, size)
+#define myth_wrap_realloc(ptr, size) real_realloc(ptr, size)
+#endif
 
 void * __wrap(malloc)(size_t size) {
   int _ = enter_wrapped_func("%lu", size);
-  void * x = real_malloc(size);
+  void * x = myth_wrap_malloc(size);
   (void)_;
   leave_wrapped_func("%p", x);
   return x;
@@ -17,13 +137,13 @@ void * __wrap(malloc)(size_t size) {
 void __wrap(free)(void * ptr) {
   int _ = enter_wrapped_func("%p", ptr);
   (void)_;
-  real_free(ptr);
+  myth_wrap_free(ptr);
   leave_wrapped_func(0);
 }
 
 void * __wrap(calloc)(size_t nmemb, size_t size) {
   int _ = enter_wrapped_func("%lu, %lu", nmemb, size);
-  void * x = real_calloc(nmemb, size);
+  void * x = myth_wrap_calloc(nmemb, size);
   (void)_;
   leave_wrapped_func("%p", x);
   return x;
@@ -31,7 +151,7 @@ void * __wrap(calloc)(size_t nmemb, size_t size) {
 
 void * __wrap(realloc)(void * ptr, size_t size) {
   int _ = enter_wrapped_func("%p, %lu", ptr, size);
-  void * x = real_realloc(ptr, size);
+  void * x = myth_wrap_realloc(ptr, size);
   (void)_;
   leave_wrapped_func("%p", x);
   return x;
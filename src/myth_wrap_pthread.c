@@ -1809,7 +1809,12 @@ int __wrap(usleep)(useconds_t usec) {
   int ret;
   (void)_;
   if (myth_should_wrap_pthread()) {
+    /* -1 and errno, as usleep does */
     ret = myth_usleep_body(usec);
+    if (ret) {
+      errno = ret;
+      ret = -1;
+    }
   } else {
     ret = real_usleep(usec);
   }
@@ -1822,7 +1827,12 @@ int __wrap(nanosleep)(const struct timespec *req, struct timespec *rem) {
   int ret;
   (void)_;
   if (myth_should_wrap_pthread()) {
+    /* -1 and errno, as nanosleep does */
     ret = myth_nanosleep_body(req, rem);
+    if (ret) {
+      errno = ret;
+      ret = -1;
+    }
   } else {
     ret = real_nanosleep(req, rem);
   }
@@ -6,9 +6,26 @@
 #include "myth_real.h"
 #include "myth_wrap_util_func.h"
 
+#if MYTH_WRAP_SOCKIO
+#include "myth_worker.h"
+#include "myth_io.h"
+#include "myth_sched_func.h"
+#include "myth_io_func.h"
+
+/* with MYTH_WRAP_SOCKIO=1, a socket call that would block a user
+   thread parks it in the I/O layer (myth_io_func.h) instead of
+   blocking its worker. calls before myth_init, after myth_fini
+   and from threads that are not workers go straight to the system */
+#define myth_sockio(body, real) \
+  (((g_myth_io_on & MYTH_IO_ON_SOCK) && g_worker_rank >= 0) ? (body) : (real))
+#else
+#define myth_sockio(body, real) (real)
+#endif
+
 int __wrap(socket)(int domain, int type, int protocol) {
   int _ = enter_wrapped_func("%d, %d, %d", domain, type, protocol);
-  int x = real_socket(domain, type, protocol);
+  int x = myth_sockio(myth_socket_body(domain, type, protocol),
+		      real_socket(domain, type, protocol));
   (void)_;
   leave_wrapped_func("%p", x);
   return x;
@@ -24,7 +41,8 @@ int __wrap(socketpair)(int domain, int type, int protocol, int sv[2]) {
 
 int __wrap(accept)(int sockfd, struct sockaddr *addr, socklen_t *addrlen) {
   int _ = enter_wrapped_func("%d, %p, %p", sockfd, addr, addrlen);
-  int x = real_accept(sockfd, addr, addrlen);
+  int x = myth_sockio(myth_accept_body(sockfd, addr, addrlen),
+		      real_accept(sockfd, addr, addrlen));
   (void)_;
   leave_wrapped_func("%p", x);
   return x;
@@ -34,7 +52,8 @@ int __wrap(accept)(int sockfd, struct sockaddr *addr, socklen_t *addrlen) {
 int __wrap(accept4)(int sockfd, struct sockaddr *addr,
 		    socklen_t *addrlen, int flags) {
   int _ = enter_wrapped_func("%d, %p, %p, %d", sockfd, addr, addrlen, flags);
-  int x = real_accept4(sockfd, addr, addrlen, flags);
+  int x = myth_sockio(myth_accept4_body(sockfd, addr, addrlen, flags),
+		      real_accept4(sockfd, addr, addrlen, flags));
   (void)_;
   leave_wrapped_func("%p", x);
   return x;
@@ -44,7 +63,8 @@ int __wrap(accept4)(int sockfd, struct sockaddr *addr,
 
 int __wrap(bind)(int sockfd, const struct sockaddr *addr, socklen_t addrlen) {
   int _ = enter_wrapped_func("%d, %p, %lu", sockfd, addr, addrlen);
-  int x = real_bind(sockfd, addr, addrlen);
+  int x = myth_sockio(myth_bind_body(sockfd, addr, addrlen),
+		      real_bind(sockfd, addr, addrlen));
   (void)_;
   leave_wrapped_func("%p", x);
   return x;
@@ -52,7 +72,7 @@ int __wrap(bind)(int sockfd, const struct sockaddr *addr, socklen_t addrlen) {
 
 int __wrap(close)(int fd) {
   int _ = enter_wrapped_func("%d", fd);
-  int x = real_close(fd);
+  int x = myth_sockio(myth_close_body(fd), real_close(fd));
   (void)_;
   leave_wrapped_func("%p", x);
   return x;
@@ -61,7 +81,8 @@ int __wrap(close)(int fd) {
 int __wrap(connect)(int sockfd, const struct sockaddr *addr,
 		    socklen_t addrlen) {
   int _ = enter_wrapped_func("%d, %p, %lu", sockfd, addr, addrlen);
-  int x = real_connect(sockfd, addr, addrlen);
+  int x = myth_sockio(myth_connect_body(sockfd, addr, addrlen),
+		      real_connect(sockfd, addr, addrlen));
   (void)_;
   leave_wrapped_func("%p", x);
   return x;
@@ -158,7 +179,8 @@ int __wrap(fcntl)(int fd, int cmd, ... /* arg */ ) {
 
 int __wrap(listen)(int sockfd, int backlog) {
   int _ = enter_wrapped_func("%d, %d", sockfd, backlog);
-  int x = real_listen(sockfd, backlog);
+  int x = myth_sockio(myth_listen_body(sockfd, backlog),
+		      real_listen(sockfd, backlog));
   (void)_;
   leave_wrapped_func("%p", x);
   return x;
@@ -166,7 +188,8 @@ int __wrap(listen)(int sockfd, int backlog) {
 
 ssize_t __wrap(recv)(int sockfd, void *buf, size_t len, int flags) {
   int _ = enter_wrapped_func("%d, %p, %lu, %d", sockfd, buf, len, flags);
-  ssize_t x = real_recv(sockfd, buf, len, flags);
+  ssize_t x = myth_sockio(myth_recv_body(sockfd, buf, len, flags),
+			  real_recv(sockfd, buf, len, flags));
   (void)_;
   leave_wrapped_func("%p", x);
   return x;
@@ -176,7 +199,9 @@ ssize_t __wrap(recvfrom)(int sockfd, void *buf, size_t len, int flags,
 			 struct sockaddr *src_addr, socklen_t *addrlen) {
   int _ = enter_wrapped_func("%d, %p, %lu, %d, %p, %p",
 			     sockfd, buf, len, flags, src_addr, addrlen);
-  ssize_t x = real_recvfrom(sockfd, buf, len, flags, src_addr, addrlen);
+  ssize_t x = myth_sockio(myth_recvfrom_body(sockfd, buf, len, flags,
+					     src_addr, addrlen),
+			  real_recvfrom(sockfd, buf, len, flags, src_addr, addrlen));
   (void)_;
   leave_wrapped_func("%p", x);
   return x;
@@ -184,32 +209,58 @@ ssize_t __wrap(recvfrom)(int sockfd, void *buf, size_t len, int flags,
 
 ssize_t __wrap(recvmsg)(int sockfd, struct msghdr *msg, int flags) {
   int _ = enter_wrapped_func("%d, %p, %d", sockfd, msg, flags);
-  ssize_t x = real_recvmsg(sockfd, msg, flags);
+  ssize_t x = myth_sockio(myth_recvmsg_body(sockfd, msg, flags),
+			  real_recvmsg(sockfd, msg, flags));
   (void)_;
   leave_wrapped_func("%p", x);
   return x;
 }
 
-ssize_t __wrap(read)(int fd, void *buf, size_t count) {
-  int _ = enter_wrapped_func("%d, %p, %lu", fd, buf, count);
-  ssize_t x = real_read(fd, buf, count);
+int __wrap(select)(int nfds, fd_set *readfds, fd_set *writefds,
+		   fd_set *exceptfds, struct timeval *timeout) {
+  int _ = enter_wrapped_func("%d, %p, %p, %p, %p", nfds, readfds, writefds, exceptfds, timeout);
+  int x = myth_sockio(myth_select_body(nfds, readfds, writefds, exceptfds, timeout),
+		      real_select(nfds, readfds, writefds, exceptfds, timeout));
   (void)_;
   leave_wrapped_func("%p", x);
   return x;
 }
 
-int __wrap(select)(int nfds, fd_set *readfds, fd_set *writefds,
-		   fd_set *exceptfds, struct timeval *timeout) {
-  int _ = enter_wrapped_func("%d, %p, %p, %p, %p", nfds, readfds, writefds, exceptfds, timeout);
-  int x = real_select(nfds, readfds, writefds, exceptfds, timeout);
+int __wrap(poll)(struct pollfd *fds, nfds_t nfds, int timeout) {
+  int _ = enter_wrapped_func("%p, %lu, %d", fds, nfds, timeout);
+  int x = myth_sockio(myth_poll_body(fds, nfds, timeout),
+		      real_poll(fds, nfds, timeout));
   (void)_;
-  leave_wrapped_func("%p", x);
+  leave_wrapped_func("%d", x);
+  return x;
+}
+
+#if defined(HAVE_PPOLL)
+int __wrap(ppoll)(struct pollfd *fds, nfds_t nfds,
+		  const struct timespec *tmo_p, const sigset_t *sigmask) {
+  int _ = enter_wrapped_func("%p, %lu, %p, %p", fds, nfds, tmo_p, sigmask);
+  int x = myth_sockio(myth_ppoll_body(fds, nfds, tmo_p, sigmask),
+		      real_ppoll(fds, nfds, tmo_p, sigmask));
+  (void)_;
+  leave_wrapped_func("%d", x);
+  return x;
+}
+#endif	/* HAVE_PPOLL */
+
+int __wrap(epoll_wait)(int epfd, struct epoll_event *events,
+		       int maxevents, int timeout) {
+  int _ = enter_wrapped_func("%d, %p, %d, %d", epfd, events, maxevents, timeout);
+  int x = myth_sockio(myth_epoll_wait_body(epfd, events, maxevents, timeout),
+		      real_epoll_wait(epfd, events, maxevents, timeout));
+  (void)_;
+  leave_wrapped_func("%d", x);
   return x;
 }
 
 ssize_t __wrap(send)(int sockfd, const void *buf, size_t len, int flags) {
   int _ = enter_wrapped_func("%d, %p, %lu, %d", sockfd, buf, len, flags);
-  ssize_t x = real_send(sockfd, buf, len, flags);
+  ssize_t x = myth_sockio(myth_send_body(sockfd, buf, len, flags),
+			  real_send(sockfd, buf, len, flags));
   (void)_;
   leave_wrapped_func("%p", x);
   return x;
@@ -219,7 +270,9 @@ ssize_t __wrap(sendto)(int sockfd, const void *buf, size_t len, int flags,
 		       const struct sockaddr *dest_addr, socklen_t addrlen) {
   int _ = enter_wrapped_func("%d, %p, %lu, %d, %p, %p",
 			     sockfd, buf, len, flags, dest_addr, addrlen);
-  ssize_t x = real_sendto(sockfd, buf, len, flags, dest_addr, addrlen);
+  ssize_t x = myth_sockio(myth_sendto_body(sockfd, buf, len, flags,
+					   dest_addr, addrlen),
+			  real_sendto(sockfd, buf, len, flags, dest_addr, addrlen));
   (void)_;
   leave_wrapped_func("%p", x);
   return x;
@@ -227,16 +280,66 @@ ssize_t __wrap(sendto)(int sockfd, const void *buf, size_t len, int flags,
 
 ssize_t __wrap(sendmsg)(int sockfd, const struct msghdr *msg, int flags) {
   int _ = enter_wrapped_func("%d, %p, %d", sockfd, msg, flags);
-  ssize_t x = real_sendmsg(sockfd, msg, flags);
+  ssize_t x = myth_sockio(myth_sendmsg_body(sockfd, msg, flags),
+			  real_sendmsg(sockfd, msg, flags));
   (void)_;
   leave_wrapped_func("%p", x);
   return x;
 }
 
-ssize_t __wrap(write)(int fd, const void *buf, size_t count) {
-  int _ = enter_wrapped_func("%d, %p, %lu", fd, buf, count);
-  ssize_t x = real_write(fd, buf, count);
+int __wrap(setsockopt)(int sockfd, int level, int optname,
+		       const void *optval, socklen_t optlen) {
+  int _ = enter_wrapped_func("%d, %d, %d, %p, %lu", sockfd, level, optname, optval, optlen);
+  int x = myth_sockio(myth_setsockopt_body(sockfd, level, optname, optval, optlen),
+		      real_setsockopt(sockfd, level, optname, optval, optlen));
+  (void)_;
+  leave_wrapped_func("%d", x);
+  return x;
+}
+
+#if defined(HAVE_SYS_SENDFILE_H)
+ssize_t __wrap(sendfile)(int out_fd, int in_fd, off_t *offset, size_t count) {
+  int _ = enter_wrapped_func("%d, %d, %p, %lu", out_fd, in_fd, offset, count);
+  ssize_t x = myth_sockio(myth_sendfile_body(out_fd, in_fd, offset, count),
+			  real_sendfile(out_fd, in_fd, offset, count));
+  (void)_;
+  leave_wrapped_func("%p", x);
+  return x;
+}
+#endif	/* HAVE_SYS_SENDFILE_H */
+
+#if defined(HAVE_SPLICE)
+ssize_t __wrap(splice)(int fd_in, loff_t *off_in, int fd_out, loff_t *off_out,
+		       size_t len, unsigned int flags) {
+  int _ = enter_wrapped_func("%d, %p, %d, %p, %lu, %u",
+			     fd_in, off_in, fd_out, off_out, len, flags);
+  ssize_t x = myth_sockio(myth_splice_body(fd_in, off_in, fd_out, off_out, len, flags),
+			  real_splice(fd_in, off_in, fd_out, off_out, len, flags));
   (void)_;
   leave_wrapped_func("%p", x);
   return x;
 }
+#endif	/* HAVE_SPLICE */
+
+#if defined(HAVE_RECVMMSG)
+int __wrap(recvmmsg)(int sockfd, struct mmsghdr *msgvec, unsigned int vlen,
+		     int flags, struct timespec *timeout) {
+  int _ = enter_wrapped_func("%d, %p, %u, %d, %p", sockfd, msgvec, vlen, flags, timeout);
+  int x = myth_sockio(myth_recvmmsg_body(sockfd, msgvec, vlen, flags, timeout),
+		      real_recvmmsg(sockfd, msgvec, vlen, flags, timeout));
+  (void)_;
+  leave_wrapped_func("%d", x);
+  return x;
+}
+#endif	/* HAVE_RECVMMSG */
+
+#if defined(HAVE_SENDMMSG)
+int __wrap(sendmmsg)(int sockfd, struct mmsghdr *msgvec, unsigned int vlen, int flags) {
+  int _ = enter_wrapped_func("%d, %p, %u, %d", sockfd, msgvec, vlen, flags);
+  int x = myth_sockio(myth_sendmmsg_body(sockfd, msgvec, vlen, flags),
+		      real_sendmmsg(sockfd, msgvec, vlen, flags));
+  (void)_;
+  leave_wrapped_func("%d", x);
+  return x;
+}
+#endif	/* HAVE_SENDMMSG */
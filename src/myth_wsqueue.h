@@ -71,6 +71,7 @@ typedef struct myth_thread_queue
   struct myth_thread** ptr;
   int size;
   myth_spinlock_t lock;
+  unsigned long long n_pops;//Items popped by the owner (see myth_get_stats)
 #if USE_LOCK || USE_LOCK_ANY
   myth_spinlock_t m_lock;
 #endif
@@ -118,6 +118,7 @@ static inline void myth_queue_init(myth_thread_queue_t q){
   memset(q->ptr,0,sizeof(myth_thread_t)*q->size);
   q->base = q->size/2;
   q->top = q->base;
+  q->n_pops = 0;
   memset(&q->wc,0,sizeof(myth_wscache));
 }
 
@@ -190,6 +191,48 @@ static inline void __attribute__((always_inline)) myth_queue_push(myth_thread_qu
   myth_queue_exit_operation(q);
 }
 
+//Push n threads at once, publishing them with a single barrier
+static inline void myth_queue_push_many(myth_thread_queue_t q, myth_thread_t * th, int n)
+{
+  myth_queue_enter_operation(q);
+#if USE_LOCK || USE_LOCK_PUSH
+  myth_spin_lock_body(&q->m_lock);
+#endif
+  int t = q->top;
+  int i;
+  //read barrier
+  myth_wsqueue_rbarrier();
+  if (t + n > q->size){
+    //Acquire lock
+    myth_wsqueue_lock_lock(&q->lock);
+    //Runqueue full?
+    if (q->base + (q->size - q->top) < n){
+      myth_assert(0);
+      fprintf(stderr, "Fatal error:Runqueue overflow\n");
+      abort();
+      /* TODO:extend runqueue */
+    } else {
+      //Shift pointers, leaving half the free entries below
+      int offset = (q->base + (q->size - q->top) - n) / 2 - q->base;
+      myth_assert(offset < 0);
+      memmove(&q->ptr[q->base+offset], &q->ptr[q->base],
+	      sizeof(myth_thread_t) * (q->top - q->base));
+      q->top += offset;
+      q->base += offset;
+    }
+    t = q->top;
+    myth_assert(t + n <= q->size);
+    myth_wsqueue_lock_unlock(&q->lock);
+  }
+  for (i = 0; i < n; i++) q->ptr[t + i] = th[i];
+  myth_wsqueue_wbarrier();//Guarantee W-W dependency
+  q->top = t + n;
+#if USE_LOCK || USE_LOCK_PUSH
+  myth_spin_unlock_body(&q->m_lock);
+#endif
+  myth_queue_exit_operation(q);
+}
+
 #if MYTH_QUEUE_LIFO
 static inline myth_thread_t __attribute__((always_inline)) myth_queue_pop(myth_thread_queue_t q)
 {
@@ -219,6 +262,7 @@ static inline myth_thread_t __attribute__((always_inline)) myth_queue_pop(myth_t
     myth_spin_unlock_body(&q->m_lock);
 #endif
     myth_queue_exit_operation(q);
+    q->n_pops++;
     return ret;
   } else {
     myth_wsqueue_lock_lock(&q->lock);
@@ -246,6 +290,7 @@ static inline myth_thread_t __attribute__((always_inline)) myth_queue_pop(myth_t
       myth_spin_unlock_body(&q->m_lock);
 #endif
       myth_queue_exit_operation(q);
+      q->n_pops++;
       return ret;
     } else {
       q->top = q->size/2;
@@ -264,7 +309,9 @@ static inline myth_thread_t __attribute__((always_inline)) myth_queue_pop(myth_t
 #else  /* MYTH_QUEUE_LIFO */
 static inline myth_thread_t myth_queue_take(myth_thread_queue_t q);
 static inline myth_thread_t myth_queue_pop(myth_thread_queue_t q){
-  return myth_queue_take(q);
+  myth_thread_t ret = myth_queue_take(q);
+  if (ret) q->n_pops++;
+  return ret;
 }
 #endif /* MYTH_QUEUE_LIFO */
 
@@ -366,6 +413,37 @@ static inline int myth_queue_trypass(myth_thread_queue_t q,myth_thread_t th)
   return ret;
 }
 
+//Give n threads at once to the bottom of another worker's queue.
+//0 if it is busy or has no room for them
+static inline int myth_queue_trypass_many(myth_thread_queue_t q,myth_thread_t * th,int n)
+{
+#if USE_LOCK || USE_LOCK_TRYPASS
+  myth_spin_lock_body(&q->m_lock);
+#endif
+  int ret = 1;
+  if (!myth_wsqueue_lock_trylock(&q->lock)) {
+#if USE_LOCK || USE_LOCK_TRYPASS
+    myth_spin_unlock_body(&q->m_lock);
+#endif
+    return 0;
+  }
+  if (q->base < n){
+    ret = 0;
+  }
+  else{
+    int b, i;
+    b = q->base;
+    for (i = 0; i < n; i++) q->ptr[b-n+i] = th[i];
+    myth_wsqueue_wbarrier();
+    q->base = b - n;
+  }
+  myth_wsqueue_lock_unlock(&q->lock);
+#if USE_LOCK || USE_LOCK_TRYPASS
+  myth_spin_unlock_body(&q->m_lock);
+#endif
+  return ret;
+}
+
 static inline void myth_queue_pass(myth_thread_queue_t q,myth_thread_t th)
 {
   int ret;
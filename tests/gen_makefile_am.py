@@ -15,6 +15,14 @@ files_in_order = [
     (0, "myth_create_1"),
     (0, "myth_create_2"),
     (0, "myth_create_join_many"),
+    (0, "myth_create_join_many_grain"),
+    (0, "myth_stats"),
+    (0, "myth_create_many"),
+    (0, "myth_join_oversub"),
+    (0, "myth_fpcsr"),
+    (0, "myth_task"),
+    (0, "myth_coro"),
+    (0, "myth_cancel"),
     (0, "myth_yield_0"),
     (0, "myth_yield_1"),
     (0, "myth_yield_2"),
@@ -37,10 +45,22 @@ files_in_order = [
     (0, "myth_key_getspecific"),
     (0, "myth_key_destructor"),
     (0, "myth_globalattr_set_n_workers"),
+    (0, "myth_alloc_stats"),
+    (0, "myth_wrap_malloc"),
+    (0, "myth_sockio"),
+    (0, "myth_sockio_vec"),
+    (0, "myth_sockio_mmsg"),
+    (0, "myth_sockio_poll"),
+    (0, "myth_sockio_fds"),
+    (0, "myth_sockio_sched"),
+    (0, "myth_sockio_shard"),
+    (0, "myth_sockio_stats"),
+    (0, "myth_fileio"),
     (0, "measure_create"),
     (0, "measure_latency"),
     (0, "measure_wakeup_latency"),
     (0, "measure_malloc"),
+    (0, "measure_fileio"),
     (0, "measure_thread_specific"),
     (0, "pth_barrier"),
     (0, "pth_cond_broadcast_0"),
@@ -54,8 +74,20 @@ files_in_order = [
     (0, "pth_mutex_initializer"),
     (0, "pth_trylock"),
     (0, "pth_yield"),
+    (1, "myth_mtbb_coro"),
 ]
 
+# flags some tests need on top of common_cflags/common_cxxflags
+extra_flags = {
+    "myth_mtbb_coro" : "-I$(abs_top_srcdir)/src $(CXX_COROUTINE_FLAGS)",
+}
+
+def file_extra_flags(f):
+    for x,flags in extra_flags.items():
+        if x in f:
+            return " " + flags
+    return ""
+
 def file_order(f):
     for i,(c,x) in enumerate(files_in_order):
         if x in f:
@@ -146,12 +178,12 @@ def add_flags(lib):
             assert 0, f
         if cond: wr("if %s\n" % cond)
         wr("""%s_SOURCES = %s
-%s_%sFLAGS = $(common_%sflags)
+%s_%sFLAGS = $(common_%sflags)%s
 %s_LDADD = $(%s_ldadd)
 %s_LDFLAGS = $(%s_ldflags)
 """
            % (base_suffix, f,
-              base_suffix, lang.upper(), lang,
+              base_suffix, lang.upper(), lang, file_extra_flags(f),
               base_suffix, lib,
               base_suffix, lib))
         if cond: wr("endif\n")
@@ -1,5 +1,6 @@
 
 #include <assert.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <time.h>
@@ -29,6 +30,37 @@ void * f(void * arg_) {
   return 0;
 }
 
+/* the same with children spawned by myth_task_spawn */
+void * f_task(void * arg_) {
+  arg_t * arg = (arg_t *)arg_;
+  long a = arg->a, b = arg->b;
+  if (b - a == 1) {
+    arg->r = a;
+  } else {
+    long c = (a + b) / 2;
+    arg_t cargs[2] = { { a, c, 0 }, { c, b, 0 } };
+    myth_task_t t;
+    myth_task_spawn(&t, f_task, cargs);
+    f_task(cargs + 1);
+    myth_task_join(&t, 0);
+    arg->r = cargs[0].r + cargs[1].r;
+  }
+  return 0;
+}
+
+/* CPU clocks where we know how to read them, nanoseconds elsewhere */
+static inline uint64_t cur_clock(void) {
+#if defined __i386__ || defined __x86_64__
+  uint32_t hi, lo;
+  asm volatile("lfence\nrdtsc\n" : "=a"(lo),"=d"(hi));
+  return ((uint64_t)hi)<<32 | lo;
+#else
+  struct timespec ts[1];
+  clock_gettime(CLOCK_MONOTONIC, ts);
+  return ts->tv_sec * 1000000000ull + ts->tv_nsec;
+#endif
+}
+
 double cur_time() {
   struct timeval tv[1];
   gettimeofday(tv, 0);
@@ -38,22 +70,28 @@ double cur_time() {
 int main(int argc, char ** argv) {
   long nthreads = (argc > 1 ? atol(argv[1]) : 100000);
   arg_t arg[1] = { { 0, nthreads, 0 } };
-  long i;
-  for (i = 0; i < 3; i++) {
-    double t0 = cur_time();
-    myth_thread_t tid = myth_create(f, arg);
-    myth_join(tid, 0);
-    double t1 = cur_time();
-    double dt = t1 - t0;
-    if (arg->r == (nthreads - 1) * nthreads / 2) {
-      printf("OK\n");
-      printf("%ld thread creation/join in %.9f sec (%.3f per sec)\n",
-	     nthreads, dt, nthreads / dt);
-    } else {
-      printf("NG\n");
-      return 1;
+  long i, k;
+  for (k = 0; k < 2; k++) {
+    myth_func_t fn = (k ? f_task : f);
+    const char * what = (k ? "task spawn/join" : "thread creation/join");
+    for (i = 0; i < 3; i++) {
+      double t0 = cur_time();
+      uint64_t c0 = cur_clock();
+      myth_thread_t tid = myth_create(fn, arg);
+      myth_join(tid, 0);
+      uint64_t c1 = cur_clock();
+      double t1 = cur_time();
+      double dt = t1 - t0;
+      if (arg->r == (nthreads - 1) * nthreads / 2) {
+	printf("OK\n");
+	printf("%ld %s in %.9f sec (%.3f per sec, %.1f clocks each)\n",
+	       nthreads, what, dt, nthreads / dt,
+	       (double)(c1 - c0) / nthreads);
+      } else {
+	printf("NG\n");
+	return 1;
+      }
     }
   }
   return 0;
 }
-
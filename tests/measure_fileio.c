@@ -0,0 +1,106 @@
+/* run CPU-bound tasks mixed with tasks writing, syncing and
+   reading back files, and report how busy the workers were
+   with the CPU-bound ones.
+   with libmyth-ld or libmyth-dl, compare file calls blocking
+   their workers against those offloaded to io_uring or helper
+   threads with
+     MYTH_WRAP_FILEIO=0 ./measure_fileio_ld 1000 100 /var/tmp
+     MYTH_WRAP_FILEIO=1 ./measure_fileio_ld 1000 100 /var/tmp
+     MYTH_WRAP_FILEIO=1 MYTH_IO_URING=0 ./measure_fileio_ld 1000 100 /var/tmp */
+
+#include <assert.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#include <myth/myth.h>
+
+enum { file_sz = 256 << 10, chunk = 16 << 10 };
+
+static long cpu_iters = 1000000;
+static const char * dir = ".";
+
+double cur_time() {
+  struct timeval tv[1];
+  gettimeofday(tv, 0);
+  return tv->tv_sec + tv->tv_usec * 1.0e-6;
+}
+
+void * cpu_task(void * arg) {
+  volatile double x = 1.0;
+  long i;
+  (void)arg;
+  for (i = 0; i < cpu_iters; i++) x = x * 0.999999 + 1.0e-6;
+  return 0;
+}
+
+void * disk_task(void * arg) {
+  long id = (long)arg;
+  char path[4096];
+  char * buf = (char *)malloc(chunk);
+  long i;
+  int fd;
+  snprintf(path, sizeof(path), "%s/measure_fileio.%d.%ld.tmp",
+	   dir, (int)getpid(), id);
+  memset(buf, (int)id, chunk);
+  fd = open(path, O_CREAT | O_TRUNC | O_RDWR, 0600);
+  if (fd < 0) {
+    perror(path);
+    exit(1);
+  }
+  for (i = 0; i < file_sz; i += chunk) {
+    assert(write(fd, buf, chunk) == chunk);
+  }
+  assert(fsync(fd) == 0);
+  for (i = 0; i < file_sz; i += chunk) {
+    assert(pread(fd, buf, chunk, i) == chunk);
+  }
+  assert(close(fd) == 0);
+  assert(unlink(path) == 0);
+  free(buf);
+  return 0;
+}
+
+int main(int argc, char ** argv) {
+  long n_cpu = (argc > 1 ? atol(argv[1]) : 200);
+  long n_disk = (argc > 2 ? atol(argv[2]) : 20);
+  const char * wrap = getenv("MYTH_WRAP_FILEIO");
+  myth_thread_t * th;
+  long n = n_cpu + n_disk;
+  long i, j;
+  int r, nw;
+  if (argc > 3) dir = argv[3];
+  myth_init();
+  nw = myth_get_num_workers();
+  th = (myth_thread_t *)malloc(sizeof(myth_thread_t) * (n > 0 ? n : 1));
+  /* what a CPU-bound task takes alone */
+  double c0 = cur_time();
+  cpu_task(0);
+  double t_cpu = cur_time() - c0;
+  printf("file I/O: %s\n",
+	 (wrap && atoi(wrap) ? "offloaded" : "blocking"));
+  for (r = 0; r < 3; r++) {
+    double t0 = cur_time();
+    /* spread disk tasks evenly among CPU-bound ones */
+    for (i = 0, j = 0; i < n; i++) {
+      if (j < n_disk && j * n < i * n_disk + n_disk) {
+	th[i] = myth_create(disk_task, (void *)j);
+	j++;
+      } else {
+	th[i] = myth_create(cpu_task, 0);
+      }
+    }
+    for (i = 0; i < n; i++) myth_join(th[i], 0);
+    double dt = cur_time() - t0;
+    printf("%ld CPU tasks (%.6f sec each) and %ld disk tasks"
+	   " on %d workers in %.6f sec, utilization %.1f%%\n",
+	   n_cpu, t_cpu, n_disk, nw, dt,
+	   100.0 * n_cpu * t_cpu / (dt * nw));
+  }
+  free(th);
+  myth_fini();
+  return 0;
+}
@@ -2,6 +2,7 @@
 #include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 
 #include <myth/myth.h>
@@ -93,11 +94,50 @@ void bench(long n) {
 
 }
 
+typedef struct {
+  volatile int parent_joining;
+  ts_t child_finished;
+} handoff_arg_t;
+
+void * g(void * arg_) {
+  handoff_arg_t * arg = (handoff_arg_t *)arg_;
+  /* let the parent run and wait for us */
+  while (! arg->parent_joining) {
+    myth_yield();
+  }
+  myth_yield();
+  arg->child_finished = cur_time();
+  return 0;
+}
+
+/* from a child returning to its parent, which was blocked in
+   myth_join, running again */
+void bench_handoff(long n) {
+  long i;
+  ts_t handoff_latency_sum = 0;
+  handoff_arg_t arg[1];
+
+  for (i = 0; i < n; i++) {
+    arg->parent_joining = 0;
+    myth_thread_t c = myth_create(g, arg);
+    arg->parent_joining = 1;
+    myth_join(c, 0);
+    ts_t t0 = cur_time();
+    handoff_latency_sum += (t0 - arg->child_finished);
+  }
+
+  printf("avg handoff latency = %.9f clocks\n", handoff_latency_sum / (double)n);
+}
+
+/* measure_latency [N [handoff]]; bench spins until the child runs,
+   so it needs two workers, while the handoff case alone runs on one */
 int main(int argc, char ** argv) {
   long n = (argc > 1 ? atol(argv[1]) : 2000);
+  int handoff_only = (argc > 2 && strcmp(argv[2], "handoff") == 0);
   long i;
   for (i = 0; i < 3; i++) {
-    bench(n);
+    if (! handoff_only) bench(n);
+    bench_handoff(n);
   }
   return 0;
 }
@@ -1,3 +1,10 @@
+/* allocate the nodes of a binary tree in parallel, and then
+   free them in parallel (mostly by workers other than those
+   that allocated them).
+   with libmyth-ld or libmyth-dl, compare the real malloc against
+   the per-worker caches of MassiveThreads with
+     MYTH_WRAP_MALLOC=0 ./measure_malloc_ld 1000000
+     MYTH_WRAP_MALLOC=1 ./measure_malloc_ld 1000000 */
 
 #include <assert.h>
 #include <stdio.h>
@@ -92,8 +99,11 @@ double cur_time() {
 int main(int argc, char ** argv) {
   long nthreads = (argc > 1 ? atol(argv[1]) : 1000);
   long i;
+  myth_alloc_stats_t s0, s1;
+  myth_init();
   for (i = 0; i < 3; i++) {
     arg_t arg[1] = { { 0, nthreads, 0 } };
+    myth_get_alloc_stats(-1, &s0);
     double t0 = cur_time();
     myth_thread_t tid = myth_create(mk_tree, arg);
     myth_join(tid, 0);
@@ -102,13 +112,20 @@ int main(int argc, char ** argv) {
     tid = myth_create(del_tree, arg);
     myth_join(tid, 0);
     double t2 = cur_time();
+    myth_get_alloc_stats(-1, &s1);
     double dt0 = t1 - t0;
     double dt1 = t2 - t1;
     long n_nodes = 2 * nthreads - 1;
+    /* nodes allocated by MassiveThreads count in its stats */
+    printf("malloc: %s\n",
+	   (s1.n_allocs - s0.n_allocs >= (unsigned long long)n_nodes
+	    ? "myth" : "real"));
     printf("%ld allocates in %.9f sec (%.3f per sec)\n",
-	   n_nodes, dt0, n_nodes / dt1);
+	   n_nodes, dt0, n_nodes / dt0);
     printf("%ld frees in %.9f sec (%.3f per sec)\n",
 	   n_nodes, dt1, n_nodes / dt1);
+    printf("%llu of them freed remotely\n",
+	   s1.n_remote_frees - s0.n_remote_frees);
   }
   return 0;
 }
@@ -0,0 +1,195 @@
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <myth/myth.h>
+
+/* stacks of threads created with an explicit stack size
+   come from the internal allocator. create trees of such
+   threads so that stacks are often freed by a worker other
+   than the one that allocated them, and check that one is
+   (remote_free) and that per-worker caches stay bounded
+   (cache_bound) */
+
+typedef struct {
+  long a;
+  long b;
+  long r;
+  size_t stacksize;
+} arg_t;
+
+void * f(void * arg_) {
+  arg_t * arg = (arg_t *)arg_;
+  long a = arg->a, b = arg->b;
+  if (b - a == 1) {
+    arg->r = a;
+  } else {
+    long c = (a + b) / 2;
+    arg_t cargs[2] = { { a, c, 0, arg->stacksize }, { c, b, 0, arg->stacksize } };
+    myth_thread_attr_t attr;
+    myth_thread_t tid;
+    myth_thread_attr_init(&attr);
+    myth_thread_attr_setstacksize(&attr, arg->stacksize);
+    myth_create_ex(&tid, &attr, f, cargs);
+    f(cargs + 1);
+    myth_join(tid, 0);
+    arg->r = cargs[0].r + cargs[1].r;
+  }
+  return 0;
+}
+
+void * nop(void * arg) {
+  return arg;
+}
+
+static volatile long gen;
+
+/* keep the worker busy until its creator, which has been
+   stolen meanwhile (or is yet to be), moves gen on */
+void * spinner(void * arg) {
+  while (gen == (long)arg) { }
+  return 0;
+}
+
+static myth_mutex_t m[1];
+static myth_cond_t c[1];
+static volatile int go;
+
+void * waiter(void * arg) {
+  myth_mutex_lock(m);
+  while (!go) myth_cond_wait(c, m);
+  myth_mutex_unlock(m);
+  return arg;
+}
+
+/* free a stack on a worker other than the one that allocated it.
+   a thread finishing releases its stack, and a woken thread runs
+   on the worker of its waker, so wake up a waiter from another
+   worker, which the creator moves to by spawning spinners. the
+   worker it came from may steal the waiter back, so retry */
+static void remote_free(void) {
+  myth_alloc_stats_t s, t;
+  myth_thread_attr_t attr;
+  myth_thread_t tid;
+  int i, j, r;
+  myth_thread_attr_init(&attr);
+  myth_thread_attr_setstacksize(&attr, 4096);
+  myth_mutex_init(m, 0);
+  myth_cond_init(c, 0);
+  assert(myth_get_alloc_stats(-1, &s) == 0);
+  for (i = 0; i < 100; i++) {
+    go = 0;
+    r = myth_get_worker_num();
+    myth_create_ex(&tid, &attr, waiter, 0);
+    for (j = 0; j < 1000 && myth_get_worker_num() == r; j++) {
+      long g = gen;
+      myth_detach(myth_create(spinner, (void *)g));
+      gen = g + 1;
+    }
+    myth_mutex_lock(m);
+    go = 1;
+    myth_cond_signal(c);
+    myth_mutex_unlock(m);
+    myth_join(tid, 0);
+    assert(myth_get_alloc_stats(-1, &t) == 0);
+    if (t.n_remote_frees > s.n_remote_frees) break;
+  }
+  assert(t.n_remote_frees > s.n_remote_frees);
+  myth_cond_destroy(c);
+  myth_mutex_destroy(m);
+}
+
+static myth_barrier_t bar[1];
+
+void * barrier_waiter(void * arg) {
+  myth_barrier_wait(bar);
+  return arg;
+}
+
+/* blocks a worker keeps per size class (MYTH_FL_CACHE_BYTES
+   over the block size); see myth_config.h */
+#define CACHE_CAP_4096 (1024 * 1024 / 4096)
+
+/* free many blocks of one class at once: n threads wait at a
+   barrier and release their stacks when they finish. each worker
+   keeps at most CACHE_CAP_4096 of those it frees and spills the
+   rest to the global pool */
+static void cache_bound(long n) {
+  myth_alloc_stats_t s, t;
+  myth_thread_attr_t attr;
+  myth_thread_t * tids = malloc(sizeof(myth_thread_t) * n);
+  long i, local;
+  myth_thread_attr_init(&attr);
+  myth_thread_attr_setstacksize(&attr, 4096);
+  assert(myth_barrier_init(bar, 0, n + 1) == 0);
+  for (i = 0; i < n; i++) {
+    myth_create_ex(&tids[i], &attr, barrier_waiter, 0);
+  }
+  /* nothing is allocated from here on */
+  assert(myth_get_alloc_stats(-1, &s) == 0);
+  myth_barrier_wait(bar);
+  for (i = 0; i < n; i++) {
+    myth_join(tids[i], 0);
+  }
+  assert(myth_get_alloc_stats(-1, &t) == 0);
+  local = (long)((t.n_frees - s.n_frees) - (t.n_remote_frees - s.n_remote_frees));
+  assert(local + (long)(t.n_remote_frees - s.n_remote_frees) == n);
+  assert((long)(t.n_spills - s.n_spills)
+	 >= local - (long)myth_get_num_workers() * CACHE_CAP_4096);
+  assert(myth_barrier_destroy(bar) == 0);
+  free(tids);
+}
+
+int main(int argc, char ** argv) {
+  long nthreads = (argc > 1 ? atol(argv[1]) : 10000);
+  /* a slab class, a power of two and a size in between */
+  size_t sizes[3] = { 4096, 16384, 20480 };
+  myth_alloc_stats_t s, t;
+  int i, nw;
+  for (i = 0; i < 3; i++) {
+    arg_t arg[1] = { { 0, nthreads, 0, sizes[i] } };
+    f(arg);
+    assert(arg->r == (nthreads - 1) * nthreads / 2);
+  }
+  assert(myth_get_alloc_stats(-1, &s) == 0);
+  assert(s.n_allocs >= 3 * (nthreads - 1));
+  assert(s.n_frees <= s.n_allocs);
+  assert(s.n_remote_frees <= s.n_frees);
+  assert(s.n_maps > 0);
+  /* the sum over workers equals the total */
+  nw = myth_get_num_workers();
+  unsigned long long n_allocs = 0, n_frees = 0;
+  for (i = 0; i < nw; i++) {
+    assert(myth_get_alloc_stats(i, &t) == 0);
+    n_allocs += t.n_allocs;
+    n_frees += t.n_frees;
+  }
+  assert(n_allocs >= s.n_allocs);
+  assert(n_frees >= s.n_frees);
+  assert(myth_get_alloc_stats(nw, &t) == EINVAL);
+  assert(myth_get_alloc_stats(-2, &t) == EINVAL);
+  printf("allocs=%llu frees=%llu remote frees=%llu spills=%llu refills=%llu maps=%llu (%llu bytes)\n",
+	 s.n_allocs, s.n_frees, s.n_remote_frees, s.n_spills,
+	 s.n_refills, s.n_maps, s.mapped_bytes);
+  /* a spawn/join loop reuses the descriptor and
+     the stack its previous child has just freed */
+  for (i = 0; i < nthreads; i++) {
+    myth_thread_t tid = myth_create(nop, 0);
+    myth_join(tid, 0);
+  }
+  assert(myth_get_alloc_stats(-1, &t) == 0);
+  assert(t.n_desc_hot_hits + t.n_desc_hot_misses
+	 >= s.n_desc_hot_hits + s.n_desc_hot_misses + nthreads);
+  assert(t.n_stack_hot_hits + t.n_stack_hot_misses
+	 >= s.n_stack_hot_hits + s.n_stack_hot_misses + nthreads);
+  assert(t.n_desc_hot_hits > s.n_desc_hot_hits);
+  assert(t.n_stack_hot_hits > s.n_stack_hot_hits);
+  printf("hot slot hits: desc %llu/%llu stack %llu/%llu\n",
+	 t.n_desc_hot_hits, t.n_desc_hot_hits + t.n_desc_hot_misses,
+	 t.n_stack_hot_hits, t.n_stack_hot_hits + t.n_stack_hot_misses);
+  cache_bound(nthreads);
+  if (nw > 1) remote_free();
+  printf("OK\n");
+  return 0;
+}
@@ -0,0 +1,216 @@
+#define _GNU_SOURCE 1
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+#include <myth/myth.h>
+
+/* myth_cancel waking up a thread blocked in myth_cond_wait,
+   myth_usleep and recv, which then fail with ECANCELED (myth_sleep
+   returns the seconds left), and
+   myth_cancel_group cancelling threads that wait in a group,
+   including those created by its members (as threads or as
+   tasks that get a thread) and those that join it afterwards.
+   nobody signals the condition, so a test that is not woken up
+   hangs. recv is tested only when the I/O layer multiplexes it
+   (MYTH_WRAP_SOCKIO=1, without io_uring, whose operations are
+   not interrupted) */
+
+enum { n_members = 50 };
+
+static double cur_time(void) {
+  struct timeval tv[1];
+  gettimeofday(tv, 0);
+  return tv->tv_sec + tv->tv_usec * 1.0e-6;
+}
+
+static myth_mutex_t m[1];
+static myth_cond_t c[1];
+static volatile int n_waiting;
+
+/* wait for c, which is never signaled */
+void * cond_waiter(void * arg) {
+  long r;
+  (void)arg;
+  myth_mutex_lock(m);
+  n_waiting++;
+  r = myth_cond_wait(c, m);
+  /* with the mutex held */
+  n_waiting--;
+  myth_mutex_unlock(m);
+  return (void *)r;
+}
+
+/* wait until n threads have entered cond_waiter and released m */
+static void wait_waiting(int n) {
+  while (1) {
+    myth_mutex_lock(m);
+    if (n_waiting == n) break;
+    myth_mutex_unlock(m);
+    myth_yield();
+  }
+  myth_mutex_unlock(m);
+}
+
+static void cond_waits(void) {
+  myth_thread_t th = myth_create(cond_waiter, 0);
+  void * r;
+  wait_waiting(1);
+  assert(myth_cancel(th) == 0);
+  myth_join(th, &r);
+  assert((long)r == ECANCELED);
+  assert(n_waiting == 0);
+}
+
+void * sleeper(void * arg) {
+  double t0 = cur_time();
+  long r;
+  (void)arg;
+  r = myth_usleep(10 * 1000 * 1000);
+  assert(cur_time() - t0 < 5.0);
+  return (void *)r;
+}
+
+void * long_sleeper(void * arg) {
+  (void)arg;
+  return (void *)(long)myth_sleep(10);
+}
+
+static void sleeps(void) {
+  struct timespec bad = { 0, 1000000000 };
+  myth_thread_t th = myth_create(sleeper, 0);
+  void * r;
+  int i;
+  for (i = 0; i < 10; i++) myth_yield();
+  assert(myth_cancel(th) == 0);
+  myth_join(th, &r);
+  assert((long)r == ECANCELED);
+  th = myth_create(long_sleeper, 0);
+  for (i = 0; i < 10; i++) myth_yield();
+  assert(myth_cancel(th) == 0);
+  myth_join(th, &r);
+  assert((long)r > 5 && (long)r <= 10);
+  /* wrapped or not, nanosleep fails as the system's does */
+  errno = 0;
+  assert(nanosleep(&bad, 0) == -1 && errno == EINVAL);
+}
+
+/* a member that creates another, which joins the group too */
+void * parent(void * arg) {
+  myth_thread_t th = myth_create(cond_waiter, 0);
+  void * r;
+  (void)arg;
+  assert(cond_waiter(0) == (void *)ECANCELED);
+  myth_join(th, &r);
+  return r;
+}
+
+void * returner(void * arg) {
+  return arg;
+}
+
+/* a member that spawns two tasks and joins the first, which gives
+   a thread to the second, which joins the group too */
+void * task_parent(void * arg) {
+  myth_task_t t[2];
+  void * r;
+  (void)arg;
+  assert(myth_task_spawn(&t[0], returner, 0) == 0);
+  assert(myth_task_spawn(&t[1], cond_waiter, 0) == 0);
+  assert(myth_task_join(&t[0], &r) == 0);
+  assert(myth_task_join(&t[1], &r) == 0);
+  return r;
+}
+
+static void groups(void) {
+  myth_cancel_group_t g;
+  myth_thread_attr_t attr;
+  myth_func_t members[3] = { cond_waiter, parent, task_parent };
+  myth_thread_t th[n_members], late;
+  void * r;
+  long i, n = 0;
+  assert(myth_cancel_group_create(&g) == 0);
+  myth_thread_attr_init(&attr);
+  assert(myth_thread_attr_setcancelgroup(&attr, g) == 0);
+  for (i = 0; i < n_members; i++) {
+    assert(myth_create_ex(&th[i], &attr, members[i % 3], 0) == 0);
+    /* parents wait with their child */
+    n += (i % 3 == 1 ? 2 : 1);
+  }
+  wait_waiting(n);
+  assert(myth_cancel_group_destroy(g) == EBUSY);
+  assert(myth_cancel_group(g) == 0);
+  /* cancelled as soon as it joins */
+  assert(myth_create_ex(&late, &attr, cond_waiter, 0) == 0);
+  for (i = 0; i < n_members; i++) {
+    myth_join(th[i], &r);
+    assert((long)r == ECANCELED);
+  }
+  myth_join(late, &r);
+  assert((long)r == ECANCELED);
+  assert(n_waiting == 0);
+  assert(myth_cancel_group_destroy(g) == 0);
+}
+
+static int sock;
+
+void * receiver(void * arg) {
+  char c;
+  (void)arg;
+  assert(recv(sock, &c, 1, 0) == -1);
+  return (void *)(long)errno;
+}
+
+static void recvs(void) {
+  struct sockaddr_in addr;
+  myth_thread_t th;
+  void * r;
+  int i;
+  sock = socket(AF_INET, SOCK_DGRAM, 0);
+  assert(sock >= 0);
+  /* we did not ask for it; the I/O layer did */
+  if (!(fcntl(sock, F_GETFL) & O_NONBLOCK)) {
+    printf("socket calls are not multiplexed\n");
+    close(sock);
+    return;
+  }
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = 0;
+  assert(bind(sock, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+  th = myth_create(receiver, 0);
+  for (i = 0; i < 10; i++) myth_yield();
+  assert(myth_cancel(th) == 0);
+  myth_join(th, &r);
+  assert((long)r == ECANCELED);
+  assert(close(sock) == 0);
+}
+
+int main() {
+  /* must be set before the first call to MassiveThreads */
+  setenv("MYTH_WRAP_SOCKIO", "1", 1);
+  setenv("MYTH_IO_URING", "0", 1);
+  myth_init();
+  myth_mutex_init(m, 0);
+  myth_cond_init(c, 0);
+  cond_waits();
+  sleeps();
+  groups();
+  recvs();
+  myth_cond_destroy(c);
+  myth_mutex_destroy(m);
+  myth_fini();
+  printf("OK\n");
+  return 0;
+}
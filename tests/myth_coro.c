@@ -0,0 +1,124 @@
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <myth/myth.h>
+
+/* coroutines as generators, passing values both ways, nested in
+   one another, destroyed before they finish, and run by many
+   threads that yield the thread from within a coroutine (and so
+   may resume on another worker). yielding outside a coroutine
+   fails */
+
+enum { n_values = 1000, n_threads = 100 };
+
+/* yields 0, 1, ..., n - 1 and returns -1 */
+void * gen(void * arg) {
+  long n = (long)arg, i;
+  for (i = 0; i < n; i++) assert(myth_coro_yield((void *)i, 0) == 0);
+  return (void *)-1;
+}
+
+/* returns the sum of what it is resumed with, until 0 */
+void * sum(void * arg) {
+  long s = 0;
+  void * x = arg;
+  while (x) {
+    s += (long)x;
+    assert(myth_coro_yield((void *)s, &x) == 0);
+  }
+  return (void *)s;
+}
+
+/* yields the squares of what a nested generator yields */
+void * squares(void * arg) {
+  myth_coro_t g;
+  void * x;
+  assert(myth_coro_create(&g, gen, 0) == 0);
+  assert(myth_coro_resume(g, arg, &x) == 0);
+  while (!myth_coro_done(g)) {
+    long v = (long)x;
+    assert(myth_coro_yield((void *)(v * v), 0) == 0);
+    assert(myth_coro_resume(g, 0, &x) == 0);
+  }
+  assert(myth_coro_destroy(g) == 0);
+  return (void *)-1;
+}
+
+/* yields the thread within the coroutine */
+void * yielder(void * arg) {
+  long n = (long)arg, i;
+  for (i = 0; i < n; i++) {
+    myth_yield();
+    assert(myth_coro_yield((void *)i, 0) == 0);
+  }
+  return (void *)-1;
+}
+
+void * thread_main(void * arg) {
+  myth_coro_t co;
+  void * x;
+  long i = 0;
+  assert(myth_coro_create(&co, yielder, 0) == 0);
+  for (assert(myth_coro_resume(co, (void *)20, &x) == 0);
+       !myth_coro_done(co);
+       assert(myth_coro_resume(co, 0, &x) == 0)) {
+    if ((long)x != i++) return (void *)1;
+    myth_yield();
+  }
+  assert(myth_coro_destroy(co) == 0);
+  return (void *)(long)(i == 20 ? 0 : 1);
+}
+
+int main() {
+  myth_coro_t co;
+  myth_thread_t th[n_threads];
+  void * x;
+  long i;
+  /* not in a coroutine */
+  x = (void *)7;
+  assert(myth_coro_yield(0, &x) == EPERM);
+  assert(x == (void *)7);
+  /* a generator */
+  assert(myth_coro_create(&co, gen, 0) == 0);
+  assert(!myth_coro_done(co));
+  for (i = 0; i <= n_values; i++) {
+    assert(myth_coro_resume(co, (void *)n_values, &x) == 0);
+    assert((long)x == (i < n_values ? i : -1));
+  }
+  assert(myth_coro_done(co));
+  assert(myth_coro_resume(co, 0, &x) == EINVAL);
+  assert(myth_coro_destroy(co) == 0);
+  /* values both ways, with a stack of its own size */
+  assert(myth_coro_create(&co, sum, 64 * 1024) == 0);
+  for (i = 1; i <= 100; i++) {
+    assert(myth_coro_resume(co, (void *)i, &x) == 0);
+    assert((long)x == i * (i + 1) / 2);
+  }
+  assert(myth_coro_resume(co, 0, &x) == 0);
+  assert(myth_coro_done(co));
+  assert((long)x == 5050);
+  assert(myth_coro_destroy(co) == 0);
+  /* nested */
+  assert(myth_coro_create(&co, squares, 0) == 0);
+  for (i = 0; i <= 100; i++) {
+    assert(myth_coro_resume(co, (void *)100, &x) == 0);
+    assert((long)x == (i < 100 ? i * i : -1));
+  }
+  assert(myth_coro_destroy(co) == 0);
+  /* dropped halfway */
+  for (i = 0; i < 1000; i++) {
+    assert(myth_coro_create(&co, gen, 0) == 0);
+    assert(myth_coro_resume(co, (void *)10, &x) == 0);
+    assert(myth_coro_destroy(co) == 0);
+  }
+  /* within many threads */
+  for (i = 0; i < n_threads; i++) th[i] = myth_create(thread_main, 0);
+  for (i = 0; i < n_threads; i++) {
+    myth_join(th[i], &x);
+    assert(x == 0);
+  }
+  printf("OK\n");
+  return 0;
+}
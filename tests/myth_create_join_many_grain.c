@@ -0,0 +1,67 @@
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#include <myth/myth.h>
+
+/* myth_create_join_many_grain_ex over many elements that do
+   almost nothing, with one thread per element, with a fixed
+   grainsize and with MYTH_GRAINSIZE_AUTO. every element must
+   be run once and its result stored; the time of each is shown */
+
+typedef struct {
+  long x;
+  long y;
+  void * r;
+} arg_t;
+
+void * f(void * arg_) {
+  arg_t * arg = arg_;
+  arg->y = arg->x * 2;
+  return (void *)(arg->x + 1);
+}
+
+static double cur_time(void) {
+  struct timeval tv[1];
+  gettimeofday(tv, 0);
+  return tv->tv_sec + tv->tv_usec * 1.0e-6;
+}
+
+int main(int argc, char ** argv) {
+  long n = (argc > 1 ? atol(argv[1]) : 1000000);
+  long grains[3] = { 1, 1000, MYTH_GRAINSIZE_AUTO };
+  arg_t * args = calloc(sizeof(arg_t), n);
+  myth_thread_t * ids = calloc(sizeof(myth_thread_t), n);
+  long g, i;
+  for (g = 0; g < 3; g++) {
+    double t0, t1;
+    for (i = 0; i < n; i++) {
+      args[i].x = i;
+      args[i].y = -1;
+      args[i].r = 0;
+      ids[i] = 0;
+    }
+    t0 = cur_time();
+    assert(myth_create_join_many_grain_ex(ids, 0, f, args, &args[0].r,
+					  sizeof(myth_thread_t), 0,
+					  sizeof(arg_t), sizeof(arg_t),
+					  n, grains[g]) == 0);
+    t1 = cur_time();
+    for (i = 0; i < n; i++) {
+      assert(args[i].y == i * 2);
+      assert((long)args[i].r == i + 1);
+      assert(ids[i]);
+    }
+    printf("grainsize %ld: %ld elements in %.6f sec (%.1f ns each)\n",
+	   grains[g], n, t1 - t0, (t1 - t0) * 1.0e9 / n);
+  }
+  assert(myth_create_join_many_grain_ex(0, 0, f, args, 0,
+					0, 0, sizeof(arg_t), 0,
+					n, -1) == EINVAL);
+  free(args);
+  free(ids);
+  printf("OK\n");
+  return 0;
+}
@@ -0,0 +1,94 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#include <myth/myth.h>
+
+/* a fan-out of threads created by myth_create_many, joined and
+   detached, each of which must run once with its own argument.
+   the rate of starting them is shown next to that of creating
+   them one by one with myth_create (in which case each runs
+   first until it yields) */
+
+typedef struct {
+  long x;
+  long y;
+} arg_t;
+
+static long n_done;
+
+void * f(void * arg_) {
+  arg_t * arg = arg_;
+  /* stay alive while the others are created */
+  myth_yield();
+  arg->y = arg->x * arg->x;
+  __sync_fetch_and_add(&n_done, 1);
+  return (void *)arg->x;
+}
+
+static double cur_time(void) {
+  struct timeval tv[1];
+  gettimeofday(tv, 0);
+  return tv->tv_sec + tv->tv_usec * 1.0e-6;
+}
+
+static void check(arg_t * args, long n) {
+  long i;
+  for (i = 0; i < n; i++) {
+    assert(args[i].y == args[i].x * args[i].x);
+  }
+}
+
+int main(int argc, char ** argv) {
+  long n = (argc > 1 ? atol(argv[1]) : 10000);
+  arg_t * args = calloc(sizeof(arg_t), n);
+  myth_thread_t * ids = calloc(sizeof(myth_thread_t), n);
+  double t0, t1, t2;
+  long i, r;
+  for (r = 0; r < 3; r++) {
+    for (i = 0; i < n; i++) {
+      args[i].x = i + r;
+      args[i].y = -1;
+    }
+    /* one by one */
+    t0 = cur_time();
+    for (i = 0; i < n; i++) ids[i] = myth_create(f, &args[i]);
+    t1 = cur_time();
+    for (i = 0; i < n; i++) {
+      void * x;
+      myth_join(ids[i], &x);
+      assert((long)x == args[i].x);
+    }
+    t2 = cur_time();
+    check(args, n);
+    printf("myth_create:      %ld threads started in %.6f sec"
+	   " (%.0f per sec), joined in %.6f sec\n",
+	   n, t1 - t0, n / (t1 - t0), t2 - t1);
+    /* all at once */
+    for (i = 0; i < n; i++) args[i].y = -1;
+    t0 = cur_time();
+    assert(myth_create_many(ids, 0, f, args, sizeof(arg_t), n) == 0);
+    t1 = cur_time();
+    for (i = 0; i < n; i++) {
+      void * x;
+      myth_join(ids[i], &x);
+      assert((long)x == args[i].x);
+    }
+    t2 = cur_time();
+    check(args, n);
+    printf("myth_create_many: %ld threads started in %.6f sec"
+	   " (%.0f per sec), joined in %.6f sec\n",
+	   n, t1 - t0, n / (t1 - t0), t2 - t1);
+  }
+  /* detached */
+  for (i = 0; i < n; i++) args[i].y = -1;
+  n_done = 0;
+  assert(myth_create_many(0, 0, f, args, sizeof(arg_t), n) == 0);
+  while (n_done < n) myth_yield();
+  check(args, n);
+  free(args);
+  free(ids);
+  printf("OK\n");
+  return 0;
+}
@@ -0,0 +1,168 @@
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include <myth/myth.h>
+
+/* file I/O of user threads with MYTH_WRAP_FILEIO=1.
+   a thread reading an empty pipe must not block its worker,
+   which has to run the thread that fills it, nor hold a helper:
+   more threads than helpers read empty pipes before anyone
+   writes to them. many threads also write, sync and read back
+   their own files. this is done with io_uring (if the kernel
+   supports it), with helper threads, and with no helper at all
+   (calls on files block the worker). with libmyth, file calls
+   are not wrapped and the test does nothing */
+
+enum { n_files = 32, file_sz = 64 << 10, chunk = 4096 };
+/* more than MYTH_IO_HELPERS below */
+enum { n_helpers = 4, n_pipes = 3 * n_helpers };
+
+static int pipe_fd[2];
+
+void * pipe_reader(void * arg) {
+  char c = 0;
+  (void)arg;
+  assert(read(pipe_fd[0], &c, 1) == 1);
+  assert(c == 'x');
+  return 0;
+}
+
+static void pipe_test(void) {
+  myth_thread_t th;
+  assert(pipe(pipe_fd) == 0);
+  /* runs first and parks on the empty pipe */
+  th = myth_create(pipe_reader, 0);
+  assert(write(pipe_fd[1], "x", 1) == 1);
+  myth_join(th, 0);
+  assert(close(pipe_fd[0]) == 0);
+  assert(close(pipe_fd[1]) == 0);
+}
+
+static int pipe_fds[n_pipes][2];
+
+void * pipes_reader(void * arg) {
+  long i = (long)arg;
+  char c = 0;
+  assert(read(pipe_fds[i][0], &c, 1) == 1);
+  assert(c == 'a' + i);
+  return 0;
+}
+
+static void pipes_test(void) {
+  myth_thread_t th[n_pipes];
+  long i;
+  for (i = 0; i < n_pipes; i++) assert(pipe(pipe_fds[i]) == 0);
+  /* each runs first and parks on its empty pipe */
+  for (i = 0; i < n_pipes; i++) th[i] = myth_create(pipes_reader, (void *)i);
+  for (i = 0; i < n_pipes; i++) {
+    char c = 'a' + i;
+    assert(write(pipe_fds[i][1], &c, 1) == 1);
+  }
+  for (i = 0; i < n_pipes; i++) {
+    myth_join(th[i], 0);
+    assert(close(pipe_fds[i][0]) == 0);
+    assert(close(pipe_fds[i][1]) == 0);
+  }
+}
+
+void * file_worker(void * arg) {
+  long id = (long)arg;
+  char path[64];
+  char * buf = (char *)malloc(file_sz);
+  char * got = (char *)malloc(file_sz);
+  long i;
+  int fd;
+  snprintf(path, sizeof(path), "myth_fileio.%d.%ld.tmp", (int)getpid(), id);
+  for (i = 0; i < file_sz; i++) buf[i] = (char)(i * 13 + id);
+  fd = open(path, O_CREAT | O_TRUNC | O_RDWR, 0600);
+  assert(fd >= 0);
+  /* write through the file position */
+  for (i = 0; i < file_sz; i += chunk) {
+    assert(write(fd, buf + i, chunk) == chunk);
+  }
+  assert(fsync(fd) == 0);
+  /* read back at explicit offsets, last chunk first */
+  for (i = file_sz - chunk; i >= 0; i -= chunk) {
+    assert(pread(fd, got + i, chunk, i) == chunk);
+  }
+  assert(memcmp(buf, got, file_sz) == 0);
+  /* overwrite a chunk in place and read everything back in order */
+  memset(buf + chunk, 'z', chunk);
+  assert(pwrite(fd, buf + chunk, chunk, chunk) == chunk);
+  assert(lseek(fd, 0, SEEK_SET) == 0);
+  for (i = 0; i < file_sz; i += chunk) {
+    assert(read(fd, got + i, chunk) == chunk);
+  }
+  assert(read(fd, got, chunk) == 0);
+  assert(memcmp(buf, got, file_sz) == 0);
+  assert(close(fd) == 0);
+  assert(unlink(path) == 0);
+  free(buf);
+  free(got);
+  return 0;
+}
+
+/* errno of the worker the calling thread runs on now. the compiler
+   may keep the address of errno across a call, during which the
+   thread may have moved to another worker */
+static int __attribute__((noinline)) last_error(void) {
+  return errno;
+}
+
+static void run(void) {
+  myth_thread_t th[n_files];
+  char c;
+  long i;
+  pipe_test();
+  pipes_test();
+  for (i = 0; i < n_files; i++) th[i] = myth_create(file_worker, (void *)i);
+  for (i = 0; i < n_files; i++) myth_join(th[i], 0);
+  /* errors come back in errno */
+  assert(open("myth_fileio.no/such/file", O_RDONLY) == -1);
+  assert(last_error() == ENOENT);
+  assert(read(-1, &c, 1) == -1);
+  assert(last_error() == EBADF);
+  assert(fsync(-1) == -1);
+  assert(last_error() == EBADF);
+}
+
+/* the library makes sockets non-blocking when
+   it multiplexes them, and wraps file calls too */
+static int wrapped(void) {
+  int s = socket(AF_INET, SOCK_STREAM, 0);
+  int r;
+  assert(s >= 0);
+  r = (fcntl(s, F_GETFL) & O_NONBLOCK) != 0;
+  close(s);
+  return r;
+}
+
+int main() {
+  /* must be set before the first call to MassiveThreads */
+  setenv("MYTH_WRAP_SOCKIO", "1", 1);
+  setenv("MYTH_WRAP_FILEIO", "1", 1);
+  setenv("MYTH_IO_HELPERS", "4", 1);	/* n_helpers */
+  myth_init();
+  if (!wrapped()) {
+    printf("file calls are not offloaded\n");
+  } else {
+    run();
+    myth_fini();
+    setenv("MYTH_IO_URING", "0", 1);
+    myth_init();
+    run();
+    myth_fini();
+    setenv("MYTH_IO_HELPERS", "0", 1);
+    myth_init();
+    run();
+  }
+  myth_fini();
+  printf("OK\n");
+  return 0;
+}
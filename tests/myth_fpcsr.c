@@ -0,0 +1,105 @@
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <myth/myth.h>
+
+/* threads made with MYTH_FPCSR_SAVE each set their own rounding
+   mode and must find it again after every yield, wherever they
+   resume, while the other threads always see the default one */
+
+enum { n_threads = 64, n_yields = 100 };
+
+#if defined(__x86_64__)
+/* rounding control bits of MXCSR */
+static unsigned get_round(void) {
+  unsigned x;
+  asm volatile("stmxcsr %0" : "=m"(x));
+  return (x >> 13) & 3;
+}
+static void set_round(unsigned r) {
+  unsigned x;
+  asm volatile("stmxcsr %0" : "=m"(x));
+  x = (x & ~(3u << 13)) | (r << 13);
+  asm volatile("ldmxcsr %0" : : "m"(x));
+}
+#define HAVE_FPCSR 1
+#elif defined(__aarch64__)
+/* rounding mode bits of FPCR */
+static unsigned get_round(void) {
+  unsigned long x;
+  asm volatile("mrs %0, fpcr" : "=r"(x));
+  return (x >> 22) & 3;
+}
+static void set_round(unsigned r) {
+  unsigned long x;
+  asm volatile("mrs %0, fpcr" : "=r"(x));
+  x = (x & ~(3ul << 22)) | ((unsigned long)r << 22);
+  asm volatile("msr fpcr, %0" : : "r"(x));
+}
+#define HAVE_FPCSR 1
+#else
+#define HAVE_FPCSR 0
+#endif
+
+#if HAVE_FPCSR
+static unsigned default_round;
+
+void * own(void * arg) {
+  unsigned r = (long)arg % 4;
+  long i;
+  set_round(r);
+  for (i = 0; i < n_yields; i++) {
+    myth_yield();
+    if (get_round() != r) return (void *)1;
+  }
+  /* leave it changed; it must not leak to the others */
+  return 0;
+}
+
+void * shared(void * arg) {
+  long i;
+  (void)arg;
+  for (i = 0; i < n_yields; i++) {
+    if (get_round() != default_round) return (void *)1;
+    myth_yield();
+  }
+  return 0;
+}
+#endif
+
+int main() {
+  myth_thread_attr_t attr[1];
+  int x;
+  myth_thread_attr_init(attr);
+  assert(myth_thread_attr_getfpcsr(attr, &x) == 0);
+  assert(x == MYTH_FPCSR_SHARED);
+  assert(myth_thread_attr_setfpcsr(attr, 2) == EINVAL);
+  assert(myth_thread_attr_setfpcsr(attr, MYTH_FPCSR_SAVE) == 0);
+  assert(myth_thread_attr_getfpcsr(attr, &x) == 0);
+  assert(x == MYTH_FPCSR_SAVE);
+#if HAVE_FPCSR
+  {
+    myth_thread_t th[2 * n_threads];
+    long i;
+    myth_init();
+    default_round = get_round();
+    for (i = 0; i < n_threads; i++) {
+      myth_create_ex(&th[2 * i], attr, own, (void *)i);
+      th[2 * i + 1] = myth_create(shared, 0);
+    }
+    for (i = 0; i < 2 * n_threads; i++) {
+      void * r;
+      myth_join(th[i], &r);
+      assert(r == 0);
+    }
+    assert(get_round() == default_round);
+    myth_fini();
+  }
+#else
+  printf("no FP control registers to check on this machine\n");
+#endif
+  printf("OK\n");
+  return 0;
+}
@@ -0,0 +1,105 @@
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <myth/myth.h>
+
+/* joins while there are more workers than cores, so a worker is
+   often descheduled by the OS, possibly while a thread on it is
+   finishing. every join, tryjoin and detach must still complete
+   and get the right result. the time from when both the joiner
+   and the child were done to when myth_join returned is shown;
+   its tail should be a scheduling delay, not a spin for a whole
+   OS time slice */
+
+enum { n_rounds = 100, n_children = 16 };
+
+typedef struct {
+  long x;
+  double finished;
+} child_t;
+
+static double cur_time(void) {
+  struct timespec ts[1];
+  clock_gettime(CLOCK_MONOTONIC, ts);
+  return ts->tv_sec + ts->tv_nsec * 1.0e-9;
+}
+
+void * child(void * arg) {
+  child_t * c = arg;
+  volatile long s = 0;
+  long i;
+  for (i = 0; i < c->x * 100; i++) s += i;
+  if (c->x % 3 == 0) myth_yield();
+  c->finished = cur_time();
+  return (void *)(c->x * c->x);
+}
+
+static long n_detached_done;
+
+void * detached(void * arg) {
+  if ((long)arg % 2) myth_yield();
+  __sync_fetch_and_add(&n_detached_done, 1);
+  return 0;
+}
+
+static int cmp(const void * a, const void * b) {
+  double x = *(const double *)a, y = *(const double *)b;
+  return (x < y ? -1 : x > y ? 1 : 0);
+}
+
+static double lat[n_rounds * n_children];
+
+int main() {
+  long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+  child_t c[n_children];
+  myth_thread_t th[n_children];
+  char val[16];
+  long r, i, n = 0;
+  if (ncpu < 1) ncpu = 1;
+  /* must be set before the first call to MassiveThreads */
+  sprintf(val, "%ld", 4 * ncpu);
+  setenv("MYTH_NUM_WORKERS", val, 1);
+  myth_init();
+  assert(myth_get_num_workers() == 4 * ncpu);
+  for (r = 0; r < n_rounds; r++) {
+    for (i = 0; i < n_children; i++) {
+      c[i].x = i + r;
+      th[i] = myth_create(child, &c[i]);
+    }
+    for (i = 0; i < n_children; i++) {
+      void * y = 0;
+      double t0, t1;
+      if (r % 4 == 3) {
+	/* poll for some of them */
+	while (myth_tryjoin(th[i], &y) == EBUSY) myth_yield();
+	assert((long)y == c[i].x * c[i].x);
+	continue;
+      }
+      t0 = cur_time();
+      myth_join(th[i], &y);
+      t1 = cur_time();
+      assert((long)y == c[i].x * c[i].x);
+      lat[n++] = t1 - (c[i].finished > t0 ? c[i].finished : t0);
+    }
+    /* and let the others go */
+    for (i = 0; i < n_children; i++) {
+      th[i] = myth_create(detached, (void *)i);
+      if (i % 4 == 0) myth_yield();
+      assert(myth_detach(th[i]) == 0);
+    }
+  }
+  while (n_detached_done < n_rounds * n_children) myth_yield();
+  qsort(lat, n, sizeof(double), cmp);
+  printf("%ld joins on %ld workers / %ld cores:"
+	 " latency median %.1f us, 99%% %.1f us, max %.1f us\n",
+	 n, 4 * ncpu, ncpu, lat[n / 2] * 1.0e6, lat[n * 99 / 100] * 1.0e6,
+	 lat[n - 1] * 1.0e6);
+  myth_fini();
+  printf("OK\n");
+  return 0;
+}
@@ -0,0 +1,158 @@
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+
+#include <myth/myth.h>
+#include <mtbb/coro.h>
+
+/* C++20 coroutines of mtbb/coro.h: a spawned fib against the
+   serial one, a counter under mtbb::mutex held across a co_await,
+   a mutex handed through many waiters in a row, values and
+   exceptions from myth_spawn, and recv that has to wait for a
+   send, on a socketpair and on a TCP connection (a socket of the
+   I/O layer when it multiplexes socket calls) */
+
+enum { n_fib = 22, n_incs = 200, n_waiters = 10000, n_msgs = 100 };
+
+static long serial_fib(long n) {
+  return n < 2 ? n : serial_fib(n - 1) + serial_fib(n - 2);
+}
+
+mtbb::task<long> fib(long n) {
+  if (n < 2) co_return n;
+  auto a = mtbb::spawn(fib(n - 1));
+  long b = co_await fib(n - 2);
+  co_return co_await a + b;
+}
+
+/* counter is read before and written after a co_await in
+   the critical section; without the lock increments get lost */
+mtbb::task<> inc(mtbb::mutex& m, long& counter) {
+  co_await m.lock();
+  long x = counter;
+  co_await mtbb::myth_spawn([] { myth_yield(); });
+  counter = x + 1;
+  m.unlock();
+}
+
+mtbb::task<long> incs(long n) {
+  mtbb::mutex m;
+  long counter = 0;
+  for (long i = 0; i < n; i++) {
+    auto a = mtbb::spawn(inc(m, counter));
+    co_await inc(m, counter);
+    co_await a;
+  }
+  co_return counter;
+}
+
+/* each unlock hands the mutex to the next waiter in line */
+mtbb::task<> waiter(mtbb::mutex& m, std::atomic<long>& n, long& counter) {
+  n++;
+  co_await m.lock();
+  counter++;
+  m.unlock();
+}
+
+mtbb::task<long> waiters() {
+  mtbb::mutex m;
+  std::atomic<long> n(0);
+  long counter = 0;
+  std::vector<mtbb::spawned<void>> w;
+  co_await m.lock();
+  for (long i = 0; i < n_waiters; i++) w.push_back(mtbb::spawn(waiter(m, n, counter)));
+  while (n < n_waiters) co_await mtbb::myth_spawn([] { myth_yield(); });
+  m.unlock();
+  for (auto& a : w) co_await a;
+  co_return counter;
+}
+
+mtbb::task<long> spawns() {
+  long x = co_await mtbb::myth_spawn([] { myth_yield(); return 7L; });
+  try {
+    co_await mtbb::myth_spawn([]() -> long { throw std::runtime_error("x"); });
+    co_return -1;
+  } catch (std::runtime_error& e) {
+    assert(strcmp(e.what(), "x") == 0);
+  }
+  co_return x;
+}
+
+mtbb::task<long> receiver(int fd) {
+  long s = 0;
+  for (long i = 0; i < n_msgs; i++) {
+    long x;
+    ssize_t r = co_await mtbb::recv(fd, &x, sizeof(x), 0);
+    assert(r == (ssize_t)sizeof(x));
+    s += x;
+  }
+  co_return s;
+}
+
+mtbb::task<> sender(int fd) {
+  for (long i = 0; i < n_msgs; i++) {
+    /* let the receiver find nothing first */
+    co_await mtbb::myth_spawn([] { myth_yield(); });
+    ssize_t r = co_await mtbb::send(fd, &i, sizeof(i), 0);
+    assert(r == (ssize_t)sizeof(i));
+  }
+}
+
+mtbb::task<long> pingpong(int fd0, int fd1) {
+  auto r = mtbb::spawn(receiver(fd0));
+  co_await sender(fd1);
+  co_return co_await r;
+}
+
+/* a connected pair of TCP sockets on the loopback */
+static void tcp_pair(int fds[2]) {
+  struct sockaddr_in addr;
+  socklen_t len = sizeof(addr);
+  int s = socket(AF_INET, SOCK_STREAM, 0);
+  assert(s >= 0);
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = 0;
+  assert(bind(s, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+  assert(listen(s, 1) == 0);
+  assert(getsockname(s, (struct sockaddr *)&addr, &len) == 0);
+  fds[1] = socket(AF_INET, SOCK_STREAM, 0);
+  assert(fds[1] >= 0);
+  assert(connect(fds[1], (struct sockaddr *)&addr, sizeof(addr)) == 0);
+  fds[0] = accept(s, 0, 0);
+  assert(fds[0] >= 0);
+  close(s);
+}
+
+int main() {
+  int fds[2];
+  /* must be set before the first call to MassiveThreads */
+  setenv("MYTH_WRAP_SOCKIO", "1", 1);
+  assert(mtbb::sync_wait(fib(n_fib)) == serial_fib(n_fib));
+  assert(mtbb::sync_wait(incs(n_incs)) == 2 * n_incs);
+  assert(mtbb::sync_wait(waiters()) == n_waiters);
+  assert(mtbb::sync_wait(spawns()) == 7);
+  assert(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+  assert(mtbb::sync_wait(pingpong(fds[0], fds[1])) == n_msgs * (n_msgs - 1) / 2);
+  close(fds[0]);
+  close(fds[1]);
+  tcp_pair(fds);
+  /* the I/O layer does not wait for it either */
+  char c;
+  assert(recv(fds[0], &c, 1, MSG_DONTWAIT) == -1 && errno == EAGAIN);
+  assert(mtbb::sync_wait(pingpong(fds[0], fds[1])) == n_msgs * (n_msgs - 1) / 2);
+  close(fds[0]);
+  close(fds[1]);
+  printf("OK\n");
+  return 0;
+}
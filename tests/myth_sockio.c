@@ -0,0 +1,211 @@
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+#include <myth/myth.h>
+
+/* blocking socket calls of user threads with MYTH_WRAP_SOCKIO=1.
+   many clients talk to an echo server over loopback, and one of
+   them pushes more data than socket buffers hold. all threads
+   share a few workers, so a call blocking its worker would hang
+   the test. this is done with io_uring (if the kernel supports
+   it) and then with epoll.
+   a socket pair made before myth_init is not registered with the I/O
+   layer, so a call on it waits only if the user has not made it
+   non-blocking, which may change at any time (here, with ioctl).
+   with libmyth, socket calls are not wrapped and the test does
+   nothing */
+
+enum { n_clients = 50, n_rounds = 20, big = 8 << 20 };
+
+static struct sockaddr_in server_addr;
+static int pair[2];
+
+static void recv_all(int s, void * buf, size_t sz) {
+  size_t got = 0;
+  while (got < sz) {
+    ssize_t r = recv(s, (char *)buf + got, sz - got, 0);
+    assert(r > 0);
+    got += r;
+  }
+}
+
+static void send_all(int s, const void * buf, size_t sz) {
+  size_t sent = 0;
+  while (sent < sz) {
+    ssize_t r = send(s, (const char *)buf + sent, sz - sent, 0);
+    assert(r > 0);
+    sent += r;
+  }
+}
+
+/* echo until the peer shuts down */
+void * handler(void * arg) {
+  int s = (int)(long)arg;
+  char buf[16384];
+  ssize_t r;
+  while ((r = recv(s, buf, sizeof(buf), 0)) > 0) {
+    send_all(s, buf, r);
+  }
+  assert(r == 0);
+  assert(close(s) == 0);
+  return 0;
+}
+
+void * server(void * arg) {
+  int ls = (int)(long)arg;
+  myth_thread_t th[n_clients + 1];
+  int i;
+  for (i = 0; i < n_clients + 1; i++) {
+    int s = accept(ls, 0, 0);
+    assert(s >= 0);
+    th[i] = myth_create(handler, (void *)(long)s);
+  }
+  for (i = 0; i < n_clients + 1; i++) myth_join(th[i], 0);
+  return 0;
+}
+
+static int connect_to_server(void) {
+  int s = socket(AF_INET, SOCK_STREAM, 0);
+  assert(s >= 0);
+  assert(connect(s, (struct sockaddr *)&server_addr,
+		 sizeof(server_addr)) == 0);
+  return s;
+}
+
+/* shut down our side and wait for the server to do the same */
+static void hang_up(int s) {
+  char c;
+  assert(shutdown(s, SHUT_WR) == 0);
+  assert(recv(s, &c, 1, 0) == 0);
+  assert(close(s) == 0);
+}
+
+void * client(void * arg) {
+  long id = (long)arg;
+  int s = connect_to_server();
+  long i;
+  for (i = 0; i < n_rounds; i++) {
+    long msg[2] = { id, i };
+    long reply[2];
+    send_all(s, msg, sizeof(msg));
+    recv_all(s, reply, sizeof(reply));
+    assert(reply[0] == id && reply[1] == i);
+  }
+  hang_up(s);
+  return 0;
+}
+
+typedef struct {
+  int s;
+  char * buf;
+} bulk_arg_t;
+
+void * bulk_sender(void * arg_) {
+  bulk_arg_t * arg = (bulk_arg_t *)arg_;
+  send_all(arg->s, arg->buf, big);
+  return 0;
+}
+
+/* send a lot while receiving the echo in another thread */
+void * bulk_client(void * arg) {
+  bulk_arg_t a;
+  char * echo = (char *)malloc(big);
+  long i;
+  myth_thread_t th;
+  (void)arg;
+  a.s = connect_to_server();
+  a.buf = (char *)malloc(big);
+  for (i = 0; i < big; i++) a.buf[i] = (char)(i * 7);
+  th = myth_create(bulk_sender, &a);
+  recv_all(a.s, echo, big);
+  myth_join(th, 0);
+  assert(memcmp(a.buf, echo, big) == 0);
+  hang_up(a.s);
+  free(a.buf);
+  free(echo);
+  return 0;
+}
+
+void * pair_receiver(void * arg) {
+  char c = 0;
+  (void)arg;
+  assert(recv(pair[0], &c, 1, 0) == 1);
+  assert(c == 'y');
+  return 0;
+}
+
+static void user_nonblock_test(void) {
+  struct timeval tv = { 0, 10000 };
+  myth_thread_t th;
+  char c;
+  int on = 1;
+  /* recv gives EAGAIN every 10ms, so it waits in the I/O layer */
+  assert(setsockopt(pair[0], SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) == 0);
+  th = myth_create(pair_receiver, 0);
+  myth_yield();
+  assert(send(pair[1], "y", 1, 0) == 1);
+  myth_join(th, 0);
+  /* but no longer once the user makes it non-blocking */
+  assert(ioctl(pair[0], FIONBIO, &on) == 0);
+  assert(recv(pair[0], &c, 1, 0) == -1 && errno == EAGAIN);
+  on = 0;
+  assert(ioctl(pair[0], FIONBIO, &on) == 0);
+}
+
+static int run(void) {
+  socklen_t len = sizeof(server_addr);
+  myth_thread_t sv, bc, cl[n_clients];
+  int ls;
+  long i;
+  ls = socket(AF_INET, SOCK_STREAM, 0);
+  assert(ls >= 0);
+  /* we did not ask for it; the I/O layer did */
+  if (!(fcntl(ls, F_GETFL) & O_NONBLOCK)) {
+    close(ls);
+    return 0;
+  }
+  memset(&server_addr, 0, sizeof(server_addr));
+  server_addr.sin_family = AF_INET;
+  server_addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  server_addr.sin_port = 0;
+  assert(bind(ls, (struct sockaddr *)&server_addr, len) == 0);
+  assert(getsockname(ls, (struct sockaddr *)&server_addr, &len) == 0);
+  assert(listen(ls, n_clients + 1) == 0);
+  sv = myth_create(server, (void *)(long)ls);
+  for (i = 0; i < n_clients; i++) cl[i] = myth_create(client, (void *)i);
+  bc = myth_create(bulk_client, 0);
+  for (i = 0; i < n_clients; i++) myth_join(cl[i], 0);
+  myth_join(bc, 0);
+  myth_join(sv, 0);
+  assert(close(ls) == 0);
+  user_nonblock_test();
+  return 1;
+}
+
+int main() {
+  assert(socketpair(AF_UNIX, SOCK_STREAM, 0, pair) == 0);
+  /* must be set before the first call to MassiveThreads */
+  setenv("MYTH_WRAP_SOCKIO", "1", 1);
+  myth_init();
+  if (!run()) {
+    printf("socket calls are not multiplexed\n");
+  } else {
+    myth_fini();
+    setenv("MYTH_IO_URING", "0", 1);
+    myth_init();
+    assert(run());
+  }
+  myth_fini();
+  printf("OK\n");
+  return 0;
+}
@@ -0,0 +1,103 @@
+#include <assert.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+
+#include <myth/myth.h>
+
+/* sockets of user threads with MYTH_WRAP_SOCKIO=1 whose fds are
+   beyond RLIMIT_NOFILE at myth_init, which is raised afterwards.
+   the I/O layer must still find them, so a thread receiving on one
+   parks instead of blocking its worker, which would hang the test
+   when there is only one worker. this is done with io_uring (if
+   the kernel supports it) and then with epoll.
+   with libmyth, socket calls are not wrapped and the test does
+   nothing */
+
+enum { n_socks = 5000, low_limit = 1024 };
+
+static int socks[n_socks];
+
+void * receiver(void * arg) {
+  int s = (int)(long)arg;
+  char c = 0;
+  assert(recv(s, &c, 1, 0) == 1);
+  assert(c == 'x');
+  return 0;
+}
+
+static int run(void) {
+  struct sockaddr_in a, b;
+  socklen_t len = sizeof(a);
+  struct rlimit rl;
+  myth_thread_t th;
+  int i, on, s, r, w;
+  s = socket(AF_INET, SOCK_DGRAM, 0);
+  assert(s >= 0);
+  /* we did not ask for it; the I/O layer did */
+  on = (fcntl(s, F_GETFL) & O_NONBLOCK) != 0;
+  close(s);
+  if (!on) return 0;
+  assert(getrlimit(RLIMIT_NOFILE, &rl) == 0);
+  rl.rlim_cur = n_socks + 64;
+  assert(setrlimit(RLIMIT_NOFILE, &rl) == 0);
+  for (i = 0; i < n_socks; i++) {
+    socks[i] = socket(AF_INET, SOCK_DGRAM, 0);
+    assert(socks[i] >= 0);
+    assert(fcntl(socks[i], F_GETFL) & O_NONBLOCK);
+  }
+  /* the last two, far beyond the limit we started with */
+  r = socks[n_socks - 1];
+  w = socks[n_socks - 2];
+  assert(r > low_limit && w > low_limit);
+  memset(&a, 0, sizeof(a));
+  a.sin_family = AF_INET;
+  a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  b = a;
+  assert(bind(r, (struct sockaddr *)&a, len) == 0);
+  assert(getsockname(r, (struct sockaddr *)&a, &len) == 0);
+  assert(bind(w, (struct sockaddr *)&b, len) == 0);
+  assert(getsockname(w, (struct sockaddr *)&b, &len) == 0);
+  assert(connect(r, (struct sockaddr *)&b, len) == 0);
+  assert(connect(w, (struct sockaddr *)&a, len) == 0);
+  th = myth_create(receiver, (void *)(long)r);
+  assert(send(w, "x", 1, 0) == 1);
+  myth_join(th, 0);
+  for (i = 0; i < n_socks; i++) assert(close(socks[i]) == 0);
+  /* start low again for the next round */
+  rl.rlim_cur = low_limit;
+  assert(setrlimit(RLIMIT_NOFILE, &rl) == 0);
+  return 1;
+}
+
+int main() {
+  struct rlimit rl;
+  assert(getrlimit(RLIMIT_NOFILE, &rl) == 0);
+  if (rl.rlim_max != RLIM_INFINITY && rl.rlim_max < n_socks + 64) {
+    printf("RLIMIT_NOFILE is too low to test\n");
+    printf("OK\n");
+    return 0;
+  }
+  rl.rlim_cur = low_limit;
+  assert(setrlimit(RLIMIT_NOFILE, &rl) == 0);
+  /* must be set before the first call to MassiveThreads */
+  setenv("MYTH_WRAP_SOCKIO", "1", 1);
+  myth_init();
+  if (!run()) {
+    printf("socket calls are not multiplexed\n");
+  } else {
+    myth_fini();
+    setenv("MYTH_IO_URING", "0", 1);
+    myth_init();
+    assert(run());
+  }
+  myth_fini();
+  printf("OK\n");
+  return 0;
+}
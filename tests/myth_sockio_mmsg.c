@@ -0,0 +1,228 @@
+#define _GNU_SOURCE 1
+
+#include <assert.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include <myth/myth.h>
+
+/* batched socket calls of user threads with MYTH_WRAP_SOCKIO=1:
+   recvmmsg/sendmmsg over UDP, and many threads accepting from
+   one listening socket, which takes connections from the backlog
+   in bursts. the receiving and accepting threads start first and
+   find nothing, so a call blocking its worker would hang the test
+   when there is only one worker. this is done with io_uring (if
+   the kernel supports it) and then with epoll.
+   with libmyth, socket calls are not wrapped and the test does
+   nothing */
+
+enum { n_dgrams = 128, batch = 8, dgram_sz = 32, n_conns = 40 };
+
+static struct sockaddr_in loopback(void) {
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  return addr;
+}
+
+/* two UDP sockets on loopback connected to each other */
+static void udp_pair(int * a, int * b) {
+  struct sockaddr_in aa = loopback(), ba = loopback();
+  socklen_t len = sizeof(aa);
+  *a = socket(AF_INET, SOCK_DGRAM, 0);
+  *b = socket(AF_INET, SOCK_DGRAM, 0);
+  assert(*a >= 0 && *b >= 0);
+  assert(bind(*a, (struct sockaddr *)&aa, len) == 0);
+  assert(bind(*b, (struct sockaddr *)&ba, len) == 0);
+  assert(getsockname(*a, (struct sockaddr *)&aa, &len) == 0);
+  assert(getsockname(*b, (struct sockaddr *)&ba, &len) == 0);
+  assert(connect(*a, (struct sockaddr *)&ba, len) == 0);
+  assert(connect(*b, (struct sockaddr *)&aa, len) == 0);
+}
+
+typedef struct {
+  int s;
+  int flags;
+} rd_arg_t;
+
+/* receive N_DGRAMS datagrams in batches and check them */
+void * dgram_reader(void * arg_) {
+  rd_arg_t * arg = (rd_arg_t *)arg_;
+  char buf[batch][dgram_sz];
+  struct iovec iov[batch];
+  struct mmsghdr vec[batch];
+  int got = 0, i;
+  while (got < n_dgrams) {
+    int r;
+    memset(vec, 0, sizeof(vec));
+    for (i = 0; i < batch; i++) {
+      iov[i].iov_base = buf[i];
+      iov[i].iov_len = dgram_sz;
+      vec[i].msg_hdr.msg_iov = &iov[i];
+      vec[i].msg_hdr.msg_iovlen = 1;
+    }
+    r = recvmmsg(arg->s, vec, batch, arg->flags, 0);
+    assert(r > 0);
+    /* without MSG_WAITFORONE, it waits for all of them */
+    if (!(arg->flags & MSG_WAITFORONE)) assert(r == batch);
+    for (i = 0; i < r; i++) {
+      assert(vec[i].msg_len == dgram_sz);
+      assert(buf[i][0] == (char)(got + i));
+      assert(buf[i][dgram_sz - 1] == (char)~(got + i));
+    }
+    got += r;
+  }
+  assert(got == n_dgrams);
+  return 0;
+}
+
+static void dgrams(int flags) {
+  char buf[batch][dgram_sz];
+  struct iovec iov[batch];
+  struct mmsghdr vec[batch];
+  rd_arg_t arg;
+  myth_thread_t th;
+  int a, b, sent = 0, i;
+  udp_pair(&a, &b);
+  arg.s = b;
+  arg.flags = flags;
+  th = myth_create(dgram_reader, &arg);
+  while (sent < n_dgrams) {
+    memset(vec, 0, sizeof(vec));
+    for (i = 0; i < batch; i++) {
+      memset(buf[i], 0, dgram_sz);
+      buf[i][0] = (char)(sent + i);
+      buf[i][dgram_sz - 1] = (char)~(sent + i);
+      iov[i].iov_base = buf[i];
+      iov[i].iov_len = dgram_sz;
+      vec[i].msg_hdr.msg_iov = &iov[i];
+      vec[i].msg_hdr.msg_iovlen = 1;
+    }
+    assert(sendmmsg(a, vec, batch, 0) == batch);
+    sent += batch;
+    /* let the reader take them before the socket buffer fills */
+    myth_yield();
+  }
+  myth_join(th, 0);
+  assert(close(a) == 0);
+  assert(close(b) == 0);
+}
+
+static int listener(struct sockaddr_in * addr) {
+  socklen_t len = sizeof(*addr);
+  int ls = socket(AF_INET, SOCK_STREAM, 0);
+  assert(ls >= 0);
+  *addr = loopback();
+  assert(bind(ls, (struct sockaddr *)addr, len) == 0);
+  assert(getsockname(ls, (struct sockaddr *)addr, &len) == 0);
+  assert(listen(ls, 2 * n_conns) == 0);
+  return ls;
+}
+
+static int connect_to(struct sockaddr_in * addr, char id) {
+  int s = socket(AF_INET, SOCK_STREAM, 0);
+  assert(s >= 0);
+  assert(connect(s, (struct sockaddr *)addr, sizeof(*addr)) == 0);
+  assert(send(s, &id, 1, 0) == 1);
+  return s;
+}
+
+static int seen[n_conns];
+
+/* the id the client sent, which is seen once */
+static void serve(int s) {
+  char id = -1;
+  assert(recv(s, &id, 1, 0) == 1);
+  assert(id >= 0 && id < n_conns);
+  assert(!__sync_fetch_and_add(&seen[(int)id], 1));
+  assert(close(s) == 0);
+}
+
+void * acceptor(void * arg) {
+  struct sockaddr_in peer;
+  socklen_t len = sizeof(peer);
+  int ls = (int)(long)arg;
+  int s = accept(ls, (struct sockaddr *)&peer, &len);
+  assert(s >= 0);
+  assert(len == sizeof(peer));
+  assert(peer.sin_family == AF_INET);
+  assert(peer.sin_addr.s_addr == htonl(INADDR_LOOPBACK));
+  serve(s);
+  return 0;
+}
+
+static void accepts(void) {
+  myth_thread_t th[n_conns];
+  struct sockaddr_in addr;
+  int cs[n_conns];
+  int ls, i, s;
+  memset(seen, 0, sizeof(seen));
+  ls = listener(&addr);
+  /* all acceptors wait on the socket before the connections come */
+  for (i = 0; i < n_conns; i++) th[i] = myth_create(acceptor, (void *)(long)ls);
+  for (i = 0; i < n_conns; i++) cs[i] = connect_to(&addr, (char)i);
+  for (i = 0; i < n_conns; i++) myth_join(th[i], 0);
+  for (i = 0; i < n_conns; i++) assert(close(cs[i]) == 0);
+  /* connections that come with no one waiting are taken in a burst
+     and kept for the following calls; accept4 still honours flags */
+  memset(seen, 0, sizeof(seen));
+  for (i = 0; i < n_conns; i++) cs[i] = connect_to(&addr, (char)i);
+  for (i = 0; i < n_conns; i++) {
+    s = accept4(ls, 0, 0, (i % 2 ? SOCK_CLOEXEC : 0));
+    assert(s >= 0);
+    assert(((fcntl(s, F_GETFD) & FD_CLOEXEC) != 0) == (i % 2));
+    serve(s);
+  }
+  for (i = 0; i < n_conns; i++) assert(close(cs[i]) == 0);
+  /* the accept takes both, and the one kept is
+     closed together with the listening socket */
+  cs[0] = connect_to(&addr, 0);
+  cs[1] = connect_to(&addr, 1);
+  s = accept(ls, 0, 0);
+  assert(s >= 0);
+  assert(close(s) == 0);
+  assert(close(ls) == 0);
+  for (i = 0; i < 2; i++) {
+    char c;
+    assert(recv(cs[i], &c, 1, 0) <= 0);
+    assert(close(cs[i]) == 0);
+  }
+}
+
+static int run(void) {
+  int s = socket(AF_INET, SOCK_STREAM, 0);
+  int on;
+  assert(s >= 0);
+  /* we did not ask for it; the I/O layer did */
+  on = (fcntl(s, F_GETFL) & O_NONBLOCK) != 0;
+  close(s);
+  if (!on) return 0;
+  dgrams(0);
+  dgrams(MSG_WAITFORONE);
+  accepts();
+  return 1;
+}
+
+int main() {
+  /* must be set before the first call to MassiveThreads */
+  setenv("MYTH_WRAP_SOCKIO", "1", 1);
+  myth_init();
+  if (!run()) {
+    printf("socket calls are not multiplexed\n");
+  } else {
+    myth_fini();
+    setenv("MYTH_IO_URING", "0", 1);
+    myth_init();
+    assert(run());
+  }
+  myth_fini();
+  printf("OK\n");
+  return 0;
+}
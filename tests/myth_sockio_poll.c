@@ -0,0 +1,231 @@
+#define _GNU_SOURCE 1
+
+#include <assert.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+#include <myth/myth.h>
+
+/* poll, ppoll, select and epoll_wait of user threads with
+   MYTH_WRAP_SOCKIO=1. a thread waiting for an fd that only
+   another thread makes ready must not block its worker, which
+   would hang the test when there is only one worker. threads
+   waiting with a timeout get 0 after it, while others run.
+   this is done with io_uring (if the kernel supports it) and
+   then with epoll.
+   with libmyth, these calls are not wrapped and the test does
+   nothing */
+
+enum { n_pipes = 16 };
+
+static double cur_time(void) {
+  struct timeval tv[1];
+  gettimeofday(tv, 0);
+  return tv->tv_sec + tv->tv_usec * 1.0e-6;
+}
+
+static int pipes[n_pipes][2];
+
+/* wait for pipe I with poll and take its byte */
+void * poll_reader(void * arg) {
+  long i = (long)arg;
+  struct pollfd pfd[2];
+  char c;
+  /* the other fd never becomes ready */
+  pfd[0].fd = pipes[(i + 1) % n_pipes][1];
+  pfd[0].events = POLLIN;
+  pfd[1].fd = pipes[i][0];
+  pfd[1].events = POLLIN;
+  assert(poll(pfd, 2, -1) == 1);
+  assert(pfd[0].revents == 0);
+  assert(pfd[1].revents & POLLIN);
+  assert(read(pipes[i][0], &c, 1) == 1);
+  assert(c == (char)i);
+  return 0;
+}
+
+static void polls(void) {
+  myth_thread_t th[n_pipes];
+  long i;
+  for (i = 0; i < n_pipes; i++) assert(pipe(pipes[i]) == 0);
+  /* all of them wait before anything is written */
+  for (i = 0; i < n_pipes; i++) th[i] = myth_create(poll_reader, (void *)i);
+  for (i = n_pipes - 1; i >= 0; i--) {
+    char c = (char)i;
+    assert(write(pipes[i][1], &c, 1) == 1);
+  }
+  for (i = 0; i < n_pipes; i++) myth_join(th[i], 0);
+  for (i = 0; i < n_pipes; i++) {
+    assert(close(pipes[i][0]) == 0);
+    assert(close(pipes[i][1]) == 0);
+  }
+}
+
+static volatile int ticks;
+
+/* wait for nothing for 100ms in the way ARG says */
+void * sleeper(void * arg) {
+  long how = (long)arg;
+  double t0 = cur_time();
+  int p[2];
+  assert(pipe(p) == 0);
+  switch (how) {
+  case 0:
+    assert(poll(0, 0, 100) == 0);
+    break;
+  case 1: {
+    struct pollfd pfd;
+    struct timespec ts = { 0, 100 * 1000 * 1000 };
+    pfd.fd = p[0];
+    pfd.events = POLLIN;
+    assert(ppoll(&pfd, 1, &ts, 0) == 0);
+    assert(pfd.revents == 0);
+    break;
+  }
+  case 2: {
+    fd_set rfds;
+    struct timeval tv = { 0, 100 * 1000 };
+    FD_ZERO(&rfds);
+    FD_SET(p[0], &rfds);
+    assert(select(p[0] + 1, &rfds, 0, 0, &tv) == 0);
+    assert(!FD_ISSET(p[0], &rfds));
+    /* the time left */
+    assert(tv.tv_sec == 0 && tv.tv_usec < 100 * 1000);
+    break;
+  }
+  case 3: {
+    struct epoll_event ev;
+    int ep = epoll_create1(0);
+    assert(ep >= 0);
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    assert(epoll_ctl(ep, EPOLL_CTL_ADD, p[0], &ev) == 0);
+    assert(epoll_wait(ep, &ev, 1, 100) == 0);
+    assert(close(ep) == 0);
+    break;
+  }
+  default:
+    assert(0);
+  }
+  assert(cur_time() - t0 >= 0.099);
+  assert(close(p[0]) == 0);
+  assert(close(p[1]) == 0);
+  return 0;
+}
+
+static void timeouts(void) {
+  long how;
+  for (how = 0; how < 4; how++) {
+    myth_thread_t th = myth_create(sleeper, (void *)how);
+    int t = ticks;
+    /* we keep running while it waits */
+    while (ticks - t < 10) {
+      ticks++;
+      myth_yield();
+    }
+    myth_join(th, 0);
+  }
+}
+
+static int sv[2];
+
+void * select_reader(void * arg) {
+  fd_set rfds, wfds;
+  char c;
+  (void)arg;
+  FD_ZERO(&rfds);
+  FD_ZERO(&wfds);
+  FD_SET(sv[0], &rfds);
+  assert(select(sv[0] + 1, &rfds, &wfds, 0, 0) == 1);
+  assert(FD_ISSET(sv[0], &rfds));
+  assert(recv(sv[0], &c, 1, 0) == 1);
+  assert(c == 's');
+  /* ready at once; a socket is writable */
+  FD_SET(sv[0], &wfds);
+  assert(select(sv[0] + 1, 0, &wfds, 0, 0) == 1);
+  assert(FD_ISSET(sv[0], &wfds));
+  return 0;
+}
+
+typedef struct {
+  int ep;
+  int fd;
+} ep_arg_t;
+
+void * epoll_reader(void * arg_) {
+  ep_arg_t * arg = (ep_arg_t *)arg_;
+  struct epoll_event ev;
+  char c;
+  assert(epoll_wait(arg->ep, &ev, 1, -1) == 1);
+  assert(ev.data.fd == arg->fd);
+  assert(ev.events & EPOLLIN);
+  assert(read(arg->fd, &c, 1) == 1);
+  assert(c == 'e');
+  return 0;
+}
+
+static void readiness(void) {
+  struct epoll_event ev;
+  ep_arg_t arg;
+  myth_thread_t th;
+  int p[2];
+  assert(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0);
+  th = myth_create(select_reader, 0);
+  assert(send(sv[1], "s", 1, 0) == 1);
+  myth_join(th, 0);
+  assert(close(sv[0]) == 0);
+  assert(close(sv[1]) == 0);
+  assert(pipe(p) == 0);
+  arg.ep = epoll_create1(0);
+  arg.fd = p[0];
+  assert(arg.ep >= 0);
+  memset(&ev, 0, sizeof(ev));
+  ev.events = EPOLLIN;
+  ev.data.fd = p[0];
+  assert(epoll_ctl(arg.ep, EPOLL_CTL_ADD, p[0], &ev) == 0);
+  th = myth_create(epoll_reader, &arg);
+  assert(write(p[1], "e", 1) == 1);
+  myth_join(th, 0);
+  assert(close(arg.ep) == 0);
+  assert(close(p[0]) == 0);
+  assert(close(p[1]) == 0);
+}
+
+static int run(void) {
+  int s = socket(AF_INET, SOCK_STREAM, 0);
+  int on;
+  assert(s >= 0);
+  /* we did not ask for it; the I/O layer did */
+  on = (fcntl(s, F_GETFL) & O_NONBLOCK) != 0;
+  close(s);
+  if (!on) return 0;
+  polls();
+  timeouts();
+  readiness();
+  return 1;
+}
+
+int main() {
+  /* must be set before the first call to MassiveThreads */
+  setenv("MYTH_WRAP_SOCKIO", "1", 1);
+  myth_init();
+  if (!run()) {
+    printf("socket calls are not multiplexed\n");
+  } else {
+    myth_fini();
+    setenv("MYTH_IO_URING", "0", 1);
+    myth_init();
+    assert(run());
+  }
+  myth_fini();
+  printf("OK\n");
+  return 0;
+}
@@ -0,0 +1,135 @@
+#include <assert.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+#include <myth/myth.h>
+
+/* sockets of user threads with MYTH_WRAP_SOCKIO=1 while workers
+   are never idle. threads computing (and yielding) until the last
+   request is answered keep every runqueue non-empty, so requests
+   are served only if I/O is checked between threads; otherwise
+   the test hangs. the request latency under this load is shown.
+   this is done with io_uring (if the kernel supports it), then
+   with epoll, and then checking I/O only by time and letting
+   ready threads run after the computing ones.
+   with libmyth, socket calls are not wrapped and the test does
+   nothing */
+
+enum { n_reqs = 200 };
+
+static double cur_time(void) {
+  struct timeval tv[1];
+  gettimeofday(tv, 0);
+  return tv->tv_sec + tv->tv_usec * 1.0e-6;
+}
+
+/* a connected pair of TCP sockets over loopback */
+static void tcp_pair(int * a, int * b) {
+  struct sockaddr_in addr;
+  socklen_t len = sizeof(addr);
+  int ls = socket(AF_INET, SOCK_STREAM, 0);
+  assert(ls >= 0);
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  assert(bind(ls, (struct sockaddr *)&addr, len) == 0);
+  assert(getsockname(ls, (struct sockaddr *)&addr, &len) == 0);
+  assert(listen(ls, 1) == 0);
+  *a = socket(AF_INET, SOCK_STREAM, 0);
+  assert(*a >= 0);
+  assert(connect(*a, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+  *b = accept(ls, 0, 0);
+  assert(*b >= 0);
+  assert(close(ls) == 0);
+}
+
+static volatile int stop;
+
+void * compute(void * arg) {
+  volatile long x = 0;
+  long i;
+  (void)arg;
+  while (!stop) {
+    for (i = 0; i < 1000; i++) x += i;
+    myth_yield();
+  }
+  return 0;
+}
+
+/* answer each byte with the byte after it */
+void * server(void * arg) {
+  int s = (int)(long)arg;
+  int i;
+  for (i = 0; i < n_reqs; i++) {
+    char c;
+    assert(recv(s, &c, 1, 0) == 1);
+    c++;
+    assert(send(s, &c, 1, 0) == 1);
+  }
+  return 0;
+}
+
+static int run(const char * what) {
+  int n_compute = 4 * myth_get_num_workers();
+  myth_thread_t * th = malloc(sizeof(myth_thread_t) * n_compute);
+  myth_thread_t sv_th;
+  double total = 0.0, worst = 0.0;
+  int sv[2], on, i;
+  tcp_pair(&sv[0], &sv[1]);
+  /* we did not ask for it; the I/O layer did */
+  on = (fcntl(sv[0], F_GETFL) & O_NONBLOCK) != 0;
+  if (on) {
+    stop = 0;
+    for (i = 0; i < n_compute; i++) th[i] = myth_create(compute, 0);
+    sv_th = myth_create(server, (void *)(long)sv[1]);
+    for (i = 0; i < n_reqs; i++) {
+      char c = (char)i;
+      double t0 = cur_time(), t;
+      assert(send(sv[0], &c, 1, 0) == 1);
+      assert(recv(sv[0], &c, 1, 0) == 1);
+      assert(c == (char)(i + 1));
+      t = cur_time() - t0;
+      total += t;
+      if (t > worst) worst = t;
+    }
+    stop = 1;
+    myth_join(sv_th, 0);
+    for (i = 0; i < n_compute; i++) myth_join(th[i], 0);
+    printf("%s: %d requests under load, latency avg %.1f us max %.1f us\n",
+           what, n_reqs, total / n_reqs * 1.0e6, worst * 1.0e6);
+  }
+  assert(close(sv[0]) == 0);
+  assert(close(sv[1]) == 0);
+  free(th);
+  return on;
+}
+
+int main() {
+  /* must be set before the first call to MassiveThreads */
+  setenv("MYTH_WRAP_SOCKIO", "1", 1);
+  myth_init();
+  if (!run("default")) {
+    printf("socket calls are not multiplexed\n");
+  } else {
+    myth_fini();
+    setenv("MYTH_IO_URING", "0", 1);
+    myth_init();
+    assert(run("epoll"));
+    myth_fini();
+    setenv("MYTH_IO_POLL_SWITCHES", "0", 1);
+    setenv("MYTH_IO_POLL_INTERVAL", "200", 1);
+    setenv("MYTH_IO_POLL_PRIO", "0", 1);
+    myth_init();
+    assert(run("epoll, every 200us, I/O last"));
+  }
+  myth_fini();
+  printf("OK\n");
+  return 0;
+}
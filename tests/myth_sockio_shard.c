@@ -0,0 +1,126 @@
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include <myth/myth.h>
+
+/* a listening socket of user threads with MYTH_WRAP_SOCKIO=1 and
+   MYTH_IO_SHARD=1, which has a socket for each worker behind it.
+   connections spread over them must all be accepted, by threads
+   each waiting for one and by a single thread taking them one by
+   one, and once the socket is closed no connection is accepted.
+   this is done with io_uring (if the kernel supports it) and then
+   with epoll.
+   with libmyth, socket calls are not wrapped and the test does
+   nothing */
+
+enum { n_conns = 64 };
+
+static int seen[n_conns];
+
+static int connect_to(struct sockaddr_in * addr, char id) {
+  int s = socket(AF_INET, SOCK_STREAM, 0);
+  assert(s >= 0);
+  assert(connect(s, (struct sockaddr *)addr, sizeof(*addr)) == 0);
+  assert(send(s, &id, 1, 0) == 1);
+  return s;
+}
+
+/* the id the client sent, which is seen once */
+static void serve(int s) {
+  char id = -1;
+  assert(recv(s, &id, 1, 0) == 1);
+  assert(id >= 0 && id < n_conns);
+  assert(!__sync_fetch_and_add(&seen[(int)id], 1));
+  assert(close(s) == 0);
+}
+
+void * acceptor(void * arg) {
+  int ls = (int)(long)arg;
+  int s = accept(ls, 0, 0);
+  assert(s >= 0);
+  serve(s);
+  return 0;
+}
+
+void * accept_all(void * arg) {
+  int ls = (int)(long)arg;
+  int i;
+  for (i = 0; i < n_conns; i++) {
+    int s = accept(ls, 0, 0);
+    assert(s >= 0);
+    serve(s);
+  }
+  return 0;
+}
+
+static int run(void) {
+  myth_thread_t th[n_conns];
+  struct sockaddr_in addr;
+  socklen_t len = sizeof(addr);
+  int cs[n_conns];
+  int ls, on, one = 0, i, s;
+  ls = socket(AF_INET, SOCK_STREAM, 0);
+  assert(ls >= 0);
+  /* we did not ask for it; the I/O layer did */
+  on = (fcntl(ls, F_GETFL) & O_NONBLOCK) != 0;
+  if (!on) {
+    close(ls);
+    return 0;
+  }
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  assert(bind(ls, (struct sockaddr *)&addr, len) == 0);
+  assert(getsockname(ls, (struct sockaddr *)&addr, &len) == 0);
+  assert(listen(ls, 2 * n_conns) == 0);
+  /* set by bind for the other workers' sockets */
+  len = sizeof(one);
+  assert(getsockopt(ls, SOL_SOCKET, SO_REUSEPORT, &one, &len) == 0);
+  assert(one);
+  /* acceptors wait before the connections come */
+  memset(seen, 0, sizeof(seen));
+  for (i = 0; i < n_conns; i++) th[i] = myth_create(acceptor, (void *)(long)ls);
+  for (i = 0; i < n_conns; i++) cs[i] = connect_to(&addr, (char)i);
+  for (i = 0; i < n_conns; i++) myth_join(th[i], 0);
+  for (i = 0; i < n_conns; i++) assert(close(cs[i]) == 0);
+  /* one thread gets those of all workers */
+  memset(seen, 0, sizeof(seen));
+  th[0] = myth_create(accept_all, (void *)(long)ls);
+  for (i = 0; i < n_conns; i++) cs[i] = connect_to(&addr, (char)i);
+  myth_join(th[0], 0);
+  for (i = 0; i < n_conns; i++) assert(close(cs[i]) == 0);
+  /* no socket listens on the address any more */
+  assert(close(ls) == 0);
+  s = socket(AF_INET, SOCK_STREAM, 0);
+  assert(s >= 0);
+  assert(connect(s, (struct sockaddr *)&addr, sizeof(addr)) == -1);
+  assert(errno == ECONNREFUSED);
+  assert(close(s) == 0);
+  return 1;
+}
+
+int main() {
+  /* must be set before the first call to MassiveThreads */
+  setenv("MYTH_WRAP_SOCKIO", "1", 1);
+  setenv("MYTH_IO_SHARD", "1", 1);
+  myth_init();
+  if (!run()) {
+    printf("socket calls are not multiplexed\n");
+  } else {
+    myth_fini();
+    setenv("MYTH_IO_URING", "0", 1);
+    myth_init();
+    assert(run());
+  }
+  myth_fini();
+  printf("OK\n");
+  return 0;
+}
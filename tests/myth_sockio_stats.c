@@ -0,0 +1,194 @@
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+#include <myth/myth.h>
+
+/* per-fd counters and slow calls of sockets of user threads with
+   MYTH_WRAP_SOCKIO=1, MYTH_IO_STATS=1 and MYTH_IO_SLOW_USEC set.
+   a thread receiving before anything is sent must be counted as
+   having waited, and its call recorded as slow, while the send is
+   counted as done at once. the stats are then dumped by a call
+   and by MYTH_IO_STATS_SIGNAL, and dumped again and again while
+   another thread opens and closes sockets.
+   this is done with io_uring (if the kernel supports it) and then
+   with epoll.
+   with libmyth, socket calls are not wrapped and the test does
+   nothing */
+
+enum { msg_size = 100, slow_usec = 10000, wait_usec = 30000,
+       n_churns = 2000 };
+
+static double cur_time(void) {
+  struct timeval tv[1];
+  gettimeofday(tv, 0);
+  return tv->tv_sec + tv->tv_usec * 1.0e-6;
+}
+
+/* a connected pair of TCP sockets over loopback */
+static void tcp_pair(int * a, int * b) {
+  struct sockaddr_in addr;
+  socklen_t len = sizeof(addr);
+  int ls = socket(AF_INET, SOCK_STREAM, 0);
+  assert(ls >= 0);
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  assert(bind(ls, (struct sockaddr *)&addr, len) == 0);
+  assert(getsockname(ls, (struct sockaddr *)&addr, &len) == 0);
+  assert(listen(ls, 1) == 0);
+  *a = socket(AF_INET, SOCK_STREAM, 0);
+  assert(*a >= 0);
+  assert(connect(*a, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+  *b = accept(ls, 0, 0);
+  assert(*b >= 0);
+  assert(close(ls) == 0);
+}
+
+void * receiver(void * arg) {
+  int s = (int)(long)arg;
+  char buf[msg_size];
+  int got = 0;
+  while (got < msg_size) {
+    ssize_t r = recv(s, buf + got, msg_size - got, 0);
+    assert(r > 0);
+    got += r;
+  }
+  return 0;
+}
+
+/* what has been written to the non-blocking pipe P so far */
+static int drain(int p, char * buf, int size) {
+  int got = 0;
+  ssize_t r;
+  while (got < size - 1 && (r = read(p, buf + got, size - 1 - got)) > 0) got += r;
+  buf[got] = 0;
+  return got;
+}
+
+static char out[1 << 16];
+
+static volatile int churning;
+
+void * churner(void * arg) {
+  int i;
+  (void)arg;
+  for (i = 0; i < n_churns; i++) {
+    int s = socket(AF_INET, SOCK_STREAM, 0);
+    assert(s >= 0);
+    assert(close(s) == 0);
+    if (i % 16 == 0) myth_yield();
+  }
+  churning = 0;
+  return 0;
+}
+
+static int run(void) {
+  myth_io_fd_stats_t st;
+  myth_io_slow_op_t ops[16];
+  myth_thread_t th;
+  char buf[msg_size];
+  double t0;
+  int a, b, p[2], err2, got, n, on, s;
+  s = socket(AF_INET, SOCK_STREAM, 0);
+  assert(s >= 0);
+  /* we did not ask for it; the I/O layer did */
+  on = (fcntl(s, F_GETFL) & O_NONBLOCK) != 0;
+  close(s);
+  if (!on) {
+    assert(myth_io_get_fd_stats(0, &st) == EINVAL);
+    return 0;
+  }
+  tcp_pair(&a, &b);
+  /* it waits while we keep running */
+  th = myth_create(receiver, (void *)(long)b);
+  t0 = cur_time();
+  while (cur_time() - t0 < wait_usec * 1.0e-6) myth_yield();
+  memset(buf, 'x', sizeof(buf));
+  assert(send(a, buf, msg_size, 0) == msg_size);
+  myth_join(th, 0);
+  assert(myth_io_get_fd_stats(b, &st) == 0);
+  assert(st.n_reads >= 1 && st.read_bytes == msg_size);
+  assert(st.n_eagain >= 1 && st.park_usec >= slow_usec);
+  assert(myth_io_get_fd_stats(a, &st) == 0);
+  assert(st.n_writes == 1 && st.written_bytes == msg_size);
+  assert(st.n_eagain == 0);
+  n = myth_io_get_slow_ops(ops, 16);
+  assert(n >= 1);
+  assert(ops[n - 1].fd == b && strcmp(ops[n - 1].op, "recv") == 0);
+  assert(ops[n - 1].thread == th && ops[n - 1].usec >= slow_usec);
+  assert(ops[n - 1].ret > 0);
+  /* dumped on request */
+  assert(pipe(p) == 0);
+  assert(fcntl(p[0], F_SETFL, O_NONBLOCK) == 0);
+  assert(myth_io_dump_stats(p[1]) == 0);
+  drain(p[0], out, sizeof(out));
+  assert(strstr(out, "myth I/O stats"));
+  assert(strstr(out, " recv "));
+  /* and on the signal, by a worker, to the standard error */
+  err2 = dup(2);
+  assert(err2 >= 0);
+  assert(dup2(p[1], 2) == 2);
+  assert(raise(SIGUSR2) == 0);
+  t0 = cur_time();
+  out[0] = 0;
+  got = 0;
+  while (!strstr(out, "slow calls") && cur_time() - t0 < 5.0) {
+    myth_yield();
+    got += drain(p[0], out + got, sizeof(out) - got);
+  }
+  assert(dup2(err2, 2) == 2);
+  assert(close(err2) == 0);
+  assert(strstr(out, "myth I/O stats"));
+  assert(strstr(out, "slow calls"));
+  assert(close(p[0]) == 0);
+  assert(close(p[1]) == 0);
+  /* a dump must not read the counters of a socket being freed */
+  s = open("/dev/null", O_WRONLY);
+  assert(s >= 0);
+  churning = 1;
+  th = myth_create(churner, 0);
+  while (churning) {
+    assert(myth_io_dump_stats(s) == 0);
+    myth_yield();
+  }
+  myth_join(th, 0);
+  assert(close(s) == 0);
+  assert(close(a) == 0);
+  assert(close(b) == 0);
+  /* counters go with the socket */
+  assert(myth_io_get_fd_stats(a, &st) == EINVAL);
+  return 1;
+}
+
+int main() {
+  char val[16];
+  /* must be set before the first call to MassiveThreads */
+  setenv("MYTH_WRAP_SOCKIO", "1", 1);
+  setenv("MYTH_IO_STATS", "1", 1);
+  sprintf(val, "%d", slow_usec);
+  setenv("MYTH_IO_SLOW_USEC", val, 1);
+  sprintf(val, "%d", SIGUSR2);
+  setenv("MYTH_IO_STATS_SIGNAL", val, 1);
+  myth_init();
+  if (!run()) {
+    printf("socket calls are not multiplexed\n");
+  } else {
+    myth_fini();
+    setenv("MYTH_IO_URING", "0", 1);
+    myth_init();
+    assert(run());
+  }
+  myth_fini();
+  printf("OK\n");
+  return 0;
+}
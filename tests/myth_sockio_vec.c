@@ -0,0 +1,276 @@
+#define _GNU_SOURCE 1
+
+#include <assert.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include <myth/myth.h>
+
+/* vectored and zero-copy socket calls of user threads with
+   MYTH_WRAP_SOCKIO=1: readv/writev, recvmsg/sendmsg, send and
+   sendmsg with MSG_ZEROCOPY, sendfile and splice. in each case
+   the receiving thread starts first and finds nothing to read,
+   so a call blocking its worker would hang the test when there
+   is only one worker. this is done with io_uring (if the kernel
+   supports it) and then with epoll.
+   with libmyth, socket calls are not wrapped and the test does
+   nothing */
+
+#ifndef SO_ZEROCOPY
+#define SO_ZEROCOPY 60
+#endif
+#ifndef MSG_ZEROCOPY
+#define MSG_ZEROCOPY 0x4000000
+#endif
+
+enum { big = 1 << 20 };
+
+static char byte_at(long i) {
+  return (char)(i * 7 + (i >> 12));
+}
+
+/* a connected pair of TCP sockets over loopback */
+static void tcp_pair(int * a, int * b) {
+  struct sockaddr_in addr;
+  socklen_t len = sizeof(addr);
+  int ls = socket(AF_INET, SOCK_STREAM, 0);
+  assert(ls >= 0);
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  assert(bind(ls, (struct sockaddr *)&addr, len) == 0);
+  assert(getsockname(ls, (struct sockaddr *)&addr, &len) == 0);
+  assert(listen(ls, 1) == 0);
+  *a = socket(AF_INET, SOCK_STREAM, 0);
+  assert(*a >= 0);
+  assert(connect(*a, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+  *b = accept(ls, 0, 0);
+  assert(*b >= 0);
+  assert(close(ls) == 0);
+}
+
+typedef struct {
+  int s;
+  int how;
+} rd_arg_t;
+
+enum { rd_recv, rd_readv, rd_recvmsg, rd_splice };
+
+/* receive BIG bytes and check them */
+void * reader(void * arg_) {
+  rd_arg_t * arg = (rd_arg_t *)arg_;
+  char * buf = (char *)malloc(big);
+  long got = 0, i;
+  int p[2];
+  if (arg->how == rd_splice) assert(pipe(p) == 0);
+  while (got < big) {
+    long want = big - got;
+    ssize_t r;
+    if (want > 65536) want = 65536;
+    switch (arg->how) {
+    case rd_recv:
+      r = recv(arg->s, buf + got, want, 0);
+      break;
+    case rd_readv:
+    case rd_recvmsg: {
+      /* scatter into three pieces */
+      struct iovec iov[3];
+      long h = want / 3;
+      iov[0].iov_base = buf + got;
+      iov[0].iov_len = h;
+      iov[1].iov_base = buf + got + h;
+      iov[1].iov_len = h;
+      iov[2].iov_base = buf + got + 2 * h;
+      iov[2].iov_len = want - 2 * h;
+      if (arg->how == rd_readv) {
+	r = readv(arg->s, iov, 3);
+      } else {
+	struct msghdr msg;
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = iov;
+	msg.msg_iovlen = 3;
+	r = recvmsg(arg->s, &msg, 0);
+      }
+      break;
+    }
+    case rd_splice: {
+      /* the pipe is empty, so it takes all we splice */
+      ssize_t k;
+      r = splice(arg->s, 0, p[1], 0, want, 0);
+      assert(r > 0);
+      for (k = 0; k < r; ) {
+	ssize_t q = read(p[0], buf + got + k, r - k);
+	assert(q > 0);
+	k += q;
+      }
+      break;
+    }
+    default:
+      assert(0);
+      r = -1;
+    }
+    assert(r > 0);
+    got += r;
+  }
+  for (i = 0; i < big; i++) assert(buf[i] == byte_at(i));
+  if (arg->how == rd_splice) {
+    assert(close(p[0]) == 0);
+    assert(close(p[1]) == 0);
+  }
+  free(buf);
+  return 0;
+}
+
+static char * pattern(void) {
+  char * buf = (char *)malloc(big);
+  long i;
+  for (i = 0; i < big; i++) buf[i] = byte_at(i);
+  return buf;
+}
+
+/* gather from three pieces */
+static void write_vec(int s, char * buf, int use_msg, int flags) {
+  long sent = 0;
+  while (sent < big) {
+    long want = big - sent;
+    struct iovec iov[3];
+    ssize_t r;
+    if (want > 100000) want = 100000;
+    iov[0].iov_base = buf + sent;
+    iov[0].iov_len = want / 2;
+    iov[1].iov_base = buf + sent + want / 2;
+    iov[1].iov_len = 1;
+    iov[2].iov_base = buf + sent + want / 2 + 1;
+    iov[2].iov_len = want - want / 2 - 1;
+    if (use_msg) {
+      struct msghdr msg;
+      memset(&msg, 0, sizeof(msg));
+      msg.msg_iov = iov;
+      msg.msg_iovlen = 3;
+      r = sendmsg(s, &msg, flags);
+    } else {
+      r = writev(s, iov, 3);
+    }
+    assert(r > 0);
+    /* with MSG_ZEROCOPY, the buffer is ours again */
+    if (flags & MSG_ZEROCOPY) memset(buf + sent, 0, r);
+    sent += r;
+  }
+}
+
+static void send_zc(int s, char * buf) {
+  long sent = 0;
+  while (sent < big) {
+    ssize_t r = send(s, buf + sent, big - sent, MSG_ZEROCOPY);
+    assert(r > 0);
+    memset(buf + sent, 0, r);
+    sent += r;
+  }
+}
+
+static void send_file(int s) {
+  char path[64];
+  char * buf = pattern();
+  off_t off = 0;
+  int fd;
+  snprintf(path, sizeof(path), "myth_sockio_vec.%d.tmp", (int)getpid());
+  fd = open(path, O_CREAT | O_TRUNC | O_RDWR, 0600);
+  assert(fd >= 0);
+  assert(unlink(path) == 0);
+  assert(write(fd, buf, big) == big);
+  while (off < big) {
+    assert(sendfile(s, fd, &off, big - off) > 0);
+  }
+  assert(close(fd) == 0);
+  free(buf);
+}
+
+/* send BIG bytes over one socket of a pair in the way HOW
+   while the other end receives them in the way RD */
+static void transfer(int how, int rd) {
+  rd_arg_t arg;
+  myth_thread_t th;
+  int a, b, one = 1;
+  char * buf = pattern();
+  tcp_pair(&a, &b);
+  arg.s = b;
+  arg.how = rd;
+  th = myth_create(reader, &arg);
+  switch (how) {
+  case 0:
+    write_vec(a, buf, 0, 0);
+    break;
+  case 1:
+    write_vec(a, buf, 1, 0);
+    break;
+  case 2:
+    /* an old kernel does not have SO_ZEROCOPY,
+       and then ignores MSG_ZEROCOPY */
+    setsockopt(a, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one));
+    write_vec(a, buf, 1, MSG_ZEROCOPY);
+    break;
+  case 3:
+    if (setsockopt(a, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) == 0) {
+      struct pollfd p = { a, 0, 0 };
+      send_zc(a, buf);
+      /* every send has been waited for, so the I/O layer has
+	 consumed all the notifications on the error queue */
+      assert(poll(&p, 1, 0) == 0 || !(p.revents & POLLERR));
+    } else {
+      send_zc(a, buf);
+    }
+    break;
+  case 4:
+    send_file(a);
+    break;
+  default:
+    assert(0);
+  }
+  myth_join(th, 0);
+  assert(close(a) == 0);
+  assert(close(b) == 0);
+  free(buf);
+}
+
+static int run(void) {
+  int s = socket(AF_INET, SOCK_STREAM, 0);
+  int on;
+  assert(s >= 0);
+  /* we did not ask for it; the I/O layer did */
+  on = (fcntl(s, F_GETFL) & O_NONBLOCK) != 0;
+  close(s);
+  if (!on) return 0;
+  transfer(0, rd_readv);
+  transfer(1, rd_recvmsg);
+  transfer(2, rd_recv);
+  transfer(3, rd_readv);
+  transfer(4, rd_recv);
+  transfer(0, rd_splice);
+  return 1;
+}
+
+int main() {
+  /* must be set before the first call to MassiveThreads */
+  setenv("MYTH_WRAP_SOCKIO", "1", 1);
+  myth_init();
+  if (!run()) {
+    printf("socket calls are not multiplexed\n");
+  } else {
+    myth_fini();
+    setenv("MYTH_IO_URING", "0", 1);
+    myth_init();
+    assert(run());
+  }
+  myth_fini();
+  printf("OK\n");
+  return 0;
+}
@@ -0,0 +1,112 @@
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <myth/myth.h>
+
+/* the scheduling counters of myth_get_stats must count the
+   threads and tasks created and the joins that waited, agree with
+   the per-victim steal counts, and be written every
+   MYTH_STATS_INTERVAL milliseconds while the program runs */
+
+enum { n_threads = 1000, n_tasks = 1000 };
+
+void * f(void * arg) {
+  if ((long)arg % 2) myth_yield();
+  return arg;
+}
+
+void * g(void * arg) {
+  return arg;
+}
+
+static void sleep_ms(long ms) {
+  struct timespec ts[1] = { { ms / 1000, (ms % 1000) * 1000000L } };
+  nanosleep(ts, 0);
+}
+
+int main() {
+  myth_thread_t th[n_threads];
+  myth_task_t t[n_tasks];
+  myth_stats_t s0, s1, sw;
+  unsigned long long * attempts, * steals;
+  char path[] = "/tmp/myth_stats_XXXXXX";
+  char buf[256];
+  int fd = mkstemp(path);
+  int saved_err = dup(2);
+  long i;
+  unsigned nw;
+  FILE * fp;
+  assert(fd >= 0);
+  /* must be set before the first call to MassiveThreads */
+  setenv("MYTH_STATS_INTERVAL", "20", 1);
+  dup2(fd, 2);
+  myth_init();
+  nw = myth_get_num_workers();
+  assert(myth_get_stats(-1, &s0) == 0);
+  for (i = 0; i < n_threads; i++) th[i] = myth_create(f, (void *)i);
+  for (i = 0; i < n_threads; i++) {
+    void * r;
+    myth_join(th[i], &r);
+    assert((long)r == i);
+  }
+  for (i = 0; i < n_tasks; i++) myth_task_spawn(&t[i], g, (void *)i);
+  for (i = n_tasks - 1; i >= 0; i--) {
+    void * r;
+    myth_task_join(&t[i], &r);
+    assert((long)r == i);
+  }
+  assert(myth_get_stats(-1, &s1) == 0);
+  assert(s1.n_creates - s0.n_creates >= n_threads);
+  assert(s1.n_task_spawns - s0.n_task_spawns == n_tasks);
+  assert(s1.n_switches - s0.n_switches >= n_threads);
+  assert(s1.n_local_pops >= s0.n_local_pops);
+  assert(s1.n_steals <= s1.n_steal_attempts);
+  /* the sum is that of the workers */
+  memset(&s0, 0, sizeof(s0));
+  for (i = 0; i < nw; i++) {
+    assert(myth_get_stats(i, &sw) == 0);
+    s0.n_task_spawns += sw.n_task_spawns;
+  }
+  assert(s0.n_task_spawns >= s1.n_task_spawns);
+  /* and steals are those of the victims */
+  attempts = calloc(nw, sizeof(unsigned long long));
+  steals = calloc(nw, sizeof(unsigned long long));
+  for (i = 0; i < nw; i++) {
+    long j;
+    assert(myth_get_stats(i, &sw) == 0);
+    assert(myth_get_steal_stats(i, attempts, steals) == 0);
+    assert(attempts[i] == 0);
+    for (j = 0; j < nw; j++) {
+      assert(steals[j] <= attempts[j]);
+      sw.n_steal_attempts -= attempts[j];
+    }
+    /* may have tried again in between */
+    assert((long long)sw.n_steal_attempts <= 0);
+  }
+  assert(myth_get_stats(nw, &sw) == EINVAL);
+  assert(myth_get_steal_stats(-2, attempts, 0) == EINVAL);
+  sleep_ms(100);
+  assert(myth_dump_stats(fd) == 0);
+  myth_fini();
+  dup2(saved_err, 2);
+  /* written periodically, and once by myth_dump_stats */
+  fp = fdopen(fd, "r");
+  rewind(fp);
+  i = 0;
+  while (fgets(buf, sizeof(buf), fp)) {
+    if (strncmp(buf, "myth stats:", 11) == 0) i++;
+  }
+  fclose(fp);
+  unlink(path);
+  assert(i >= 2);
+  printf("%ld dumps\n", i);
+  free(attempts);
+  free(steals);
+  printf("OK\n");
+  return 0;
+}
@@ -0,0 +1,98 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <myth/myth.h>
+
+/* children spawned by myth_task_spawn, which get a thread only
+   when another worker takes them. they must all run exactly once
+   and return their results, whether they are joined in the order
+   they were spawned in reverse (recursively, in fib), in the order
+   they were spawned, or after the spawner moved to another worker */
+
+enum { n_tasks = 100 };
+
+long fib_serial(long n) {
+  return (n < 2 ? n : fib_serial(n - 1) + fib_serial(n - 2));
+}
+
+void * fib(void * arg) {
+  long n = (long)arg;
+  if (n < 2) {
+    return (void *)n;
+  } else {
+    myth_task_t t;
+    void * x;
+    long y;
+    myth_task_spawn(&t, fib, (void *)(n - 1));
+    y = (long)fib((void *)(n - 2));
+    assert(myth_task_join(&t, &x) == 0);
+    return (void *)((long)x + y);
+  }
+}
+
+static long done[n_tasks];
+
+void * square(void * arg) {
+  long i = (long)arg;
+  /* give other workers a chance to take the rest */
+  myth_yield();
+  assert(__sync_fetch_and_add(&done[i], 1) == 0);
+  return (void *)(i * i);
+}
+
+void * run_fib(void * arg) {
+  return fib(arg);
+}
+
+/* spawn, join in ORDER (1 : as spawned, -1 : reverse),
+   yielding between them if MOVE */
+static void spawn_join(int order, int move) {
+  myth_task_t t[n_tasks];
+  long i;
+  for (i = 0; i < n_tasks; i++) {
+    done[i] = 0;
+    assert(myth_task_spawn(&t[i], square, (void *)i) == 0);
+  }
+  if (move) {
+    for (i = 0; i < 10; i++) myth_yield();
+  }
+  for (i = 0; i < n_tasks; i++) {
+    long j = (order > 0 ? i : n_tasks - 1 - i);
+    void * r = 0;
+    assert(myth_task_join(&t[j], &r) == 0);
+    assert((long)r == j * j);
+    assert(done[j] == 1);
+  }
+}
+
+void * run_spawn_join(void * arg) {
+  long k = (long)arg;
+  spawn_join((k & 1) ? 1 : -1, (k & 2) != 0);
+  return 0;
+}
+
+int main(int argc, char ** argv) {
+  long n = (argc > 1 ? atol(argv[1]) : 22);
+  myth_thread_t th[4];
+  void * r;
+  long k;
+  myth_task_t t;
+  /* from the main thread */
+  assert(myth_task_spawn(&t, run_fib, (void *)n) == 0);
+  assert(myth_task_join(&t, &r) == 0);
+  assert((long)r == fib_serial(n));
+  for (k = 0; k < 4; k++) run_spawn_join((void *)k);
+  /* from threads, several at a time */
+  for (k = 0; k < 4; k++) th[k] = myth_create(run_fib, (void *)n);
+  for (k = 0; k < 4; k++) {
+    myth_join(th[k], &r);
+    assert((long)r == fib_serial(n));
+  }
+  for (k = 0; k < 4; k++) {
+    th[0] = myth_create(run_spawn_join, (void *)k);
+    myth_join(th[0], 0);
+  }
+  printf("OK\n");
+  return 0;
+}
@@ -0,0 +1,103 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <myth/myth.h>
+
+/* malloc, calloc, realloc and free with MYTH_WRAP_MALLOC=1.
+   with libmyth-ld and libmyth-dl small blocks come from the
+   workers' caches; blocks are allocated in leaves and freed or
+   reallocated by their parents, which often run on another
+   worker. with libmyth, this is just a test of the real malloc */
+
+typedef struct {
+  long a;
+  long b;
+  char * p;			/* block allocated by this subtree */
+  size_t sz;			/* its size */
+} arg_t;
+
+static size_t size_of(long a) {
+  /* mostly small, sometimes beyond the largest slab block */
+  return (a % 7 == 0 ? 5000 + a % 3000 : 1 + (a * 37) % 2000);
+}
+
+static void fill(char * p, size_t sz, long a) {
+  size_t i;
+  for (i = 0; i < sz; i++) p[i] = (char)(a + i);
+}
+
+static void check(char * p, size_t sz, long a) {
+  size_t i;
+  for (i = 0; i < sz; i++) assert(p[i] == (char)(a + i));
+}
+
+void * f(void * arg_) {
+  arg_t * arg = (arg_t *)arg_;
+  long a = arg->a, b = arg->b;
+  if (b - a == 1) {
+    size_t sz = size_of(a);
+    size_t i;
+    char * q = (char *)calloc(sz, 1);
+    assert(q);
+    for (i = 0; i < sz; i++) assert(q[i] == 0);
+    free(q);
+    arg->p = (char *)malloc(sz);
+    assert(arg->p);
+    assert(((unsigned long)arg->p) % 16 == 0);
+    fill(arg->p, sz, a);
+    arg->sz = sz;
+  } else {
+    long c = (a + b) / 2;
+    arg_t cargs[2] = { { a, c, 0, 0 }, { c, b, 0, 0 } };
+    myth_thread_t tid = myth_create(f, cargs);
+    f(cargs + 1);
+    myth_join(tid, 0);
+    check(cargs[0].p, cargs[0].sz, cargs[0].a);
+    check(cargs[1].p, cargs[1].sz, cargs[1].a);
+    /* grow one block and shrink the other */
+    size_t sz0 = cargs[0].sz * 3 + 1;
+    size_t sz1 = cargs[1].sz / 3 + 1;
+    char * p0 = (char *)realloc(cargs[0].p, sz0);
+    char * p1 = (char *)realloc(cargs[1].p, sz1);
+    assert(p0 && p1);
+    check(p0, cargs[0].sz, cargs[0].a);
+    check(p1, sz1, cargs[1].a);
+    free(p0);
+    free(p1);
+    arg->sz = size_of(a + b);
+    arg->p = (char *)malloc(arg->sz);
+    fill(arg->p, arg->sz, a);
+  }
+  return 0;
+}
+
+int main(int argc, char ** argv) {
+  long n = (argc > 1 ? atol(argv[1]) : 10000);
+  myth_alloc_stats_t s;
+  char * left;
+  int i;
+  /* must be set before the first call to MassiveThreads */
+  setenv("MYTH_WRAP_MALLOC", "1", 1);
+  for (i = 0; i < 3; i++) {
+    arg_t arg[1] = { { 0, n, 0, 0 } };
+    f(arg);
+    check(arg->p, arg->sz, 0);
+    free(arg->p);
+  }
+  assert(myth_get_alloc_stats(-1, &s) == 0);
+  printf("allocs=%llu frees=%llu remote frees=%llu\n",
+	 s.n_allocs, s.n_frees, s.n_remote_frees);
+  /* a block may outlive the scheduler */
+  left = (char *)malloc(100);
+  fill(left, 100, 1);
+  myth_fini();
+  check(left, 100, 1);
+  left = (char *)realloc(left, 200);
+  check(left, 100, 1);
+  free(left);
+  free(malloc(10));
+  printf("OK\n");
+  return 0;
+}